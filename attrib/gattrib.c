@@ -180,6 +180,14 @@ struct bt_att *g_attrib_get_att(GAttrib *attrib)
 	return attrib->att;
 }
 
+struct bt_gatt_client *g_attrib_get_client(GAttrib *attrib)
+{
+	if (!attrib)
+		return NULL;
+
+	return attrib->client;
+}
+
 gboolean g_attrib_set_destroy_function(GAttrib *attrib, GDestroyNotify destroy,
 							gpointer user_data)
 {
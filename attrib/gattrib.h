@@ -37,6 +37,7 @@ void g_attrib_unref(GAttrib *attrib);
 GIOChannel *g_attrib_get_channel(GAttrib *attrib);
 
 struct bt_att *g_attrib_get_att(GAttrib *attrib);
+struct bt_gatt_client *g_attrib_get_client(GAttrib *attrib);
 
 gboolean g_attrib_set_destroy_function(GAttrib *attrib,
 		GDestroyNotify destroy, gpointer user_data);
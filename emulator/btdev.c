@@ -35,6 +35,7 @@
 #include "src/shared/crypto.h"
 #include "src/shared/ecc.h"
 #include "src/shared/queue.h"
+#include "src/shared/ad.h"
 #include "monitor/bt.h"
 #include "monitor/msft.h"
 #include "monitor/emulator.h"
@@ -136,6 +137,31 @@ struct le_cig {
 	bool activated;
 } __attribute__ ((packed));
 
+struct adv_load_dev {
+	uint8_t addr_type;
+	uint8_t addr[6];
+	uint8_t data[31];
+	uint8_t data_len;
+	uint8_t seq;
+	bool rpa;
+};
+
+struct adv_load {
+	struct btdev_adv_load params;
+	struct adv_load_dev *devs;
+	unsigned int timeout_id;
+	unsigned int remainder;
+	uint32_t rand;
+	uint64_t count;
+};
+
+struct btdev_cmd;
+
+struct btdev_cmd_index {
+	const struct btdev_cmd **cmds;
+	uint16_t len;
+};
+
 struct btdev {
 	enum btdev_type type;
 	uint16_t id;
@@ -183,10 +209,13 @@ struct btdev {
 	uint8_t  le_features[248];
 	uint8_t  le_states[8];
 	const struct btdev_cmd *cmds;
+	struct btdev_cmd_index cmd_index[64];	/* Indexed by OGF */
 	uint16_t msft_opcode;
 	const struct btdev_cmd *msft_cmds;
+	struct btdev_cmd_index msft_index;
 	uint16_t emu_opcode;
 	const struct btdev_cmd *emu_cmds;
+	struct btdev_cmd_index emu_index;
 	bool aosp_capable;
 
 	uint16_t default_link_policy;
@@ -265,6 +294,9 @@ struct btdev {
 	struct queue *le_per_adv;
 	struct queue *le_big;
 
+	bool le_scan_ext;
+	struct adv_load *adv_load;
+
 	btdev_debug_func_t debug_callback;
 	btdev_destroy_func_t debug_destroy;
 	void *debug_data;
@@ -434,6 +466,83 @@ struct btdev_cmd {
 		.complete = _complete, \
 	}
 
+#define CMD_OGF(_opcode) ((_opcode) >> 10)
+#define CMD_OCF(_opcode) ((_opcode) & 0x03ff)
+
+static void cmd_index_clear(struct btdev_cmd_index *index)
+{
+	free(index->cmds);
+	index->cmds = NULL;
+	index->len = 0;
+}
+
+/* Build a lookup table from a command table so that dispatching a command
+ * does not require a linear scan. Only entries whose opcode belongs to the
+ * given OGF are added (ogf < 0 means vendor subcommands which are indexed
+ * by their 8 bit opcode). If the same opcode is listed more than once the
+ * first entry wins, matching the order of the command table.
+ */
+static void cmd_index_build(struct btdev_cmd_index *index,
+				const struct btdev_cmd *cmds, int ogf)
+{
+	const struct btdev_cmd *cmd;
+	uint16_t key;
+
+	cmd_index_clear(index);
+
+	for (cmd = cmds; cmd && cmd->func; cmd++) {
+		if (ogf >= 0 && CMD_OGF(cmd->opcode) != ogf)
+			continue;
+
+		key = ogf >= 0 ? CMD_OCF(cmd->opcode) : cmd->opcode;
+		if (key >= index->len)
+			index->len = key + 1;
+	}
+
+	if (!index->len)
+		return;
+
+	index->cmds = new0(const struct btdev_cmd *, index->len);
+
+	for (cmd = cmds; cmd && cmd->func; cmd++) {
+		if (ogf >= 0 && CMD_OGF(cmd->opcode) != ogf)
+			continue;
+
+		key = ogf >= 0 ? CMD_OCF(cmd->opcode) : cmd->opcode;
+		if (!index->cmds[key])
+			index->cmds[key] = cmd;
+	}
+}
+
+static const struct btdev_cmd *cmd_index_lookup(
+					const struct btdev_cmd_index *index,
+					uint16_t key)
+{
+	if (key >= index->len)
+		return NULL;
+
+	return index->cmds[key];
+}
+
+static void build_cmd_index(struct btdev *btdev)
+{
+	int ogf;
+
+	for (ogf = 0; ogf < (int) ARRAY_SIZE(btdev->cmd_index); ogf++)
+		cmd_index_build(&btdev->cmd_index[ogf], btdev->cmds, ogf);
+}
+
+static void clear_cmd_index(struct btdev *btdev)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(btdev->cmd_index); i++)
+		cmd_index_clear(&btdev->cmd_index[i]);
+
+	cmd_index_clear(&btdev->msft_index);
+	cmd_index_clear(&btdev->emu_index);
+}
+
 static void send_packet(struct btdev *btdev, const struct iovec *iov,
 								int iovlen)
 {
@@ -3846,6 +3955,7 @@ static int cmd_set_scan_enable(struct btdev *dev, const void *data, uint8_t len)
 
 	dev->le_scan_enable = cmd->enable;
 	dev->le_filter_dup = cmd->filter_dup;
+	dev->le_scan_ext = false;
 	status = BT_HCI_ERR_SUCCESS;
 
 done:
@@ -5762,6 +5872,7 @@ static int cmd_set_ext_scan_enable(struct btdev *dev, const void *data,
 
 	dev->le_scan_enable = cmd->enable;
 	dev->le_filter_dup = cmd->filter_dup;
+	dev->le_scan_ext = true;
 	status = BT_HCI_ERR_SUCCESS;
 
 done:
@@ -7829,6 +7940,289 @@ static void set_amp_features(struct btdev *btdev)
 {
 }
 
+#define ADV_LOAD_INTERVAL	10	/* 10 milliseconds */
+#define ADV_LOAD_MAX_BURST	1000
+
+/* Simple xorshift PRNG so that a given seed always produces the same load */
+static uint32_t adv_load_rand(struct adv_load *load)
+{
+	uint32_t x = load->rand;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	load->rand = x;
+
+	return x;
+}
+
+static void adv_load_rand_bytes(struct adv_load *load, uint8_t *buf,
+								size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = adv_load_rand(load);
+}
+
+static size_t adv_load_put(uint8_t *data, size_t len, uint8_t type,
+					const uint8_t *val, size_t val_len)
+{
+	if (len + 2 + val_len > 31)
+		return len;
+
+	data[len++] = val_len + 1;
+	data[len++] = type;
+	memcpy(data + len, val, val_len);
+
+	return len + val_len;
+}
+
+static void adv_load_gen_addr(struct adv_load *load, struct adv_load_dev *dev)
+{
+	adv_load_rand_bytes(load, dev->addr, sizeof(dev->addr));
+
+	if (dev->rpa) {
+		/* Resolvable private address: two MSBs set to 0b01 */
+		dev->addr_type = 0x01;
+		dev->addr[5] = (dev->addr[5] & 0x3f) | 0x40;
+	} else if (adv_load_rand(load) & 1) {
+		/* Static random address: two MSBs set to 0b11 */
+		dev->addr_type = 0x01;
+		dev->addr[5] |= 0xc0;
+	} else
+		dev->addr_type = 0x00;
+}
+
+static void adv_load_gen_data(struct adv_load *load, struct adv_load_dev *dev)
+{
+	static const uint8_t flags = 0x06;
+	uint8_t val[29];
+	uint8_t val_len;
+	size_t len = 0;
+
+	len = adv_load_put(dev->data, len, BT_AD_FLAGS, &flags, 1);
+
+	switch (adv_load_rand(load) % 4) {
+	case 0:
+		/* 1-3 16 bit service UUIDs */
+		val_len = 2 * (1 + adv_load_rand(load) % 3);
+		adv_load_rand_bytes(load, val, val_len);
+		len = adv_load_put(dev->data, len, BT_AD_UUID16_ALL, val,
+								val_len);
+		break;
+	case 1:
+		/* Company ID followed by the sequence and random payload */
+		val_len = 3 + adv_load_rand(load) % 22;
+		adv_load_rand_bytes(load, val, val_len);
+		val[1] &= 0x0f;
+		val[2] = dev->seq;
+		len = adv_load_put(dev->data, len, BT_AD_MANUFACTURER_DATA,
+								val, val_len);
+		break;
+	case 2:
+		val_len = 3 + adv_load_rand(load) % 18;
+		adv_load_rand_bytes(load, val, val_len);
+		val[2] = dev->seq;
+		len = adv_load_put(dev->data, len, BT_AD_SERVICE_DATA16,
+								val, val_len);
+		break;
+	default:
+		val_len = snprintf((char *) val, sizeof(val), "load-%02x%02x",
+						dev->addr[1], dev->addr[0]);
+		len = adv_load_put(dev->data, len, BT_AD_NAME_COMPLETE, val,
+								val_len);
+		break;
+	}
+
+	if (adv_load_rand(load) & 1) {
+		val[0] = adv_load_rand(load) % 20;
+		len = adv_load_put(dev->data, len, BT_AD_TX_POWER, val, 1);
+	}
+
+	dev->data_len = len;
+}
+
+static void adv_load_send_ext_report(struct btdev *btdev,
+					const struct adv_load_dev *dev,
+					int8_t rssi)
+{
+	struct __packed {
+		uint8_t num_reports;
+		union {
+			struct bt_hci_le_ext_adv_report lear;
+			uint8_t raw[24 + 31];
+		};
+	} meta_event;
+
+	memset(&meta_event, 0, sizeof(meta_event));
+	meta_event.num_reports = 1;
+	/* Legacy ADV_IND */
+	meta_event.lear.event_type = cpu_to_le16(0x0013);
+	meta_event.lear.addr_type = dev->addr_type;
+	memcpy(meta_event.lear.addr, dev->addr, 6);
+	meta_event.lear.primary_phy = 0x01;
+	meta_event.lear.sid = 0xff;
+	meta_event.lear.tx_power = 127;
+	meta_event.lear.rssi = rssi;
+	meta_event.lear.data_len = dev->data_len;
+	memcpy(meta_event.lear.data, dev->data, dev->data_len);
+
+	le_meta_event(btdev, BT_HCI_EVT_LE_EXT_ADV_REPORT, &meta_event,
+						1 + 24 + dev->data_len);
+}
+
+static void adv_load_send_report(struct btdev *btdev,
+					const struct adv_load_dev *dev,
+					int8_t rssi)
+{
+	struct __packed {
+		uint8_t subevent;
+		union {
+			struct bt_hci_evt_le_adv_report lar;
+			uint8_t raw[10 + 31 + 1];
+		};
+	} meta_event;
+
+	if (btdev->le_scan_ext) {
+		adv_load_send_ext_report(btdev, dev, rssi);
+		return;
+	}
+
+	memset(&meta_event, 0, sizeof(meta_event));
+	meta_event.subevent = BT_HCI_EVT_LE_ADV_REPORT;
+	meta_event.lar.num_reports = 1;
+	/* ADV_IND */
+	meta_event.lar.event_type = 0x00;
+	meta_event.lar.addr_type = dev->addr_type;
+	memcpy(meta_event.lar.addr, dev->addr, 6);
+	meta_event.lar.data_len = dev->data_len;
+	memcpy(meta_event.lar.data, dev->data, dev->data_len);
+	meta_event.raw[10 + dev->data_len] = rssi;
+
+	send_event(btdev, BT_HCI_EVT_LE_META_EVENT, &meta_event,
+						1 + 10 + dev->data_len + 1);
+}
+
+static bool adv_load_timeout(void *user_data)
+{
+	struct btdev *btdev = user_data;
+	struct adv_load *load = btdev->adv_load;
+	const struct btdev_adv_load *params = &load->params;
+	unsigned int count, range;
+
+	load->remainder += params->rate * ADV_LOAD_INTERVAL;
+	count = load->remainder / 1000;
+	load->remainder %= 1000;
+
+	if (!btdev->le_scan_enable)
+		return true;
+
+	count = MIN(count, ADV_LOAD_MAX_BURST);
+	range = params->rssi_max - params->rssi_min + 1;
+
+	while (count--) {
+		struct adv_load_dev *dev;
+		int8_t rssi;
+
+		dev = &load->devs[adv_load_rand(load) % params->num_devices];
+
+		if (adv_load_rand(load) % 100 < params->change) {
+			dev->seq++;
+
+			/* Model RPA rotation along with the payload change */
+			if (dev->rpa)
+				adv_load_gen_addr(load, dev);
+
+			adv_load_gen_data(load, dev);
+		}
+
+		rssi = params->rssi_min + adv_load_rand(load) % range;
+
+		adv_load_send_report(btdev, dev, rssi);
+		load->count++;
+	}
+
+	return true;
+}
+
+static void adv_load_free(struct adv_load *load)
+{
+	if (!load)
+		return;
+
+	if (load->timeout_id)
+		timeout_remove(load->timeout_id);
+
+	free(load->devs);
+	free(load);
+}
+
+int btdev_set_adv_load(struct btdev *btdev, const struct btdev_adv_load *load)
+{
+	struct adv_load *adv_load;
+	unsigned int i;
+
+	if (!btdev)
+		return -EINVAL;
+
+	adv_load_free(btdev->adv_load);
+	btdev->adv_load = NULL;
+
+	if (!load || !load->rate)
+		return 0;
+
+	if (!load->num_devices || load->rpa > 100 || load->change > 100 ||
+					load->rssi_min > load->rssi_max)
+		return -EINVAL;
+
+	switch (btdev->type) {
+	case BTDEV_TYPE_BREDRLE:
+	case BTDEV_TYPE_LE:
+	case BTDEV_TYPE_BREDRLE50:
+	case BTDEV_TYPE_BREDRLE52:
+	case BTDEV_TYPE_BREDRLE60:
+		break;
+	case BTDEV_TYPE_BREDR:
+	case BTDEV_TYPE_AMP:
+	case BTDEV_TYPE_BREDR20:
+	default:
+		return -ENOTSUP;
+	}
+
+	adv_load = new0(struct adv_load, 1);
+	adv_load->params = *load;
+	adv_load->rand = load->seed ? load->seed : 0x2545f491;
+	adv_load->devs = new0(struct adv_load_dev, load->num_devices);
+
+	for (i = 0; i < load->num_devices; i++) {
+		struct adv_load_dev *dev = &adv_load->devs[i];
+
+		dev->rpa = adv_load_rand(adv_load) % 100 < load->rpa;
+		adv_load_gen_addr(adv_load, dev);
+		adv_load_gen_data(adv_load, dev);
+	}
+
+	adv_load->timeout_id = timeout_add(ADV_LOAD_INTERVAL, adv_load_timeout,
+							btdev, NULL);
+	if (!adv_load->timeout_id) {
+		adv_load_free(adv_load);
+		return -EIO;
+	}
+
+	btdev->adv_load = adv_load;
+
+	return 0;
+}
+
+uint64_t btdev_get_adv_load_count(struct btdev *btdev)
+{
+	if (!btdev || !btdev->adv_load)
+		return 0;
+
+	return btdev->adv_load->count;
+}
+
 struct btdev *btdev_create(enum btdev_type type, uint16_t id)
 {
 	struct btdev *btdev;
@@ -7936,6 +8330,10 @@ struct btdev *btdev_create(enum btdev_type type, uint16_t id)
 
 	btdev->le_al_len = AL_SIZE;
 	btdev->le_rl_len = RL_SIZE;
+
+	/* The command set is fixed once the type has been configured */
+	build_cmd_index(btdev);
+
 	return btdev;
 }
 
@@ -7947,6 +8345,8 @@ void btdev_destroy(struct btdev *btdev)
 	if (btdev->inquiry_id > 0)
 		timeout_remove(btdev->inquiry_id);
 
+	adv_load_free(btdev->adv_load);
+
 	bt_crypto_unref(btdev->crypto);
 	del_btdev(btdev);
 
@@ -7955,6 +8355,8 @@ void btdev_destroy(struct btdev *btdev)
 	queue_destroy(btdev->le_per_adv, free);
 	queue_destroy(btdev->le_big, le_big_free);
 
+	clear_cmd_index(btdev);
+
 	free(btdev);
 }
 
@@ -8109,21 +8511,25 @@ static const struct btdev_cmd *run_cmd(struct btdev *btdev,
 }
 
 static const struct btdev_cmd *vnd_cmd(struct btdev *btdev, uint8_t op,
-					const struct btdev_cmd *cmd,
+					const struct btdev_cmd_index *index,
 					const void *data, uint8_t len)
 {
-	uint8_t opcode = ((const uint8_t *)data)[0];
+	const struct btdev_cmd *cmd;
+	uint8_t opcode;
 
-	for (; cmd && cmd->func; cmd++) {
-		if (cmd->opcode != opcode)
-			continue;
+	if (!len)
+		goto unsupported;
+
+	opcode = ((const uint8_t *)data)[0];
 
+	cmd = cmd_index_lookup(index, opcode);
+	if (cmd)
 		return run_cmd(btdev, cmd, data, len);
-	}
 
 	util_debug(btdev->debug_callback, btdev->debug_data,
 			"Unsupported Vendor subcommand 0x%2.2x", opcode);
 
+unsupported:
 	cmd_status(btdev, BT_HCI_ERR_UNKNOWN_COMMAND, op);
 
 	return NULL;
@@ -8135,17 +8541,15 @@ static const struct btdev_cmd *default_cmd(struct btdev *btdev, uint16_t opcode,
 	const struct btdev_cmd *cmd;
 
 	if (btdev->emu_opcode == opcode)
-		return vnd_cmd(btdev, opcode, btdev->emu_cmds, data, len);
+		return vnd_cmd(btdev, opcode, &btdev->emu_index, data, len);
 
 	if (btdev->msft_opcode == opcode)
-		return vnd_cmd(btdev, opcode, btdev->msft_cmds, data, len);
-
-	for (cmd = btdev->cmds; cmd->func; cmd++) {
-		if (cmd->opcode != opcode)
-			continue;
+		return vnd_cmd(btdev, opcode, &btdev->msft_index, data, len);
 
+	cmd = cmd_index_lookup(&btdev->cmd_index[CMD_OGF(opcode)],
+							CMD_OCF(opcode));
+	if (cmd)
 		return run_cmd(btdev, cmd, data, len);
-	}
 
 	util_debug(btdev->debug_callback, btdev->debug_data,
 			"Unsupported command 0x%4.4x", opcode);
@@ -8585,6 +8989,7 @@ int btdev_set_msft_opcode(struct btdev *btdev, uint16_t opcode)
 	case BTDEV_TYPE_BREDRLE60:
 		btdev->msft_opcode = opcode;
 		btdev->msft_cmds = cmd_msft;
+		cmd_index_build(&btdev->msft_index, cmd_msft, -1);
 		return 0;
 	case BTDEV_TYPE_BREDR:
 	case BTDEV_TYPE_LE:
@@ -8643,6 +9048,7 @@ int btdev_set_emu_opcode(struct btdev *btdev, uint16_t opcode)
 	case BTDEV_TYPE_BREDRLE60:
 		btdev->emu_opcode = opcode;
 		btdev->emu_cmds = cmd_emu;
+		cmd_index_build(&btdev->emu_index, cmd_emu, -1);
 		return 0;
 	case BTDEV_TYPE_BREDR:
 	case BTDEV_TYPE_LE:
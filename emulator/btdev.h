@@ -111,3 +111,17 @@ bool btdev_del_hook(struct btdev *btdev, enum btdev_hook_type type,
 int btdev_set_msft_opcode(struct btdev *btdev, uint16_t opcode);
 int btdev_set_aosp_capable(struct btdev *btdev, bool enable);
 int btdev_set_emu_opcode(struct btdev *btdev, uint16_t opcode);
+
+struct btdev_adv_load {
+	unsigned int rate;		/* Advertising reports per second */
+	unsigned int num_devices;	/* Number of distinct advertisers */
+	uint8_t rpa;			/* Percentage of advertisers using RPAs */
+	uint8_t change;			/* Percentage of reports with new data */
+	int8_t rssi_min;
+	int8_t rssi_max;
+	uint32_t seed;
+};
+
+int btdev_set_adv_load(struct btdev *btdev,
+				const struct btdev_adv_load *load);
+uint64_t btdev_get_adv_load_count(struct btdev *btdev);
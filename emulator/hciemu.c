@@ -664,6 +664,44 @@ void hciemu_set_central_le_rl_len(struct hciemu *hciemu, uint8_t len)
 	btdev_set_rl_len(dev, len);
 }
 
+int hciemu_set_central_adv_load(struct hciemu *hciemu, unsigned int rate,
+						unsigned int num_devices)
+{
+	struct btdev_adv_load load;
+	struct btdev *dev;
+
+	if (!hciemu || !hciemu->vhci)
+		return -EINVAL;
+
+	dev = vhci_get_btdev(hciemu->vhci);
+	if (!dev)
+		return -ENODEV;
+
+	memset(&load, 0, sizeof(load));
+	load.rate = rate;
+	load.num_devices = num_devices;
+	load.rpa = 50;
+	load.change = 10;
+	load.rssi_min = -100;
+	load.rssi_max = -30;
+
+	return btdev_set_adv_load(dev, &load);
+}
+
+uint64_t hciemu_get_central_adv_load_count(struct hciemu *hciemu)
+{
+	struct btdev *dev;
+
+	if (!hciemu || !hciemu->vhci)
+		return 0;
+
+	dev = vhci_get_btdev(hciemu->vhci);
+	if (!dev)
+		return 0;
+
+	return btdev_get_adv_load_count(dev);
+}
+
 const uint8_t *hciemu_get_central_adv_addr(struct hciemu *hciemu,
 								uint8_t handle)
 {
@@ -75,6 +75,10 @@ void hciemu_set_central_le_rl_len(struct hciemu *hciemu, uint8_t len);
 const uint8_t *hciemu_get_central_adv_addr(struct hciemu *hciemu,
 							uint8_t handle);
 
+int hciemu_set_central_adv_load(struct hciemu *hciemu, unsigned int rate,
+						unsigned int num_devices);
+uint64_t hciemu_get_central_adv_load_count(struct hciemu *hciemu);
+
 typedef void (*hciemu_command_func_t)(uint16_t opcode, const void *data,
 						uint8_t len, void *user_data);
 
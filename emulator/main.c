@@ -54,6 +54,7 @@ static void usage(void)
 		"\t-B                    Create BR/EDR only controller\n"
 		"\t-A                    Create AMP controller\n"
 		"\t-T[num]               Number of test AMP controllers\n"
+		"\t-R rate[,devices]     Generate advertising reports load\n"
 		"\t-h, --help            Show help options\n");
 }
 
@@ -67,6 +68,7 @@ static const struct option main_options[] = {
 	{ "bredr",   no_argument,       NULL, 'B' },
 	{ "amp",     no_argument,       NULL, 'A' },
 	{ "letest",  optional_argument, NULL, 'U' },
+	{ "adv-load", required_argument, NULL, 'R' },
 	{ "version", no_argument,	NULL, 'v' },
 	{ "help",    no_argument,	NULL, 'h' },
 	{ }
@@ -93,6 +95,14 @@ int main(int argc, char *argv[])
 	int letest_count = 0;
 	int vhci_count = 0;
 	enum btdev_type type = BTDEV_TYPE_BREDRLE60;
+	struct btdev_adv_load adv_load = {
+		.num_devices = 1000,
+		.rpa = 50,
+		.change = 10,
+		.rssi_min = -100,
+		.rssi_max = -30,
+	};
+	char *endptr;
 	int i;
 
 	mainloop_init();
@@ -100,7 +110,7 @@ int main(int argc, char *argv[])
 	for (;;) {
 		int opt;
 
-		opt = getopt_long(argc, argv, "dSst::l::LBAU::T::vh",
+		opt = getopt_long(argc, argv, "dSst::l::LBAU::T::R:vh",
 						main_options, NULL);
 		if (opt < 0)
 			break;
@@ -142,6 +152,16 @@ int main(int argc, char *argv[])
 			else
 				letest_count = 1;
 			break;
+		case 'R':
+			adv_load.rate = strtoul(optarg, &endptr, 10);
+			if (*endptr == ',')
+				adv_load.num_devices = strtoul(endptr + 1,
+								&endptr, 10);
+			if (*endptr != '\0' || !adv_load.num_devices) {
+				fprintf(stderr, "Invalid advertising load\n");
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'v':
 			printf("%s\n", VERSION);
 			return EXIT_SUCCESS;
@@ -185,6 +205,12 @@ int main(int argc, char *argv[])
 
 		vhci_set_emu_opcode(vhci, 0xfc10);
 		vhci_set_msft_opcode(vhci, 0xfc1e);
+
+		adv_load.seed = i + 1;
+
+		if (adv_load.rate && btdev_set_adv_load(vhci_get_btdev(vhci),
+							&adv_load) < 0)
+			fprintf(stderr, "Failed to set advertising load\n");
 	}
 
 	if (serial_enabled) {
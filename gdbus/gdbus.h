@@ -74,6 +74,7 @@ typedef void (* GDBusSecurityFunction) (DBusConnection *connection,
 enum GDBusFlags {
 	G_DBUS_FLAG_ENABLE_EXPERIMENTAL = (1 << 0),
 	G_DBUS_FLAG_ENABLE_TESTING      = (1 << 1),
+	G_DBUS_FLAG_PROPERTY_SNAPSHOT   = (1 << 2),
 };
 
 enum GDBusMethodFlags {
@@ -104,6 +105,7 @@ enum GDBusSecurityFlags {
 
 enum GDbusPropertyChangedFlags {
 	G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH = (1 << 0),
+	G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE = (1 << 1),
 };
 
 typedef enum GDBusMethodFlags GDBusMethodFlags;
@@ -234,6 +236,19 @@ struct GDBusSecurityTable {
 void g_dbus_set_flags(int flags);
 int g_dbus_get_flags(void);
 
+struct GDBusPropertyStats {
+	unsigned long changed;
+	unsigned long merged;
+	unsigned long deferred;
+	unsigned long signals;
+};
+
+typedef struct GDBusPropertyStats GDBusPropertyStats;
+
+void g_dbus_set_property_coalescing(unsigned int window,
+						unsigned int interval);
+void g_dbus_get_property_stats(GDBusPropertyStats *stats);
+
 typedef void (*g_dbus_destroy_func_t)(void *user_data);
 typedef void (*g_dbus_debug_func_t)(const char *str, void *user_data);
 
@@ -342,6 +357,14 @@ gboolean g_dbus_get_properties(DBusConnection *connection, const char *path,
 gboolean g_dbus_attach_object_manager(DBusConnection *connection);
 gboolean g_dbus_detach_object_manager(DBusConnection *connection);
 
+/*
+ * Implements a paged and filtered GetManagedObjects taking an a{sv} filter
+ * and returning (a{oa{sa{sv}}} objects, o next), for users that want to
+ * export it on an interface of their own.
+ */
+DBusMessage *g_dbus_get_managed_objects_filtered(DBusConnection *connection,
+							DBusMessage *message);
+
 typedef struct GDBusClient GDBusClient;
 typedef struct GDBusProxy GDBusProxy;
 
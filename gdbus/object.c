@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <dbus/dbus.h>
@@ -52,6 +53,8 @@ struct generic_data {
 	GSList *removed;
 	guint process_id;
 	gboolean pending_prop;
+	guint coalesce_id;
+	gint64 coalesce_due;
 	char *introspect;
 	struct generic_data *parent;
 };
@@ -61,11 +64,20 @@ struct interface_data {
 	const GDBusMethodTable *methods;
 	const GDBusSignalTable *signals;
 	const GDBusPropertyTable *properties;
-	GSList *pending_prop;
+	struct property_state *props;
+	unsigned int pending_prop;
+	DBusMessage *snapshot;
 	void *user_data;
 	GDBusDestroyFunction destroy;
 };
 
+/* Indexed the same as the interface property table */
+struct property_state {
+	gboolean pending;
+	gint64 due;
+	gint64 last;
+};
+
 struct security_data {
 	GDBusPendingReply pending;
 	DBusMessage *message;
@@ -89,11 +101,16 @@ static int global_flags = 0;
 static struct generic_data *root;
 static GSList *pending = NULL;
 static struct debug_data debug = { NULL, NULL, NULL };
+static gint64 coalesce_window;
+static gint64 coalesce_interval;
+static GDBusPropertyStats property_stats;
 
 static gboolean process_changes(gpointer user_data);
-static void process_properties_from_interface(struct generic_data *data,
-						struct interface_data *iface);
-static void process_property_changes(struct generic_data *data);
+static gint64 process_properties_from_interface(struct generic_data *data,
+						struct interface_data *iface,
+						gint64 now);
+static void process_property_changes(struct generic_data *data,
+							gboolean force);
 
 static void print_arguments(GString *gstr, const GDBusArgInfo *args,
 						const char *direction)
@@ -610,6 +627,123 @@ static void append_interface(gpointer data, gpointer user_data)
 	dbus_message_iter_close_container(array, &entry);
 }
 
+static void copy_iter(DBusMessageIter *src, DBusMessageIter *dst)
+{
+	int type;
+
+	while ((type = dbus_message_iter_get_arg_type(src)) !=
+							DBUS_TYPE_INVALID) {
+		DBusMessageIter src_sub, dst_sub;
+		DBusBasicValue value;
+		char *sig = NULL;
+		int elem;
+
+		if (dbus_type_is_basic(type)) {
+			dbus_message_iter_get_basic(src, &value);
+			dbus_message_iter_append_basic(dst, type, &value);
+
+			/* Both getting and appending dup the descriptor */
+			if (type == DBUS_TYPE_UNIX_FD)
+				close(value.fd);
+
+			dbus_message_iter_next(src);
+			continue;
+		}
+
+		dbus_message_iter_recurse(src, &src_sub);
+
+		if (type == DBUS_TYPE_ARRAY) {
+			sig = dbus_message_iter_get_signature(src);
+			elem = dbus_message_iter_get_element_type(src);
+
+			dbus_message_iter_open_container(dst, type, sig + 1,
+								&dst_sub);
+
+			/* Byte arrays and alike can be copied in one go */
+			if (dbus_type_is_fixed(elem) &&
+						elem != DBUS_TYPE_UNIX_FD) {
+				const void *ptr;
+				int n;
+
+				dbus_message_iter_get_fixed_array(&src_sub,
+								&ptr, &n);
+				dbus_message_iter_append_fixed_array(&dst_sub,
+								elem, &ptr, n);
+			} else
+				copy_iter(&src_sub, &dst_sub);
+		} else {
+			if (type == DBUS_TYPE_VARIANT)
+				sig = dbus_message_iter_get_signature(&src_sub);
+
+			dbus_message_iter_open_container(dst, type, sig,
+								&dst_sub);
+			copy_iter(&src_sub, &dst_sub);
+		}
+
+		dbus_message_iter_close_container(dst, &dst_sub);
+		dbus_free(sig);
+
+		dbus_message_iter_next(src);
+	}
+}
+
+static void invalidate_snapshot(struct interface_data *iface)
+{
+	if (iface->snapshot == NULL)
+		return;
+
+	dbus_message_unref(iface->snapshot);
+	iface->snapshot = NULL;
+}
+
+static DBusMessage *get_snapshot(struct interface_data *iface)
+{
+	DBusMessageIter iter;
+
+	if (iface->snapshot)
+		return iface->snapshot;
+
+	iface->snapshot = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+	if (iface->snapshot == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(iface->snapshot, &iter);
+	append_properties(iface, &iter);
+
+	return iface->snapshot;
+}
+
+/*
+ * Same as append_interface but reuses the properties serialized by a
+ * previous call, which is only done when G_DBUS_FLAG_PROPERTY_SNAPSHOT is
+ * set since it relies on every change being signalled.
+ */
+static void append_interface_snapshot(gpointer data, gpointer user_data)
+{
+	struct interface_data *iface = data;
+	DBusMessageIter *array = user_data;
+	DBusMessageIter entry, iter;
+	DBusMessage *snapshot;
+
+	if (!(global_flags & G_DBUS_FLAG_PROPERTY_SNAPSHOT)) {
+		append_interface(data, user_data);
+		return;
+	}
+
+	snapshot = get_snapshot(iface);
+	if (snapshot == NULL) {
+		append_interface(data, user_data);
+		return;
+	}
+
+	dbus_message_iter_open_container(array, DBUS_TYPE_DICT_ENTRY, NULL,
+								&entry);
+	dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &iface->name);
+	dbus_message_iter_init(snapshot, &iter);
+	copy_iter(&iter, &entry);
+	dbus_message_iter_close_container(array, &entry);
+}
+
 static const char *dbus_message_type_string(DBusMessage *msg)
 {
 	return dbus_message_type_to_string(dbus_message_get_type(msg));
@@ -708,6 +842,20 @@ static gboolean g_dbus_args_have_signature(const GDBusArgInfo *args,
 	return TRUE;
 }
 
+static struct property_state *new_property_state(
+				const GDBusPropertyTable *properties)
+{
+	unsigned int count = 0;
+
+	for (; properties && properties->name; properties++)
+		count++;
+
+	if (!count)
+		return NULL;
+
+	return g_new0(struct property_state, count);
+}
+
 static void add_pending(struct generic_data *data)
 {
 	guint old_id = data->process_id;
@@ -734,7 +882,10 @@ static gboolean remove_interface(struct generic_data *data, const char *name)
 	if (iface == NULL)
 		return FALSE;
 
-	process_properties_from_interface(data, iface);
+	process_properties_from_interface(data, iface, 0);
+	g_free(iface->props);
+	iface->props = NULL;
+	invalidate_snapshot(iface);
 
 	data->interfaces = g_slist_remove(data->interfaces, iface);
 
@@ -1090,7 +1241,7 @@ static gboolean process_changes(gpointer user_data)
 
 	/* Flush pending properties */
 	if (data->pending_prop == TRUE)
-		process_property_changes(data);
+		process_property_changes(data, FALSE);
 
 	if (data->removed != NULL)
 		emit_interfaces_removed(data);
@@ -1100,6 +1251,19 @@ static gboolean process_changes(gpointer user_data)
 	return FALSE;
 }
 
+/* Emit the coalesced properties of the object without waiting for them */
+static void flush_coalesced(struct generic_data *data)
+{
+	if (data->coalesce_id > 0) {
+		g_source_remove(data->coalesce_id);
+		data->coalesce_id = 0;
+		data->coalesce_due = 0;
+	}
+
+	if (data->pending_prop == TRUE)
+		process_property_changes(data, TRUE);
+}
+
 static void generic_unregister(DBusConnection *connection, void *user_data)
 {
 	struct generic_data *data = user_data;
@@ -1114,6 +1278,8 @@ static void generic_unregister(DBusConnection *connection, void *user_data)
 		process_changes(data);
 	}
 
+	flush_coalesced(data);
+
 	g_slist_foreach(data->objects, reset_parent, data->parent);
 	g_slist_free(data->objects);
 
@@ -1198,15 +1364,14 @@ static void append_interfaces(struct generic_data *data, DBusMessageIter *iter)
 				DBUS_DICT_ENTRY_END_CHAR_AS_STRING
 				DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &array);
 
-	g_slist_foreach(data->interfaces, append_interface, &array);
+	g_slist_foreach(data->interfaces, append_interface_snapshot, &array);
 
 	dbus_message_iter_close_container(iter, &array);
 }
 
-static void append_object(gpointer data, gpointer user_data)
+static void append_object_entry(struct generic_data *child,
+						DBusMessageIter *array)
 {
-	struct generic_data *child = data;
-	DBusMessageIter *array = user_data;
 	DBusMessageIter entry;
 
 	dbus_message_iter_open_container(array, DBUS_TYPE_DICT_ENTRY, NULL,
@@ -1215,25 +1380,20 @@ static void append_object(gpointer data, gpointer user_data)
 								&child->path);
 	append_interfaces(child, &entry);
 	dbus_message_iter_close_container(array, &entry);
-
-	g_slist_foreach(child->objects, append_object, user_data);
 }
 
-static DBusMessage *get_objects(DBusConnection *connection,
-				DBusMessage *message, void *user_data)
+static void append_object(gpointer data, gpointer user_data)
 {
-	struct generic_data *data = user_data;
-	DBusMessage *reply;
-	DBusMessageIter iter;
-	DBusMessageIter array;
+	struct generic_data *child = data;
 
-	reply = dbus_message_new_method_return(message);
-	if (reply == NULL)
-		return NULL;
+	append_object_entry(child, user_data);
 
-	dbus_message_iter_init_append(reply, &iter);
+	g_slist_foreach(child->objects, append_object, user_data);
+}
 
-	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+static void open_objects_array(DBusMessageIter *iter, DBusMessageIter *array)
+{
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
 					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
 					DBUS_TYPE_OBJECT_PATH_AS_STRING
 					DBUS_TYPE_ARRAY_AS_STRING
@@ -1246,7 +1406,24 @@ static DBusMessage *get_objects(DBusConnection *connection,
 					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
 					DBUS_DICT_ENTRY_END_CHAR_AS_STRING
 					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
-					&array);
+					array);
+}
+
+static DBusMessage *get_objects(DBusConnection *connection,
+				DBusMessage *message, void *user_data)
+{
+	struct generic_data *data = user_data;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+	DBusMessageIter array;
+
+	reply = dbus_message_new_method_return(message);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	open_objects_array(&iter, &array);
 
 	g_slist_foreach(data->objects, append_object, &array);
 
@@ -1255,6 +1432,191 @@ static DBusMessage *get_objects(DBusConnection *connection,
 	return reply;
 }
 
+/*
+ * The walk state is a stack of links into the objects lists, one per tree
+ * level, pointing to the next object to visit.  Resuming after start only
+ * needs a lookup per level instead of walking all the preceding objects.
+ */
+static GSList *object_walk_init(struct generic_data *data,
+					struct generic_data *start)
+{
+	GSList *stack = NULL;
+	struct generic_data *obj;
+
+	if (start == NULL)
+		return g_slist_prepend(NULL, data->objects);
+
+	stack = g_slist_prepend(NULL, start->objects);
+
+	for (obj = start; obj != data; obj = obj->parent) {
+		GSList *link = g_slist_find(obj->parent->objects, obj);
+
+		stack = g_slist_append(stack, link ? link->next : NULL);
+	}
+
+	return stack;
+}
+
+static struct generic_data *object_walk_next(GSList **stack)
+{
+	while (*stack) {
+		GSList *link = (*stack)->data;
+		struct generic_data *obj;
+
+		if (link == NULL) {
+			*stack = g_slist_delete_link(*stack, *stack);
+			continue;
+		}
+
+		obj = link->data;
+		(*stack)->data = link->next;
+
+		if (obj->objects)
+			*stack = g_slist_prepend(*stack, obj->objects);
+
+		return obj;
+	}
+
+	return NULL;
+}
+
+static bool path_has_prefix(const char *path, const char *prefix)
+{
+	size_t len = strlen(prefix);
+
+	if (strncmp(path, prefix, len))
+		return false;
+
+	if (len == 1 || path[len] == '\0' || path[len] == '/')
+		return true;
+
+	return false;
+}
+
+/*
+ * Look up path below data in the object tree, each object is a child of its
+ * closest registered ancestor so only one branch needs to be followed.
+ */
+static struct generic_data *find_child_object(struct generic_data *data,
+							const char *path)
+{
+	GSList *l;
+
+	for (l = data->objects; l != NULL; l = l->next) {
+		struct generic_data *child = l->data;
+
+		if (!strcmp(child->path, path))
+			return child;
+
+		if (path_has_prefix(path, child->path))
+			return find_child_object(child, path);
+	}
+
+	return NULL;
+}
+
+DBusMessage *g_dbus_get_managed_objects_filtered(DBusConnection *connection,
+							DBusMessage *message)
+{
+	struct generic_data *data = root;
+	struct generic_data *start = NULL, *obj, *last = NULL;
+	const char *interface = NULL, *prefix = NULL, *next = "/";
+	dbus_uint32_t limit = 0, count = 0;
+	DBusMessage *reply;
+	DBusMessageIter iter, dict, array;
+	GSList *stack;
+
+	if (data == NULL || data->conn != connection)
+		return g_dbus_create_error(message, DBUS_ERROR_UNKNOWN_OBJECT,
+					"Object manager not attached");
+
+	dbus_message_iter_init(message, &iter);
+	dbus_message_iter_recurse(&iter, &dict);
+
+	while (dbus_message_iter_get_arg_type(&dict) == DBUS_TYPE_DICT_ENTRY) {
+		DBusMessageIter entry, value;
+		const char *key, *str;
+		int type;
+
+		dbus_message_iter_recurse(&dict, &entry);
+		dbus_message_iter_get_basic(&entry, &key);
+		dbus_message_iter_next(&entry);
+		dbus_message_iter_recurse(&entry, &value);
+
+		type = dbus_message_iter_get_arg_type(&value);
+
+		if (!strcmp(key, "Limit")) {
+			if (type != DBUS_TYPE_UINT32)
+				goto invalid;
+			dbus_message_iter_get_basic(&value, &limit);
+		} else if (!strcmp(key, "Interface")) {
+			if (type != DBUS_TYPE_STRING)
+				goto invalid;
+			dbus_message_iter_get_basic(&value, &interface);
+		} else if (!strcmp(key, "PathPrefix")) {
+			if (type != DBUS_TYPE_OBJECT_PATH)
+				goto invalid;
+			dbus_message_iter_get_basic(&value, &prefix);
+		} else if (!strcmp(key, "Start")) {
+			if (type != DBUS_TYPE_OBJECT_PATH)
+				goto invalid;
+			dbus_message_iter_get_basic(&value, &str);
+
+			if (!strcmp(str, "/")) {
+				start = NULL;
+			} else {
+				start = find_child_object(data, str);
+				/* Object to resume from is gone */
+				if (start == NULL)
+					goto invalid;
+			}
+		} else
+			goto invalid;
+
+		dbus_message_iter_next(&dict);
+	}
+
+	reply = dbus_message_new_method_return(message);
+	if (reply == NULL)
+		return NULL;
+
+	dbus_message_iter_init_append(reply, &iter);
+
+	open_objects_array(&iter, &array);
+
+	stack = object_walk_init(data, start);
+
+	while ((obj = object_walk_next(&stack))) {
+		if (prefix && !path_has_prefix(obj->path, prefix))
+			continue;
+
+		if (interface && !find_interface(obj->interfaces, interface))
+			continue;
+
+		/* More objects left, let the caller continue from the last */
+		if (limit && count == limit) {
+			next = last->path;
+			break;
+		}
+
+		append_object_entry(obj, &array);
+		last = obj;
+		count++;
+	}
+
+	g_slist_free(stack);
+
+	dbus_message_iter_close_container(&iter, &array);
+
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_OBJECT_PATH, &next);
+
+	return reply;
+
+invalid:
+	return g_dbus_create_error(message, DBUS_ERROR_INVALID_ARGS,
+					"Invalid arguments in method call");
+}
+
 static const GDBusMethodTable manager_methods[] = {
 	{ GDBUS_METHOD("GetManagedObjects", NULL,
 		GDBUS_ARGS({ "objects", "a{oa{sa{sv}}}" }), get_objects) },
@@ -1318,6 +1680,7 @@ done:
 	iface->methods = methods;
 	iface->signals = signals;
 	iface->properties = properties;
+	iface->props = new_property_state(properties);
 	iface->user_data = user_data;
 	iface->destroy = destroy;
 
@@ -1628,6 +1991,16 @@ gboolean g_dbus_send_message(DBusConnection *connection, DBusMessage *message)
 	/* Flush pending signal to guarantee message order */
 	g_dbus_flush(connection);
 
+	/* Coalesced properties of an object go out before its own signals */
+	if (dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL) {
+		struct generic_data *data = NULL;
+
+		if (dbus_connection_get_object_path_data(connection,
+					dbus_message_get_path(message),
+					(void **) &data) && data != NULL)
+			flush_coalesced(data);
+	}
+
 	switch (dbus_message_get_type(message)) {
 	case DBUS_MESSAGE_TYPE_METHOD_RETURN:
 		g_dbus_debug("[%s:%s] < [#%d]",
@@ -1800,26 +2173,56 @@ fail:
 	return ret;
 }
 
-static void process_properties_from_interface(struct generic_data *data,
-						struct interface_data *iface)
+/*
+ * Emit the pending properties of the interface that are due at now, or all
+ * of them if now is 0. Returns when the next deferred property is due or 0
+ * if there are none left.
+ */
+static gint64 process_properties_from_interface(struct generic_data *data,
+						struct interface_data *iface,
+						gint64 now)
 {
-	GSList *l;
+	const GDBusPropertyTable *p;
+	struct property_state *state;
 	DBusMessage *signal;
 	DBusMessageIter iter, dict, array;
-	GSList *invalidated;
+	GSList *l, *ready = NULL, *invalidated = NULL;
+	gint64 next = 0;
 
-	if (iface->pending_prop == NULL)
-		return;
+	if (!iface->pending_prop)
+		return 0;
+
+	for (p = iface->properties, state = iface->props; p->name;
+							p++, state++) {
+		if (!state->pending)
+			continue;
+
+		if (now && state->due > now) {
+			if (!next || state->due < next)
+				next = state->due;
+			continue;
+		}
+
+		state->pending = FALSE;
+		state->last = now ? now : g_get_monotonic_time();
+		iface->pending_prop--;
+
+		ready = g_slist_prepend(ready, (void *) p);
+	}
+
+	if (!ready)
+		return next;
 
 	signal = dbus_message_new_signal(data->path,
 			DBUS_INTERFACE_PROPERTIES, "PropertiesChanged");
 	if (signal == NULL) {
 		error("Unable to allocate new " DBUS_INTERFACE_PROPERTIES
 						".PropertiesChanged signal");
-		return;
+		g_slist_free(ready);
+		return next;
 	}
 
-	iface->pending_prop = g_slist_reverse(iface->pending_prop);
+	ready = g_slist_reverse(ready);
 
 	dbus_message_iter_init_append(signal, &iter);
 	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING,	&iface->name);
@@ -1828,16 +2231,14 @@ static void process_properties_from_interface(struct generic_data *data,
 			DBUS_TYPE_STRING_AS_STRING DBUS_TYPE_VARIANT_AS_STRING
 			DBUS_DICT_ENTRY_END_CHAR_AS_STRING, &dict);
 
-	invalidated = NULL;
-
-	for (l = iface->pending_prop; l != NULL; l = l->next) {
-		GDBusPropertyTable *p = l->data;
+	for (l = ready; l != NULL; l = l->next) {
+		p = l->data;
 
 		if (p->get == NULL)
 			continue;
 
 		if (p->exists != NULL && !p->exists(p, iface->user_data)) {
-			invalidated = g_slist_prepend(invalidated, p);
+			invalidated = g_slist_prepend(invalidated, (void *) p);
 			continue;
 		}
 
@@ -1849,7 +2250,7 @@ static void process_properties_from_interface(struct generic_data *data,
 	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
 				DBUS_TYPE_STRING_AS_STRING, &array);
 	for (l = invalidated; l != NULL; l = g_slist_next(l)) {
-		GDBusPropertyTable *p = l->data;
+		p = l->data;
 
 		dbus_message_iter_append_basic(&array, DBUS_TYPE_STRING,
 								&p->name);
@@ -1857,24 +2258,71 @@ static void process_properties_from_interface(struct generic_data *data,
 	g_slist_free(invalidated);
 	dbus_message_iter_close_container(&iter, &array);
 
-	g_slist_free(iface->pending_prop);
-	iface->pending_prop = NULL;
+	g_slist_free(ready);
+
+	property_stats.signals++;
 
 	/* Use g_dbus_send_unref to avoid recursive calls to g_dbus_flush */
 	g_dbus_send_unref(data->conn, signal);
+
+	return next;
 }
 
-static void process_property_changes(struct generic_data *data)
+static gboolean coalesce_timeout(gpointer user_data)
 {
+	struct generic_data *data = user_data;
+
+	data->coalesce_id = 0;
+	data->coalesce_due = 0;
+
+	process_property_changes(data, FALSE);
+
+	return FALSE;
+}
+
+static void schedule_coalesce(struct generic_data *data, gint64 due)
+{
+	gint64 now;
+
+	if (data->coalesce_id > 0) {
+		if (data->coalesce_due <= due)
+			return;
+
+		g_source_remove(data->coalesce_id);
+	}
+
+	now = g_get_monotonic_time();
+
+	data->coalesce_due = due;
+	data->coalesce_id = g_timeout_add(due > now ?
+						(due - now + 999) / 1000 : 0,
+						coalesce_timeout, data);
+}
+
+static void process_property_changes(struct generic_data *data,
+							gboolean force)
+{
+	gint64 now = force ? 0 : g_get_monotonic_time();
+	gint64 next = 0;
 	GSList *l;
 
 	data->pending_prop = FALSE;
 
 	for (l = data->interfaces; l != NULL; l = l->next) {
 		struct interface_data *iface = l->data;
+		gint64 due;
 
-		process_properties_from_interface(data, iface);
+		due = process_properties_from_interface(data, iface, now);
+		if (due && (!next || due < next))
+			next = due;
 	}
+
+	if (!next)
+		return;
+
+	/* Some coalesced properties are not due yet */
+	data->pending_prop = TRUE;
+	schedule_coalesce(data, next);
 }
 
 void g_dbus_emit_property_changed_full(DBusConnection *connection,
@@ -1885,6 +2333,7 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 	const GDBusPropertyTable *property;
 	struct generic_data *data;
 	struct interface_data *iface;
+	struct property_state *state;
 
 	if (path == NULL)
 		return;
@@ -1897,6 +2346,8 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 	if (iface == NULL)
 		return;
 
+	invalidate_snapshot(iface);
+
 	/*
 	 * If ObjectManager is attached, don't emit property changed if
 	 * interface is not yet published
@@ -1911,17 +2362,42 @@ void g_dbus_emit_property_changed_full(DBusConnection *connection,
 		return;
 	}
 
-	if (g_slist_find(iface->pending_prop, (void *) property) != NULL)
+	property_stats.changed++;
+
+	state = &iface->props[property - iface->properties];
+	if (state->pending) {
+		property_stats.merged++;
 		return;
+	}
 
+	state->pending = TRUE;
+	state->due = 0;
+	iface->pending_prop++;
 	data->pending_prop = TRUE;
-	iface->pending_prop = g_slist_prepend(iface->pending_prop,
-						(void *) property);
 
-	if (flags & G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH)
-		process_property_changes(data);
-	else
-		add_pending(data);
+	if (flags & G_DBUS_PROPERTY_CHANGED_FLAG_FLUSH) {
+		process_property_changes(data, TRUE);
+		return;
+	}
+
+	if ((flags & G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE) &&
+				(coalesce_window || coalesce_interval)) {
+		gint64 now = g_get_monotonic_time();
+
+		state->due = now + coalesce_window;
+
+		/* Rate limit the property to one change per interval */
+		if (state->last && state->last + coalesce_interval > state->due)
+			state->due = state->last + coalesce_interval;
+
+		if (state->due > now) {
+			property_stats.deferred++;
+			schedule_coalesce(data, state->due);
+			return;
+		}
+	}
+
+	add_pending(data);
 }
 
 void g_dbus_emit_property_changed(DBusConnection *connection, const char *path,
@@ -1989,6 +2465,19 @@ int g_dbus_get_flags(void)
 	return global_flags;
 }
 
+void g_dbus_set_property_coalescing(unsigned int window,
+						unsigned int interval)
+{
+	coalesce_window = window * G_GINT64_CONSTANT(1000);
+	coalesce_interval = interval * G_GINT64_CONSTANT(1000);
+}
+
+void g_dbus_get_property_stats(GDBusPropertyStats *stats)
+{
+	if (stats)
+		*stats = property_stats;
+}
+
 void g_dbus_set_debug(g_dbus_debug_func_t cb, void *user_data,
 				g_dbus_destroy_func_t destroy)
 {
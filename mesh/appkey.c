@@ -28,14 +28,58 @@
 #include "mesh/appkey.h"
 
 struct mesh_app_key {
+	struct mesh_net *net;
 	uint16_t net_idx;
 	uint16_t app_idx;
 	uint8_t key[16];
 	uint8_t key_aid;
 	uint8_t new_key[16];
 	uint8_t new_key_aid;
+	struct mesh_crypto_ctx *ctx;
+	struct mesh_crypto_ctx *new_ctx;
 };
 
+/* Keys by AID of either key phase, most recently successful first */
+static struct l_queue *aid_keys[KEY_AID_MASK + 1];
+static uint32_t trial_count;
+static uint32_t trial_failed;
+
+static void index_key(struct mesh_app_key *key)
+{
+	uint8_t aid = key->key_aid & KEY_AID_MASK;
+
+	if (!aid_keys[aid])
+		aid_keys[aid] = l_queue_new();
+
+	l_queue_push_tail(aid_keys[aid], key);
+
+	if (key->new_key_aid == APP_AID_INVALID ||
+					key->new_key_aid == key->key_aid)
+		return;
+
+	aid = key->new_key_aid & KEY_AID_MASK;
+
+	if (!aid_keys[aid])
+		aid_keys[aid] = l_queue_new();
+
+	l_queue_push_tail(aid_keys[aid], key);
+}
+
+static void unindex_key(struct mesh_app_key *key)
+{
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(aid_keys); i++) {
+		if (!l_queue_remove(aid_keys[i], key))
+			continue;
+
+		if (l_queue_isempty(aid_keys[i])) {
+			l_queue_destroy(aid_keys[i], NULL);
+			aid_keys[i] = NULL;
+		}
+	}
+}
+
 static bool match_key_index(const void *a, const void *b)
 {
 	const struct mesh_app_key *key = a;
@@ -63,11 +107,19 @@ static void finalize_key(void *a, void *b)
 	if (key->new_key_aid == APP_AID_INVALID)
 		return;
 
+	unindex_key(key);
+
 	key->key_aid = key->new_key_aid;
 
 	key->new_key_aid = APP_AID_INVALID;
 
 	memcpy(key->key, key->new_key, 16);
+
+	mesh_crypto_ctx_free(key->ctx);
+	key->ctx = key->new_ctx;
+	key->new_ctx = NULL;
+
+	index_key(key);
 }
 
 void appkey_finalize(struct mesh_net *net, uint16_t net_idx)
@@ -81,10 +133,11 @@ void appkey_finalize(struct mesh_net *net, uint16_t net_idx)
 	l_queue_foreach(app_keys, finalize_key, L_UINT_TO_PTR(net_idx));
 }
 
-static struct mesh_app_key *app_key_new(void)
+static struct mesh_app_key *app_key_new(struct mesh_net *net)
 {
 	struct mesh_app_key *key = l_new(struct mesh_app_key, 1);
 
+	key->net = net;
 	key->new_key_aid = APP_AID_INVALID;
 	return key;
 }
@@ -98,10 +151,15 @@ static bool set_key(struct mesh_app_key *key, uint16_t app_idx,
 		return false;
 
 	key_aid = KEY_ID_AKF | (key_aid << KEY_AID_SHIFT);
-	if (!is_new)
+	if (!is_new) {
 		key->key_aid = key_aid;
-	else
+		mesh_crypto_ctx_free(key->ctx);
+		key->ctx = mesh_crypto_ctx_new(key_value);
+	} else {
 		key->new_key_aid = key_aid;
+		mesh_crypto_ctx_free(key->new_ctx);
+		key->new_ctx = mesh_crypto_ctx_new(key_value);
+	}
 
 	memcpy(is_new ? key->new_key : key->key, key_value, 16);
 
@@ -115,6 +173,9 @@ void appkey_key_free(void *data)
 	if (!key)
 		return;
 
+	unindex_key(key);
+	mesh_crypto_ctx_free(key->ctx);
+	mesh_crypto_ctx_free(key->new_ctx);
 	l_free(key);
 }
 
@@ -134,7 +195,7 @@ bool appkey_key_init(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	if (!mesh_net_have_key(net, net_idx))
 		return false;
 
-	key = app_key_new();
+	key = app_key_new(net);
 	if (!key)
 		return false;
 
@@ -152,11 +213,12 @@ bool appkey_key_init(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	}
 
 	l_queue_push_tail(app_keys, key);
+	index_key(key);
 
 	return true;
 }
 
-const uint8_t *appkey_get_key(struct mesh_net *net, uint16_t app_idx,
+struct mesh_crypto_ctx *appkey_get_ctx(struct mesh_net *net, uint16_t app_idx,
 							uint8_t *key_aid)
 {
 	struct mesh_app_key *app_key;
@@ -178,34 +240,74 @@ const uint8_t *appkey_get_key(struct mesh_net *net, uint16_t app_idx,
 
 	if (phase != KEY_REFRESH_PHASE_TWO) {
 		*key_aid = app_key->key_aid;
-		return app_key->key;
+		return app_key->ctx;
 	}
 
 	if (app_key->new_key_aid == APP_AID_INVALID)
 		return NULL;
 
 	*key_aid = app_key->new_key_aid;
-	return app_key->new_key;
+	return app_key->new_ctx;
 }
 
-int appkey_get_key_idx(struct mesh_app_key *app_key,
-				const uint8_t **key, uint8_t *key_aid,
-				const uint8_t **new_key, uint8_t *new_key_aid)
+static bool try_key(struct mesh_crypto_ctx *ctx, const uint8_t *key,
+				appkey_decrypt_func_t func, void *user_data)
 {
-	if (!app_key)
-		return -1;
+	trial_count++;
 
-	if (key && key_aid) {
-		*key = app_key->key;
-		*key_aid = app_key->key_aid;
+	if (func(ctx, user_data)) {
+		print_packet("Used App Key", key, 16);
+		return true;
+	}
+
+	print_packet("Failed App Key", key, 16);
+	trial_failed++;
+
+	return false;
+}
+
+int appkey_decrypt(struct mesh_net *net, uint8_t key_aid,
+				appkey_decrypt_func_t func, void *user_data)
+{
+	struct l_queue *bucket = aid_keys[key_aid & KEY_AID_MASK];
+	const struct l_queue_entry *entry;
+	struct mesh_app_key *key;
+
+	for (entry = l_queue_get_entries(bucket); entry; entry = entry->next) {
+		key = entry->data;
+
+		if (key->net != net)
+			continue;
+
+		if (key->key_aid == key_aid &&
+				try_key(key->ctx, key->key, func, user_data))
+			break;
+
+		if (key->new_key_aid == key_aid &&
+				try_key(key->new_ctx, key->new_key, func,
+								user_data))
+			break;
 	}
 
-	if (new_key && new_key_aid) {
-		*new_key = app_key->new_key;
-		*new_key_aid = app_key->new_key_aid;
+	if (!entry)
+		return -1;
+
+	/* Keep the key that matched up front for the next message */
+	if (entry != l_queue_get_entries(bucket)) {
+		l_queue_remove(bucket, key);
+		l_queue_push_head(bucket, key);
 	}
 
-	return app_key->app_idx;
+	return key->app_idx;
+}
+
+void appkey_trial_stats(uint32_t *trials, uint32_t *failed)
+{
+	if (trials)
+		*trials = trial_count;
+
+	if (failed)
+		*failed = trial_failed;
 }
 
 bool appkey_have_key(struct mesh_net *net, uint16_t app_idx)
@@ -249,6 +351,7 @@ int appkey_key_update(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	struct l_queue *app_keys;
 	uint8_t phase = KEY_REFRESH_PHASE_NONE;
 	struct mesh_node *node;
+	bool result;
 
 	app_keys = mesh_net_get_app_keys(net);
 	if (!app_keys)
@@ -273,7 +376,11 @@ int appkey_key_update(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	if (memcmp(new_key, key->new_key, 16) == 0)
 		return MESH_STATUS_SUCCESS;
 
-	if (!set_key(key, app_idx, new_key, true))
+	unindex_key(key);
+	result = set_key(key, app_idx, new_key, true);
+	index_key(key);
+
+	if (!result)
 		return MESH_STATUS_INSUFF_RESOURCES;
 
 	node = mesh_net_node_get(net);
@@ -312,7 +419,7 @@ int appkey_key_add(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	if (l_queue_length(app_keys) >= MAX_APP_KEYS)
 		return MESH_STATUS_INSUFF_RESOURCES;
 
-	key = app_key_new();
+	key = app_key_new(net);
 
 	if (!set_key(key, app_idx, new_key, false)) {
 		appkey_key_free(key);
@@ -330,6 +437,7 @@ int appkey_key_add(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 	key->net_idx = net_idx;
 	key->app_idx = app_idx;
 	l_queue_push_tail(app_keys, key);
+	index_key(key);
 
 	return MESH_STATUS_SUCCESS;
 }
@@ -12,16 +12,20 @@
 #define MAX_APP_KEYS	32
 
 struct mesh_app_key;
+struct mesh_crypto_ctx;
+
+typedef bool (*appkey_decrypt_func_t)(struct mesh_crypto_ctx *ctx,
+							void *user_data);
 
 bool appkey_key_init(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
 				uint8_t *key_value, uint8_t *new_key_value);
 void appkey_key_free(void *data);
 void appkey_finalize(struct mesh_net *net, uint16_t net_idx);
-const uint8_t *appkey_get_key(struct mesh_net *net, uint16_t app_idx,
+struct mesh_crypto_ctx *appkey_get_ctx(struct mesh_net *net, uint16_t app_idx,
 							uint8_t *key_aid);
-int appkey_get_key_idx(struct mesh_app_key *app_key,
-				const uint8_t **key, uint8_t *key_aid,
-				const uint8_t **new_key, uint8_t *new_key_aid);
+int appkey_decrypt(struct mesh_net *net, uint8_t key_aid,
+				appkey_decrypt_func_t func, void *user_data);
+void appkey_trial_stats(uint32_t *trials, uint32_t *failed);
 bool appkey_have_key(struct mesh_net *net, uint16_t app_idx);
 uint16_t appkey_net_idx(struct mesh_net *net, uint16_t app_idx);
 int appkey_key_add(struct mesh_net *net, uint16_t net_idx, uint16_t app_idx,
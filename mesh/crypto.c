@@ -25,18 +25,115 @@
 /* Multiply used Zero array */
 static const uint8_t zero[16] = { 0, };
 
-static bool aes_ecb_one(const uint8_t key[16], const uint8_t in[16],
+/*
+ * Kernel backed cipher handles bound to a single key. Each handle is set up
+ * on first use and kept until the owning key goes away, so that the per
+ * packet path does not pay for a socket setup on every PDU.
+ */
+struct mesh_crypto_ctx {
+	uint8_t key[16];
+	struct l_cipher *ecb;
+	struct l_checksum *cmac;
+	struct l_aead_cipher *ccm[2];	/* 32-bit and 64-bit MIC */
+};
+
+static void ctx_init(struct mesh_crypto_ctx *ctx, const uint8_t key[16])
+{
+	memset(ctx, 0, sizeof(*ctx));
+	memcpy(ctx->key, key, 16);
+}
+
+static void ctx_clear(struct mesh_crypto_ctx *ctx)
+{
+	l_cipher_free(ctx->ecb);
+	l_checksum_free(ctx->cmac);
+	l_aead_cipher_free(ctx->ccm[0]);
+	l_aead_cipher_free(ctx->ccm[1]);
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+struct mesh_crypto_ctx *mesh_crypto_ctx_new(const uint8_t key[16])
+{
+	struct mesh_crypto_ctx *ctx = l_new(struct mesh_crypto_ctx, 1);
+
+	ctx_init(ctx, key);
+
+	return ctx;
+}
+
+void mesh_crypto_ctx_free(struct mesh_crypto_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	ctx_clear(ctx);
+	l_free(ctx);
+}
+
+static bool ctx_ecb(struct mesh_crypto_ctx *ctx, const uint8_t in[16],
 								uint8_t out[16])
 {
-	void *cipher;
-	bool result = false;
+	if (!ctx)
+		return false;
 
-	cipher = l_cipher_new(L_CIPHER_AES, key, 16);
+	if (!ctx->ecb)
+		ctx->ecb = l_cipher_new(L_CIPHER_AES, ctx->key, 16);
 
-	if (cipher) {
-		result = l_cipher_encrypt(cipher, in, out, 16);
-		l_cipher_free(cipher);
-	}
+	if (!ctx->ecb)
+		return false;
+
+	return l_cipher_encrypt(ctx->ecb, in, out, 16);
+}
+
+static bool ctx_cmac(struct mesh_crypto_ctx *ctx, const void *msg,
+					size_t msg_len, uint8_t res[16])
+{
+	if (!ctx)
+		return false;
+
+	if (!ctx->cmac)
+		ctx->cmac = l_checksum_new_cmac_aes(ctx->key, 16);
+
+	if (!ctx->cmac)
+		return false;
+
+	if (!l_checksum_update(ctx->cmac, msg, msg_len))
+		return false;
+
+	return l_checksum_get_digest(ctx->cmac, res, 16) == 16;
+}
+
+static struct l_aead_cipher *ctx_ccm(struct mesh_crypto_ctx *ctx,
+							size_t mic_size)
+{
+	unsigned int i;
+
+	if (!ctx)
+		return NULL;
+
+	if (mic_size == 4)
+		i = 0;
+	else if (mic_size == 8)
+		i = 1;
+	else
+		return NULL;
+
+	if (!ctx->ccm[i])
+		ctx->ccm[i] = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM,
+						ctx->key, 16, mic_size);
+
+	return ctx->ccm[i];
+}
+
+static bool aes_ecb_one(const uint8_t key[16], const uint8_t in[16],
+								uint8_t out[16])
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, key);
+	result = ctx_ecb(&ctx, in, out);
+	ctx_clear(&ctx);
 
 	return result;
 }
@@ -81,41 +178,40 @@ bool mesh_crypto_aes_cmac(const uint8_t key[16], const uint8_t *msg,
 	return aes_cmac_one(key, msg, msg_len, res);
 }
 
-bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
+bool mesh_crypto_ctx_ccm_encrypt(struct mesh_crypto_ctx *ctx,
+					const uint8_t nonce[13],
 					const uint8_t *aad, uint16_t aad_len,
 					const void *msg, uint16_t msg_len,
 					void *out_msg, size_t mic_size)
 {
-	void *cipher;
-	bool result;
+	struct l_aead_cipher *cipher = ctx_ccm(ctx, mic_size);
 
-	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, key, 16, mic_size);
+	if (!cipher)
+		return false;
 
-	result = l_aead_cipher_encrypt(cipher, msg, msg_len, aad, aad_len,
+	return l_aead_cipher_encrypt(cipher, msg, msg_len, aad, aad_len,
 					nonce, 13, out_msg, msg_len + mic_size);
-
-	l_aead_cipher_free(cipher);
-
-	return result;
 }
 
-bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
+bool mesh_crypto_ctx_ccm_decrypt(struct mesh_crypto_ctx *ctx,
+				const uint8_t nonce[13],
 				const uint8_t *aad, uint16_t aad_len,
 				const void *enc_msg, uint16_t enc_msg_len,
 				void *out_msg,
 				void *out_mic, size_t mic_size)
 {
-	void *cipher;
-	bool result;
+	struct l_aead_cipher *cipher = ctx_ccm(ctx, mic_size);
 	size_t out_msg_len = enc_msg_len - mic_size;
 
-	cipher = l_aead_cipher_new(L_AEAD_CIPHER_AES_CCM, key, 16, mic_size);
+	if (!cipher)
+		return false;
 
-	result = l_aead_cipher_decrypt(cipher, enc_msg, enc_msg_len,
+	if (!l_aead_cipher_decrypt(cipher, enc_msg, enc_msg_len,
 							aad, aad_len, nonce, 13,
-							out_msg, out_msg_len);
+							out_msg, out_msg_len))
+		return false;
 
-	if (result && out_mic) {
+	if (out_mic) {
 		if (mic_size == 4)
 			*(uint32_t *)out_mic =
 				l_get_be32(enc_msg + enc_msg_len - mic_size);
@@ -124,7 +220,39 @@ bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
 				l_get_be64(enc_msg + enc_msg_len - mic_size);
 	}
 
-	l_aead_cipher_free(cipher);
+	return true;
+}
+
+bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
+					const uint8_t *aad, uint16_t aad_len,
+					const void *msg, uint16_t msg_len,
+					void *out_msg, size_t mic_size)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, key);
+	result = mesh_crypto_ctx_ccm_encrypt(&ctx, nonce, aad, aad_len,
+					msg, msg_len, out_msg, mic_size);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
+bool mesh_crypto_aes_ccm_decrypt(const uint8_t nonce[13], const uint8_t key[16],
+				const uint8_t *aad, uint16_t aad_len,
+				const void *enc_msg, uint16_t enc_msg_len,
+				void *out_msg,
+				void *out_mic, size_t mic_size)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, key);
+	result = mesh_crypto_ctx_ccm_decrypt(&ctx, nonce, aad, aad_len,
+					enc_msg, enc_msg_len, out_msg,
+					out_mic, mic_size);
+	ctx_clear(&ctx);
 
 	return result;
 }
@@ -288,7 +416,7 @@ bool mesh_crypto_k4(const uint8_t a[16], uint8_t out6[1])
 	return true;
 }
 
-bool mesh_crypto_beacon_cmac(const uint8_t encryption_key[16],
+bool mesh_crypto_ctx_beacon_cmac(struct mesh_crypto_ctx *ctx,
 				const uint8_t network_id[8],
 				uint32_t iv_index, bool kr, bool iu,
 				uint64_t *cmac)
@@ -303,7 +431,7 @@ bool mesh_crypto_beacon_cmac(const uint8_t encryption_key[16],
 	memcpy(msg + 1, network_id, 8);
 	l_put_be32(iv_index, msg + 9);
 
-	if (!aes_cmac_one(encryption_key, msg, 13, tmp))
+	if (!ctx_cmac(ctx, msg, 13, tmp))
 		return false;
 
 	*cmac = l_get_be64(tmp);
@@ -311,6 +439,22 @@ bool mesh_crypto_beacon_cmac(const uint8_t encryption_key[16],
 	return true;
 }
 
+bool mesh_crypto_beacon_cmac(const uint8_t encryption_key[16],
+				const uint8_t network_id[8],
+				uint32_t iv_index, bool kr, bool iu,
+				uint64_t *cmac)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, encryption_key);
+	result = mesh_crypto_ctx_beacon_cmac(&ctx, network_id, iv_index,
+								kr, iu, cmac);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
 static void mesh_crypto_network_nonce(bool ctl, uint8_t ttl,
 					uint32_t seq, uint16_t src,
 					uint32_t iv_index, uint8_t nonce[13])
@@ -465,17 +609,17 @@ static void mesh_crypto_privacy_counter(uint32_t iv_index,
 	memcpy(privacy_counter + 9, payload, 7);
 }
 
-static bool mesh_crypto_pecb(const uint8_t privacy_key[16],
+static bool mesh_crypto_pecb(struct mesh_crypto_ctx *privacy_key,
 						uint32_t iv_index,
 						const uint8_t *payload,
 						uint8_t pecb[16])
 {
 	mesh_crypto_privacy_counter(iv_index, payload, pecb);
-	return aes_ecb_one(privacy_key, pecb, pecb);
+	return ctx_ecb(privacy_key, pecb, pecb);
 }
 
 static bool mesh_crypto_network_obfuscate(uint8_t *packet,
-						const uint8_t privacy_key[16],
+					struct mesh_crypto_ctx *privacy_key,
 						uint32_t iv_index,
 						bool ctl, uint8_t ttl,
 						uint32_t seq, uint16_t src)
@@ -498,7 +642,7 @@ static bool mesh_crypto_network_obfuscate(uint8_t *packet,
 }
 
 static bool mesh_crypto_network_clarify(uint8_t *packet,
-						const uint8_t privacy_key[16],
+					struct mesh_crypto_ctx *privacy_key,
 						uint32_t iv_index,
 						bool *ctl, uint8_t *ttl,
 						uint32_t *seq, uint16_t *src)
@@ -719,12 +863,12 @@ bool mesh_crypto_packet_parse(const uint8_t *packet, uint8_t packet_len,
 	return true;
 }
 
-bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
+bool mesh_crypto_ctx_payload_encrypt(uint8_t *aad, const uint8_t *payload,
 				uint8_t *out, uint16_t payload_len,
 				uint16_t src, uint16_t dst, uint8_t key_aid,
 				uint32_t seq, uint32_t iv_index,
 				bool aszmic,
-				const uint8_t app_key[16])
+				struct mesh_crypto_ctx *app_key)
 {
 	uint8_t nonce[13];
 
@@ -738,7 +882,7 @@ bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
 		mesh_crypto_application_nonce(seq, src, dst, iv_index, aszmic,
 									nonce);
 
-	if (!mesh_crypto_aes_ccm_encrypt(nonce, app_key,
+	if (!mesh_crypto_ctx_ccm_encrypt(app_key, nonce,
 							aad, aad ? 16 : 0,
 							payload, payload_len,
 							out, aszmic ? 8 : 4))
@@ -747,13 +891,13 @@ bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
 	return true;
 }
 
-bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
+bool mesh_crypto_ctx_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 				const uint8_t *payload, uint16_t payload_len,
 				bool aszmic,
 				uint16_t src, uint16_t dst,
 				uint8_t key_aid, uint32_t seq,
 				uint32_t iv_index, uint8_t *out,
-				const uint8_t app_key[16])
+				struct mesh_crypto_ctx *app_key)
 {
 	uint8_t nonce[13];
 	uint32_t mic32;
@@ -772,7 +916,7 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 	memcpy(out, payload, payload_len);
 
 	if (aszmic) {
-		if (!mesh_crypto_aes_ccm_decrypt(nonce, app_key,
+		if (!mesh_crypto_ctx_ccm_decrypt(app_key, nonce,
 					aad, aad_len,
 					payload, payload_len,
 					out, &mic64, sizeof(mic64)))
@@ -784,7 +928,7 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 		if (mic64)
 			return false;
 	} else {
-		if (!mesh_crypto_aes_ccm_decrypt(nonce, app_key,
+		if (!mesh_crypto_ctx_ccm_decrypt(app_key, nonce,
 					aad, aad_len,
 					payload, payload_len,
 					out, &mic32, sizeof(mic32)))
@@ -800,8 +944,47 @@ bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
 	return true;
 }
 
+bool mesh_crypto_payload_encrypt(uint8_t *aad, const uint8_t *payload,
+				uint8_t *out, uint16_t payload_len,
+				uint16_t src, uint16_t dst, uint8_t key_aid,
+				uint32_t seq, uint32_t iv_index,
+				bool aszmic,
+				const uint8_t app_key[16])
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, app_key);
+	result = mesh_crypto_ctx_payload_encrypt(aad, payload, out,
+					payload_len, src, dst, key_aid,
+					seq, iv_index, aszmic, &ctx);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
+bool mesh_crypto_payload_decrypt(uint8_t *aad, uint16_t aad_len,
+				const uint8_t *payload, uint16_t payload_len,
+				bool aszmic,
+				uint16_t src, uint16_t dst,
+				uint8_t key_aid, uint32_t seq,
+				uint32_t iv_index, uint8_t *out,
+				const uint8_t app_key[16])
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, app_key);
+	result = mesh_crypto_ctx_payload_decrypt(aad, aad_len, payload,
+					payload_len, aszmic, src, dst,
+					key_aid, seq, iv_index, out, &ctx);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
 static bool mesh_crypto_packet_encrypt(uint8_t *packet, uint8_t packet_len,
-				const uint8_t network_key[16],
+				struct mesh_crypto_ctx *network_key,
 				uint32_t iv_index, bool proxy,
 				bool ctl, uint8_t ttl, uint32_t seq,
 				uint16_t src)
@@ -816,13 +999,13 @@ static bool mesh_crypto_packet_encrypt(uint8_t *packet, uint8_t packet_len,
 
 	/* Check for Long net-MIC */
 	if (ctl) {
-		if (!mesh_crypto_aes_ccm_encrypt(nonce, network_key,
+		if (!mesh_crypto_ctx_ccm_encrypt(network_key, nonce,
 					NULL, 0,
 					packet + 7, packet_len - 7 - 8,
 					packet + 7, 8))
 			return false;
 	} else {
-		if (!mesh_crypto_aes_ccm_encrypt(nonce, network_key,
+		if (!mesh_crypto_ctx_ccm_encrypt(network_key, nonce,
 					NULL, 0,
 					packet + 7, packet_len - 7 - 4,
 					packet + 7, 4))
@@ -832,10 +1015,10 @@ static bool mesh_crypto_packet_encrypt(uint8_t *packet, uint8_t packet_len,
 	return true;
 }
 
-bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
+bool mesh_crypto_ctx_packet_encode(uint8_t *packet, uint8_t packet_len,
 				uint32_t iv_index,
-				const uint8_t network_key[16],
-				const uint8_t privacy_key[16])
+				struct mesh_crypto_ctx *network_key,
+				struct mesh_crypto_ctx *privacy_key)
 {
 	bool ctl;
 	uint8_t ttl;
@@ -858,7 +1041,7 @@ bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
 }
 
 static bool mesh_crypto_packet_decrypt(uint8_t *packet, uint8_t packet_len,
-				const uint8_t network_key[16],
+				struct mesh_crypto_ctx *network_key,
 				uint32_t iv_index, bool proxy,
 				bool ctl, uint8_t ttl, uint32_t seq,
 				uint16_t src)
@@ -879,7 +1062,7 @@ static bool mesh_crypto_packet_decrypt(uint8_t *packet, uint8_t packet_len,
 	if (ctl) {
 		uint64_t mic;
 
-		if (!mesh_crypto_aes_ccm_decrypt(nonce, network_key,
+		if (!mesh_crypto_ctx_ccm_decrypt(network_key, nonce,
 					NULL, 0,
 					packet + 7, packet_len - 7,
 					packet + 7, &mic, sizeof(mic)))
@@ -893,7 +1076,7 @@ static bool mesh_crypto_packet_decrypt(uint8_t *packet, uint8_t packet_len,
 	} else {
 		uint32_t mic;
 
-		if (!mesh_crypto_aes_ccm_decrypt(nonce, network_key,
+		if (!mesh_crypto_ctx_ccm_decrypt(network_key, nonce,
 					NULL, 0,
 					packet + 7, packet_len - 7,
 					packet + 7, &mic, sizeof(mic)))
@@ -909,10 +1092,10 @@ static bool mesh_crypto_packet_decrypt(uint8_t *packet, uint8_t packet_len,
 	return true;
 }
 
-bool mesh_crypto_packet_decode(const uint8_t *packet, uint8_t packet_len,
+bool mesh_crypto_ctx_packet_decode(const uint8_t *packet, uint8_t packet_len,
 				bool proxy, uint8_t *out, uint32_t iv_index,
-				const uint8_t network_key[16],
-				const uint8_t privacy_key[16])
+				struct mesh_crypto_ctx *network_key,
+				struct mesh_crypto_ctx *privacy_key)
 {
 	bool ctl;
 	uint8_t ttl;
@@ -933,6 +1116,42 @@ bool mesh_crypto_packet_decode(const uint8_t *packet, uint8_t packet_len,
 							ctl, ttl, seq, src);
 }
 
+bool mesh_crypto_packet_encode(uint8_t *packet, uint8_t packet_len,
+				uint32_t iv_index,
+				const uint8_t network_key[16],
+				const uint8_t privacy_key[16])
+{
+	struct mesh_crypto_ctx net_ctx, prv_ctx;
+	bool result;
+
+	ctx_init(&net_ctx, network_key);
+	ctx_init(&prv_ctx, privacy_key);
+	result = mesh_crypto_ctx_packet_encode(packet, packet_len, iv_index,
+							&net_ctx, &prv_ctx);
+	ctx_clear(&net_ctx);
+	ctx_clear(&prv_ctx);
+
+	return result;
+}
+
+bool mesh_crypto_packet_decode(const uint8_t *packet, uint8_t packet_len,
+				bool proxy, uint8_t *out, uint32_t iv_index,
+				const uint8_t network_key[16],
+				const uint8_t privacy_key[16])
+{
+	struct mesh_crypto_ctx net_ctx, prv_ctx;
+	bool result;
+
+	ctx_init(&net_ctx, network_key);
+	ctx_init(&prv_ctx, privacy_key);
+	result = mesh_crypto_ctx_packet_decode(packet, packet_len, proxy, out,
+					iv_index, &net_ctx, &prv_ctx);
+	ctx_clear(&net_ctx);
+	ctx_clear(&prv_ctx);
+
+	return result;
+}
+
 bool mesh_crypto_packet_label(uint8_t *packet, uint8_t packet_len,
 				uint16_t iv_index, uint8_t network_id)
 {
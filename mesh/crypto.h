@@ -12,6 +12,47 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+struct mesh_crypto_ctx;
+
+struct mesh_crypto_ctx *mesh_crypto_ctx_new(const uint8_t key[16]);
+void mesh_crypto_ctx_free(struct mesh_crypto_ctx *ctx);
+bool mesh_crypto_ctx_ccm_encrypt(struct mesh_crypto_ctx *ctx,
+					const uint8_t nonce[13],
+					const uint8_t *aad, uint16_t aad_len,
+					const void *msg, uint16_t msg_len,
+					void *out_msg, size_t mic_size);
+bool mesh_crypto_ctx_ccm_decrypt(struct mesh_crypto_ctx *ctx,
+				const uint8_t nonce[13],
+				const uint8_t *aad, uint16_t aad_len,
+				const void *enc_msg, uint16_t enc_msg_len,
+				void *out_msg,
+				void *out_mic, size_t mic_size);
+bool mesh_crypto_ctx_beacon_cmac(struct mesh_crypto_ctx *ctx,
+				const uint8_t network_id[8],
+				uint32_t iv_index, bool kr,
+				bool iu, uint64_t *cmac);
+bool mesh_crypto_ctx_payload_encrypt(uint8_t *aad, const uint8_t *payload,
+				uint8_t *out, uint16_t payload_len,
+				uint16_t src, uint16_t dst, uint8_t key_aid,
+				uint32_t seq_num, uint32_t iv_index,
+				bool aszmic,
+				struct mesh_crypto_ctx *application_key);
+bool mesh_crypto_ctx_payload_decrypt(uint8_t *aad, uint16_t aad_len,
+				const uint8_t *payload, uint16_t payload_len,
+				bool szmict,
+				uint16_t src, uint16_t dst, uint8_t key_aid,
+				uint32_t seq_num, uint32_t iv_index,
+				uint8_t *out,
+				struct mesh_crypto_ctx *application_key);
+bool mesh_crypto_ctx_packet_encode(uint8_t *packet, uint8_t packet_len,
+				uint32_t iv_index,
+				struct mesh_crypto_ctx *network_key,
+				struct mesh_crypto_ctx *privacy_key);
+bool mesh_crypto_ctx_packet_decode(const uint8_t *packet, uint8_t packet_len,
+				bool proxy, uint8_t *out, uint32_t iv_index,
+				struct mesh_crypto_ctx *network_key,
+				struct mesh_crypto_ctx *privacy_key);
+
 bool mesh_crypto_aes_ccm_encrypt(const uint8_t nonce[13], const uint8_t key[16],
 					const uint8_t *aad, uint16_t aad_len,
 					const void *msg, uint16_t msg_len,
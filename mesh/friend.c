@@ -42,6 +42,179 @@ static uint8_t frnd_sublist_size = FRND_SUB_LIST_SIZE;
 static uint16_t counter;
 static struct l_queue *retired_lpns;
 
+struct friend_cache_slot {
+	struct mesh_friend_msg *msg;
+	uint16_t size;
+};
+
+/*
+ * Friend Queue of one LPN. The slots and their message buffers last as
+ * long as the friendship and are reused, only growing for larger messages.
+ */
+struct friend_cache {
+	struct friend_cache_slot *slots;
+	struct l_hashmap *acks;
+	struct friend_cache_stats stats;
+	uint8_t head;
+	uint8_t len;
+};
+
+static bool is_seg_ack(const struct mesh_friend_msg *msg)
+{
+	return msg->ctl && ((msg->u.one[0].hdr >> OPCODE_HDR_SHIFT) &
+					OPCODE_MASK) == NET_OP_SEG_ACKNOWLEDGE;
+}
+
+static void *ack_key(const struct mesh_friend_msg *msg)
+{
+	uint32_t seq_zero = (msg->u.one[0].hdr >> SEQ_ZERO_HDR_SHIFT) &
+								SEQ_ZERO_MASK;
+
+	return L_UINT_TO_PTR(msg->src * (SEQ_ZERO_MASK + 1) + seq_zero);
+}
+
+struct friend_cache *friend_cache_new(uint8_t size)
+{
+	struct friend_cache *cache = l_new(struct friend_cache, 1);
+
+	cache->slots = l_new(struct friend_cache_slot, size);
+	cache->stats.size = size;
+	cache->stats.bytes = size * sizeof(struct friend_cache_slot);
+
+	return cache;
+}
+
+void friend_cache_free(struct mesh_friend *frnd)
+{
+	struct friend_cache *cache = frnd->pkt_cache;
+	uint8_t i;
+
+	if (!cache)
+		return;
+
+	l_debug("Friend Queue %4.4x: %u queued, %u delivered, %u evicted, "
+			"%u replaced, peak %u of %u, %u bytes", frnd->lp_addr,
+			cache->stats.queued, cache->stats.delivered,
+			cache->stats.evicted, cache->stats.replaced,
+			cache->stats.peak, cache->stats.size,
+			cache->stats.bytes);
+
+	for (i = 0; i < cache->stats.size; i++)
+		l_free(cache->slots[i].msg);
+
+	l_hashmap_destroy(cache->acks, NULL);
+	l_free(cache->slots);
+	l_free(cache);
+
+	frnd->pkt_cache = NULL;
+	frnd->pkt = NULL;
+}
+
+static struct mesh_friend_msg *cache_head(struct friend_cache *cache)
+{
+	if (!cache || !cache->len)
+		return NULL;
+
+	return cache->slots[cache->head].msg;
+}
+
+static void cache_pop(struct mesh_friend *frnd)
+{
+	struct friend_cache *cache = frnd->pkt_cache;
+	struct mesh_friend_msg *msg = cache->slots[cache->head].msg;
+
+	if (is_seg_ack(msg))
+		l_hashmap_remove(cache->acks, ack_key(msg));
+
+	/* A Poll response still pending for it has nothing left to send */
+	if (frnd->pkt == msg)
+		frnd->pkt = NULL;
+
+	cache->head = (cache->head + 1) % cache->stats.size;
+	cache->len--;
+}
+
+void friend_cache_push(struct mesh_friend *frnd,
+					const struct mesh_friend_msg *msg)
+{
+	struct friend_cache *cache = frnd->pkt_cache;
+	struct friend_cache_slot *slot;
+	size_t size = FRND_MSG_SIZE(msg->cnt_in);
+	unsigned int idx;
+
+	if (!cache)
+		return;
+
+	/* Special handling for Seg Ack -- Only one per message queue */
+	if (is_seg_ack(msg)) {
+		idx = L_PTR_TO_UINT(l_hashmap_lookup(cache->acks,
+								ack_key(msg)));
+
+		/* The newer Ack takes the place of the older one */
+		if (idx--) {
+			/* If we are replacing head, reset FRND SEQ */
+			if (idx == cache->head)
+				frnd->u.active.last = frnd->u.active.seq;
+
+			memcpy(cache->slots[idx].msg, msg, size);
+			cache->stats.replaced++;
+			return;
+		}
+	}
+
+	if (cache->len == cache->stats.size) {
+		/*
+		 * TODO: Guard against popping UPDATE packets
+		 * (disallowed per spec)
+		 */
+		cache_pop(frnd);
+		cache->stats.evicted++;
+		frnd->u.active.last = frnd->u.active.seq;
+	}
+
+	idx = (cache->head + cache->len) % cache->stats.size;
+	slot = &cache->slots[idx];
+
+	if (slot->size < size) {
+		cache->stats.bytes += size - slot->size;
+		cache->stats.allocs++;
+		l_free(slot->msg);
+		slot->msg = l_malloc(size);
+		slot->size = size;
+	}
+
+	memcpy(slot->msg, msg, size);
+	cache->len++;
+	cache->stats.queued++;
+
+	if (cache->len > cache->stats.peak)
+		cache->stats.peak = cache->len;
+
+	if (!is_seg_ack(msg))
+		return;
+
+	if (!cache->acks)
+		cache->acks = l_hashmap_new();
+
+	l_hashmap_insert(cache->acks, ack_key(msg), L_UINT_TO_PTR(idx + 1));
+}
+
+uint8_t friend_cache_length(struct mesh_friend *frnd)
+{
+	return frnd->pkt_cache ? frnd->pkt_cache->len : 0;
+}
+
+bool friend_cache_get_stats(struct mesh_friend *frnd,
+					struct friend_cache_stats *stats)
+{
+	if (!frnd || !frnd->pkt_cache || !stats)
+		return false;
+
+	*stats = frnd->pkt_cache->stats;
+
+	return true;
+}
+
 static void response_timeout(struct l_timeout *timeout, void *user_data)
 {
 	struct mesh_friend *neg = user_data;
@@ -83,7 +256,7 @@ static void response_delay(struct l_timeout *timeout, void *user_data)
 
 	msg[n++] = NET_OP_FRND_OFFER;
 	msg[n++] = frnd_relay_window;
-	msg[n++] = frnd_cache_size;
+	msg[n++] = neg->cache_size;
 	msg[n++] = frnd_sublist_size;
 	msg[n++] = neg->u.negotiate.rssi;
 	l_put_be16(neg->fn_cnt, msg + n);
@@ -180,6 +353,7 @@ void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
 	neg->poll_timeout = timeout;
 	neg->old_friend = prev;
 	neg->ele_cnt = num_ele;
+	neg->cache_size = frnd_cache_size;
 	neg->net_idx = net_idx;
 
 	/* RSSI (Negative Factor, larger values == less time)
@@ -461,7 +635,8 @@ void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 						neg->receive_delay,
 						neg->frw,
 						neg->poll_timeout,
-						neg->fn_cnt, neg->lp_cnt);
+						neg->fn_cnt, neg->lp_cnt,
+						neg->cache_size);
 
 		frnd->timeout = l_timeout_create_ms(
 					frnd->poll_timeout * 100,
@@ -500,28 +675,28 @@ void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 	/* Reset Poll Timeout */
 	l_timeout_modify_ms(frnd->timeout, frnd->poll_timeout * 100);
 
-	if (!l_queue_length(frnd->pkt_cache))
+	if (!friend_cache_length(frnd))
 		goto update;
 
 	if (frnd->u.active.seq != frnd->u.active.last &&
 						frnd->u.active.seq != seq) {
-		pkt = l_queue_peek_head(frnd->pkt_cache);
+		pkt = cache_head(frnd->pkt_cache);
 		if (pkt->cnt_out < pkt->cnt_in) {
 			pkt->cnt_out++;
 		} else {
-			pkt = l_queue_pop_head(frnd->pkt_cache);
-			l_free(pkt);
+			cache_pop(frnd);
+			frnd->pkt_cache->stats.delivered++;
 		}
 	}
 
-	pkt = l_queue_peek_head(frnd->pkt_cache);
+	pkt = cache_head(frnd->pkt_cache);
 
 	if (!pkt)
 		goto update;
 
 	frnd->u.active.seq = seq;
 	frnd->u.active.last = !seq;
-	md = (l_queue_length(frnd->pkt_cache) > 1);
+	md = (friend_cache_length(frnd) > 1);
 
 	if (pkt->ctl) {
 		/* Make sure we don't change the bit-sense of MD,
@@ -17,6 +17,25 @@
 #define OP_FRND_NEGOTIATE		0x8046
 #define OP_FRND_CLEAR			0x8047
 
+struct friend_cache_stats {
+	uint32_t queued;
+	uint32_t delivered;
+	uint32_t evicted;
+	uint32_t replaced;
+	uint32_t allocs;
+	uint32_t bytes;
+	uint8_t size;
+	uint8_t peak;
+};
+
+struct friend_cache *friend_cache_new(uint8_t size);
+void friend_cache_free(struct mesh_friend *frnd);
+void friend_cache_push(struct mesh_friend *frnd,
+					const struct mesh_friend_msg *msg);
+uint8_t friend_cache_length(struct mesh_friend *frnd);
+bool friend_cache_get_stats(struct mesh_friend *frnd,
+					struct friend_cache_stats *stats);
+
 void friend_poll(struct mesh_net *net, uint16_t src, bool seq,
 						struct mesh_friend *frnd);
 void friend_request(struct mesh_net *net, uint16_t net_idx, uint16_t src,
@@ -17,9 +17,11 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <ftw.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -42,11 +44,17 @@
 
 struct mesh_config {
 	json_object *jnode;
+	json_object *jsaved;
 	char *node_dir_path;
 	uint8_t uuid[16];
 	uint32_t write_seq;
 	struct timeval write_time;
 	struct l_queue *idles;
+	struct l_timeout *flush_to;
+	int journal_fd;
+	size_t journal_size;
+	size_t save_size;
+	struct mesh_config_stats stats;
 };
 
 struct write_info {
@@ -58,6 +66,9 @@ struct write_info {
 static const char *cfgnode_name = "/node.json";
 static const char *bak_ext = ".bak";
 static const char *tmp_ext = ".tmp";
+static const char *journal_ext = ".journal";
+
+static struct mesh_config_opts opts;
 
 /* JSON key words */
 static const char *unicastAddress = "unicastAddress";
@@ -86,10 +97,11 @@ static const char *disabled = "disabled";
 static const char *unsupported = "unsupported";
 
 
-static bool save_config(json_object *jnode, const char *fname)
+static bool save_config(struct mesh_config *cfg, const char *fname)
 {
 	FILE *outfile;
 	const char *str;
+	size_t len;
 	bool result = false;
 
 	outfile = fopen(fname, "w");
@@ -98,18 +110,391 @@ static bool save_config(json_object *jnode, const char *fname)
 		return false;
 	}
 
-	str = json_object_to_json_string_ext(jnode, JSON_C_TO_STRING_PRETTY);
+	str = json_object_to_json_string_ext(cfg->jnode, opts.compact ?
+				JSON_C_TO_STRING_PLAIN : JSON_C_TO_STRING_PRETTY);
+	len = strlen(str);
 
-	if (fwrite(str, sizeof(char), strlen(str), outfile) < strlen(str))
+	if (fwrite(str, sizeof(char), len, outfile) < len)
 		l_warn("Incomplete write of mesh configuration");
 	else
 		result = true;
 
 	fclose(outfile);
 
+	if (result) {
+		cfg->save_size = len;
+		cfg->stats.saves++;
+		cfg->stats.save_bytes += len;
+	}
+
 	return result;
 }
 
+/*
+ * The journal holds one line per change, each a JSON array of operations
+ * that take the last saved configuration to the current one. Every
+ * operation carries a path ("p") of object keys and array indexes, and
+ * either a new value ("v") or nothing when the member is removed.
+ */
+static void add_journal_op(json_object *jops, json_object *jpath,
+							json_object *jval, bool set)
+{
+	json_object *jop, *jcopy;
+	int i, len;
+
+	jop = json_object_new_object();
+	jcopy = json_object_new_array();
+	len = json_object_array_length(jpath);
+
+	for (i = 0; i < len; i++)
+		json_object_array_add(jcopy, json_object_get(
+				json_object_array_get_idx(jpath, i)));
+
+	json_object_object_add(jop, "p", jcopy);
+
+	if (set)
+		json_object_object_add(jop, "v", json_object_get(jval));
+
+	json_object_array_add(jops, jop);
+}
+
+static void diff_config(json_object *jold, json_object *jnew,
+					json_object *jpath, json_object *jops)
+{
+	int i, len;
+
+	if (json_object_equal(jold, jnew))
+		return;
+
+	if (json_object_get_type(jold) == json_type_object &&
+			json_object_get_type(jnew) == json_type_object) {
+		json_object_object_foreach(jnew, key, jval) {
+			json_object *jprev = NULL;
+
+			json_object_object_get_ex(jold, key, &jprev);
+			json_object_array_add(jpath,
+						json_object_new_string(key));
+			diff_config(jprev, jval, jpath, jops);
+			json_object_array_del_idx(jpath,
+					json_object_array_length(jpath) - 1, 1);
+		}
+
+		json_object_object_foreach(jold, key_old, jval_old) {
+			if (json_object_object_get_ex(jnew, key_old, NULL))
+				continue;
+
+			json_object_array_add(jpath,
+					json_object_new_string(key_old));
+			add_journal_op(jops, jpath, jval_old, false);
+			json_object_array_del_idx(jpath,
+					json_object_array_length(jpath) - 1, 1);
+		}
+
+		return;
+	}
+
+	/* Anything but arrays of the same length is replaced as a whole */
+	if (json_object_get_type(jold) != json_type_array ||
+			json_object_get_type(jnew) != json_type_array ||
+			json_object_array_length(jold) !=
+					json_object_array_length(jnew)) {
+		add_journal_op(jops, jpath, jnew, true);
+		return;
+	}
+
+	len = json_object_array_length(jnew);
+
+	for (i = 0; i < len; i++) {
+		json_object_array_add(jpath, json_object_new_int(i));
+		diff_config(json_object_array_get_idx(jold, i),
+				json_object_array_get_idx(jnew, i), jpath, jops);
+		json_object_array_del_idx(jpath,
+					json_object_array_length(jpath) - 1, 1);
+	}
+}
+
+static json_object *get_journal_child(json_object *jobj, json_object *jkey)
+{
+	json_object *jchild = NULL;
+	int idx;
+
+	if (json_object_get_type(jkey) == json_type_string) {
+		json_object_object_get_ex(jobj, json_object_get_string(jkey),
+								&jchild);
+		return jchild;
+	}
+
+	if (json_object_get_type(jobj) != json_type_array)
+		return NULL;
+
+	idx = json_object_get_int(jkey);
+	if (idx < 0 || (size_t) idx >= json_object_array_length(jobj))
+		return NULL;
+
+	return json_object_array_get_idx(jobj, idx);
+}
+
+static bool apply_journal_op(json_object *jroot, json_object *jop)
+{
+	json_object *jpath, *jkey, *jval = NULL, *jcopy = NULL;
+	json_object *jobj = jroot;
+	bool set;
+	int i, len, idx;
+
+	if (!json_object_object_get_ex(jop, "p", &jpath) ||
+			json_object_get_type(jpath) != json_type_array)
+		return false;
+
+	len = json_object_array_length(jpath);
+	if (!len)
+		return false;
+
+	for (i = 0; i < len - 1 && jobj; i++)
+		jobj = get_journal_child(jobj,
+					json_object_array_get_idx(jpath, i));
+
+	if (!jobj)
+		return false;
+
+	set = json_object_object_get_ex(jop, "v", &jval);
+	if (set && json_object_deep_copy(jval, &jcopy, NULL) < 0)
+		return false;
+
+	jkey = json_object_array_get_idx(jpath, len - 1);
+
+	if (json_object_get_type(jkey) == json_type_string &&
+			json_object_get_type(jobj) == json_type_object) {
+		if (set)
+			json_object_object_add(jobj,
+					json_object_get_string(jkey), jcopy);
+		else
+			json_object_object_del(jobj,
+					json_object_get_string(jkey));
+
+		return true;
+	}
+
+	idx = json_object_get_int(jkey);
+
+	if (set && json_object_get_type(jkey) == json_type_int &&
+			json_object_get_type(jobj) == json_type_array &&
+			idx >= 0 &&
+			(size_t) idx < json_object_array_length(jobj)) {
+		json_object_array_put_idx(jobj, idx, jcopy);
+		return true;
+	}
+
+	json_object_put(jcopy);
+
+	return false;
+}
+
+static void apply_journal_ops(json_object *jroot, json_object *jops)
+{
+	int i, len = json_object_array_length(jops);
+
+	for (i = 0; i < len; i++)
+		apply_journal_op(jroot, json_object_array_get_idx(jops, i));
+}
+
+static char *journal_path(struct mesh_config *cfg)
+{
+	return l_strdup_printf("%s%s", cfg->node_dir_path, journal_ext);
+}
+
+static size_t load_journal(json_object *jnode, const char *fname)
+{
+	json_object *jops;
+	char *line = NULL;
+	size_t len = 0, good = 0;
+	ssize_t sz;
+	FILE *fp;
+
+	fp = fopen(fname, "r");
+	if (!fp)
+		return 0;
+
+	while ((sz = getline(&line, &len, fp)) > 0) {
+		/* A torn final change from a crash ends the replay */
+		if (line[sz - 1] != '\n')
+			break;
+
+		jops = json_tokener_parse(line);
+		if (json_object_get_type(jops) != json_type_array) {
+			json_object_put(jops);
+			break;
+		}
+
+		apply_journal_ops(jnode, jops);
+		json_object_put(jops);
+		good += sz;
+	}
+
+	free(line);
+	fclose(fp);
+
+	if (good)
+		l_info("Replayed %zu bytes of configuration journal", good);
+
+	return good;
+}
+
+/* Appends what changed since the last save, the configuration stays dirty */
+static bool journal_config(struct mesh_config *cfg)
+{
+	json_object *jops, *jpath;
+	char *fname, *line;
+	bool result = true;
+	size_t len;
+
+	if (!cfg->jsaved)
+		return false;
+
+	jops = json_object_new_array();
+	jpath = json_object_new_array();
+	diff_config(cfg->jsaved, cfg->jnode, jpath, jops);
+	json_object_put(jpath);
+
+	if (!json_object_array_length(jops))
+		goto done;
+
+	if (cfg->journal_fd < 0) {
+		fname = journal_path(cfg);
+		cfg->journal_fd = open(fname, O_WRONLY | O_CREAT | O_APPEND,
+									0600);
+		l_free(fname);
+	}
+
+	line = l_strdup_printf("%s\n", json_object_to_json_string_ext(jops,
+						JSON_C_TO_STRING_PLAIN));
+	len = strlen(line);
+
+	result = cfg->journal_fd >= 0 &&
+				write(cfg->journal_fd, line, len) == (ssize_t) len;
+	l_free(line);
+
+	if (!result) {
+		l_warn("Failed to journal mesh configuration change");
+		goto done;
+	}
+
+	apply_journal_ops(cfg->jsaved, jops);
+
+	cfg->journal_size += len;
+	cfg->stats.journal_writes++;
+	cfg->stats.journal_bytes += len;
+
+done:
+	json_object_put(jops);
+	return result;
+}
+
+static void reset_journal(struct mesh_config *cfg)
+{
+	char *fname;
+
+	if (cfg->journal_fd < 0 && !cfg->journal_size)
+		return;
+
+	if (cfg->journal_fd >= 0)
+		close(cfg->journal_fd);
+
+	fname = journal_path(cfg);
+	remove(fname);
+	l_free(fname);
+
+	cfg->journal_fd = -1;
+	cfg->journal_size = 0;
+}
+
+/* Keeps a copy of what is on disk to tell later changes apart */
+static void snapshot_config(struct mesh_config *cfg)
+{
+	json_object_put(cfg->jsaved);
+	cfg->jsaved = NULL;
+
+	if (opts.journal &&
+		json_object_deep_copy(cfg->jnode, &cfg->jsaved, NULL) < 0) {
+		json_object_put(cfg->jsaved);
+		cfg->jsaved = NULL;
+	}
+}
+
+static bool write_config(struct mesh_config *cfg)
+{
+	char *fname_tmp, *fname_bak, *fname_cfg;
+	bool result = false;
+
+	/*
+	 * Bring the journal up to date first, so replaying it over the new
+	 * file is harmless should we stop before it is removed.
+	 */
+	if (opts.journal)
+		journal_config(cfg);
+
+	l_timeout_remove(cfg->flush_to);
+	cfg->flush_to = NULL;
+
+	fname_cfg = cfg->node_dir_path;
+	fname_tmp = l_strdup_printf("%s%s", fname_cfg, tmp_ext);
+	fname_bak = l_strdup_printf("%s%s", fname_cfg, bak_ext);
+	remove(fname_tmp);
+
+	result = save_config(cfg, fname_tmp);
+
+	if (result) {
+		remove(fname_bak);
+
+		/* A new node has no previous file to back up */
+		if ((rename(fname_cfg, fname_bak) < 0 && errno != ENOENT) ||
+					rename(fname_tmp, fname_cfg) < 0)
+			result = false;
+	}
+
+	remove(fname_tmp);
+
+	l_free(fname_tmp);
+	l_free(fname_bak);
+
+	if (result) {
+		reset_journal(cfg);
+		snapshot_config(cfg);
+	}
+
+	return result;
+}
+
+static void flush_timeout(struct l_timeout *timeout, void *user_data)
+{
+	struct mesh_config *cfg = user_data;
+
+	write_config(cfg);
+}
+
+/*
+ * Records a change to the node configuration. With the journal enabled the
+ * change is appended to it and the full file is only rewritten once the
+ * journal outgrows it, otherwise the full file is rewritten after the
+ * flush window, coalescing whatever else changes in the meantime.
+ */
+static bool commit_config(struct mesh_config *cfg)
+{
+	cfg->stats.changes++;
+
+	if (opts.journal && journal_config(cfg) &&
+					cfg->journal_size < cfg->save_size)
+		return true;
+
+	if (!opts.flush_window)
+		return write_config(cfg);
+
+	if (!cfg->flush_to)
+		cfg->flush_to = l_timeout_create_ms(opts.flush_window,
+						flush_timeout, cfg, NULL);
+
+	return true;
+}
+
 static bool get_int(json_object *jobj, const char *keyword, int *value)
 {
 	json_object *jvalue;
@@ -674,7 +1059,7 @@ bool mesh_config_net_key_add(struct mesh_config *cfg, uint16_t idx,
 
 	json_object_array_add(jarray, jentry);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 
 fail:
 	if (jentry)
@@ -716,7 +1101,7 @@ bool mesh_config_net_key_update(struct mesh_config *cfg, uint16_t idx,
 	json_object_object_add(jentry, keyRefresh,
 				json_object_new_int(KEY_REFRESH_PHASE_ONE));
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_net_key_del(struct mesh_config *cfg, uint16_t idx)
@@ -736,7 +1121,7 @@ bool mesh_config_net_key_del(struct mesh_config *cfg, uint16_t idx)
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jnode, netKeys);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_device_key(struct mesh_config *cfg, const uint8_t *key)
@@ -744,7 +1129,7 @@ bool mesh_config_write_device_key(struct mesh_config *cfg, const uint8_t *key)
 	if (!cfg || !add_key_value(cfg->jnode, deviceKey, key))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_candidate(struct mesh_config *cfg, const uint8_t *key)
@@ -752,7 +1137,7 @@ bool mesh_config_write_candidate(struct mesh_config *cfg, const uint8_t *key)
 	if (!cfg || !add_key_value(cfg->jnode, deviceCan, key))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_read_candidate(struct mesh_config *cfg, uint8_t *key)
@@ -779,7 +1164,7 @@ bool mesh_config_finalize_candidate(struct mesh_config *cfg)
 	if (!add_key_value(cfg->jnode, deviceKey, key))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_token(struct mesh_config *cfg, const uint8_t *token)
@@ -787,7 +1172,7 @@ bool mesh_config_write_token(struct mesh_config *cfg, const uint8_t *token)
 	if (!cfg || !add_u64_value(cfg->jnode, "token", token))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_app_key_add(struct mesh_config *cfg, uint16_t net_idx,
@@ -830,7 +1215,7 @@ bool mesh_config_app_key_add(struct mesh_config *cfg, uint16_t net_idx,
 
 	json_object_array_add(jarray, jentry);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 
 fail:
 
@@ -872,7 +1257,7 @@ bool mesh_config_app_key_update(struct mesh_config *cfg, uint16_t app_idx,
 	if (!add_key_value(jentry, "key", key))
 		return false;
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_app_key_del(struct mesh_config *cfg, uint16_t net_idx,
@@ -893,7 +1278,7 @@ bool mesh_config_app_key_del(struct mesh_config *cfg, uint16_t net_idx,
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jnode, appKeys);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_binding_add(struct mesh_config *cfg, uint16_t ele_addr,
@@ -940,7 +1325,7 @@ bool mesh_config_model_binding_add(struct mesh_config *cfg, uint16_t ele_addr,
 
 	json_object_array_add(jarray, jstring);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_binding_del(struct mesh_config *cfg, uint16_t ele_addr,
@@ -976,7 +1361,7 @@ bool mesh_config_model_binding_del(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jmodel, bind);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 static void free_model(void *data)
@@ -1587,7 +1972,7 @@ bool mesh_config_write_mode(struct mesh_config *cfg, const char *keyword,
 	if (!cfg || !write_mode(cfg->jnode, keyword, value))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_mode_ex(struct mesh_config *cfg, const char *keyword,
@@ -1635,7 +2020,7 @@ bool mesh_config_write_unicast(struct mesh_config *cfg, uint16_t unicast)
 	if (!cfg || !write_uint16_hex(cfg->jnode, unicastAddress, unicast))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_relay_mode(struct mesh_config *cfg, uint8_t mode,
@@ -1645,7 +2030,7 @@ bool mesh_config_write_relay_mode(struct mesh_config *cfg, uint8_t mode,
 	if (!cfg || !write_relay_mode(cfg->jnode, mode, count, interval))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_mpb(struct mesh_config *cfg, uint8_t mode,
@@ -1660,7 +2045,7 @@ bool mesh_config_write_mpb(struct mesh_config *cfg, uint8_t mode,
 			return false;
 	}
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_net_transmit(struct mesh_config *cfg, uint8_t cnt,
@@ -1686,7 +2071,7 @@ bool mesh_config_write_net_transmit(struct mesh_config *cfg, uint8_t cnt,
 	json_object_object_del(jnode, retransmit);
 	json_object_object_add(jnode, retransmit, jrtx);
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 
 fail:
 	json_object_put(jrtx);
@@ -1711,7 +2096,7 @@ bool mesh_config_write_iv_index(struct mesh_config *cfg, uint32_t idx,
 	if (!write_int(jnode, "IVupdate", tmp))
 		return false;
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 static void add_model(void *a, void *b)
@@ -1848,6 +2233,7 @@ static struct mesh_config *create_config(const char *cfg_path,
 	cfg->node_dir_path = l_strdup(cfg_path);
 	cfg->write_seq = node->seq_number;
 	cfg->idles = l_queue_new();
+	cfg->journal_fd = -1;
 	gettimeofday(&cfg->write_time, NULL);
 
 	return cfg;
@@ -2000,7 +2386,7 @@ bool mesh_config_net_key_set_phase(struct mesh_config *cfg, uint16_t idx,
 		finish_key_refresh(jnode, idx);
 	}
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_pub_add(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2063,7 +2449,7 @@ bool mesh_config_model_pub_add(struct mesh_config *cfg, uint16_t ele_addr,
 	json_object_object_add(jpub, retransmit, jrtx);
 	json_object_object_add(jmodel, publish, jpub);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 
 fail:
 	json_object_put(jpub);
@@ -2096,7 +2482,7 @@ bool mesh_config_model_pub_del(struct mesh_config *cfg, uint16_t addr,
 								publish))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 static bool del_page(json_object *jarray, uint8_t page)
@@ -2142,7 +2528,7 @@ void mesh_config_comp_page_del(struct mesh_config *cfg, uint8_t page)
 	json_object_object_get_ex(jnode, "pages", &jarray);
 
 	if (del_page(jarray, page))
-		save_config(jnode, cfg->node_dir_path);
+		commit_config(cfg);
 }
 
 bool mesh_config_comp_page_add(struct mesh_config *cfg, uint8_t page,
@@ -2182,7 +2568,7 @@ bool mesh_config_comp_page_add(struct mesh_config *cfg, uint8_t page,
 	json_object_array_add(jarray, jstring);
 	l_free(buf);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_sub_add(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2234,7 +2620,7 @@ bool mesh_config_model_sub_add(struct mesh_config *cfg, uint16_t ele_addr,
 
 	json_object_array_add(jarray, jstring);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_sub_del(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2275,7 +2661,7 @@ bool mesh_config_model_sub_del(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!json_object_array_length(jarray))
 		json_object_object_del(jmodel, subscribe);
 
-	return save_config(jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_sub_del_all(struct mesh_config *cfg, uint16_t addr,
@@ -2285,7 +2671,7 @@ bool mesh_config_model_sub_del_all(struct mesh_config *cfg, uint16_t addr,
 								subscribe))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_pub_enable(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2314,7 +2700,7 @@ bool mesh_config_model_pub_enable(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!enable)
 		json_object_object_del(jmodel, publish);
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_model_sub_enable(struct mesh_config *cfg, uint16_t ele_addr,
@@ -2343,7 +2729,7 @@ bool mesh_config_model_sub_enable(struct mesh_config *cfg, uint16_t ele_addr,
 	if (!enable)
 		json_object_object_del(jmodel, subscribe);
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_write_seq_number(struct mesh_config *cfg, uint32_t seq,
@@ -2427,7 +2813,7 @@ bool mesh_config_write_ttl(struct mesh_config *cfg, uint8_t ttl)
 	if (!cfg || !write_int(cfg->jnode, defaultTTL, ttl))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_update_company_id(struct mesh_config *cfg, uint16_t cid)
@@ -2435,7 +2821,7 @@ bool mesh_config_update_company_id(struct mesh_config *cfg, uint16_t cid)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "cid", cid))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_update_product_id(struct mesh_config *cfg, uint16_t pid)
@@ -2443,7 +2829,7 @@ bool mesh_config_update_product_id(struct mesh_config *cfg, uint16_t pid)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "pid", pid))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_update_version_id(struct mesh_config *cfg, uint16_t vid)
@@ -2451,7 +2837,7 @@ bool mesh_config_update_version_id(struct mesh_config *cfg, uint16_t vid)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "vid", vid))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
 bool mesh_config_update_crpl(struct mesh_config *cfg, uint16_t crpl)
@@ -2459,10 +2845,16 @@ bool mesh_config_update_crpl(struct mesh_config *cfg, uint16_t crpl)
 	if (!cfg || !write_uint16_hex(cfg->jnode, "crpl", crpl))
 		return false;
 
-	return save_config(cfg->jnode, cfg->node_dir_path);
+	return commit_config(cfg);
 }
 
-static bool load_node(const char *fname, const uint8_t uuid[16],
+/*
+ * Loads the node from fname, which is either the node configuration at path
+ * or its backup.  The journal of path is replayed on top in both cases since
+ * it is written against whichever file the last full save left behind.
+ */
+static bool load_node(const char *fname, const char *path,
+				const uint8_t uuid[16],
 				mesh_config_node_func_t cb, void *user_data)
 {
 	int fd;
@@ -2472,6 +2864,8 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 	bool result = false;
 	json_object *jnode;
 	struct mesh_config_node node;
+	char *journal;
+	size_t journal_size;
 
 	if (!cb) {
 		l_info("Node read callback is required");
@@ -2505,6 +2899,9 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 	if (!jnode)
 		goto done;
 
+	journal = l_strdup_printf("%s%s", path, journal_ext);
+	journal_size = load_journal(jnode, journal);
+
 	memset(&node, 0, sizeof(node));
 
 	node.elements = l_queue_new();
@@ -2514,19 +2911,36 @@ static bool load_node(const char *fname, const uint8_t uuid[16],
 
 	result = read_node(jnode, &node);
 
+	/* Put the backup back in place before touching its journal */
+	if (result && strcmp(fname, path) && rename(fname, path) < 0) {
+		l_error("Failed to restore configuration backup %s", fname);
+		result = false;
+	}
+
+	/* Never append new changes behind a damaged one */
+	if (result && truncate(journal, journal_size) < 0 && errno != ENOENT)
+		l_warn("Failed to trim configuration journal %s", journal);
+
+	l_free(journal);
+
 	if (result) {
 		struct mesh_config *cfg = l_new(struct mesh_config, 1);
 
 		cfg->jnode = jnode;
 		memcpy(cfg->uuid, uuid, 16);
-		cfg->node_dir_path = l_strdup(fname);
+		cfg->node_dir_path = l_strdup(path);
 		cfg->write_seq = node.seq_number;
 		cfg->idles = l_queue_new();
+		cfg->journal_fd = -1;
+		cfg->journal_size = journal_size;
+		cfg->save_size = st.st_size;
 		gettimeofday(&cfg->write_time, NULL);
+		snapshot_config(cfg);
 
 		result = cb(&node, uuid, cfg, user_data);
 
 		if (!result) {
+			json_object_put(cfg->jsaved);
 			l_free(cfg->idles);
 			l_free(cfg->node_dir_path);
 			l_free(cfg);
@@ -2565,36 +2979,48 @@ void mesh_config_release(struct mesh_config *cfg)
 
 	l_queue_destroy(cfg->idles, release_idle);
 
+	/* Changes still inside the flush window are written out now */
+	if (cfg->flush_to)
+		write_config(cfg);
+
+	l_debug("Config writes: %u changes, %u saves (%" PRIu64 " bytes), "
+			"%u journal writes (%" PRIu64 " bytes)",
+			cfg->stats.changes, cfg->stats.saves,
+			cfg->stats.save_bytes, cfg->stats.journal_writes,
+			cfg->stats.journal_bytes);
+
+	if (cfg->journal_fd >= 0)
+		close(cfg->journal_fd);
+
 	l_free(cfg->node_dir_path);
+	json_object_put(cfg->jsaved);
 	json_object_put(cfg->jnode);
 	l_free(cfg);
 }
 
-static void idle_save_config(struct l_idle *idle, void *user_data)
+void mesh_config_set_opts(const struct mesh_config_opts *new_opts)
 {
-	struct write_info *info = user_data;
-	char *fname_tmp, *fname_bak, *fname_cfg;
-	bool result = false;
-
-	fname_cfg = info->cfg->node_dir_path;
-	fname_tmp = l_strdup_printf("%s%s", fname_cfg, tmp_ext);
-	fname_bak = l_strdup_printf("%s%s", fname_cfg, bak_ext);
-	remove(fname_tmp);
+	if (new_opts)
+		opts = *new_opts;
+}
 
-	result = save_config(info->cfg->jnode, fname_tmp);
+bool mesh_config_get_stats(struct mesh_config *cfg,
+					struct mesh_config_stats *stats)
+{
+	if (!cfg || !stats)
+		return false;
 
-	if (result) {
-		remove(fname_bak);
+	*stats = cfg->stats;
 
-		if (rename(fname_cfg, fname_bak) < 0 ||
-					rename(fname_tmp, fname_cfg) < 0)
-			result = false;
-	}
+	return true;
+}
 
-	remove(fname_tmp);
+static void idle_save_config(struct l_idle *idle, void *user_data)
+{
+	struct write_info *info = user_data;
+	bool result;
 
-	l_free(fname_tmp);
-	l_free(fname_bak);
+	result = write_config(info->cfg);
 
 	gettimeofday(&info->cfg->write_time, NULL);
 
@@ -2671,16 +3097,11 @@ bool mesh_config_load_nodes(const char *cfgdir_name, mesh_config_node_func_t cb,
 		dirname = l_strdup_printf("%s/%s", cfgdir_name, entry->d_name);
 		fname = l_strdup_printf("%s%s", dirname, cfgnode_name);
 
-		if (!load_node(fname, uuid, cb, user_data)) {
+		if (!load_node(fname, fname, uuid, cb, user_data)) {
 
 			/* Fall-back to Backup version */
 			bak = l_strdup_printf("%s%s", fname, bak_ext);
-
-			if (load_node(bak, uuid, cb, user_data)) {
-				remove(fname);
-				rename(bak, fname);
-			}
-
+			load_node(bak, fname, uuid, cb, user_data);
 			l_free(bak);
 		}
 
@@ -2702,6 +3123,16 @@ void mesh_config_destroy_nvm(struct mesh_config *cfg)
 	if (!cfg)
 		return;
 
+	/* Nothing may be written back once the node is gone */
+	l_timeout_remove(cfg->flush_to);
+	cfg->flush_to = NULL;
+
+	if (cfg->journal_fd >= 0)
+		close(cfg->journal_fd);
+
+	cfg->journal_fd = -1;
+	cfg->journal_size = 0;
+
 	node_dir = dirname(cfg->node_dir_path);
 	l_debug("Delete node config %s", node_dir);
 
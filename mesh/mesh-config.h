@@ -109,6 +109,20 @@ struct mesh_config_node {
 	uint8_t token[8];
 };
 
+struct mesh_config_opts {
+	uint32_t flush_window;	/* ms to coalesce changes, 0 saves at once */
+	bool compact;
+	bool journal;
+};
+
+struct mesh_config_stats {
+	uint32_t changes;
+	uint32_t saves;
+	uint32_t journal_writes;
+	uint64_t save_bytes;
+	uint64_t journal_bytes;
+};
+
 typedef void (*mesh_config_status_func_t)(void *user_data, bool result);
 typedef bool (*mesh_config_node_func_t)(struct mesh_config_node *node,
 							const uint8_t uuid[16],
@@ -117,6 +131,9 @@ typedef bool (*mesh_config_node_func_t)(struct mesh_config_node *node,
 
 bool mesh_config_load_nodes(const char *cfgdir_name, mesh_config_node_func_t cb,
 							void *user_data);
+void mesh_config_set_opts(const struct mesh_config_opts *opts);
+bool mesh_config_get_stats(struct mesh_config *cfg,
+					struct mesh_config_stats *stats);
 void mesh_config_release(struct mesh_config *cfg);
 void mesh_config_destroy_nvm(struct mesh_config *cfg);
 bool mesh_config_save(struct mesh_config *cfg, bool no_wait,
@@ -41,11 +41,17 @@ struct mesh_io_reg {
 	uint8_t filter[];
 };
 
+/* Receive filters, indexed by AD type and then by each following octet */
+struct mesh_io_filter;
+
 struct mesh_io {
 	int				index;
 	int				favored_index;
 	mesh_io_ready_func_t		ready;
 	struct l_queue			*rx_regs;
+	struct mesh_io_filter		*rx_filters[256];
+	unsigned int			rx_depth;
+	bool				rx_prune;
 	struct mesh_io_private		*pvt;
 	void				*user_data;
 	const struct mesh_io_api	*api;
@@ -55,3 +61,6 @@ struct mesh_io_table {
 	enum mesh_io_type		type;
 	const struct mesh_io_api	*api;
 };
+
+void mesh_io_process_rx(struct mesh_io *io, struct mesh_io_recv_info *info,
+					const uint8_t *data, uint8_t len);
@@ -31,24 +31,42 @@
 #include "mesh/mesh-io-api.h"
 #include "mesh/mesh-io-generic.h"
 
+/* Advertising sets used when the controller supports LE Ext Advertising */
+#define MAX_ADV_SETS	4
+
+/* Advertising set busy until the disable issued by the host completes */
+#define ADV_SET_DISABLING	((struct tx_pkt *) -1)
+
+struct adv_set {
+	struct mesh_io_private *pvt;
+	struct tx_pkt *tx;
+	uint32_t interval;
+	uint8_t handle;
+	bool failed;
+};
+
+struct tx_stats {
+	uint32_t start;
+	uint32_t pkts;
+	uint32_t pdus;
+	uint32_t cmds;
+};
+
 struct mesh_io_private {
 	struct mesh_io *io;
 	struct bt_hci *hci;
 	struct l_timeout *tx_timeout;
 	struct l_queue *tx_pkts;
 	struct tx_pkt *tx;
+	struct adv_set sets[MAX_ADV_SETS];
+	struct tx_stats stats;
 	uint16_t interval;
+	uint8_t num_sets;
+	bool ready;
 	bool sending;
 	bool active;
 };
 
-struct process_data {
-	struct mesh_io_private		*pvt;
-	const uint8_t			*data;
-	uint8_t				len;
-	struct mesh_io_recv_info	info;
-};
-
 struct tx_pkt {
 	struct mesh_io_send_info	info;
 	bool				delete;
@@ -79,52 +97,25 @@ static uint32_t instant_remaining_ms(uint32_t instant)
 	return instant;
 }
 
-static void process_rx_callbacks(void *v_reg, void *v_rx)
-{
-	struct mesh_io_reg *rx_reg = v_reg;
-	struct process_data *rx = v_rx;
-
-	if (!memcmp(rx->data, rx_reg->filter, rx_reg->len))
-		rx_reg->cb(rx_reg->user_data, &rx->info, rx->data, rx->len);
-}
-
 static void process_rx(struct mesh_io_private *pvt, int8_t rssi,
 					uint32_t instant, const uint8_t *addr,
 					const uint8_t *data, uint8_t len)
 {
-	struct process_data rx = {
-		.pvt = pvt,
-		.data = data,
-		.len = len,
-		.info.instant = instant,
-		.info.addr = addr,
-		.info.chan = 7,
-		.info.rssi = rssi,
+	struct mesh_io_recv_info info = {
+		.instant = instant,
+		.addr = addr,
+		.chan = 7,
+		.rssi = rssi,
 	};
 
-	l_queue_foreach(pvt->io->rx_regs, process_rx_callbacks, &rx);
+	mesh_io_process_rx(pvt->io, &info, data, len);
 }
 
-static void event_adv_report(struct mesh_io *io, const void *buf, uint8_t size)
+static void process_adv(struct mesh_io *io, int8_t rssi, const uint8_t *addr,
+					const uint8_t *adv, uint8_t adv_len)
 {
-	const struct bt_hci_evt_le_adv_report *evt = buf;
-	const uint8_t *adv;
-	const uint8_t *addr;
-	uint32_t instant;
-	uint8_t adv_len;
+	uint32_t instant = get_instant();
 	uint16_t len = 0;
-	int8_t rssi;
-
-	if (evt->event_type != 0x03)
-		return;
-
-	instant = get_instant();
-	adv = evt->data;
-	adv_len = evt->data_len;
-	addr = evt->addr;
-
-	/* rssi is just beyond last byte of data */
-	rssi = (int8_t) adv[adv_len];
 
 	while (len < adv_len - 1) {
 		uint8_t field_len = adv[0];
@@ -146,6 +137,50 @@ static void event_adv_report(struct mesh_io *io, const void *buf, uint8_t size)
 	}
 }
 
+static void event_adv_report(struct mesh_io *io, const void *buf, uint8_t size)
+{
+	const struct bt_hci_evt_le_adv_report *evt = buf;
+
+	if (evt->event_type != 0x03)
+		return;
+
+	/* rssi is just beyond last byte of data */
+	process_adv(io, (int8_t) evt->data[evt->data_len], evt->addr,
+						evt->data, evt->data_len);
+}
+
+static void event_ext_adv_report(struct mesh_io *io, const void *buf,
+								uint8_t size)
+{
+	const struct bt_hci_evt_le_ext_adv_report *evt = buf;
+	const struct bt_hci_le_ext_adv_report *rpt;
+	uint8_t i;
+
+	if (size < sizeof(*evt))
+		return;
+
+	buf += sizeof(*evt);
+	size -= sizeof(*evt);
+
+	for (i = 0; i < evt->num_reports; i++) {
+		rpt = buf;
+
+		if (size < sizeof(*rpt) || size < sizeof(*rpt) + rpt->data_len)
+			return;
+
+		/* Legacy ADV_NONCONN_IND, complete */
+		if (L_LE16_TO_CPU(rpt->event_type) == 0x0010)
+			process_adv(io, rpt->rssi, rpt->addr, rpt->data,
+								rpt->data_len);
+
+		buf += sizeof(*rpt) + rpt->data_len;
+		size -= sizeof(*rpt) + rpt->data_len;
+	}
+}
+
+static void event_adv_set_term(struct mesh_io *io, const void *buf,
+								uint8_t size);
+
 static void event_callback(const void *buf, uint8_t size, void *user_data)
 {
 	uint8_t event = l_get_u8(buf);
@@ -156,18 +191,50 @@ static void event_callback(const void *buf, uint8_t size, void *user_data)
 		event_adv_report(io, buf + 1, size - 1);
 		break;
 
+	case BT_HCI_EVT_LE_EXT_ADV_REPORT:
+		event_ext_adv_report(io, buf + 1, size - 1);
+		break;
+
+	case BT_HCI_EVT_LE_ADV_SET_TERM:
+		event_adv_set_term(io, buf + 1, size - 1);
+		break;
+
 	default:
 		l_debug("Other Meta Evt - %d", event);
 	}
 }
 
+static void tx_worker(void *user_data);
+static void io_started(struct mesh_io_private *pvt);
+static void create_adv_sets(const void *data, uint8_t size, void *user_data);
+
 static void local_commands_callback(const void *data, uint8_t size,
 							void *user_data)
 {
 	const struct bt_hci_rsp_read_local_commands *rsp = data;
+	struct mesh_io_private *pvt = user_data;
 
-	if (rsp->status)
+	if (size < sizeof(*rsp) || rsp->status) {
 		l_error("Failed to read local commands");
+		io_started(pvt);
+		return;
+	}
+
+	/*
+	 * LE Set Advertising Set Random Address, LE Set Extended Advertising
+	 * Parameters, Data and Enable, LE Read Number of Supported
+	 * Advertising Sets, LE Set Extended Scan Parameters and Enable.
+	 * Legacy and extended commands cannot be mixed, so scanning has to
+	 * follow whichever is used to transmit.
+	 */
+	if ((rsp->commands[36] & 0xae) != 0xae ||
+				(rsp->commands[37] & 0x60) != 0x60) {
+		io_started(pvt);
+		return;
+	}
+
+	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_READ_NUM_SUPPORTED_ADV_SETS,
+				NULL, 0, create_adv_sets, pvt, NULL);
 }
 
 static void local_features_callback(const void *data, uint8_t size,
@@ -190,21 +257,10 @@ static void hci_generic_callback(const void *data, uint8_t size,
 
 static void configure_hci(struct mesh_io_private *io)
 {
-	struct bt_hci_cmd_le_set_scan_parameters cmd;
 	struct bt_hci_cmd_set_event_mask cmd_sem;
 	struct bt_hci_cmd_le_set_event_mask cmd_slem;
 	struct bt_hci_cmd_le_set_random_address cmd_raddr;
 
-	/* Set scan parameters */
-	cmd.type = 0x00; /* Passive Scanning. No scanning PDUs shall be sent */
-	cmd.interval = 0x0030; /* Scan Interval = N * 0.625ms */
-	cmd.window = 0x0030; /* Scan Window = N * 0.625ms */
-	cmd.own_addr_type = 0x00; /* Public Device Address */
-	/* Accept all advertising packets except directed advertising packets
-	 * not addressed to this device (default).
-	 */
-	cmd.filter_policy = 0x00;
-
 	/* Set event mask
 	 *
 	 * Mask: 0x2000800002008890
@@ -255,9 +311,9 @@ static void configure_hci(struct mesh_io_private *io)
 	bt_hci_send(io->hci, BT_HCI_CMD_RESET, NULL, 0, hci_generic_callback,
 								NULL, NULL);
 
-	/* Read local supported commands */
+	/* Read local supported commands, picks legacy or extended ADVs */
 	bt_hci_send(io->hci, BT_HCI_CMD_READ_LOCAL_COMMANDS, NULL, 0,
-					local_commands_callback, NULL, NULL);
+					local_commands_callback, io, NULL);
 
 	/* Read local supported features */
 	bt_hci_send(io->hci, BT_HCI_CMD_READ_LOCAL_FEATURES, NULL, 0,
@@ -274,10 +330,6 @@ static void configure_hci(struct mesh_io_private *io)
 	/* Set LE random address */
 	bt_hci_send(io->hci, BT_HCI_CMD_LE_SET_RANDOM_ADDRESS, &cmd_raddr,
 			sizeof(cmd_raddr), hci_generic_callback, NULL, NULL);
-
-	/* Scan Params */
-	bt_hci_send(io->hci, BT_HCI_CMD_LE_SET_SCAN_PARAMETERS, &cmd,
-				sizeof(cmd), hci_generic_callback, NULL, NULL);
 }
 
 static void scan_enable_rsp(const void *buf, uint8_t size,
@@ -294,6 +346,18 @@ static void set_recv_scan_enable(const void *buf, uint8_t size,
 {
 	struct mesh_io_private *pvt = user_data;
 	struct bt_hci_cmd_le_set_scan_enable cmd;
+	struct bt_hci_cmd_le_set_ext_scan_enable ext_cmd;
+
+	if (pvt->num_sets) {
+		ext_cmd.enable = 0x01;		/* Enable scanning */
+		ext_cmd.filter_dup = 0x00;	/* Report duplicates */
+		ext_cmd.duration = 0;		/* Until disabled */
+		ext_cmd.period = 0;
+		bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_EXT_SCAN_ENABLE,
+				&ext_cmd, sizeof(ext_cmd),
+				scan_enable_rsp, pvt, NULL);
+		return;
+	}
 
 	cmd.enable = 0x01;	/* Enable scanning */
 	cmd.filter_dup = 0x00;	/* Report duplicates */
@@ -301,6 +365,24 @@ static void set_recv_scan_enable(const void *buf, uint8_t size,
 			&cmd, sizeof(cmd), scan_enable_rsp, pvt, NULL);
 }
 
+static void set_recv_ext_scan_params(struct mesh_io_private *pvt)
+{
+	uint8_t buf[sizeof(struct bt_hci_cmd_le_set_ext_scan_params) +
+					sizeof(struct bt_hci_le_scan_phy)];
+	struct bt_hci_cmd_le_set_ext_scan_params *cmd = (void *) buf;
+	struct bt_hci_le_scan_phy *phy = (void *) cmd->data;
+
+	cmd->own_addr_type = 0x01;		/* ADDR_TYPE_RANDOM */
+	cmd->filter_policy = 0x00;		/* Accept all */
+	cmd->num_phys = 0x01;			/* LE 1M */
+	phy->type = pvt->active ? 0x01 : 0x00;	/* Passive/Active scanning */
+	phy->interval = L_CPU_TO_LE16(0x0010);	/* 10 ms */
+	phy->window = L_CPU_TO_LE16(0x0010);	/* 10 ms */
+
+	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_EXT_SCAN_PARAMS,
+			buf, sizeof(buf), set_recv_scan_enable, pvt, NULL);
+}
+
 static void scan_disable_rsp(const void *buf, uint8_t size,
 							void *user_data)
 {
@@ -311,6 +393,11 @@ static void scan_disable_rsp(const void *buf, uint8_t size,
 	if (status)
 		l_error("LE Scan disable failed (0x%02x)", status);
 
+	if (pvt->num_sets) {
+		set_recv_ext_scan_params(pvt);
+		return;
+	}
+
 	cmd.type = pvt->active ? 0x01 : 0x00;	/* Passive/Active scanning */
 	cmd.interval = L_CPU_TO_LE16(0x0010);	/* 10 ms */
 	cmd.window = L_CPU_TO_LE16(0x0010);	/* 10 ms */
@@ -360,18 +447,152 @@ static bool find_active(const void *a, const void *b)
 	return false;
 }
 
-static void restart_scan(struct mesh_io_private *pvt)
+static void scan_disable(struct mesh_io_private *pvt,
+					bt_hci_callback_func_t callback)
 {
 	struct bt_hci_cmd_le_set_scan_enable cmd;
+	struct bt_hci_cmd_le_set_ext_scan_enable ext_cmd;
 
-	if (l_queue_isempty(pvt->io->rx_regs))
+	/* Scanning starts once the advertising commands are picked */
+	if (!pvt->ready)
 		return;
 
-	pvt->active = l_queue_find(pvt->io->rx_regs, find_active, NULL);
+	if (pvt->num_sets) {
+		memset(&ext_cmd, 0, sizeof(ext_cmd));	/* Disable scanning */
+		bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_EXT_SCAN_ENABLE,
+				&ext_cmd, sizeof(ext_cmd), callback, pvt, NULL);
+		return;
+	}
+
 	cmd.enable = 0x00;	/* Disable scanning */
 	cmd.filter_dup = 0x00;	/* Report duplicates */
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_SCAN_ENABLE,
-				&cmd, sizeof(cmd), scan_disable_rsp, pvt, NULL);
+				&cmd, sizeof(cmd), callback, pvt, NULL);
+}
+
+static void restart_scan(struct mesh_io_private *pvt)
+{
+	if (l_queue_isempty(pvt->io->rx_regs))
+		return;
+
+	pvt->active = l_queue_find(pvt->io->rx_regs, find_active, NULL);
+	scan_disable(pvt, scan_disable_rsp);
+}
+
+static void io_started(struct mesh_io_private *pvt)
+{
+	struct mesh_io *io = pvt->io;
+
+	pvt->ready = true;
+
+	l_debug("Started mesh on hci %u (%u advertising sets)", io->index,
+								pvt->num_sets);
+
+	restart_scan(pvt);
+
+	if (!l_queue_isempty(pvt->tx_pkts))
+		l_idle_oneshot(tx_worker, pvt, NULL);
+
+	if (io->ready)
+		io->ready(io->user_data, true);
+}
+
+/*
+ * Commands configuring a set are queued ahead of its data without waiting
+ * for each to complete, a failure is only acted upon once the data is set.
+ */
+static void adv_set_cmd_rsp(const void *buf, uint8_t size, void *user_data)
+{
+	struct adv_set *set = user_data;
+	uint8_t status = l_get_u8(buf);
+
+	if (!status)
+		return;
+
+	l_error("Failed to configure advertising set %u (0x%02x)",
+							set->handle, status);
+
+	/* Parameters are sent again along with the next packet */
+	set->interval = 0;
+	set->failed = true;
+}
+
+static void set_adv_set_params(struct adv_set *set, uint32_t interval)
+{
+	struct bt_hci_cmd_le_set_ext_adv_params cmd;
+
+	memset(&cmd, 0, sizeof(cmd));
+
+	cmd.handle = set->handle;
+	cmd.evt_properties = L_CPU_TO_LE16(0x0010); /* Legacy ADV_NONCONN_IND */
+	l_put_le16(interval, cmd.min_interval);
+	cmd.min_interval[2] = interval >> 16;
+	memcpy(cmd.max_interval, cmd.min_interval, 3);
+	cmd.channel_map = 0x07;
+	cmd.own_addr_type = 0x01;	/* ADDR_TYPE_RANDOM */
+	cmd.filter_policy = 0x00;
+	cmd.tx_power = 0x7f;		/* No preference */
+	cmd.primary_phy = 0x01;		/* LE 1M */
+	cmd.secondary_phy = 0x01;	/* LE 1M */
+	cmd.sid = set->handle;
+
+	set->interval = interval;
+	set->pvt->stats.cmds++;
+
+	bt_hci_send(set->pvt->hci, BT_HCI_CMD_LE_SET_EXT_ADV_PARAMS,
+				&cmd, sizeof(cmd), adv_set_cmd_rsp, set, NULL);
+}
+
+static void set_adv_set_rand_addr(struct adv_set *set)
+{
+	struct bt_hci_cmd_le_set_adv_set_rand_addr cmd;
+
+	cmd.handle = set->handle;
+	l_getrandom(cmd.bdaddr, 6);
+	cmd.bdaddr[5] |= 0xc0;
+
+	set->pvt->stats.cmds++;
+
+	bt_hci_send(set->pvt->hci, BT_HCI_CMD_LE_SET_ADV_SET_RAND_ADDR,
+				&cmd, sizeof(cmd), adv_set_cmd_rsp, set, NULL);
+}
+
+static void create_adv_sets(const void *data, uint8_t size, void *user_data)
+{
+	const struct bt_hci_rsp_le_read_num_supported_adv_sets *rsp = data;
+	struct mesh_io_private *pvt = user_data;
+	struct bt_hci_cmd_le_set_event_mask cmd_slem;
+	uint8_t i;
+
+	if (size < sizeof(*rsp) || rsp->status || !rsp->num_of_sets) {
+		io_started(pvt);
+		return;
+	}
+
+	/* Add LE Extended Advertising Report and Advertising Set Terminated */
+	memset(&cmd_slem, 0, sizeof(cmd_slem));
+	cmd_slem.mask[0] = 0x7f;
+	cmd_slem.mask[1] = 0x18;
+	cmd_slem.mask[2] = 0x02;
+	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_EVENT_MASK, &cmd_slem,
+			sizeof(cmd_slem), hci_generic_callback, NULL, NULL);
+
+	pvt->num_sets = rsp->num_of_sets;
+	if (pvt->num_sets > MAX_ADV_SETS)
+		pvt->num_sets = MAX_ADV_SETS;
+
+	/*
+	 * Sets are created once and only get their data (and interval, if
+	 * it changed) updated for each packet afterwards.
+	 */
+	for (i = 0; i < pvt->num_sets; i++) {
+		pvt->sets[i].pvt = pvt;
+		pvt->sets[i].handle = i;
+		set_adv_set_params(&pvt->sets[i], 0x20);
+		set_adv_set_rand_addr(&pvt->sets[i]);
+	}
+
+	io_started(pvt);
 }
 
 static void hci_init(void *user_data)
@@ -398,9 +619,8 @@ static void hci_init(void *user_data)
 		bt_hci_register(io->pvt->hci, BT_HCI_EVT_LE_META_EVENT,
 						event_callback, io, NULL);
 
-		l_debug("Started mesh on hci %u", io->index);
-
-		restart_scan(io->pvt);
+		/* Ready once the controller commands have been read */
+		return;
 	}
 
 	if (io->ready)
@@ -426,12 +646,19 @@ static bool dev_init(struct mesh_io *io, void *opts, void *user_data)
 static bool dev_destroy(struct mesh_io *io)
 {
 	struct mesh_io_private *pvt = io->pvt;
+	uint8_t i;
 
 	if (!pvt)
 		return true;
 
 	bt_hci_unref(pvt->hci);
 	l_timeout_remove(pvt->tx_timeout);
+
+	for (i = 0; i < pvt->num_sets; i++) {
+		if (pvt->sets[i].tx != ADV_SET_DISABLING)
+			l_free(pvt->sets[i].tx);
+	}
+
 	l_queue_remove_if(pvt->tx_pkts, simple_match, pvt->tx);
 	l_queue_destroy(pvt->tx_pkts, l_free);
 	l_free(pvt->tx);
@@ -454,6 +681,30 @@ static bool dev_caps(struct mesh_io *io, struct mesh_io_caps *caps)
 	return true;
 }
 
+static void report_tx_stats(struct mesh_io_private *pvt)
+{
+	struct tx_stats *stats = &pvt->stats;
+	uint32_t ms;
+
+	if (!stats->pkts)
+		return;
+
+	ms = get_instant() - stats->start;
+
+	l_debug("TX burst: %u packets, %u PDUs in %u ms (%u PDUs/s), "
+				"%u HCI commands", stats->pkts, stats->pdus,
+				ms, ms ? stats->pdus * 1000 / ms : 0,
+				stats->cmds);
+
+	memset(stats, 0, sizeof(*stats));
+}
+
+static void count_tx_pkt(struct mesh_io_private *pvt)
+{
+	if (!pvt->stats.pkts++)
+		pvt->stats.start = get_instant();
+}
+
 static void send_cancel_done(const void *buf, uint8_t size,
 							void *user_data)
 {
@@ -464,6 +715,8 @@ static void send_cancel_done(const void *buf, uint8_t size,
 		return;
 
 	pvt->sending = false;
+	pvt->stats.cmds++;
+	report_tx_stats(pvt);
 
 	/* At end of any burst of ADVs, change random address */
 	l_getrandom(cmd.addr, 6);
@@ -476,7 +729,7 @@ static void send_cancel(struct mesh_io_private *pvt)
 {
 	struct bt_hci_cmd_le_set_adv_enable cmd;
 
-	if (!pvt)
+	if (!pvt || pvt->num_sets)
 		return;
 
 	if (!pvt->sending) {
@@ -484,6 +737,7 @@ static void send_cancel(struct mesh_io_private *pvt)
 		return;
 	}
 
+	pvt->stats.cmds++;
 	cmd.enable = 0x00;	/* Disable advertising */
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_ADV_ENABLE,
 				&cmd, sizeof(cmd),
@@ -500,6 +754,7 @@ static void set_send_adv_enable(const void *buf, uint8_t size,
 		return;
 
 	pvt->sending = true;
+	pvt->stats.cmds++;
 	cmd.enable = 0x01;	/* Enable advertising */
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_ADV_ENABLE,
 				&cmd, sizeof(cmd), NULL, NULL, NULL);
@@ -525,6 +780,7 @@ static void set_send_adv_data(const void *buf, uint8_t size,
 	cmd.data[0] = tx->len;
 	memcpy(cmd.data + 1, tx->pkt, tx->len);
 
+	pvt->stats.cmds++;
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_ADV_DATA,
 					&cmd, sizeof(cmd),
 					set_send_adv_enable, pvt, NULL);
@@ -557,6 +813,7 @@ static void set_send_adv_params(const void *buf, uint8_t size,
 	cmd.channel_map = 0x07;
 	cmd.filter_policy = 0x03;
 
+	pvt->stats.cmds++;
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_ADV_PARAMETERS,
 				&cmd, sizeof(cmd),
 				set_send_adv_data, pvt, NULL);
@@ -576,17 +833,273 @@ static void send_pkt(struct mesh_io_private *pvt, struct tx_pkt *tx,
 	pvt->tx = tx;
 	pvt->interval = interval;
 
+	count_tx_pkt(pvt);
+	pvt->stats.pdus++;
+
 	if (!pvt->sending) {
 		set_send_adv_params(NULL, 0, pvt);
 		return;
 	}
 
+	pvt->stats.cmds++;
 	cmd.enable = 0x00;	/* Disable advertising */
 	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_ADV_ENABLE,
 				&cmd, sizeof(cmd),
 				set_send_adv_params, pvt, NULL);
 }
 
+static void disable_adv_set(struct adv_set *set,
+					bt_hci_callback_func_t callback)
+{
+	uint8_t buf[sizeof(struct bt_hci_cmd_le_set_ext_adv_enable) +
+					sizeof(struct bt_hci_cmd_ext_adv_set)];
+	struct bt_hci_cmd_le_set_ext_adv_enable *cmd = (void *) buf;
+	struct bt_hci_cmd_ext_adv_set *adv_set = (void *) (cmd + 1);
+
+	memset(buf, 0, sizeof(buf));
+	cmd->enable = 0x00;		/* Disable advertising */
+	cmd->num_of_sets = 1;
+	adv_set->handle = set->handle;
+
+	set->pvt->stats.cmds++;
+
+	bt_hci_send(set->pvt->hci, BT_HCI_CMD_LE_SET_EXT_ADV_ENABLE,
+				buf, sizeof(buf), callback, set, NULL);
+}
+
+static void ext_tx_resume(struct mesh_io_private *pvt)
+{
+	uint8_t i;
+
+	/* Queued packets were waiting for a free advertising set */
+	if (!l_queue_isempty(pvt->tx_pkts)) {
+		if (!pvt->tx_timeout)
+			tx_worker(pvt);
+
+		return;
+	}
+
+	for (i = 0; i < pvt->num_sets; i++) {
+		if (pvt->sets[i].tx)
+			return;
+	}
+
+	report_tx_stats(pvt);
+
+	/* At end of any burst of ADVs, change random addresses */
+	for (i = 0; i < pvt->num_sets; i++)
+		set_adv_set_rand_addr(&pvt->sets[i]);
+}
+
+static void release_adv_set(struct adv_set *set)
+{
+	if (set->tx != ADV_SET_DISABLING)
+		l_free(set->tx);
+
+	set->tx = NULL;
+	ext_tx_resume(set->pvt);
+}
+
+static void adv_set_disabled(const void *buf, uint8_t size, void *user_data)
+{
+	struct adv_set *set = user_data;
+
+	if (set->tx == ADV_SET_DISABLING)
+		release_adv_set(set);
+}
+
+static void adv_set_enabled(const void *buf, uint8_t size, void *user_data)
+{
+	struct adv_set *set = user_data;
+	uint8_t status = l_get_u8(buf);
+
+	if (!status)
+		return;
+
+	l_error("Failed to enable advertising set %u (0x%02x)", set->handle,
+								status);
+
+	if (set->tx && set->tx != ADV_SET_DISABLING)
+		release_adv_set(set);
+}
+
+static void enable_adv_set(struct adv_set *set)
+{
+	uint8_t buf[sizeof(struct bt_hci_cmd_le_set_ext_adv_enable) +
+					sizeof(struct bt_hci_cmd_ext_adv_set)];
+	struct bt_hci_cmd_le_set_ext_adv_enable *cmd = (void *) buf;
+	struct bt_hci_cmd_ext_adv_set *adv_set = (void *) (cmd + 1);
+	struct tx_pkt *tx = set->tx;
+
+	/* The controller repeats the packet and reports when it is done */
+	memset(buf, 0, sizeof(buf));
+	cmd->enable = 0x01;
+	cmd->num_of_sets = 1;
+	adv_set->handle = set->handle;
+
+	if (tx->info.type == MESH_IO_TIMING_TYPE_GENERAL)
+		adv_set->max_events = tx->info.u.gen.cnt;
+	else
+		adv_set->max_events = 1;
+
+	set->pvt->stats.cmds++;
+
+	bt_hci_send(set->pvt->hci, BT_HCI_CMD_LE_SET_EXT_ADV_ENABLE,
+				buf, sizeof(buf), adv_set_enabled, set, NULL);
+}
+
+static void adv_set_data_rsp(const void *buf, uint8_t size, void *user_data)
+{
+	struct adv_set *set = user_data;
+	uint8_t status = l_get_u8(buf);
+	bool failed = set->failed;
+
+	set->failed = false;
+
+	/* Cancelled meanwhile, the set is released once disabled */
+	if (!set->tx || set->tx == ADV_SET_DISABLING)
+		return;
+
+	if (status)
+		l_error("Failed to set advertising set %u data (0x%02x)",
+							set->handle, status);
+
+	/* Never enable a set left half configured */
+	if (status || failed) {
+		release_adv_set(set);
+		return;
+	}
+
+	enable_adv_set(set);
+}
+
+static void event_adv_set_term(struct mesh_io *io, const void *buf,
+								uint8_t size)
+{
+	const struct bt_hci_evt_le_adv_set_term *evt = buf;
+	struct mesh_io_private *pvt = io->pvt;
+	struct adv_set *set;
+
+	if (!pvt || size < sizeof(*evt) || evt->handle >= pvt->num_sets)
+		return;
+
+	set = &pvt->sets[evt->handle];
+
+	/* Already cancelled, the set is released once disabled */
+	if (!set->tx || set->tx == ADV_SET_DISABLING)
+		return;
+
+	pvt->stats.pdus += evt->num_evts;
+	release_adv_set(set);
+}
+
+static bool is_unlimited(const struct tx_pkt *tx)
+{
+	return tx->info.type == MESH_IO_TIMING_TYPE_GENERAL &&
+			tx->info.u.gen.cnt == MESH_IO_TX_COUNT_UNLIMITED;
+}
+
+static struct adv_set *get_adv_set(struct mesh_io_private *pvt)
+{
+	struct adv_set *set;
+	uint8_t i;
+
+	for (i = 0; i < pvt->num_sets; i++) {
+		if (!pvt->sets[i].tx)
+			return &pvt->sets[i];
+	}
+
+	/*
+	 * Packets repeated until cancelled never free their set, so take
+	 * one over and requeue its packet to share the sets round robin.
+	 */
+	for (i = 0; i < pvt->num_sets; i++) {
+		set = &pvt->sets[i];
+
+		if (set->tx == ADV_SET_DISABLING || !is_unlimited(set->tx))
+			continue;
+
+		disable_adv_set(set, NULL);
+		l_queue_push_tail(pvt->tx_pkts, set->tx);
+		set->tx = NULL;
+
+		return set;
+	}
+
+	return NULL;
+}
+
+static void ext_send_pkt(struct mesh_io_private *pvt, struct adv_set *set,
+							struct tx_pkt *tx)
+{
+	uint8_t data[sizeof(struct bt_hci_cmd_le_set_ext_adv_data) +
+							BT_AD_MAX_DATA_LEN];
+	struct bt_hci_cmd_le_set_ext_adv_data *cmd_data = (void *) data;
+	uint32_t interval;
+	uint16_t ms;
+
+	if (tx->info.type == MESH_IO_TIMING_TYPE_GENERAL)
+		ms = tx->info.u.gen.interval;
+	else
+		ms = 25;
+
+	/* Legacy PDUs cannot be sent faster than every 20 ms */
+	interval = (ms * 16) / 10;
+	if (interval < 0x20)
+		interval = 0x20;
+
+	/* The set is disabled, so its interval can be changed in place */
+	if (interval != set->interval)
+		set_adv_set_params(set, interval);
+
+	cmd_data->handle = set->handle;
+	cmd_data->operation = 0x03;		/* Complete data */
+	cmd_data->fragment_preference = 0x01;	/* No fragmentation */
+	cmd_data->data_len = tx->len + 1;
+	cmd_data->data[0] = tx->len;
+	memcpy(cmd_data->data + 1, tx->pkt, tx->len);
+
+	set->tx = tx;
+	count_tx_pkt(pvt);
+	pvt->stats.cmds++;
+
+	/* Queued behind the set configuration, enabled once all succeeded */
+	bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_EXT_ADV_DATA, data,
+				sizeof(*cmd_data) + cmd_data->data_len,
+				adv_set_data_rsp, set, NULL);
+}
+
+static void ext_tx_to(struct l_timeout *timeout, struct mesh_io_private *pvt)
+{
+	struct adv_set *set = NULL;
+	struct tx_pkt *tx;
+
+	pvt->tx_timeout = timeout;
+
+	tx = l_queue_peek_head(pvt->tx_pkts);
+	if (tx)
+		set = get_adv_set(pvt);
+
+	/* Resumed as soon as an advertising set is released */
+	if (!set) {
+		l_timeout_remove(timeout);
+		pvt->tx_timeout = NULL;
+		return;
+	}
+
+	l_queue_pop_head(pvt->tx_pkts);
+	ext_send_pkt(pvt, set, tx);
+
+	if (l_queue_isempty(pvt->tx_pkts)) {
+		l_timeout_remove(timeout);
+		pvt->tx_timeout = NULL;
+		return;
+	}
+
+	/* Schedule the next packet while this one is on air */
+	tx_worker(pvt);
+}
+
 static void tx_to(struct l_timeout *timeout, void *user_data)
 {
 	struct mesh_io_private *pvt = user_data;
@@ -597,6 +1110,11 @@ static void tx_to(struct l_timeout *timeout, void *user_data)
 	if (!pvt)
 		return;
 
+	if (pvt->num_sets) {
+		ext_tx_to(timeout, pvt);
+		return;
+	}
+
 	tx = l_queue_pop_head(pvt->tx_pkts);
 	if (!tx) {
 		l_timeout_remove(timeout);
@@ -713,7 +1231,7 @@ static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
 		 * guard against in-line cancellation of HCI command chain.
 		 */
 		if (info->type == MESH_IO_TIMING_TYPE_GENERAL &&
-					!pvt->tx &&
+					!pvt->num_sets && !pvt->tx &&
 					l_queue_isempty(pvt->tx_pkts) &&
 					tx->info.u.gen.cnt == 1)
 			tx->info.u.gen.cnt++;
@@ -721,6 +1239,25 @@ static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
 		l_queue_push_tail(pvt->tx_pkts, tx);
 	}
 
+	/* Sent once the advertising commands are picked */
+	if (!pvt->ready)
+		return true;
+
+	/*
+	 * With advertising sets, the worker is only idle while no packet is
+	 * waiting for its delay, or when a poll response must jump ahead.
+	 */
+	if (pvt->num_sets) {
+		if (!pvt->tx_timeout ||
+				info->type == MESH_IO_TIMING_TYPE_POLL_RSP) {
+			l_timeout_remove(pvt->tx_timeout);
+			pvt->tx_timeout = NULL;
+			l_idle_oneshot(tx_worker, pvt, NULL);
+		}
+
+		return true;
+	}
+
 	/* If not already sending, schedule the tx worker */
 	if (!pvt->tx) {
 		l_timeout_remove(pvt->tx_timeout);
@@ -734,7 +1271,13 @@ static bool send_tx(struct mesh_io *io, struct mesh_io_send_info *info,
 static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 {
 	struct mesh_io_private *pvt = io->pvt;
+	struct tx_pattern pattern = {
+		.data = data,
+		.len = len
+	};
+	struct adv_set *set;
 	struct tx_pkt *tx;
+	uint8_t i;
 
 	if (!data)
 		return false;
@@ -750,11 +1293,6 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 
 		} while (tx);
 	} else {
-		struct tx_pattern pattern = {
-			.data = data,
-			.len = len
-		};
-
 		do {
 			tx = l_queue_remove_if(pvt->tx_pkts, find_by_pattern,
 								&pattern);
@@ -766,6 +1304,22 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 		} while (tx);
 	}
 
+	/* Packets on air are dropped once their set is disabled */
+	for (i = 0; i < pvt->num_sets; i++) {
+		set = &pvt->sets[i];
+
+		if (!set->tx || set->tx == ADV_SET_DISABLING)
+			continue;
+
+		if (len == 1 ? !find_by_ad_type(set->tx, L_UINT_TO_PTR(data[0]))
+				: !find_by_pattern(set->tx, &pattern))
+			continue;
+
+		l_free(set->tx);
+		set->tx = ADV_SET_DISABLING;
+		disable_adv_set(set, adv_set_disabled);
+	}
+
 	if (l_queue_isempty(pvt->tx_pkts)) {
 		send_cancel(pvt);
 		l_timeout_remove(pvt->tx_timeout);
@@ -778,7 +1332,6 @@ static bool tx_cancel(struct mesh_io *io, const uint8_t *data, uint8_t len)
 static bool recv_register(struct mesh_io *io, const uint8_t *filter,
 			uint8_t len, mesh_io_recv_func_t cb, void *user_data)
 {
-	struct bt_hci_cmd_le_set_scan_enable cmd;
 	struct mesh_io_private *pvt = io->pvt;
 	bool already_scanning;
 	bool active = false;
@@ -791,11 +1344,7 @@ static bool recv_register(struct mesh_io *io, const uint8_t *filter,
 
 	if (!already_scanning || pvt->active != active) {
 		pvt->active = active;
-		cmd.enable = 0x00;	/* Disable scanning */
-		cmd.filter_dup = 0x00;	/* Report duplicates */
-		bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_SCAN_ENABLE,
-				&cmd, sizeof(cmd), scan_disable_rsp, pvt, NULL);
-
+		scan_disable(pvt, scan_disable_rsp);
 	}
 
 	return true;
@@ -804,7 +1353,6 @@ static bool recv_register(struct mesh_io *io, const uint8_t *filter,
 static bool recv_deregister(struct mesh_io *io, const uint8_t *filter,
 								uint8_t len)
 {
-	struct bt_hci_cmd_le_set_scan_enable cmd = {0, 0};
 	struct mesh_io_private *pvt = io->pvt;
 	bool active = false;
 
@@ -813,13 +1361,10 @@ static bool recv_deregister(struct mesh_io *io, const uint8_t *filter,
 		active = true;
 
 	if (l_queue_isempty(io->rx_regs)) {
-		bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_SCAN_ENABLE,
-					&cmd, sizeof(cmd), NULL, NULL, NULL);
-
+		scan_disable(pvt, NULL);
 	} else if (active != pvt->active) {
 		pvt->active = active;
-		bt_hci_send(pvt->hci, BT_HCI_CMD_LE_SET_SCAN_ENABLE,
-				&cmd, sizeof(cmd), scan_disable_rsp, pvt, NULL);
+		scan_disable(pvt, scan_disable_rsp);
 	}
 
 	return true;
@@ -50,13 +50,6 @@ struct mesh_io_private {
 	bool active;
 };
 
-struct process_data {
-	struct mesh_io_private		*pvt;
-	const uint8_t			*data;
-	uint8_t				len;
-	struct mesh_io_recv_info	info;
-};
-
 struct tx_pkt {
 	struct mesh_io_send_info	info;
 	bool				delete;
@@ -191,27 +184,15 @@ static bool filter_dups(const uint8_t *addr, const uint8_t *adv,
 	return true;
 }
 
-static void process_rx_callbacks(void *v_reg, void *v_rx)
-{
-	struct mesh_io_reg *rx_reg = v_reg;
-	struct process_data *rx = v_rx;
-
-	if (!memcmp(rx->data, rx_reg->filter, rx_reg->len))
-		rx_reg->cb(rx_reg->user_data, &rx->info, rx->data, rx->len);
-}
-
 static void process_rx(uint16_t index, struct mesh_io_private *pvt, int8_t rssi,
 					uint32_t instant, const uint8_t *addr,
 					const uint8_t *data, uint8_t len)
 {
-	struct process_data rx = {
-		.pvt = pvt,
-		.data = data,
-		.len = len,
-		.info.instant = instant,
-		.info.addr = addr,
-		.info.chan = 7,
-		.info.rssi = rssi,
+	struct mesh_io_recv_info info = {
+		.instant = instant,
+		.addr = addr,
+		.chan = 7,
+		.rssi = rssi,
 	};
 
 	/* Accept all traffic except beacons from any controller */
@@ -219,7 +200,7 @@ static void process_rx(uint16_t index, struct mesh_io_private *pvt, int8_t rssi,
 		return;
 
 	print_packet("RX", data, len);
-	l_queue_foreach(pvt->io->rx_regs, process_rx_callbacks, &rx);
+	mesh_io_process_rx(pvt->io, &info, data, len);
 }
 
 static void send_cmplt(uint16_t index, uint16_t length,
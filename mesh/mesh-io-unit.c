@@ -36,27 +36,13 @@ struct mesh_io_private {
 	void *user_data;
 	char *unique_name;
 	struct l_timeout *tx_timeout;
-	struct l_queue *rx_regs;
+	struct l_timeout *name_timeout;
 	struct l_queue *tx_pkts;
 	struct sockaddr_un addr;
 	int fd;
 	uint16_t interval;
 };
 
-struct pvt_rx_reg {
-	mesh_io_recv_func_t cb;
-	void *user_data;
-	uint8_t len;
-	uint8_t filter[0];
-};
-
-struct process_data {
-	struct mesh_io_private		*pvt;
-	const uint8_t			*data;
-	uint8_t				len;
-	struct mesh_io_recv_info	info;
-};
-
 struct tx_pkt {
 	struct mesh_io_send_info	info;
 	bool				delete;
@@ -87,30 +73,18 @@ static uint32_t instant_remaining_ms(uint32_t instant)
 	return instant;
 }
 
-static void process_rx_callbacks(void *v_reg, void *v_rx)
-{
-	struct pvt_rx_reg *rx_reg = v_reg;
-	struct process_data *rx = v_rx;
-
-	if (!memcmp(rx->data, rx_reg->filter, rx_reg->len))
-		rx_reg->cb(rx_reg->user_data, &rx->info, rx->data, rx->len);
-}
-
 static void process_rx(struct mesh_io_private *pvt, int8_t rssi,
 					uint32_t instant, const uint8_t *addr,
 					const uint8_t *data, uint8_t len)
 {
-	struct process_data rx = {
-		.pvt = pvt,
-		.data = data,
-		.len = len,
-		.info.instant = instant,
-		.info.addr = addr,
-		.info.chan = 7,
-		.info.rssi = rssi,
+	struct mesh_io_recv_info info = {
+		.instant = instant,
+		.addr = addr,
+		.chan = 7,
+		.rssi = rssi,
 	};
 
-	l_queue_foreach(pvt->rx_regs, process_rx_callbacks, &rx);
+	mesh_io_process_rx(pvt->io, &info, data, len);
 }
 
 static bool incoming(struct l_io *sio, void *user_data)
@@ -125,7 +99,7 @@ static bool incoming(struct l_io *sio, void *user_data)
 	size = recv(pvt->fd, buf, sizeof(buf), MSG_DONTWAIT);
 
 	if (size > 9 && buf[0]) {
-		process_rx(pvt, -20, instant, NULL, buf + 1, (uint8_t)size);
+		process_rx(pvt, -20, instant, NULL, buf + 1, size - 1);
 	} else if (size == 1 && !buf[0] && pvt->unique_name) {
 
 		/* Return DBUS unique name */
@@ -184,8 +158,11 @@ static void get_name(struct l_timeout *timeout, void *user_data)
 	struct l_dbus_message *msg;
 
 	l_timeout_remove(timeout);
+	pvt->name_timeout = NULL;
+
 	if (!dbus) {
-		l_timeout_create_ms(20, get_name, pvt, NULL);
+		pvt->name_timeout = l_timeout_create_ms(20, get_name, pvt,
+									NULL);
 		return;
 	}
 
@@ -209,7 +186,7 @@ static void unit_up(void *user_data)
 	if (pvt->io && pvt->io->ready)
 		pvt->io->ready(pvt->user_data, true);
 
-	l_timeout_create_ms(1, get_name, pvt, NULL);
+	pvt->name_timeout = l_timeout_create_ms(1, get_name, pvt, NULL);
 }
 
 static bool unit_init(struct mesh_io *io, void *opt, void *user_data)
@@ -246,7 +223,6 @@ static bool unit_init(struct mesh_io *io, void *opt, void *user_data)
 	if (!l_io_set_read_handler(pvt->sio, incoming, pvt, NULL))
 		goto fail;
 
-	pvt->rx_regs = l_queue_new();
 	pvt->tx_pkts = l_queue_new();
 
 	pvt->io = io;
@@ -275,7 +251,7 @@ static bool unit_destroy(struct mesh_io *io)
 
 	l_free(pvt->unique_name);
 	l_timeout_remove(pvt->tx_timeout);
-	l_queue_destroy(pvt->rx_regs, l_free);
+	l_timeout_remove(pvt->name_timeout);
 	l_queue_destroy(pvt->tx_pkts, l_free);
 
 	free_socket(pvt);
@@ -36,6 +36,12 @@ struct loop_data {
 	uint8_t data[];
 };
 
+struct mesh_io_filter {
+	struct mesh_io_reg *reg;
+	struct l_queue *children;
+	uint8_t octet;
+};
+
 /* List of Supported Mesh-IO Types */
 static const struct mesh_io_table table[] = {
 	{MESH_IO_TYPE_MGMT,	&mesh_io_mgmt},
@@ -119,12 +125,27 @@ static void ctl_alert(int index, bool up, bool pwr, bool mesh, void *user_data)
 	}
 }
 
+static void free_filter(void *data)
+{
+	struct mesh_io_filter *node = data;
+
+	l_queue_destroy(node->children, free_filter);
+	l_free(node);
+}
+
 static void free_io(struct mesh_io *io)
 {
+	unsigned int i;
+
 	if (io) {
 		if (io->api && io->api->destroy)
 			io->api->destroy(io);
 
+		for (i = 0; i < L_ARRAY_SIZE(io->rx_filters); i++) {
+			if (io->rx_filters[i])
+				free_filter(io->rx_filters[i]);
+		}
+
 		l_queue_destroy(io->rx_regs, l_free);
 		io->rx_regs = NULL;
 		l_free(io);
@@ -132,23 +153,137 @@ static void free_io(struct mesh_io *io)
 	}
 }
 
-static struct mesh_io_reg *find_by_filter(struct l_queue *rx_regs,
-					const uint8_t *filter, uint8_t len)
+static struct mesh_io_filter *find_child(struct mesh_io_filter *node,
+								uint8_t octet)
 {
 	const struct l_queue_entry *entry;
 
-	entry = l_queue_get_entries(rx_regs);
+	entry = l_queue_get_entries(node->children);
 
 	for (; entry; entry = entry->next) {
-		struct mesh_io_reg *rx_reg = entry->data;
+		struct mesh_io_filter *child = entry->data;
 
-		if (rx_reg->len == len && !memcmp(rx_reg->filter, filter, len))
-			return rx_reg;
+		if (child->octet == octet)
+			return child;
 	}
 
 	return NULL;
 }
 
+static struct mesh_io_filter *new_filter(uint8_t octet)
+{
+	struct mesh_io_filter *node = l_new(struct mesh_io_filter, 1);
+
+	node->octet = octet;
+
+	return node;
+}
+
+static struct mesh_io_filter *get_filter(struct mesh_io *io,
+					const uint8_t *filter, uint8_t len,
+					bool create)
+{
+	struct mesh_io_filter *node, *child;
+	uint8_t i;
+
+	node = io->rx_filters[filter[0]];
+	if (!node) {
+		if (!create)
+			return NULL;
+
+		node = new_filter(filter[0]);
+		io->rx_filters[filter[0]] = node;
+	}
+
+	for (i = 1; i < len; i++) {
+		child = find_child(node, filter[i]);
+		if (!child) {
+			if (!create)
+				return NULL;
+
+			child = new_filter(filter[i]);
+
+			if (!node->children)
+				node->children = l_queue_new();
+
+			l_queue_push_tail(node->children, child);
+		}
+
+		node = child;
+	}
+
+	return node;
+}
+
+static bool prune_filter(struct mesh_io_filter *node);
+
+static bool prune_child(void *data, void *user_data)
+{
+	if (!prune_filter(data))
+		return false;
+
+	l_free(data);
+	return true;
+}
+
+/* Returns true if nothing is registered on or below this node anymore */
+static bool prune_filter(struct mesh_io_filter *node)
+{
+	if (node->children) {
+		l_queue_foreach_remove(node->children, prune_child, NULL);
+
+		if (l_queue_isempty(node->children)) {
+			l_queue_destroy(node->children, NULL);
+			node->children = NULL;
+		}
+	}
+
+	return !node->reg && !node->children;
+}
+
+static void prune_filters(struct mesh_io *io)
+{
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(io->rx_filters); i++) {
+		if (io->rx_filters[i] && prune_filter(io->rx_filters[i])) {
+			l_free(io->rx_filters[i]);
+			io->rx_filters[i] = NULL;
+		}
+	}
+}
+
+void mesh_io_process_rx(struct mesh_io *io, struct mesh_io_recv_info *info,
+					const uint8_t *data, uint8_t len)
+{
+	struct mesh_io_filter *node;
+	uint8_t i = 0;
+
+	if (!io || !len)
+		return;
+
+	/* Filters deregistered from a callback are only pruned after */
+	io->rx_depth++;
+
+	/* Every registered filter that prefixes the packet gets it */
+	node = io->rx_filters[data[0]];
+
+	while (node) {
+		if (node->reg)
+			node->reg->cb(node->reg->user_data, info, data, len);
+
+		if (++i == len)
+			break;
+
+		node = find_child(node, data[i]);
+	}
+
+	if (!--io->rx_depth && io->rx_prune) {
+		io->rx_prune = false;
+		prune_filters(io);
+	}
+}
+
 struct mesh_io *mesh_io_new(enum mesh_io_type type, void *opts,
 				mesh_io_ready_func_t cb, void *user_data)
 {
@@ -208,6 +343,7 @@ bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
 				uint8_t len, mesh_io_recv_func_t cb,
 				void *user_data)
 {
+	struct mesh_io_filter *node;
 	struct mesh_io_reg *rx_reg;
 
 	if (io == NULL)
@@ -216,10 +352,10 @@ bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
 	if (io != default_io || !cb || !filter || !len)
 		return false;
 
-	rx_reg = find_by_filter(io->rx_regs, filter, len);
+	node = get_filter(io, filter, len, true);
 
-	l_free(rx_reg);
-	l_queue_remove(io->rx_regs, rx_reg);
+	l_queue_remove(io->rx_regs, node->reg);
+	l_free(node->reg);
 
 	rx_reg = l_malloc(sizeof(struct mesh_io_reg) + len);
 	rx_reg->cb = cb;
@@ -227,6 +363,7 @@ bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
 	rx_reg->user_data = user_data;
 	memcpy(rx_reg->filter, filter, len);
 
+	node->reg = rx_reg;
 	l_queue_push_head(io->rx_regs, rx_reg);
 
 	if (io && io->api && io->api->reg)
@@ -238,15 +375,27 @@ bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
 bool mesh_io_deregister_recv_cb(struct mesh_io *io, const uint8_t *filter,
 								uint8_t len)
 {
-	struct mesh_io_reg *rx_reg;
+	struct mesh_io_filter *node = NULL;
+
+	if (io == NULL)
+		io = default_io;
 
 	if (io != default_io)
 		return false;
 
-	rx_reg = find_by_filter(io->rx_regs,  filter, len);
+	if (filter && len)
+		node = get_filter(io, filter, len, false);
 
-	l_queue_remove(io->rx_regs, rx_reg);
-	l_free(rx_reg);
+	if (node && node->reg) {
+		l_queue_remove(io->rx_regs, node->reg);
+		l_free(node->reg);
+		node->reg = NULL;
+
+		if (io->rx_depth)
+			io->rx_prune = true;
+		else
+			prune_filters(io);
+	}
 
 	if (io && io->api && io->api->dereg)
 		return io->api->dereg(io, filter, len);
@@ -29,6 +29,7 @@
 #include "mesh/error.h"
 #include "mesh/agent.h"
 #include "mesh/mesh.h"
+#include "mesh/mesh-config.h"
 #include "mesh/mesh-defs.h"
 
 /*
@@ -210,6 +211,7 @@ uint8_t mesh_get_friend_queue_size(void)
 static void parse_settings(const char *mesh_conf_fname)
 {
 	struct l_settings *settings;
+	struct mesh_config_opts cfg_opts = { 0 };
 	char *str;
 	uint32_t value;
 
@@ -249,6 +251,17 @@ static void parse_settings(const char *mesh_conf_fname)
 	if (l_settings_get_uint(settings, "General", "ProvTimeout", &value))
 		mesh.prov_timeout = value;
 
+	if (l_settings_get_uint(settings, "General", "ConfigFlushWindow",
+								&value))
+		cfg_opts.flush_window = value;
+
+	l_settings_get_bool(settings, "General", "CompactConfig",
+							&cfg_opts.compact);
+	l_settings_get_bool(settings, "General", "ConfigJournal",
+							&cfg_opts.journal);
+
+	mesh_config_set_opts(&cfg_opts);
+
 done:
 	l_settings_free(settings);
 }
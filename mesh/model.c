@@ -395,60 +395,51 @@ static void forward_model(void *a, void *b)
 		fwd->done = true;
 }
 
+struct app_decrypt {
+	const uint8_t *data;
+	uint8_t *out;
+	uint8_t *virt;
+	uint32_t seq;
+	uint32_t iv_idx;
+	uint16_t size;
+	uint16_t virt_size;
+	uint16_t src;
+	uint16_t dst;
+	uint8_t key_aid;
+	bool szmict;
+};
+
+static bool app_key_decrypt(struct mesh_crypto_ctx *ctx, void *user_data)
+{
+	struct app_decrypt *req = user_data;
+
+	return mesh_crypto_ctx_payload_decrypt(req->virt, req->virt_size,
+					req->data, req->size, req->szmict,
+					req->src, req->dst, req->key_aid,
+					req->seq, req->iv_idx, req->out, ctx);
+}
+
 static int app_packet_decrypt(struct mesh_net *net, const uint8_t *data,
 				uint16_t size, bool szmict, uint16_t src,
 				uint16_t dst, uint8_t *virt, uint16_t virt_size,
 				uint8_t key_aid, uint32_t seq,
 				uint32_t iv_idx, uint8_t *out)
 {
-	struct l_queue *app_keys = mesh_net_get_app_keys(net);
-	const struct l_queue_entry *entry;
-
-	if (!app_keys)
-		return -1;
-
-	for (entry = l_queue_get_entries(app_keys); entry;
-							entry = entry->next) {
-		const uint8_t *old_key = NULL, *new_key = NULL;
-		uint8_t old_key_aid, new_key_aid;
-		int app_idx;
-		bool decrypted;
-
-		app_idx = appkey_get_key_idx(entry->data,
-							&old_key, &old_key_aid,
-							&new_key, &new_key_aid);
-
-		if (app_idx < 0)
-			continue;
-
-		if (old_key && old_key_aid == key_aid) {
-			decrypted = mesh_crypto_payload_decrypt(virt, virt_size,
-					data, size, szmict, src, dst, key_aid,
-						seq, iv_idx, out, old_key);
-
-			if (decrypted) {
-				print_packet("Used App Key", old_key, 16);
-				return app_idx;
-			}
-
-			print_packet("Failed App Key", old_key, 16);
-		}
-
-		if (new_key && new_key_aid == key_aid) {
-			decrypted = mesh_crypto_payload_decrypt(virt, virt_size,
-					data, size, szmict, src, dst, key_aid,
-						seq, iv_idx, out, new_key);
-
-			if (decrypted) {
-				print_packet("Used App Key", new_key, 16);
-				return app_idx;
-			}
-
-			print_packet("Failed App Key", new_key, 16);
-		}
-	}
+	struct app_decrypt req = {
+		.data = data,
+		.out = out,
+		.virt = virt,
+		.seq = seq,
+		.iv_idx = iv_idx,
+		.size = size,
+		.virt_size = virt_size,
+		.src = src,
+		.dst = dst,
+		.key_aid = key_aid,
+		.szmict = szmict,
+	};
 
-	return -1;
+	return appkey_decrypt(net, key_aid, app_key_decrypt, &req);
 }
 
 static int dev_packet_decrypt(struct mesh_node *node, const uint8_t *data,
@@ -527,7 +518,8 @@ static bool msg_send(struct mesh_node *node, bool cred, uint16_t src,
 {
 	uint8_t dev_key[16];
 	uint32_t iv_index, seq_num;
-	const uint8_t *key;
+	const uint8_t *key = NULL;
+	struct mesh_crypto_ctx *ctx = NULL;
 	uint8_t *out;
 	uint8_t key_aid = APP_AID_DEV;
 	bool szmic = false;
@@ -553,8 +545,8 @@ static bool msg_send(struct mesh_node *node, bool cred, uint16_t src,
 
 		key = dev_key;
 	} else {
-		key = appkey_get_key(node_get_net(node), app_idx, &key_aid);
-		if (!key) {
+		ctx = appkey_get_ctx(node_get_net(node), app_idx, &key_aid);
+		if (!ctx) {
 			l_debug("no app key for (%x)", app_idx);
 			return false;
 		}
@@ -566,8 +558,16 @@ static bool msg_send(struct mesh_node *node, bool cred, uint16_t src,
 
 	seq_num = mesh_net_next_seq_num(net);
 
-	if (!mesh_crypto_payload_encrypt(label, msg, out, msg_len, src, dst,
-				key_aid, seq_num, iv_index, szmic, key)) {
+	if (ctx)
+		ret = mesh_crypto_ctx_payload_encrypt(label, msg, out, msg_len,
+					src, dst, key_aid, seq_num, iv_index,
+					szmic, ctx);
+	else
+		ret = mesh_crypto_payload_encrypt(label, msg, out, msg_len,
+					src, dst, key_aid, seq_num, iv_index,
+					szmic, key);
+
+	if (!ret) {
 		l_error("Failed to Encrypt Payload");
 		goto done;
 	}
@@ -895,6 +895,7 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 	struct mesh_virtual *decrypt_virt = NULL;
 	bool result = false;
 	bool is_subscription;
+	uint64_t start;
 
 	l_debug("iv_index %8.8x key_aid = %2.2x", iv_index, key_aid);
 	if (!dst)
@@ -908,6 +909,7 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 
 	clear_text = l_malloc(size);
 	forward.data = clear_text;
+	start = l_time_now();
 
 	/*
 	 * The packet needs to be decoded by the correct key which
@@ -928,6 +930,8 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 						key_aid, seq0, iv_index,
 						clear_text);
 
+	mesh_net_stats_record(net, MESH_NET_STAGE_TRANSPORT_DECRYPT, start);
+
 	if (decrypt_idx < 0) {
 		l_error("model.c - Failed to decrypt application payload");
 		result = false;
@@ -936,6 +940,7 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 
 	print_packet("Clr Rx", clear_text, size - (szmict ? 8 : 4));
 
+	start = l_time_now();
 	forward.virt = decrypt_virt;
 	forward.app_idx = decrypt_idx;
 	forward.net_idx = net_idx;
@@ -996,6 +1001,8 @@ bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
 			break;
 	}
 
+	mesh_net_stats_record(net, MESH_NET_STAGE_MODEL_DISPATCH, start);
+
 done:
 	l_free(clear_text);
 
@@ -31,6 +31,9 @@
 /* This allows daemon to skip decryption on recently seen beacons */
 #define BEACON_CACHE_MAX	10
 
+/* NID is the low 7 bits of the first network PDU octet */
+#define NID_MAX			0x80
+
 struct beacon_rx {
 	uint8_t data[BEACON_LEN_MAX];
 	uint32_t id;
@@ -62,10 +65,10 @@ struct net_key {
 	uint8_t friend_key;
 	uint8_t nid;
 	uint8_t flooding[16];
-	uint8_t enc_key[16];
-	uint8_t prv_key[16];
-	uint8_t snb_key[16];
-	uint8_t pvt_key[16];
+	struct mesh_crypto_ctx *enc_key;
+	struct mesh_crypto_ctx *prv_key;
+	struct mesh_crypto_ctx *snb_key;
+	struct mesh_crypto_ctx *pvt_key;
 	uint8_t net_id[8];
 	bool kr;
 	bool ivu;
@@ -75,6 +78,11 @@ static struct l_queue *beacons;
 static struct l_queue *keys;
 static uint32_t last_flooding_id;
 
+/* Keys by NID, most recently successful first */
+static struct l_queue *nid_keys[NID_MAX];
+static uint32_t trial_count;
+static uint32_t trial_failed;
+
 /* To avoid re-decrypting same packet for multiple nodes, cache and check */
 static uint8_t cache_pkt[MESH_NET_MAX_PDU_LEN];
 static uint8_t cache_plain[MESH_NET_MAX_PDU_LEN];
@@ -106,11 +114,35 @@ static bool match_network(const void *a, const void *b)
 	return memcmp(key->net_id, net_id, sizeof(key->net_id)) == 0;
 }
 
+static void free_key(void *data)
+{
+	struct net_key *key = data;
+
+	l_timeout_remove(key->mpb_to);
+	l_queue_remove(nid_keys[key->nid], key);
+	mesh_crypto_ctx_free(key->enc_key);
+	mesh_crypto_ctx_free(key->prv_key);
+	mesh_crypto_ctx_free(key->snb_key);
+	mesh_crypto_ctx_free(key->pvt_key);
+	l_free(key->snb);
+	l_free(key->mpb);
+	l_free(key);
+}
+
+static void index_key(struct net_key *key)
+{
+	if (!nid_keys[key->nid])
+		nid_keys[key->nid] = l_queue_new();
+
+	l_queue_push_head(nid_keys[key->nid], key);
+}
+
 /* Key added from Provisioning, NetKey Add or NetKey update */
 uint32_t net_key_add(const uint8_t flooding[16])
 {
 	struct net_key *key = l_queue_find(keys, match_flooding, flooding);
 	uint8_t p[] = {0};
+	uint8_t enc_key[16], prv_key[16], tmp[16];
 	bool result;
 
 	if (key) {
@@ -128,29 +160,37 @@ uint32_t net_key_add(const uint8_t flooding[16])
 	memcpy(key->flooding, flooding, 16);
 	key->ref_cnt++;
 	key->mpb_refresh = NET_MPB_REFRESH_DEFAULT;
-	result = mesh_crypto_k2(flooding, p, sizeof(p), &key->nid, key->enc_key,
-								key->prv_key);
+	result = mesh_crypto_k2(flooding, p, sizeof(p), &key->nid, enc_key,
+								prv_key);
 	if (!result)
 		goto fail;
 
+	key->enc_key = mesh_crypto_ctx_new(enc_key);
+	key->prv_key = mesh_crypto_ctx_new(prv_key);
+
 	result = mesh_crypto_k3(flooding, key->net_id);
 	if (!result)
 		goto fail;
 
-	result = mesh_crypto_nkbk(flooding, key->snb_key);
+	result = mesh_crypto_nkbk(flooding, tmp);
 	if (!result)
 		goto fail;
 
-	result = mesh_crypto_nkpk(flooding, key->pvt_key);
+	key->snb_key = mesh_crypto_ctx_new(tmp);
+
+	result = mesh_crypto_nkpk(flooding, tmp);
 	if (!result)
 		goto fail;
 
+	key->pvt_key = mesh_crypto_ctx_new(tmp);
+
 	key->id = ++last_flooding_id;
 	l_queue_push_tail(keys, key);
+	index_key(key);
 	return key->id;
 
 fail:
-	l_free(key);
+	free_key(key);
 	return 0;
 }
 
@@ -161,6 +201,7 @@ uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
 						L_UINT_TO_PTR(flooding_id));
 	struct net_key *frnd_key;
 	uint8_t p[9] = {0x01};
+	uint8_t enc_key[16], prv_key[16];
 	bool result;
 
 	if (!key || key->friend_key)
@@ -174,17 +215,20 @@ uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
 	l_put_be16(fn_cnt, p + 7);
 
 	result = mesh_crypto_k2(key->flooding, p, sizeof(p), &frnd_key->nid,
-				frnd_key->enc_key, frnd_key->prv_key);
+							enc_key, prv_key);
 
 	if (!result) {
 		l_free(frnd_key);
 		return 0;
 	}
 
+	frnd_key->enc_key = mesh_crypto_ctx_new(enc_key);
+	frnd_key->prv_key = mesh_crypto_ctx_new(prv_key);
 	frnd_key->friend_key = true;
 	frnd_key->ref_cnt++;
 	frnd_key->id = ++last_flooding_id;
 	l_queue_push_head(keys, frnd_key);
+	index_key(frnd_key);
 
 	return frnd_key->id;
 }
@@ -197,7 +241,7 @@ void net_key_unref(uint32_t id)
 		if (--key->ref_cnt == 0) {
 			l_timeout_remove(key->observe.timeout);
 			l_queue_remove(keys, key);
-			l_free(key);
+			free_key(key);
 		}
 	}
 }
@@ -224,21 +268,38 @@ bool net_key_retrieve(uint32_t id, uint8_t *flooding)
 	return false;
 }
 
-static void decrypt_net_pkt(void *a, void *b)
+static void decrypt_net_pkt(void)
 {
-	const struct net_key *key = a;
-	bool result;
+	struct l_queue *bucket = nid_keys[cache_pkt[0] & 0x7f];
+	const struct l_queue_entry *entry;
+	struct net_key *key;
 
-	if (cache_id || !key->ref_cnt || (cache_pkt[0] & 0x7f) != key->nid)
-		return;
+	for (entry = l_queue_get_entries(bucket); entry; entry = entry->next) {
+		key = entry->data;
+
+		if (!key->ref_cnt)
+			continue;
 
-	result = mesh_crypto_packet_decode(cache_pkt, cache_len, false,
+		trial_count++;
+
+		if (mesh_crypto_ctx_packet_decode(cache_pkt, cache_len, false,
 						cache_plain, cache_iv_index,
-						key->enc_key, key->prv_key);
+						key->enc_key, key->prv_key))
+			break;
 
-	if (result) {
-		cache_id = key->id;
-		cache_plainlen = cache_len;
+		trial_failed++;
+	}
+
+	if (!entry)
+		return;
+
+	cache_id = key->id;
+	cache_plainlen = cache_len;
+
+	/* Keep the key that matched up front for the next packet */
+	if (entry != l_queue_get_entries(bucket)) {
+		l_queue_remove(bucket, key);
+		l_queue_push_head(bucket, key);
 	}
 }
 
@@ -259,8 +320,8 @@ uint32_t net_key_decrypt(uint32_t iv_index, const uint8_t *pkt, size_t len,
 	cache_len = len;
 	cache_iv_index = iv_index;
 
-	/* Try all network keys known to us */
-	l_queue_foreach(keys, decrypt_net_pkt, NULL);
+	/* Try the network keys known to us that share this NID */
+	decrypt_net_pkt();
 
 done:
 	if (cache_id) {
@@ -279,8 +340,8 @@ bool net_key_encrypt(uint32_t id, uint32_t iv_index, uint8_t *pkt, size_t len)
 	if (!key)
 		return false;
 
-	result = mesh_crypto_packet_encode(pkt, len, iv_index, key->enc_key,
-							key->prv_key);
+	result = mesh_crypto_ctx_packet_encode(pkt, len, iv_index,
+						key->enc_key, key->prv_key);
 
 	if (!result)
 		return false;
@@ -319,7 +380,7 @@ static void check_auth(void *a, void *b)
 	if (auth->id)
 		return;
 
-	if (mesh_crypto_aes_ccm_decrypt(auth->data + 1, key->pvt_key, NULL, 0,
+	if (mesh_crypto_ctx_ccm_decrypt(key->pvt_key, auth->data + 1, NULL, 0,
 							auth->data + 14, 13,
 							out, NULL, 8)) {
 		auth->id = key->id;
@@ -359,8 +420,8 @@ bool net_key_snb_check(uint32_t id, uint32_t iv_index, bool kr, bool ivu,
 		return false;
 
 	/* Any behavioral changes must pass CMAC test */
-	if (!mesh_crypto_beacon_cmac(key->snb_key, key->net_id, iv_index, kr,
-							ivu, &cmac_check)) {
+	if (!mesh_crypto_ctx_beacon_cmac(key->snb_key, key->net_id, iv_index,
+							kr, ivu, &cmac_check)) {
 		l_error("mesh_crypto_beacon_cmac failed");
 		return false;
 	}
@@ -392,7 +453,7 @@ static bool mpb_compose(struct net_key *key, uint32_t ivi, bool kr, bool ivu)
 		b_data[0] |= IV_INDEX_UPDATE;
 
 	l_getrandom(random, sizeof(random));
-	if (!mesh_crypto_aes_ccm_encrypt(random, key->pvt_key, NULL, 0,
+	if (!mesh_crypto_ctx_ccm_encrypt(key->pvt_key, random, NULL, 0,
 						b_data, 5, b_data, 8))
 		return false;
 
@@ -412,7 +473,7 @@ static bool snb_compose(struct net_key *key, uint32_t ivi, bool kr, bool ivu)
 		return false;
 
 	/* Any behavioral changes must pass CMAC test */
-	if (!mesh_crypto_beacon_cmac(key->snb_key, key->net_id, ivi, kr,
+	if (!mesh_crypto_ctx_beacon_cmac(key->snb_key, key->net_id, ivi, kr,
 								ivu, &cmac)) {
 		l_error("mesh_crypto_beacon_cmac failed");
 		return false;
@@ -780,20 +841,27 @@ void net_key_beacon_disable(uint32_t id, bool mpb)
 	key->observe.timeout = NULL;
 }
 
-static void free_key(void *data)
+void net_key_trial_stats(uint32_t *trials, uint32_t *failed)
 {
-	struct net_key *key = data;
+	if (trials)
+		*trials = trial_count;
 
-	l_timeout_remove(key->mpb_to);
-	l_free(key->snb);
-	l_free(key->mpb);
-	l_free(key);
+	if (failed)
+		*failed = trial_failed;
 }
 
 void net_key_cleanup(void)
 {
+	int i;
+
 	l_queue_destroy(keys, free_key);
 	keys = NULL;
+
+	for (i = 0; i < NID_MAX; i++) {
+		l_queue_destroy(nid_keys[i], NULL);
+		nid_keys[i] = NULL;
+	}
+
 	l_queue_destroy(beacons, l_free);
 	beacons = NULL;
 }
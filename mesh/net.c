@@ -131,13 +131,15 @@ struct mesh_net {
 	struct l_queue *subnets;
 	struct l_queue *msg_cache;
 	struct l_queue *replay_cache;
-	struct l_queue *sar_in;
-	struct l_queue *sar_out;
-	struct l_queue *sar_queue;
-	struct l_queue *frnd_msgs;
+	struct l_hashmap *sar_in;	/* By remote SRC */
+	struct l_hashmap *sar_out;	/* By SRC and SeqZero */
+	struct l_hashmap *sar_queue;	/* Queue of outgoing SARs by DST */
+	struct l_hashmap *frnd_msgs;	/* By DST */
 	struct l_queue *friends;
 	struct l_queue *negotiations;
 	struct l_queue *destinations;
+
+	struct mesh_net_stats stats;
 };
 
 struct mesh_msg {
@@ -147,6 +149,7 @@ struct mesh_msg {
 };
 
 struct mesh_sar {
+	struct mesh_net *net;
 	unsigned int id;
 	struct l_timeout *seg_timeout;
 	struct l_timeout *msg_timeout;
@@ -191,6 +194,7 @@ struct net_queue_data {
 
 struct oneshot_tx {
 	struct mesh_net *net;
+	uint64_t queued;
 	uint16_t interval;
 	uint8_t cnt;
 	uint8_t size;
@@ -294,12 +298,10 @@ static bool match_by_friend(const void *a, const void *b)
 
 static void free_friend_internals(struct mesh_friend *frnd)
 {
-	if (frnd->pkt_cache)
-		l_queue_destroy(frnd->pkt_cache, l_free);
+	friend_cache_free(frnd);
 
 	l_free(frnd->u.active.grp_list);
 	frnd->u.active.grp_list = NULL;
-	frnd->pkt_cache = NULL;
 
 	net_key_unref(frnd->net_key_cur);
 	net_key_unref(frnd->net_key_upd);
@@ -347,7 +349,8 @@ static void frnd_kr_phase3(void *a, void *b)
 struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 					uint8_t ele_cnt, uint8_t frd,
 					uint8_t frw, uint32_t fpt,
-					uint16_t fn_cnt, uint16_t lp_cnt)
+					uint16_t fn_cnt, uint16_t lp_cnt,
+					uint8_t cache_size)
 {
 	struct mesh_subnet *subnet;
 	struct mesh_friend *frnd = l_queue_find(net->friends,
@@ -372,7 +375,8 @@ struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 	frnd->lp_cnt = lp_cnt;
 	frnd->poll_timeout = fpt;
 	frnd->ele_cnt = ele_cnt;
-	frnd->pkt_cache = l_queue_new();
+	frnd->cache_size = cache_size;
+	frnd->pkt_cache = friend_cache_new(cache_size);
 	frnd->net_key_upd = 0;
 
 	subnet = get_primary_subnet(net);
@@ -488,13 +492,47 @@ uint32_t mesh_net_next_seq_num(struct mesh_net *net)
 	return seq;
 }
 
-static struct mesh_sar *mesh_sar_new(size_t len)
+static void stage_add(struct mesh_net_stage_stats *stage, uint64_t us)
+{
+	unsigned int bucket = 0;
+
+	while (us >> bucket && bucket < MESH_NET_HIST_BUCKETS - 1)
+		bucket++;
+
+	stage->count++;
+	stage->total_us += us;
+	stage->hist[bucket]++;
+
+	if (us > stage->max_us)
+		stage->max_us = us > UINT32_MAX ? UINT32_MAX : us;
+}
+
+void mesh_net_stats_record(struct mesh_net *net, enum mesh_net_stage stage,
+								uint64_t start)
+{
+	if (!net || stage >= MESH_NET_STAGES)
+		return;
+
+	stage_add(&net->stats.stage[stage], l_time_diff(start, l_time_now()));
+}
+
+bool mesh_net_get_stats(struct mesh_net *net, struct mesh_net_stats *stats)
+{
+	if (!net || !stats)
+		return false;
+
+	*stats = net->stats;
+	return true;
+}
+
+static struct mesh_sar *mesh_sar_new(struct mesh_net *net, size_t len)
 {
 	size_t size = sizeof(struct mesh_sar) + len;
 	struct mesh_sar *sar;
 
 	sar = l_malloc(size);
 	memset(sar, 0, size);
+	sar->net = net;
 	return sar;
 }
 
@@ -510,6 +548,16 @@ static void mesh_sar_free(void *data)
 	l_free(sar);
 }
 
+static void sar_queue_free(void *data)
+{
+	l_queue_destroy(data, mesh_sar_free);
+}
+
+static void *sar_out_key(uint16_t src, uint16_t seqZero)
+{
+	return L_UINT_TO_PTR(((uint32_t) src << 16) | seqZero);
+}
+
 static void subnet_free(void *data)
 {
 	struct mesh_subnet *subnet = data;
@@ -627,10 +675,10 @@ struct mesh_net *mesh_net_new(struct mesh_node *node)
 
 	net->subnets = l_queue_new();
 	net->msg_cache = l_queue_new();
-	net->sar_in = l_queue_new();
-	net->sar_out = l_queue_new();
-	net->sar_queue = l_queue_new();
-	net->frnd_msgs = l_queue_new();
+	net->sar_in = l_hashmap_new();
+	net->sar_out = l_hashmap_new();
+	net->sar_queue = l_hashmap_new();
+	net->frnd_msgs = l_hashmap_new();
 	net->destinations = l_queue_new();
 	net->app_keys = l_queue_new();
 	net->replay_cache = l_queue_new();
@@ -654,10 +702,10 @@ void mesh_net_free(void *user_data)
 	l_queue_destroy(net->subnets, subnet_free);
 	l_queue_destroy(net->msg_cache, l_free);
 	l_queue_destroy(net->replay_cache, l_free);
-	l_queue_destroy(net->sar_in, mesh_sar_free);
-	l_queue_destroy(net->sar_out, mesh_sar_free);
-	l_queue_destroy(net->sar_queue, mesh_sar_free);
-	l_queue_destroy(net->frnd_msgs, l_free);
+	l_hashmap_destroy(net->sar_in, mesh_sar_free);
+	l_hashmap_destroy(net->sar_out, NULL);
+	l_hashmap_destroy(net->sar_queue, sar_queue_free);
+	l_hashmap_destroy(net->frnd_msgs, l_free);
 	l_queue_destroy(net->friends, mesh_friend_free);
 	l_queue_destroy(net->negotiations, mesh_friend_free);
 	l_queue_destroy(net->destinations, l_free);
@@ -1064,38 +1112,6 @@ static bool msg_in_cache(struct mesh_net *net, uint16_t src, uint32_t seq,
 	return false;
 }
 
-static bool match_sar_seq0(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	uint16_t seqZero = L_PTR_TO_UINT(b);
-
-	return sar->seqZero == seqZero;
-}
-
-static bool match_sar_remote(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	uint16_t remote = L_PTR_TO_UINT(b);
-
-	return sar->remote == remote;
-}
-
-static bool match_msg_timeout(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	const struct l_timeout *msg_timeout = b;
-
-	return sar->msg_timeout == msg_timeout;
-}
-
-static bool match_seg_timeout(const void *a, const void *b)
-{
-	const struct mesh_sar *sar = a;
-	const struct l_timeout *seg_timeout = b;
-
-	return sar->seg_timeout == seg_timeout;
-}
-
 static bool match_dest_dst(const void *a, const void *b)
 {
 	const struct mesh_destination *dest = a;
@@ -1169,46 +1185,18 @@ static bool is_us(struct mesh_net *net, uint16_t addr, bool src)
 
 static struct mesh_friend_msg *mesh_friend_msg_new(uint8_t seg_max)
 {
-	struct mesh_friend_msg *frnd_msg;
-
-	if (seg_max) {
-		size_t size = sizeof(struct mesh_friend_msg) -
-					sizeof(struct mesh_friend_seg_one);
-
-		size += (seg_max + 1) * sizeof(struct mesh_friend_seg_12);
-		frnd_msg = l_malloc(size);
-		memset(frnd_msg, 0, size);
-	} else
-		frnd_msg = l_new(struct mesh_friend_msg, 1);
+	size_t size = FRND_MSG_SIZE(seg_max);
+	struct mesh_friend_msg *frnd_msg = l_malloc(size);
 
+	memset(frnd_msg, 0, size);
 
 	return frnd_msg;
 }
 
-
-static bool match_ack(const void *a, const void *b)
-{
-	const struct mesh_friend_msg *old = a;
-	const struct mesh_friend_msg *rx = b;
-	uint32_t old_hdr;
-	uint32_t new_hdr;
-
-	/* Determine if old pkt is ACK to same SAR message that new ACK is */
-	if (!old->ctl || old->src != rx->src)
-		return false;
-
-	/* Check the quickest items first before digging deeper */
-	old_hdr = old->u.one[0].hdr & HDR_ACK_MASK;
-	new_hdr = rx->u.one[0].hdr & HDR_ACK_MASK;
-
-	return old_hdr == new_hdr;
-}
-
 static void enqueue_friend_pkt(void *a, void *b)
 {
 	struct mesh_friend *frnd = a;
-	struct mesh_friend_msg *pkt, *rx = b;
-	size_t size;
+	struct mesh_friend_msg *rx = b;
 	int16_t i;
 
 	if (rx->done)
@@ -1236,55 +1224,11 @@ static void enqueue_friend_pkt(void *a, void *b)
 	}
 
 enqueue:
-	/* Special handling for Seg Ack -- Only one per message queue */
-	if (((rx->u.one[0].hdr >> OPCODE_HDR_SHIFT) & OPCODE_MASK) ==
-						NET_OP_SEG_ACKNOWLEDGE) {
-		void *old_head = l_queue_peek_head(frnd->pkt_cache);
-		/* Suppress duplicate ACKs */
-		do {
-			void *old = l_queue_remove_if(frnd->pkt_cache,
-							match_ack, rx);
-
-			if (!old)
-				break;
-
-			if (old_head == old)
-				/*
-				 * If we are discarding head for any
-				 * reason, reset FRND SEQ
-				 */
-				frnd->u.active.last = frnd->u.active.seq;
-
-			l_free(old);
-
-		} while (true);
-	}
-
 	l_debug("%s for %4.4x from %4.4x ttl: %2.2x (seq: %6.6x) (ctl: %d)",
 			__func__, frnd->lp_addr, rx->src, rx->ttl,
 			rx->u.one[0].seq, rx->ctl);
 
-	if (rx->cnt_in) {
-		size = sizeof(struct mesh_friend_msg) -
-				sizeof(struct mesh_friend_seg_one);
-		size += (rx->cnt_in + 1) * sizeof(struct mesh_friend_seg_12);
-	} else
-		size = sizeof(struct mesh_friend_msg);
-
-	pkt = l_malloc(size);
-	memcpy(pkt, rx, size);
-
-	l_queue_push_tail(frnd->pkt_cache, pkt);
-
-	if (l_queue_length(frnd->pkt_cache) > FRND_CACHE_MAX) {
-		/*
-		 * TODO: Guard against popping UPDATE packets
-		 * (disallowed per spec)
-		 */
-		pkt = l_queue_pop_head(frnd->pkt_cache);
-		l_free(pkt);
-		frnd->u.active.last = frnd->u.active.seq;
-	}
+	friend_cache_push(frnd, rx);
 }
 
 static void enqueue_update(void *a, void *b)
@@ -1316,14 +1260,18 @@ static bool friend_packet_queue(struct mesh_net *net,
 					uint32_t hdr,
 					const uint8_t *data, uint16_t size)
 {
-	struct mesh_friend_msg *frnd_msg;
+	/* Copied into the Friend Queue of each LPN it is for */
+	union {
+		struct mesh_friend_msg msg;
+		uint8_t buf[FRND_MSG_SIZE(SEG_MASK)];
+	} pkt;
+	struct mesh_friend_msg *frnd_msg = &pkt.msg;
 	uint8_t seg_max = SEG_TOTAL(hdr);
-	bool ret;
 
 	if (seg_max && !IS_SEGMENTED(hdr))
 		return false;
 
-	frnd_msg = mesh_friend_msg_new(seg_max);
+	memset(frnd_msg, 0, FRND_MSG_SIZE(seg_max));
 
 	if (IS_SEGMENTED(hdr)) {
 		uint32_t seqAuth = seq_auth(seq, hdr >> SEQ_ZERO_HDR_SHIFT);
@@ -1347,10 +1295,8 @@ static bool friend_packet_queue(struct mesh_net *net,
 		if (ctl && opcode != NET_OP_SEG_ACKNOWLEDGE) {
 
 			/* Don't cache Friend Ctl opcodes */
-			if (FRND_OPCODE(opcode)) {
-				l_free(frnd_msg);
+			if (FRND_OPCODE(opcode))
 				return false;
-			}
 
 			memcpy(frnd_msg->u.one[0].data + 1, data, size);
 			frnd_msg->last_len = size + 1;
@@ -1372,12 +1318,8 @@ static bool friend_packet_queue(struct mesh_net *net,
 
 	/* Re-Package into Friend Delivery payload */
 	l_queue_foreach(net->friends, enqueue_friend_pkt, frnd_msg);
-	ret = frnd_msg->done;
 
-	/* TODO Optimization(?): Unicast messages keep this buffer */
-	l_free(frnd_msg);
-
-	return ret;
+	return frnd_msg->done;
 }
 
 static void friend_ack_rxed(struct mesh_net *net, uint32_t iv_index,
@@ -1487,31 +1429,18 @@ static void send_net_ack(struct mesh_net *net, struct mesh_sar *sar,
 
 static void inseg_to(struct l_timeout *seg_timeout, void *user_data)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_find(net->sar_in,
-					match_seg_timeout, seg_timeout);
-
-	l_timeout_remove(seg_timeout);
-	if (!sar)
-		return;
+	struct mesh_sar *sar = user_data;
 
 	/* Send NAK */
 	l_debug("Timeout %p %3.3x", sar, sar->app_idx);
-	send_net_ack(net, sar, sar->flags);
+	send_net_ack(sar->net, sar, sar->flags);
 
-	sar->seg_timeout = l_timeout_create(SEG_TO, inseg_to, net, NULL);
+	l_timeout_modify(seg_timeout, SEG_TO);
 }
 
 static void inmsg_to(struct l_timeout *msg_timeout, void *user_data)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_find(net->sar_in,
-			match_msg_timeout, msg_timeout);
-
-	if (!sar) {
-		l_timeout_remove(msg_timeout);
-		return;
-	}
+	struct mesh_sar *sar = user_data;
 
 	if (!sar->delete) {
 		/*
@@ -1525,39 +1454,88 @@ static void inmsg_to(struct l_timeout *msg_timeout, void *user_data)
 		return;
 	}
 
-	l_queue_remove(net->sar_in, sar);
+	l_hashmap_remove(sar->net->sar_in, L_UINT_TO_PTR(sar->remote));
 	mesh_sar_free(sar);
 }
 
-static void outmsg_to(struct l_timeout *msg_timeout, void *user_data)
+static void outmsg_to(struct l_timeout *msg_timeout, void *user_data);
+static void outseg_to(struct l_timeout *seg_timeout, void *user_data);
+
+/* Resend every segment not acknowledged yet and restart the Seg TO */
+static void send_missing_segs(struct mesh_sar *sar)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_remove_if(net->sar_out,
-			match_msg_timeout, msg_timeout);
+	struct mesh_net *net = sar->net;
+	uint32_t missing = sar->flags & ~sar->last_nak;
 
-	l_timeout_remove(msg_timeout);
-	if (!sar)
-		return;
+	while (missing) {
+		int i = __builtin_ctz(missing);
 
-	sar->msg_timeout = NULL;
-	mesh_sar_free(sar);
+		missing &= missing - 1;
+
+		l_debug("Resend Seg %d net:%p dst:%x app_idx:%3.3x",
+					i, net, sar->remote, sar->app_idx);
+
+		send_seg(net, net->tx_cnt, net->tx_interval, sar, i);
+	}
+
+	if (sar->seg_timeout)
+		l_timeout_modify(sar->seg_timeout, SEG_TO);
+	else
+		sar->seg_timeout = l_timeout_create(SEG_TO, outseg_to,
+								sar, NULL);
 }
 
-static void outseg_to(struct l_timeout *seg_timeout, void *user_data);
+static void start_sar_out(struct mesh_sar *sar)
+{
+	l_hashmap_insert(sar->net->sar_out,
+				sar_out_key(sar->src, sar->seqZero), sar);
 
-static void send_queued_sar(struct mesh_net *net, uint16_t dst)
+	sar->msg_timeout = l_timeout_create(MSG_TO, outmsg_to, sar, NULL);
+	sar->seg_timeout = l_timeout_create(SEG_TO, outseg_to, sar, NULL);
+}
+
+/*
+ * Outgoing SARs are single threaded per Unicast DST: the head of each
+ * queue is in flight, so once it is done the next one can go out.
+ */
+static void end_sar_out(struct mesh_sar *sar)
 {
-	struct mesh_sar *sar = l_queue_remove_if(net->sar_queue,
-			match_sar_remote, L_UINT_TO_PTR(dst));
+	struct mesh_net *net = sar->net;
+	void *dst = L_UINT_TO_PTR(sar->remote);
+	struct l_queue *queue;
 
-	if (!sar)
-		return;
+	l_hashmap_remove(net->sar_out, sar_out_key(sar->src, sar->seqZero));
+
+	queue = l_hashmap_lookup(net->sar_queue, dst);
+	l_queue_remove(queue, sar);
+	mesh_sar_free(sar);
+
+	while ((sar = l_queue_peek_head(queue))) {
+		uint32_t seq_max = net->seq_num + SEG_MAX(true, sar->len);
+
+		/* Every segment must stay within SeqZero range of SeqAuth */
+		if (seq_max - sar->seqAuth <= SEQ_ZERO_MASK) {
+			/* Out to current outgoing, and send all segments */
+			start_sar_out(sar);
+			send_missing_segs(sar);
+			return;
+		}
+
+		l_debug("OB-Expired SeqZero: %4.4x", sar->seqZero);
+		l_queue_pop_head(queue);
+		mesh_sar_free(sar);
+	}
+
+	l_hashmap_remove(net->sar_queue, dst);
+	l_queue_destroy(queue, NULL);
+}
+
+static void outmsg_to(struct l_timeout *msg_timeout, void *user_data)
+{
+	struct mesh_sar *sar = user_data;
 
-	/* Out to current outgoing, and immediate expire Seg TO */
-	l_queue_push_head(net->sar_out, sar);
-	sar->seg_timeout = NULL;
-	sar->msg_timeout = l_timeout_create(MSG_TO, outmsg_to, net, NULL);
-	outseg_to(NULL, net);
+	l_debug("ob_sar_timeout (%x)", sar->flags & ~sar->last_nak);
+	end_sar_out(sar);
 }
 
 static void ack_received(struct mesh_net *net, bool timeout,
@@ -1565,14 +1543,11 @@ static void ack_received(struct mesh_net *net, bool timeout,
 				uint16_t seq0, uint32_t ack_flag)
 {
 	struct mesh_sar *outgoing;
-	uint32_t seg_flag = 0x00000001;
-	uint32_t ack_copy = ack_flag;
-	uint16_t i;
 
 	l_debug("ACK Rxed (%x) (to:%d): %8.8x", seq0, timeout, ack_flag);
 
-	outgoing = l_queue_find(net->sar_out, match_sar_seq0,
-							L_UINT_TO_PTR(seq0));
+	/* Acks are addressed to the element that sent the SAR */
+	outgoing = l_hashmap_lookup(net->sar_out, sar_out_key(dst, seq0));
 
 	if (!outgoing) {
 		l_debug("Not Found: %4.4x", seq0);
@@ -1584,56 +1559,27 @@ static void ack_received(struct mesh_net *net, bool timeout,
 	 * SRC than we are sending to, make sure the OBO flag is set
 	 */
 
+	outgoing->last_nak |= ack_flag;
+
 	if ((!timeout && !ack_flag) ||
-			(outgoing->flags & ack_flag) == outgoing->flags) {
+		(outgoing->flags & outgoing->last_nak) == outgoing->flags) {
 		l_debug("ob_sar_removal (%x)", outgoing->flags);
 
 		/* Note: ack_flags == 0x00000000 is a remote Cancel request */
 
-		l_queue_remove(net->sar_out, outgoing);
-		send_queued_sar(net, outgoing->remote);
-		mesh_sar_free(outgoing);
-
+		end_sar_out(outgoing);
 		return;
 	}
 
-	outgoing->last_nak |= ack_flag;
-
-	ack_copy &= outgoing->flags;
-
-	for (i = 0; i <= SEG_MAX(true, outgoing->len); i++, seg_flag <<= 1) {
-		if (seg_flag & ack_flag) {
-			l_debug("Skipping Seg %d of %d",
-					i, SEG_MAX(true, outgoing->len));
-			continue;
-		}
-
-		ack_copy |= seg_flag;
-
-		l_debug("Resend Seg %d net:%p dst:%x app_idx:%3.3x",
-				i, net, outgoing->remote, outgoing->app_idx);
-
-		send_seg(net, net->tx_cnt, net->tx_interval, outgoing, i);
-	}
-
-	l_timeout_remove(outgoing->seg_timeout);
-	outgoing->seg_timeout = l_timeout_create(SEG_TO, outseg_to, net, NULL);
+	send_missing_segs(outgoing);
 }
 
 static void outseg_to(struct l_timeout *seg_timeout, void *user_data)
 {
-	struct mesh_net *net = user_data;
-	struct mesh_sar *sar = l_queue_find(net->sar_out,
-					match_seg_timeout, seg_timeout);
-
-	l_timeout_remove(seg_timeout);
-	if (!sar)
-		return;
-
-	sar->seg_timeout = NULL;
+	struct mesh_sar *sar = user_data;
 
 	/* Re-Send missing segments by faking NACK */
-	ack_received(net, true, sar->remote, sar->src,
+	ack_received(sar->net, true, sar->remote, sar->src,
 					sar->seqZero, sar->last_nak);
 }
 
@@ -1776,8 +1722,10 @@ not_for_friend:
 	/* Don't process if already in RPL */
 	crpl = node_get_crpl(net->node);
 
-	if (msg_check_replay_cache(net, src, crpl, seq, iv_index))
+	if (msg_check_replay_cache(net, src, crpl, seq, iv_index)) {
+		net->stats.rx_replayed++;
 		return false;
+	}
 
 	if (!mesh_model_rx(net->node, szmic, seqAuth, iv_index, net_idx, src,
 						dst, key_aid, data, size))
@@ -1825,14 +1773,6 @@ static uint16_t key_id_to_net_idx(struct mesh_net *net,
 		return NET_IDX_INVALID;
 }
 
-static bool match_frnd_sar_dst(const void *a, const void *b)
-{
-	const struct mesh_friend_msg *frnd_msg = a;
-	uint16_t dst = L_PTR_TO_UINT(b);
-
-	return frnd_msg->dst == dst;
-}
-
 static void friend_seg_rxed(struct mesh_net *net,
 				uint32_t iv_index,
 				uint8_t ttl, uint32_t seq,
@@ -1862,8 +1802,7 @@ static void friend_seg_rxed(struct mesh_net *net,
 	}
 
 	/* Check if we have a SAR-in-progress that matches incoming segment */
-	frnd_msg = l_queue_find(net->frnd_msgs, match_frnd_sar_dst,
-			L_UINT_TO_PTR(dst));
+	frnd_msg = l_hashmap_lookup(net->frnd_msgs, L_UINT_TO_PTR(dst));
 
 	if (frnd_msg) {
 		/* Flush if SZMICN or IV Index has changed */
@@ -1872,7 +1811,7 @@ static void friend_seg_rxed(struct mesh_net *net,
 
 		/* Flush incomplete old SAR message if it doesn't match */
 		if ((frnd_msg->u.s12[0].hdr & HDR_KEY_MASK) != hdr_key) {
-			l_queue_remove(net->frnd_msgs, frnd_msg);
+			l_hashmap_remove(net->frnd_msgs, L_UINT_TO_PTR(dst));
 			l_free(frnd_msg);
 			frnd_msg = NULL;
 		}
@@ -1884,7 +1823,7 @@ static void friend_seg_rxed(struct mesh_net *net,
 		frnd_msg->src = src;
 		frnd_msg->dst = dst;
 		frnd_msg->ttl = ttl;
-		l_queue_push_tail(net->frnd_msgs, frnd_msg);
+		l_hashmap_insert(net->frnd_msgs, L_UINT_TO_PTR(dst), frnd_msg);
 	} else if (frnd_msg->flags & this_seg_flag) /* Ignore dup segs */
 		return;
 
@@ -1915,7 +1854,7 @@ static void friend_seg_rxed(struct mesh_net *net,
 		}
 
 		/* Remove from "in progress" queue */
-		l_queue_remove(net->frnd_msgs, frnd_msg);
+		l_hashmap_remove(net->frnd_msgs, L_UINT_TO_PTR(dst));
 
 		/* TODO Optimization(?): Unicast messages keep this buffer */
 		l_free(frnd_msg);
@@ -1949,8 +1888,7 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 	 * DST could receive additional Segments after
 	 * completing due to a lost ACK, so re-ACK and discard
 	 */
-	sar_in = l_queue_find(net->sar_in, match_sar_remote,
-						L_UINT_TO_PTR(src));
+	sar_in = l_hashmap_lookup(net->sar_in, L_UINT_TO_PTR(src));
 
 	/* Discard *old* incoming-SAR-in-progress if this segment newer */
 	seqAuth = seq_auth(seq, seqZero);
@@ -1967,7 +1905,7 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 
 		if (newer) {
 			/* Cancel Old, start New */
-			l_queue_remove(net->sar_in, sar_in);
+			l_hashmap_remove(net->sar_in, L_UINT_TO_PTR(src));
 			mesh_sar_free(sar_in);
 			sar_in = NULL;
 		} else
@@ -1997,8 +1935,8 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 
 		l_debug("RXed (new: %04x %06x size: %d len: %d) %d of %d",
 				seqZero, seq, size, len, segO, segN);
-		l_debug("Queue Size: %d", l_queue_length(net->sar_in));
-		sar_in = mesh_sar_new(len);
+		l_debug("Queue Size: %d", l_hashmap_size(net->sar_in));
+		sar_in = mesh_sar_new(net, len);
 		sar_in->seqAuth = seqAuth;
 		sar_in->iv_index = iv_index;
 		sar_in->src = dst;
@@ -2009,15 +1947,15 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 		sar_in->last_seg = 0xff;
 		sar_in->net_idx = net_idx;
 		sar_in->msg_timeout = l_timeout_create(MSG_TO,
-					inmsg_to, net, NULL);
+					inmsg_to, sar_in, NULL);
 
 		l_debug("First Seg %4.4x", sar_in->flags);
-		l_queue_push_head(net->sar_in, sar_in);
+		l_hashmap_insert(net->sar_in, L_UINT_TO_PTR(src), sar_in);
 	}
 
 	seg_off = segO * MAX_SEG_LEN;
 	memcpy(sar_in->buf + seg_off, data, size);
-	this_seg_flag = 0x00000001 << segO;
+	this_seg_flag = 0x00000001U << segO;
 
 	/* Don't reset Seg TO or NAK if we already have this seg */
 	if (this_seg_flag & sar_in->flags)
@@ -2058,7 +1996,7 @@ static bool seg_rxed(struct mesh_net *net, bool frnd, uint32_t iv_index,
 			send_net_ack(net, sar_in, sar_in->flags);
 
 		sar_in->seg_timeout = l_timeout_create(SEG_TO,
-				inseg_to, net, NULL);
+				inseg_to, sar_in, NULL);
 	} else
 		largest = 0;
 
@@ -2250,6 +2188,8 @@ static void send_relay_pkt(struct mesh_net *net, uint8_t *data, uint8_t size)
 	packet[0] = BT_AD_MESH_DATA;
 	memcpy(packet + 1, data, size);
 
+	net->stats.relayed++;
+	net->stats.tx_packets++;
 	mesh_io_send(io, &info, packet, size + 1);
 }
 
@@ -2269,6 +2209,7 @@ static void send_msg_pkt_oneshot(void *user_data)
 		.len = tx->size - 1,
 		.relay_advice = RELAY_NONE,
 	};
+	uint64_t wait = l_time_diff(tx->queued, l_time_now());
 
 	/* Send to local nodes first */
 	l_queue_foreach(nets, net_rx, &net_data);
@@ -2276,11 +2217,16 @@ static void send_msg_pkt_oneshot(void *user_data)
 	/* Make sure specific network still valid */
 	net = l_queue_find(nets, simple_match, tx->net);
 
+	if (net)
+		stage_add(&net->stats.stage[MESH_NET_STAGE_TX_QUEUE], wait);
+
 	if (!net || net_data.relay_advice == RELAY_DISALLOWED) {
 		l_free(tx);
 		return;
 	}
 
+	net->stats.tx_packets++;
+
 	info.type = MESH_IO_TIMING_TYPE_GENERAL;
 	info.u.gen.interval = tx->interval;
 	info.u.gen.cnt = tx->cnt;
@@ -2298,6 +2244,7 @@ static void send_msg_pkt(struct mesh_net *net, uint8_t cnt, uint16_t interval,
 	struct oneshot_tx *tx = l_new(struct oneshot_tx, 1);
 
 	tx->net = net;
+	tx->queued = l_time_now();
 	tx->interval = interval;
 	tx->cnt = cnt;
 	tx->size = size;
@@ -2344,8 +2291,10 @@ static enum _relay_advice packet_received(struct mesh_net *net,
 	 * As a Relay, suppress repeats of last N packets that pass through
 	 * The "cache_cookie" should be unique part of App message.
 	 */
-	if (msg_in_cache(net, net_src, net_seq, cache_cookie))
+	if (msg_in_cache(net, net_src, net_seq, cache_cookie)) {
+		net->stats.rx_duplicates++;
 		return RELAY_NONE;
+	}
 
 	l_debug("RX: Network %04x -> %04x : TTL 0x%02x : IV : %8.8x SEQ 0x%06x",
 			net_src, net_dst, net_ttl, iv_index, net_seq);
@@ -2459,12 +2408,19 @@ static void net_rx(void *net_ptr, void *user_data)
 
 	/* if IVI flag differs, use previous IV Index */
 	uint32_t iv_index = net->iv_index - (ivi_pkt ^ ivi_net);
+	uint64_t start = l_time_now();
+
+	net->stats.rx_packets++;
 
 	net_key_id = net_key_decrypt(iv_index, data->data, data->len,
 							&out, &out_size);
 
-	if (!net_key_id)
+	mesh_net_stats_record(net, MESH_NET_STAGE_NET_DECRYPT, start);
+
+	if (!net_key_id) {
+		net->stats.rx_not_decrypted++;
 		return;
+	}
 
 	if (!data->seen) {
 		data->seen = true;
@@ -2484,6 +2440,9 @@ static void net_rx(void *net_ptr, void *user_data)
 
 	relay_advice = packet_received(net, net_key_id, net_idx, frnd,
 						iv_index, out, out_size, rssi);
+
+	mesh_net_stats_record(net, MESH_NET_STAGE_RX, start);
+
 	if (relay_advice > data->relay_advice) {
 		/*
 		 * If packet was encrypted with friendship credentials,
@@ -2544,8 +2503,7 @@ static void iv_upd_to(struct l_timeout *upd_timeout, void *user_data)
 
 	switch (net->iv_upd_state) {
 	case IV_UPD_UPDATING:
-		if (l_queue_length(net->sar_out) ||
-					l_queue_length(net->sar_queue)) {
+		if (!l_hashmap_isempty(net->sar_queue)) {
 			l_debug("don't leave IV Update until sar_out empty");
 			l_timeout_modify(net->iv_update_timeout, 10);
 			break;
@@ -2702,7 +2660,7 @@ static bool update_iv_ivu_state(struct mesh_net *net, uint32_t iv_index,
 {
 	if ((iv_index - ivu) > (net->iv_index - net->iv_update)) {
 		/* Don't accept IV_Index changes when performing SAR Out */
-		if (l_queue_length(net->sar_out))
+		if (!l_hashmap_isempty(net->sar_out))
 			return false;
 	}
 
@@ -3235,6 +3193,7 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 				bool szmic, const void *msg, uint16_t msg_len)
 {
 	struct mesh_sar *payload = NULL;
+	struct l_queue *queue = NULL;
 	uint8_t seg, seg_max;
 	bool result;
 
@@ -3276,7 +3235,7 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 		return true;
 
 	/* Setup OTA Network send */
-	payload = mesh_sar_new(msg_len);
+	payload = mesh_sar_new(net, msg_len);
 	memcpy(payload->buf, msg, msg_len);
 	payload->len = msg_len;
 	payload->src = src;
@@ -3296,13 +3255,13 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 		payload->id = ++net->sar_id_next;
 
 		/* Single thread SAR messages to same Unicast DST */
-		if (l_queue_find(net->sar_out, match_sar_remote,
-							L_UINT_TO_PTR(dst))) {
+		queue = l_hashmap_lookup(net->sar_queue, L_UINT_TO_PTR(dst));
+		if (queue) {
 			/* Delay sending Outbound SAR unless prior
 			 * SAR to same DST has completed */
 
 			l_debug("OB-Queued SeqZero: %4.4x", payload->seqZero);
-			l_queue_push_tail(net->sar_queue, payload);
+			l_queue_push_tail(queue, payload);
 			return true;
 		}
 	}
@@ -3324,11 +3283,10 @@ bool mesh_net_app_send(struct mesh_net *net, bool frnd_cred, uint16_t src,
 
 	/* Reliable: Cache; Unreliable: Flush*/
 	if (result && segmented && IS_UNICAST(dst)) {
-		l_queue_push_head(net->sar_out, payload);
-		payload->seg_timeout =
-			l_timeout_create(SEG_TO, outseg_to, net, NULL);
-		payload->msg_timeout =
-			l_timeout_create(MSG_TO, outmsg_to, net, NULL);
+		queue = l_queue_new();
+		l_queue_push_head(queue, payload);
+		l_hashmap_insert(net->sar_queue, L_UINT_TO_PTR(dst), queue);
+		start_sar_out(payload);
 		payload->id = ++net->sar_id_next;
 	} else
 		mesh_sar_free(payload);
@@ -156,10 +156,12 @@ struct friend_act {
 	bool last;
 };
 
+struct friend_cache;
+
 struct mesh_friend {
 	struct mesh_net *net;
 	struct l_timeout *timeout;
-	struct l_queue *pkt_cache;
+	struct friend_cache *pkt_cache;
 	void *pkt;
 	uint32_t poll_timeout;
 	uint32_t net_key_cur;
@@ -171,6 +173,7 @@ struct mesh_friend {
 	uint16_t lp_cnt;
 	uint8_t	receive_delay;
 	uint8_t ele_cnt;
+	uint8_t cache_size;
 	uint8_t frd;
 	uint8_t frw;
 	union {
@@ -212,6 +215,42 @@ struct mesh_friend_msg {
 	} u;
 };
 
+#define FRND_MSG_SIZE(seg_max)	((seg_max) ?				\
+		sizeof(struct mesh_friend_msg) -			\
+		sizeof(struct mesh_friend_seg_one) +			\
+		((seg_max) + 1) * sizeof(struct mesh_friend_seg_12) :	\
+		sizeof(struct mesh_friend_msg))
+
+/* Packet path stages timed by mesh_net_stats_record() */
+enum mesh_net_stage {
+	MESH_NET_STAGE_RX,		/* Network PDU, whole receive path */
+	MESH_NET_STAGE_NET_DECRYPT,
+	MESH_NET_STAGE_TRANSPORT_DECRYPT,
+	MESH_NET_STAGE_MODEL_DISPATCH,
+	MESH_NET_STAGE_TX_QUEUE,	/* Built until handed to mesh-io */
+	MESH_NET_STAGES
+};
+
+/* Bucket 0 is under 1 us, bucket n is under 2^n us, the last is the rest */
+#define MESH_NET_HIST_BUCKETS	16
+
+struct mesh_net_stage_stats {
+	uint32_t count;
+	uint32_t max_us;
+	uint64_t total_us;
+	uint32_t hist[MESH_NET_HIST_BUCKETS];
+};
+
+struct mesh_net_stats {
+	uint32_t rx_packets;
+	uint32_t rx_not_decrypted;
+	uint32_t rx_duplicates;
+	uint32_t rx_replayed;
+	uint32_t relayed;
+	uint32_t tx_packets;
+	struct mesh_net_stage_stats stage[MESH_NET_STAGES];
+};
+
 struct mesh_net *mesh_net_new(struct mesh_node *node);
 void mesh_net_free(void *net);
 void mesh_net_cleanup(void);
@@ -250,6 +289,9 @@ bool mesh_net_get_key(struct mesh_net *net, bool new_key, uint16_t idx,
 bool mesh_net_attach(struct mesh_net *net, struct mesh_io *io);
 struct mesh_io *mesh_net_detach(struct mesh_net *net);
 struct l_queue *mesh_net_get_app_keys(struct mesh_net *net);
+void mesh_net_stats_record(struct mesh_net *net, enum mesh_net_stage stage,
+								uint64_t start);
+bool mesh_net_get_stats(struct mesh_net *net, struct mesh_net_stats *stats);
 
 void mesh_net_transport_send(struct mesh_net *net, uint32_t net_key_id,
 				uint16_t net_idx, uint32_t iv_index,
@@ -273,7 +315,8 @@ bool mesh_net_dst_unreg(struct mesh_net *net, uint16_t dst);
 struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
 					uint8_t ele_cnt, uint8_t frd,
 					uint8_t frw, uint32_t fpt,
-					uint16_t fn_cnt, uint16_t lp_cnt);
+					uint16_t fn_cnt, uint16_t lp_cnt,
+					uint8_t cache_size);
 void mesh_friend_free(void *frnd);
 bool mesh_friend_clear(struct mesh_net *net, struct mesh_friend *frnd);
 void mesh_friend_sub_add(struct mesh_net *net, uint16_t lpn, uint8_t ele_cnt,
@@ -303,6 +303,7 @@ static void free_node_resources(void *data)
 	mesh_agent_remove(node->agent);
 	mesh_config_release(node->cfg);
 	mesh_net_free(node->net);
+	rpl_release(node);
 	l_free(node->storage_dir);
 	l_free(node);
 }
@@ -2290,6 +2291,108 @@ static struct l_dbus_message *publish_call(struct l_dbus *dbus,
 	return l_dbus_message_new_method_return(msg);
 }
 
+static const char *const stage_names[MESH_NET_STAGES] = {
+	[MESH_NET_STAGE_RX] = "Receive",
+	[MESH_NET_STAGE_NET_DECRYPT] = "NetDecrypt",
+	[MESH_NET_STAGE_TRANSPORT_DECRYPT] = "TransportDecrypt",
+	[MESH_NET_STAGE_MODEL_DISPATCH] = "ModelDispatch",
+	[MESH_NET_STAGE_TX_QUEUE] = "TxQueue",
+};
+
+static void append_stage(struct l_dbus_message_builder *builder,
+					const char *name,
+					const struct mesh_net_stage_stats *stage)
+{
+	int i;
+
+	l_dbus_message_builder_enter_dict(builder, "sv");
+	l_dbus_message_builder_append_basic(builder, 's', name);
+	l_dbus_message_builder_enter_variant(builder, "a{sv}");
+	l_dbus_message_builder_enter_array(builder, "{sv}");
+
+	dbus_append_dict_entry_basic(builder, "Count", "u", &stage->count);
+	dbus_append_dict_entry_basic(builder, "TotalTime", "t",
+							&stage->total_us);
+	dbus_append_dict_entry_basic(builder, "MaxTime", "u", &stage->max_us);
+
+	/* Bucket n counts times under 2^n microseconds */
+	l_dbus_message_builder_enter_dict(builder, "sv");
+	l_dbus_message_builder_append_basic(builder, 's', "Histogram");
+	l_dbus_message_builder_enter_variant(builder, "au");
+	l_dbus_message_builder_enter_array(builder, "u");
+
+	for (i = 0; i < MESH_NET_HIST_BUCKETS; i++)
+		l_dbus_message_builder_append_basic(builder, 'u',
+							&stage->hist[i]);
+
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_leave_variant(builder);
+	l_dbus_message_builder_leave_dict(builder);
+
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_leave_variant(builder);
+	l_dbus_message_builder_leave_dict(builder);
+}
+
+static struct l_dbus_message *get_stats_call(struct l_dbus *dbus,
+						struct l_dbus_message *msg,
+						void *user_data)
+{
+	struct mesh_node *node = user_data;
+	struct l_dbus_message_builder *builder;
+	struct l_dbus_message *reply;
+	struct mesh_net_stats stats;
+	uint32_t trials, failed;
+	const char *sender;
+	int i;
+
+	l_debug("GetStatistics");
+
+	sender = l_dbus_message_get_sender(msg);
+
+	if (strcmp(sender, node->owner))
+		return dbus_error(msg, MESH_ERROR_NOT_AUTHORIZED, NULL);
+
+	if (!mesh_net_get_stats(node->net, &stats))
+		return dbus_error(msg, MESH_ERROR_FAILED, NULL);
+
+	reply = l_dbus_message_new_method_return(msg);
+	builder = l_dbus_message_builder_new(reply);
+
+	l_dbus_message_builder_enter_array(builder, "{sv}");
+
+	dbus_append_dict_entry_basic(builder, "Received", "u",
+							&stats.rx_packets);
+	dbus_append_dict_entry_basic(builder, "NotDecrypted", "u",
+							&stats.rx_not_decrypted);
+	dbus_append_dict_entry_basic(builder, "Duplicates", "u",
+							&stats.rx_duplicates);
+	dbus_append_dict_entry_basic(builder, "Replayed", "u",
+							&stats.rx_replayed);
+	dbus_append_dict_entry_basic(builder, "Relayed", "u", &stats.relayed);
+	dbus_append_dict_entry_basic(builder, "Sent", "u", &stats.tx_packets);
+
+	/* Key trials are shared by every node in the daemon */
+	net_key_trial_stats(&trials, &failed);
+	dbus_append_dict_entry_basic(builder, "NetKeyTrials", "u", &trials);
+	dbus_append_dict_entry_basic(builder, "NetKeyTrialsFailed", "u",
+								&failed);
+
+	appkey_trial_stats(&trials, &failed);
+	dbus_append_dict_entry_basic(builder, "AppKeyTrials", "u", &trials);
+	dbus_append_dict_entry_basic(builder, "AppKeyTrialsFailed", "u",
+								&failed);
+
+	for (i = 0; i < MESH_NET_STAGES; i++)
+		append_stage(builder, stage_names[i], &stats.stage[i]);
+
+	l_dbus_message_builder_leave_array(builder);
+	l_dbus_message_builder_finalize(builder);
+	l_dbus_message_builder_destroy(builder);
+
+	return reply;
+}
+
 static bool features_getter(struct l_dbus *dbus, struct l_dbus_message *msg,
 					struct l_dbus_message_builder *builder,
 					void *user_data)
@@ -2440,6 +2543,8 @@ static void setup_node_interface(struct l_dbus_interface *iface)
 	l_dbus_interface_method(iface, "Publish", 0, publish_call, "",
 					"oqa{sv}ay", "element_path", "model_id",
 							"options", "data");
+	l_dbus_interface_method(iface, "GetStatistics", 0, get_stats_call,
+						"a{sv}", "", "statistics");
 	l_dbus_interface_property(iface, "Features", 0, "a{sv}",
 							features_getter, NULL);
 	l_dbus_interface_property(iface, "Beacon", 0, "b", beacon_getter, NULL);
@@ -33,106 +33,183 @@
 #include "mesh/rpl.h"
 
 static const char *rpl_dir = "/rpl";
+static const char *rpl_log = "/rpl/log";
+static const char *rpl_tmp = "/rpl/log.tmp";
 
-bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
-								uint32_t seq)
-{
-	const char *node_path;
-	char src_file[PATH_MAX];
-	char seq_txt[7];
-	bool result = false;
-	DIR *dir;
-	int fd;
+/* One text record per accepted message: "ssss iiiiiiii qqqqqq\n" */
+#define RPL_REC_LEN		21
 
-	if (!IS_UNICAST(src))
-		return false;
+/* Rewrite the log once stale records outnumber live ones this much */
+#define RPL_COMPACT_RATIO	4
+#define RPL_COMPACT_MIN		256
 
-	node_path = node_get_storage_dir(node);
+/* Seconds an appended record may stay in the page cache unsynced */
+#define RPL_SYNC_TIMEOUT	1
 
-	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
-		return false;
+struct rpl_store {
+	struct mesh_node *node;
+	struct l_hashmap *entries;
+	struct l_timeout *sync_to;
+	char *log_path;
+	char *tmp_path;
+	int fd;
+	uint32_t records;
+	struct rpl_io_stats stats;
+};
 
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x", node_path, rpl_dir,
-								iv_index);
-	dir = opendir(src_file);
+static struct l_queue *stores;
 
-	if (!dir) {
-		if (mkdir(src_file, 0755) != 0)
-			l_error("Failed to create dir: %s", src_file);
-	} else
-		closedir(dir);
+static bool match_node(const void *a, const void *b)
+{
+	const struct rpl_store *store = a;
+
+	return store->node == b;
+}
 
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x/%4.4x", node_path, rpl_dir,
-								iv_index, src);
+static bool entry_update(struct l_hashmap *entries, uint16_t src,
+					uint32_t iv_index, uint32_t seq)
+{
+	struct mesh_rpl *rpl;
 
-	fd = open(src_file, O_WRONLY | O_CREAT | O_TRUNC, 0600);
-	if (fd >= 0) {
-		snprintf(seq_txt, 7, "%6.6x", seq);
-		if (write(fd, seq_txt, 6) == 6)
-			result = true;
+	if (!IS_UNICAST(src) || seq > SEQ_MASK)
+		return false;
 
-		close(fd);
+	rpl = l_hashmap_lookup(entries, L_UINT_TO_PTR(src));
+	if (!rpl) {
+		rpl = l_new(struct mesh_rpl, 1);
+		rpl->src = src;
+		rpl->iv_index = iv_index;
+		rpl->seq = seq;
+		l_hashmap_insert(entries, L_UINT_TO_PTR(src), rpl);
+		return true;
 	}
 
-	if (!result)
+	/* Only ever move forward, so record order does not matter */
+	if (iv_index < rpl->iv_index ||
+			(iv_index == rpl->iv_index && seq <= rpl->seq))
 		return false;
 
-	/* Delete RPL entry from old iv_index (if it exists) */
-	iv_index--;
-	snprintf(src_file, PATH_MAX, "%s%s/%8.8x/%4.4x", node_path, rpl_dir,
-								iv_index, src);
-	if (remove(src_file) < 0 && errno != ENOENT)
-		l_error("Failed to remove(%d): %s", errno, src_file);
+	rpl->iv_index = iv_index;
+	rpl->seq = seq;
 
-	return result;
+	return true;
 }
 
-void rpl_del_entry(struct mesh_node *node, uint16_t src)
+static void sync_store(struct rpl_store *store)
 {
-	const char *node_path;
-	char rpl_path[PATH_MAX];
-	struct dirent *entry;
-	DIR *dir;
+	l_timeout_remove(store->sync_to);
+	store->sync_to = NULL;
 
-	if (!IS_UNICAST(src))
+	if (store->fd < 0)
 		return;
 
-	node_path = node_get_storage_dir(node);
+	if (fdatasync(store->fd) < 0)
+		l_error("Failed to sync(%d): %s", errno, store->log_path);
 
-	if (strlen(node_path) + strlen(rpl_dir) + 15 >= PATH_MAX)
-		return;
+	store->stats.syncs++;
+}
 
-	snprintf(rpl_path, PATH_MAX, "%s%s", node_path, rpl_dir);
-	dir = opendir(rpl_path);
+static void sync_timeout(struct l_timeout *timeout, void *user_data)
+{
+	sync_store(user_data);
+}
 
-	if (!dir)
-		return;
+static void write_entry(const void *key, void *value, void *user_data)
+{
+	struct mesh_rpl *rpl = value;
+	FILE *fp = user_data;
 
-	/* Remove all instances of src address */
-	while ((entry = readdir(dir)) != NULL) {
-		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
-			snprintf(rpl_path, PATH_MAX, "%s%s/%s/%4.4x",
-					node_path, rpl_dir, entry->d_name, src);
-			if (remove(rpl_path) < 0)
-				l_error("Failed to remove(%d): %s", errno,
-								rpl_path);
-		}
+	fprintf(fp, "%4.4x %8.8x %6.6x\n", rpl->src, rpl->iv_index, rpl->seq);
+}
+
+/*
+ * Write the live entries to a temporary file and atomically replace the
+ * log with it, so that a crash at any point leaves one complete log.
+ */
+static bool compact_store(struct rpl_store *store)
+{
+	FILE *fp;
+	int dir_fd;
+	char *dir;
+	bool result;
+
+	fp = fopen(store->tmp_path, "w");
+	if (!fp) {
+		l_error("Failed to create(%d): %s", errno, store->tmp_path);
+		return false;
 	}
 
-	closedir(dir);
+	l_hashmap_foreach(store->entries, write_entry, fp);
+
+	result = !fflush(fp) && !fdatasync(fileno(fp));
+	fclose(fp);
+
+	if (!result || rename(store->tmp_path, store->log_path) < 0) {
+		l_error("Failed to compact(%d): %s", errno, store->log_path);
+		remove(store->tmp_path);
+		return false;
+	}
+
+	/* Make the rename itself durable */
+	dir = l_strndup(store->log_path, strlen(store->log_path) -
+							strlen("/log"));
+	dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+	if (dir_fd >= 0) {
+		fsync(dir_fd);
+		close(dir_fd);
+	}
+
+	l_free(dir);
+
+	l_timeout_remove(store->sync_to);
+	store->sync_to = NULL;
+
+	if (store->fd >= 0)
+		close(store->fd);
+
+	store->fd = open(store->log_path, O_WRONLY | O_APPEND);
+	store->records = l_hashmap_size(store->entries);
+	store->stats.compactions++;
+	store->stats.syncs++;
+
+	return true;
 }
 
-static bool match_src(const void *a, const void *b)
+/* Returns false if the log holds damaged records, e.g. torn by a crash */
+static bool load_log(struct rpl_store *store)
 {
-	const struct mesh_rpl *rpl = a;
-	uint16_t src = L_PTR_TO_UINT(b);
+	char line[RPL_REC_LEN + 2];
+	uint32_t iv_index, seq;
+	uint16_t src;
+	bool clean = true;
+	FILE *fp;
+
+	fp = fopen(store->log_path, "r");
+	if (!fp)
+		return true;
+
+	while (fgets(line, sizeof(line), fp)) {
+		store->records++;
+
+		if (strlen(line) != RPL_REC_LEN ||
+				line[RPL_REC_LEN - 1] != '\n' ||
+				sscanf(line, "%04hx %08x %06x", &src,
+						&iv_index, &seq) != 3) {
+			clean = false;
+			continue;
+		}
+
+		entry_update(store->entries, src, iv_index, seq);
+	}
 
-	return rpl->src == src;
+	fclose(fp);
+
+	return clean;
 }
 
-static void get_entries(const char *iv_path, struct l_queue *rpl_list)
+/* Import RPL trees written by older versions, one file per source */
+static void get_entries(const char *iv_path, struct l_hashmap *entries)
 {
-	struct mesh_rpl *rpl;
 	struct dirent *entry;
 	DIR *dir;
 	int fd;
@@ -168,26 +245,9 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 				continue;
 
 			if (read(fd, seq_txt, 6) == 6 &&
-					sscanf(seq_txt, "%06x", &seq) == 1) {
-
-				rpl = l_queue_find(rpl_list, match_src,
-						L_UINT_TO_PTR(src));
-
-				if (rpl) {
-					/* Replace older entries */
-					if (rpl->iv_index < iv_index) {
-						rpl->iv_index = iv_index;
-						rpl->seq = seq;
-					}
-				} else if (seq <= SEQ_MASK && IS_UNICAST(src)) {
-					rpl = l_new(struct mesh_rpl, 1);
-					rpl->src = src;
-					rpl->iv_index = iv_index;
-					rpl->seq = seq;
-
-					l_queue_push_head(rpl_list, rpl);
-				}
-			}
+					sscanf(seq_txt, "%06x", &seq) == 1)
+				entry_update(entries, src, iv_index, seq);
+
 			close(fd);
 		}
 	}
@@ -195,57 +255,229 @@ static void get_entries(const char *iv_path, struct l_queue *rpl_list)
 	closedir(dir);
 }
 
-bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
+static bool load_legacy(struct rpl_store *store, const char *node_path)
 {
-	const char *node_path;
 	struct dirent *entry;
-	char *rpl_path;
-	size_t len;
+	char path[PATH_MAX];
+	bool found = false;
 	DIR *dir;
 
-	if (!rpl_list)
+	snprintf(path, PATH_MAX, "%s%s", node_path, rpl_dir);
+	dir = opendir(path);
+	if (!dir)
 		return false;
 
-	node_path = node_get_storage_dir(node);
-
-	len = strlen(node_path) + strlen(rpl_dir) + 15;
+	while ((entry = readdir(dir)) != NULL) {
+		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+			snprintf(path, PATH_MAX, "%s%s/%s",
+					node_path, rpl_dir, entry->d_name);
+			get_entries(path, store->entries);
+			found = true;
+		}
+	}
 
-	if (len > PATH_MAX)
-		return false;
+	closedir(dir);
 
-	rpl_path = l_malloc(len);
-	snprintf(rpl_path, len, "%s%s", node_path, rpl_dir);
+	return found;
+}
 
-	dir = opendir(rpl_path);
+static void remove_legacy(const char *node_path)
+{
+	struct dirent *entry;
+	char path[PATH_MAX];
+	DIR *dir;
 
-	if (!dir) {
-		l_error("Failed to read RPL dir: %s", rpl_path);
-		l_free(rpl_path);
-		return false;
-	}
+	snprintf(path, PATH_MAX, "%s%s", node_path, rpl_dir);
+	dir = opendir(path);
+	if (!dir)
+		return;
 
 	while ((entry = readdir(dir)) != NULL) {
-		/* RPL sequences are stored in files under iv_indexs */
 		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
-			snprintf(rpl_path, len, "%s%s/%s",
+			snprintf(path, PATH_MAX, "%s%s/%s",
 					node_path, rpl_dir, entry->d_name);
-			get_entries(rpl_path, rpl_list);
+			del_path(path);
 		}
 	}
 
-	l_free(rpl_path);
 	closedir(dir);
+}
+
+static struct rpl_store *get_store(struct mesh_node *node)
+{
+	struct rpl_store *store;
+	const char *node_path;
+	bool legacy, clean;
+
+	store = l_queue_find(stores, match_node, node);
+	if (store)
+		return store;
+
+	node_path = node_get_storage_dir(node);
+	if (!node_path)
+		return NULL;
+
+	if (strlen(node_path) + strlen(rpl_tmp) + 1 >= PATH_MAX)
+		return NULL;
+
+	store = l_new(struct rpl_store, 1);
+	store->node = node;
+	store->entries = l_hashmap_new();
+	store->log_path = l_strdup_printf("%s%s", node_path, rpl_log);
+	store->tmp_path = l_strdup_printf("%s%s", node_path, rpl_tmp);
+	store->fd = -1;
+
+	legacy = load_legacy(store, node_path);
+	clean = load_log(store);
+
+	/*
+	 * Fold imported trees into the log before dropping them, and never
+	 * append behind a torn record where the next one would be lost.
+	 */
+	if ((legacy || !clean) && compact_store(store) && legacy)
+		remove_legacy(node_path);
+
+	if (store->fd < 0)
+		store->fd = open(store->log_path,
+					O_WRONLY | O_APPEND | O_CREAT, 0600);
+
+	if (store->fd < 0)
+		l_error("Failed to open(%d): %s", errno, store->log_path);
+
+	if (!stores)
+		stores = l_queue_new();
+
+	l_queue_push_tail(stores, store);
+
+	return store;
+}
+
+static void free_store(void *data)
+{
+	struct rpl_store *store = data;
+
+	if (store->sync_to)
+		sync_store(store);
+
+	if (store->fd >= 0)
+		close(store->fd);
+
+	l_hashmap_destroy(store->entries, l_free);
+	l_free(store->log_path);
+	l_free(store->tmp_path);
+	l_free(store);
+}
+
+static void check_compact(struct rpl_store *store)
+{
+	uint32_t live = l_hashmap_size(store->entries);
+
+	if (store->records > RPL_COMPACT_MIN &&
+				store->records > live * RPL_COMPACT_RATIO)
+		compact_store(store);
+}
+
+bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
+								uint32_t seq)
+{
+	struct rpl_store *store;
+	char rec[RPL_REC_LEN + 1];
+
+	if (!IS_UNICAST(src))
+		return false;
+
+	store = get_store(node);
+	if (!store || store->fd < 0)
+		return false;
+
+	if (!entry_update(store->entries, src, iv_index, seq))
+		return true;
+
+	/*
+	 * The record reaches the page cache before the message is handed
+	 * on, which survives a daemon crash. Flushing to storage is
+	 * deferred so that bursts share one sync.
+	 */
+	snprintf(rec, sizeof(rec), "%4.4x %8.8x %6.6x\n", src, iv_index, seq);
+	if (write(store->fd, rec, RPL_REC_LEN) != RPL_REC_LEN) {
+		l_error("Failed to write(%d): %s", errno, store->log_path);
+		return false;
+	}
+
+	store->records++;
+	store->stats.writes++;
+
+	check_compact(store);
+
+	if (!store->sync_to)
+		store->sync_to = l_timeout_create(RPL_SYNC_TIMEOUT,
+						sync_timeout, store, NULL);
 
 	return true;
 }
 
+void rpl_del_entry(struct mesh_node *node, uint16_t src)
+{
+	struct rpl_store *store;
+	struct mesh_rpl *rpl;
+
+	if (!IS_UNICAST(src))
+		return;
+
+	store = get_store(node);
+	if (!store)
+		return;
+
+	rpl = l_hashmap_remove(store->entries, L_UINT_TO_PTR(src));
+	if (!rpl)
+		return;
+
+	l_free(rpl);
+	compact_store(store);
+}
+
+static void copy_entry(const void *key, void *value, void *user_data)
+{
+	struct mesh_rpl *rpl = l_memdup(value, sizeof(struct mesh_rpl));
+
+	l_queue_push_head(user_data, rpl);
+}
+
+bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
+{
+	struct rpl_store *store;
+
+	if (!rpl_list)
+		return false;
+
+	store = get_store(node);
+	if (!store) {
+		l_error("Failed to read RPL");
+		return false;
+	}
+
+	l_hashmap_foreach(store->entries, copy_entry, rpl_list);
+
+	return true;
+}
+
+static bool stale_entry(const void *key, void *value, void *user_data)
+{
+	struct mesh_rpl *rpl = value;
+	uint32_t cur = L_PTR_TO_UINT(user_data);
+
+	if (rpl->iv_index == cur || rpl->iv_index == cur - 1)
+		return false;
+
+	l_free(rpl);
+	return true;
+}
+
 void rpl_update(struct mesh_node *node, uint32_t cur)
 {
-	uint32_t old = cur - 1;
+	struct rpl_store *store;
 	const char *node_path;
-	struct dirent *entry;
 	char path[PATH_MAX];
-	DIR *dir;
 
 	node_path = node_get_storage_dir(node);
 	if (!node_path)
@@ -259,31 +491,41 @@ void rpl_update(struct mesh_node *node, uint32_t cur)
 	if (mkdir(path, 0755) != 0 && errno != EEXIST)
 		l_error("Failed to create dir(%d): %s", errno, path);
 
-	dir = opendir(path);
-	if (!dir)
+	store = get_store(node);
+	if (!store)
 		return;
 
-	/* Cleanup any stale or malformed trees */
-	while ((entry = readdir(dir)) != NULL) {
-		if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
-			uint32_t val;
-			bool del = false;
+	/* Drop entries of any IV Index other than the current or previous */
+	if (l_hashmap_foreach_remove(store->entries, stale_entry,
+							L_UINT_TO_PTR(cur)))
+		compact_store(store);
+}
 
-			if (strlen(entry->d_name) != 8)
-				del = true;
-			else if (sscanf(entry->d_name, "%08x", &val) != 1)
-				del = true;
+bool rpl_get_io_stats(struct mesh_node *node, struct rpl_io_stats *stats)
+{
+	struct rpl_store *store = l_queue_find(stores, match_node, node);
 
-			/* Delete all invalid iv_index trees */
-			if (del || (val != cur && val != old)) {
-				snprintf(path, PATH_MAX, "%s%s/%s",
-					node_path, rpl_dir, entry->d_name);
-				del_path(path);
-			}
-		}
-	}
+	if (!store || !stats)
+		return false;
 
-	closedir(dir);
+	*stats = store->stats;
+
+	return true;
+}
+
+void rpl_release(struct mesh_node *node)
+{
+	struct rpl_store *store = l_queue_remove_if(stores, match_node, node);
+
+	if (!store)
+		return;
+
+	free_store(store);
+
+	if (l_queue_isempty(stores)) {
+		l_queue_destroy(stores, NULL);
+		stores = NULL;
+	}
 }
 
 bool rpl_init(const char *node_path)
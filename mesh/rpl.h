@@ -14,9 +14,17 @@ struct mesh_rpl {
 	uint16_t src;
 };
 
+struct rpl_io_stats {
+	uint32_t writes;
+	uint32_t syncs;
+	uint32_t compactions;
+};
+
 bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
 								uint32_t seq);
 void rpl_del_entry(struct mesh_node *node, uint16_t src);
 bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list);
 void rpl_update(struct mesh_node *node, uint32_t iv_index);
 bool rpl_init(const char *node_path);
+void rpl_release(struct mesh_node *node);
+bool rpl_get_io_stats(struct mesh_node *node, struct rpl_io_stats *stats);
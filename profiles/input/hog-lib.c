@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <glib.h>
 
@@ -36,6 +37,7 @@
 #include "src/shared/queue.h"
 #include "src/shared/att.h"
 #include "src/shared/gatt-db.h"
+#include "src/shared/gatt-client.h"
 #include "src/log.h"
 
 #include "attrib/att.h"
@@ -98,6 +100,7 @@ struct bt_hog {
 	struct queue		*gatt_op;
 	struct gatt_db		*gatt_db;
 	struct gatt_db_attribute	*report_map_attr;
+	bool			input_batch;
 };
 
 struct report {
@@ -110,6 +113,7 @@ struct report {
 	uint8_t			properties;
 	uint16_t		ccc_handle;
 	guint			notifyid;
+	bool			notify_client;
 	uint16_t		len;
 	uint8_t			*value;
 };
@@ -320,24 +324,49 @@ static void find_included(struct bt_hog *hog, GAttrib *attrib,
 	}
 }
 
-static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
+/* Reports carry the time the notification was received so uHID can account
+ * the latency once the report has actually been written, which for batched
+ * reports is only when the mainloop flushes them.
+ */
+static void report_input(struct report *report, const uint8_t *value,
+				uint16_t len, const struct timespec *rx)
 {
-	struct report *report = user_data;
 	struct bt_hog *hog = report->hog;
 	int err;
 
+	err = bt_uhid_input_at(hog->uhid, report->numbered ? report->id : 0,
+								value, len, rx);
+	if (err < 0)
+		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
+}
+
+static void report_value_cb(const guint8 *pdu, guint16 len, gpointer user_data)
+{
+	struct report *report = user_data;
+	struct timespec rx;
+
+	clock_gettime(CLOCK_MONOTONIC, &rx);
+
 	if (len < ATT_NOTIFICATION_HEADER_SIZE) {
 		error("Malformed ATT notification");
 		return;
 	}
 
-	pdu += ATT_NOTIFICATION_HEADER_SIZE;
-	len -= ATT_NOTIFICATION_HEADER_SIZE;
+	report_input(report, pdu + ATT_NOTIFICATION_HEADER_SIZE,
+				len - ATT_NOTIFICATION_HEADER_SIZE, &rx);
+}
 
-	err = bt_uhid_input(hog->uhid, report->numbered ? report->id : 0, pdu,
-				len);
-	if (err < 0)
-		error("bt_uhid_input: %s (%d)", strerror(-err), -err);
+/* Notifications received directly from bt_gatt_client carry the value as
+ * is, which avoids GAttrib rebuilding a full PDU copy for every report.
+ */
+static void report_notify_cb(uint16_t value_handle, const uint8_t *value,
+					uint16_t length, void *user_data)
+{
+	struct timespec rx;
+
+	clock_gettime(CLOCK_MONOTONIC, &rx);
+
+	report_input(user_data, value, length, &rx);
 }
 
 static void report_notify_destroy(void *user_data)
@@ -349,12 +378,69 @@ static void report_notify_destroy(void *user_data)
 	report->notifyid = 0;
 }
 
+static void report_notify_registered(uint16_t att_ecode, void *user_data)
+{
+	struct report *report = user_data;
+
+	if (att_ecode)
+		error("Unable to enable report notification: handle 0x%04x "
+				"(%s)", report->value_handle,
+				att_ecode2str(att_ecode));
+}
+
+/* Registering with a callback has bt_gatt_client write the CCC whenever it
+ * holds no other registration for the report, which re-enables
+ * notifications once reattached since the last unregister disabled them.
+ */
+static bool report_register_notify(struct report *report)
+{
+	struct bt_hog *hog = report->hog;
+	struct bt_gatt_client *client = g_attrib_get_client(hog->attrib);
+
+	if (client) {
+		report->notifyid = bt_gatt_client_register_notify(client,
+						report->value_handle,
+						report_notify_registered,
+						report_notify_cb, report,
+						report_notify_destroy);
+		if (report->notifyid) {
+			report->notify_client = true;
+			return true;
+		}
+	}
+
+	report->notify_client = false;
+	report->notifyid = g_attrib_register(hog->attrib,
+					ATT_OP_HANDLE_NOTIFY,
+					report->value_handle,
+					report_value_cb, report,
+					report_notify_destroy);
+
+	return report->notifyid != 0;
+}
+
+static void report_unregister_notify(struct report *report)
+{
+	struct bt_hog *hog = report->hog;
+	unsigned int id = report->notifyid;
+
+	if (!id)
+		return;
+
+	report->notifyid = 0;
+
+	if (report->notify_client)
+		bt_gatt_client_unregister_notify(
+					g_attrib_get_client(hog->attrib), id);
+	else
+		g_attrib_unregister(hog->attrib, id);
+}
+
 static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 					guint16 plen, gpointer user_data)
 {
 	struct gatt_request *req = user_data;
 	struct report *report = req->user_data;
-	struct bt_hog *hog = report->hog;
 
 	if (status != 0) {
 		error("Write report characteristic descriptor failed: %s",
@@ -365,12 +451,7 @@ static void report_ccc_written_cb(guint8 status, const guint8 *pdu,
 	if (report->notifyid)
 		goto remove;
 
-	report->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					report->value_handle,
-					report_value_cb, report,
-					report_notify_destroy);
-	if (!report->notifyid) {
+	if (!report_register_notify(report)) {
 		error("Unable to register report notification: handle 0x%04x",
 					report->value_handle);
 		goto remove;
@@ -1474,6 +1555,7 @@ static void hog_attach_instance(struct bt_hog *hog,
 		return;
 
 	instance->gatt_db = gatt_db_ref(hog->gatt_db);
+	bt_hog_set_input_batch(instance, hog->input_batch);
 	hog->instances = g_slist_append(hog->instances, bt_hog_ref(instance));
 }
 
@@ -1637,6 +1719,7 @@ static void hog_attach_hog(struct bt_hog *hog, struct gatt_primary *primary)
 		return;
 
 	instance->primary = util_memdup(primary, sizeof(*primary));
+	bt_hog_set_input_batch(instance, hog->input_batch);
 	find_included(instance, hog->attrib, primary->range.start,
 			primary->range.end, find_included_cb, instance);
 
@@ -1741,12 +1824,7 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 		if (r->notifyid)
 			continue;
 
-		r->notifyid = g_attrib_register(hog->attrib,
-					ATT_OP_HANDLE_NOTIFY,
-					r->value_handle,
-					report_value_cb, r,
-					report_notify_destroy);
-		if (!r->notifyid)
+		if (!report_register_notify(r))
 			error("Unable to register report notification: "
 				"handle 0x%04x", r->value_handle);
 	}
@@ -1761,6 +1839,7 @@ bool bt_hog_attach(struct bt_hog *hog, void *gatt)
 
 void bt_hog_detach(struct bt_hog *hog, bool force)
 {
+	struct bt_uhid_input_stats stats;
 	GSList *l;
 
 	if (!hog)
@@ -1780,10 +1859,34 @@ void bt_hog_detach(struct bt_hog *hog, bool force)
 	for (l = hog->reports; l; l = l->next) {
 		struct report *r = l->data;
 
-		if (r->notifyid > 0) {
-			g_attrib_unregister(hog->attrib, r->notifyid);
-			r->notifyid = 0;
-		}
+		report_unregister_notify(r);
+	}
+
+	if (bt_uhid_get_input_stats(hog->uhid, &stats) && stats.reports) {
+		uint64_t *latency = stats.latency;
+		uint64_t written = 0;
+		unsigned int i;
+
+		DBG("%" PRIu64 " reports in %" PRIu64 " writes, %" PRIu64
+			" dropped, %" PRIu64 " errors", stats.reports,
+			stats.writes, stats.dropped, stats.errors);
+
+		/* Only reports fully written have their latency accounted */
+		for (i = 0; i < BT_UHID_LATENCY_BUCKETS; i++)
+			written += latency[i];
+
+		if (written)
+			DBG("notification to uHID write latency avg %"
+				PRIu64 " max %" PRIu64 " usec",
+				stats.latency_sum / written,
+				stats.latency_max);
+
+		DBG("latency < 10: %" PRIu64 " < 50: %" PRIu64 " < 100: %"
+			PRIu64 " < 250: %" PRIu64 " < 500: %" PRIu64
+			" < 1000: %" PRIu64 " < 5000: %" PRIu64 " >= 5000: %"
+			PRIu64 " usec", latency[0], latency[1], latency[2],
+			latency[3], latency[4], latency[5], latency[6],
+			latency[7]);
 	}
 
 	if (hog->scpp)
@@ -1849,3 +1952,55 @@ int bt_hog_send_report(struct bt_hog *hog, void *data, size_t size, int type)
 
 	return 0;
 }
+
+bool bt_hog_get_stats(struct bt_hog *hog, struct bt_uhid_input_stats *stats)
+{
+	GSList *l;
+	unsigned int i;
+
+	if (!hog || !stats)
+		return false;
+
+	if (!bt_uhid_get_input_stats(hog->uhid, stats))
+		return false;
+
+	/* Include reports delivered through included HID services */
+	for (l = hog->instances; l; l = l->next) {
+		struct bt_hog *instance = l->data;
+		struct bt_uhid_input_stats s;
+
+		if (!bt_hog_get_stats(instance, &s))
+			continue;
+
+		stats->reports += s.reports;
+		stats->writes += s.writes;
+		stats->dropped += s.dropped;
+		stats->errors += s.errors;
+		stats->latency_sum += s.latency_sum;
+		if (s.latency_max > stats->latency_max)
+			stats->latency_max = s.latency_max;
+
+		for (i = 0; i < BT_UHID_LATENCY_BUCKETS; i++)
+			stats->latency[i] += s.latency[i];
+	}
+
+	return true;
+}
+
+bool bt_hog_set_input_batch(struct bt_hog *hog, bool enable)
+{
+	GSList *l;
+
+	if (!hog)
+		return false;
+
+	hog->input_batch = enable;
+
+	for (l = hog->instances; l; l = l->next) {
+		struct bt_hog *instance = l->data;
+
+		bt_hog_set_input_batch(instance, enable);
+	}
+
+	return bt_uhid_set_input_batch(hog->uhid, enable);
+}
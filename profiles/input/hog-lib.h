@@ -9,6 +9,7 @@
  */
 
 struct bt_hog;
+struct bt_uhid_input_stats;
 
 struct bt_hog *bt_hog_new_default(const char *name, uint16_t vendor,
 					uint16_t product, uint16_t version,
@@ -26,3 +27,14 @@ void bt_hog_detach(struct bt_hog *hog, bool force);
 
 int bt_hog_set_control_point(struct bt_hog *hog, bool suspend);
 int bt_hog_send_report(struct bt_hog *hog, void *data, size_t size, int type);
+
+/* Input report counters of the device and its included HID services, see
+ * struct bt_uhid_input_stats for how latency is measured.
+ */
+bool bt_hog_get_stats(struct bt_hog *hog, struct bt_uhid_input_stats *stats);
+
+/* Coalesce input reports received in the same mainloop iteration into a
+ * single uHID write, this delays each report until the mainloop polls
+ * uHID so it only pays off for devices sending bursts of reports.
+ */
+bool bt_hog_set_input_batch(struct bt_hog *hog, bool enable);
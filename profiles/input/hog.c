@@ -55,6 +55,7 @@ struct hog_device {
 static gboolean suspend_supported = FALSE;
 static bool auto_sec = true;
 static bool uhid_state_persist = false;
+static bool input_batch = false;
 static struct queue *devices = NULL;
 
 static void hog_device_accept(struct hog_device *dev, struct gatt_db *db)
@@ -79,6 +80,8 @@ static void hog_device_accept(struct hog_device *dev, struct gatt_db *db)
 							product, version);
 
 	dev->hog = bt_hog_new_default(name, vendor, product, version, type, db);
+	if (dev->hog && input_batch)
+		bt_hog_set_input_batch(dev->hog, true);
 }
 
 static struct hog_device *hog_device_new(struct btd_device *device)
@@ -229,6 +232,7 @@ static void hog_read_config(void)
 	GKeyFile *config;
 	GError *err = NULL;
 	bool config_auto_sec;
+	bool config_input_batch;
 	char *uhid_enabled;
 
 	config = g_key_file_new();
@@ -254,6 +258,15 @@ static void hog_read_config(void)
 	} else
 		g_clear_error(&err);
 
+	config_input_batch = g_key_file_get_boolean(config, "General",
+					"LEInputBatch", &err);
+	if (!err) {
+		DBG("input.conf: LEInputBatch=%s",
+				config_input_batch ? "true" : "false");
+		input_batch = config_input_batch;
+	} else
+		g_clear_error(&err);
+
 	uhid_enabled = g_key_file_get_string(config, "General",
 					"UserspaceHID", &err);
 	if (!err) {
@@ -302,6 +302,10 @@ struct btd_adapter {
 	struct discovery_client *client;	/* active discovery client */
 
 	GSList *discovery_found;	/* list of found devices */
+	unsigned int reports;		/* reports from known devices */
+	unsigned int reports_suppressed;	/* unchanged reports */
+	unsigned int temp_peak;		/* most temporary devices */
+	unsigned int temp_evicted;	/* temporary devices evicted */
 	unsigned int discovery_idle_timeout; /* timeout between discovery
 					      * runs
 					      */
@@ -1714,6 +1718,20 @@ static void invalidate_rssi_and_tx_power(gpointer a)
 
 	device_set_rssi(dev, 0);
 	device_set_tx_power(dev, 127);
+
+	/* Next report must restore what has just been invalidated */
+	device_clear_reports(dev);
+}
+
+static size_t adapter_devices_size(struct btd_adapter *adapter)
+{
+	size_t size = 0;
+	GSList *l;
+
+	for (l = adapter->devices; l != NULL; l = g_slist_next(l))
+		size += device_get_size(l->data);
+
+	return size;
 }
 
 static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
@@ -1731,6 +1749,17 @@ static void discovery_cleanup(struct btd_adapter *adapter, int timeout)
 						invalidate_rssi_and_tx_power);
 	adapter->discovery_found = NULL;
 
+	DBG("hci%u %u reports, %u unchanged", adapter->dev_id,
+				adapter->reports, adapter->reports_suppressed);
+	DBG("hci%u %u devices (%zu bytes), peak %u temporary, %u evicted",
+				adapter->dev_id, g_slist_length(adapter->devices),
+				adapter_devices_size(adapter), adapter->temp_peak,
+				adapter->temp_evicted);
+	adapter->reports = 0;
+	adapter->reports_suppressed = 0;
+	adapter->temp_peak = 0;
+	adapter->temp_evicted = 0;
+
 	if (!adapter->devices)
 		return;
 
@@ -7180,7 +7209,7 @@ static void adapter_msd_notify(struct btd_adapter *adapter,
 	}
 }
 
-static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
+static bool is_filter_match(GSList *discovery_filter, struct eir_view *eir,
 								int8_t rssi)
 {
 	GSList *l, *m;
@@ -7211,9 +7240,7 @@ static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
 				/* m->data contains string representation of
 				 * uuid.
 				 */
-				if (g_slist_find_custom(eir_data->services,
-							m->data,
-							g_strcmp) != NULL)
+				if (eir_view_has_uuid(eir, m->data))
 					got_match = true;
 			}
 		}
@@ -7223,8 +7250,8 @@ static bool is_filter_match(GSList *discovery_filter, struct eir_data *eir_data,
 			if (item->rssi == DISTANCE_VAL_INVALID ||
 			    item->rssi <= rssi ||
 			    item->pathloss == DISTANCE_VAL_INVALID ||
-			    (eir_data->tx_power != 127 &&
-			     eir_data->tx_power - rssi <= item->pathloss))
+			    (eir->tx_power != 127 &&
+			     eir->tx_power - rssi <= item->pathloss))
 				return true;
 
 			got_match = false;
@@ -7246,8 +7273,9 @@ static void filter_duplicate_data(void *data, void *user_data)
 }
 
 static bool device_is_discoverable(struct btd_adapter *adapter,
-					struct eir_data *eir, const char *addr,
-					uint8_t bdaddr_type, bool *auto_connect)
+					struct eir_view *eir, const char *name,
+					const char *addr, uint8_t bdaddr_type,
+					bool *auto_connect)
 {
 	GSList *l;
 	bool discoverable;
@@ -7289,8 +7317,7 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 			return true;
 		}
 
-		if (eir->name && !strncmp(filter->pattern, eir->name,
-							pattern_len)) {
+		if (name && !strncmp(filter->pattern, name, pattern_len)) {
 			*auto_connect = filter->auto_connect;
 			return true;
 		}
@@ -7299,6 +7326,96 @@ static bool device_is_discoverable(struct btd_adapter *adapter,
 	return discoverable;
 }
 
+/* Makes room for a new temporary device by removing the least recently seen
+ * one that is not in use, if MaxTemporaryDevices has been reached.
+ */
+static void adapter_evict_temporary(struct btd_adapter *adapter)
+{
+	struct btd_device *lru = NULL;
+	time_t lru_seen = 0;
+	unsigned int count = 0;
+	GSList *l;
+
+	for (l = adapter->devices; l != NULL; l = g_slist_next(l)) {
+		struct btd_device *dev = l->data;
+		time_t seen;
+
+		if (!device_is_temporary(dev))
+			continue;
+
+		count++;
+
+		if (!device_is_evictable(dev))
+			continue;
+
+		seen = device_get_last_seen(dev);
+		if (!lru || seen < lru_seen) {
+			lru = dev;
+			lru_seen = seen;
+		}
+	}
+
+	if (count > adapter->temp_peak)
+		adapter->temp_peak = count;
+
+	if (!btd_opts.tmpmax || count < btd_opts.tmpmax || !lru)
+		return;
+
+	DBG("%u temporary devices, removing %s", count, device_get_path(lru));
+
+	adapter->temp_evicted++;
+	btd_adapter_remove_device(adapter, lru);
+}
+
+static void device_found_update(struct btd_adapter *adapter,
+					struct btd_device *dev,
+					uint8_t bdaddr_type,
+					const uint8_t *data, uint8_t data_len,
+					bool name_known, bool duplicate)
+{
+	struct eir_data eir_data;
+
+	memset(&eir_data, 0, sizeof(eir_data));
+	eir_parse(&eir_data, data, data_len);
+
+	if (eir_data.tx_power != 127)
+		device_set_tx_power(dev, eir_data.tx_power);
+
+	if (eir_data.appearance != 0)
+		device_set_appearance(dev, eir_data.appearance);
+
+	if (eir_data.name && (eir_data.name_complete || !name_known))
+		btd_device_device_set_name(dev, eir_data.name);
+
+	if (eir_data.class != 0)
+		device_set_class(dev, eir_data.class);
+
+	if (eir_data.did_source || eir_data.did_vendor ||
+			eir_data.did_product || eir_data.did_version)
+		btd_device_set_pnpid(dev, eir_data.did_source,
+							eir_data.did_vendor,
+							eir_data.did_product,
+							eir_data.did_version);
+
+	device_add_eir_uuids(dev, eir_data.services);
+
+	if (eir_data.msd_list) {
+		device_set_manufacturer_data(dev, eir_data.msd_list, duplicate);
+		adapter_msd_notify(adapter, dev, eir_data.msd_list);
+	}
+
+	if (eir_data.sd_list)
+		device_set_service_data(dev, eir_data.sd_list, duplicate);
+
+	if (eir_data.data_list)
+		device_set_data(dev, eir_data.data_list, duplicate);
+
+	if (bdaddr_type != BDADDR_BREDR)
+		device_set_flags(dev, eir_data.flags);
+
+	eir_data_free(&eir_data);
+}
+
 void btd_adapter_device_found(struct btd_adapter *adapter,
 					const bdaddr_t *bdaddr,
 					uint8_t bdaddr_type, int8_t rssi,
@@ -7308,7 +7425,9 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 {
 	struct btd_device *dev;
 	struct bt_ad *ad = NULL;
-	struct eir_data eir_data;
+	struct eir_view eir;
+	char name_buf[HCI_MAX_NAME_LENGTH + 2];
+	const char *name;
 	bool name_known, discoverable;
 	char addr[18];
 	bool confirm;
@@ -7316,6 +7435,7 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	bool not_connectable;
 	bool name_resolve_failed;
 	bool scan_rsp;
+	bool unchanged;
 	bool duplicate = false;
 	bool auto_connect = false;
 	struct queue *matched_monitors = NULL;
@@ -7348,12 +7468,15 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!adapter->discovering && !monitoring)
 		return;
 
-	memset(&eir_data, 0, sizeof(eir_data));
-	eir_parse(&eir_data, data, data_len);
+	/* Filter the report using a view of the raw data, the fields are only
+	 * copied once it is known that the device is going to be updated.
+	 */
+	eir_view_init(&eir, data, data_len);
+	name = eir_view_get_name(&eir, name_buf, sizeof(name_buf));
 
 	ba2str(bdaddr, addr);
 
-	discoverable = device_is_discoverable(adapter, &eir_data, addr,
+	discoverable = device_is_discoverable(adapter, &eir, name, addr,
 						bdaddr_type, &auto_connect);
 
 	dev = btd_adapter_find_device(adapter, bdaddr, bdaddr_type);
@@ -7361,15 +7484,13 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 		/* In case of being just a scan response don't attempt to create
 		 * the device.
 		 */
-		if (scan_rsp) {
-			eir_data_free(&eir_data);
+		if (scan_rsp)
 			return;
-		}
 
 		/* Monitor Devices advertising Broadcast Announcements if the
 		 * adapter is capable of synchronizing to it.
 		 */
-		if (eir_get_service_data(&eir_data, BCAA_SERVICE_UUID) &&
+		if (eir_view_has_service_data(&eir, BCAA_SERVICE_UUID) &&
 				btd_adapter_has_settings(adapter,
 				MGMT_SETTING_ISO_SYNC_RECEIVER))
 			monitoring = true;
@@ -7379,13 +7500,13 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 		 * their object are needed.
 		 */
 		if (btd_adapter_has_exp_feature(adapter, EXP_FEAT_ISO_SOCKET) &&
-						eir_data.rsi)
+						eir.rsi)
 			monitoring = true;
 
-		if (!discoverable && !monitoring) {
-			eir_data_free(&eir_data);
+		if (!discoverable && !monitoring)
 			return;
-		}
+
+		adapter_evict_temporary(adapter);
 
 		dev = adapter_create_device(adapter, bdaddr, bdaddr_type);
 	}
@@ -7393,27 +7514,31 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	if (!dev) {
 		btd_error(adapter->dev_id,
 			"Unable to create object for found device %s", addr);
-		eir_data_free(&eir_data);
 		return;
 	}
 
 	device_update_last_seen(dev, bdaddr_type, !not_connectable);
 
+	unchanged = device_report_unchanged(dev, bdaddr_type, scan_rsp, data,
+								data_len);
+	adapter->reports++;
+
 	/*
 	 * FIXME: We need to check for non-zero flags first because
 	 * older kernels send separate adv_ind and scan_rsp. Newer
 	 * kernels send them merged, so once we know which mgmt version
 	 * supports this we can make the non-zero check conditional.
 	 */
-	if (bdaddr_type != BDADDR_BREDR && eir_data.flags &&
-					!(eir_data.flags & EIR_BREDR_UNSUP)) {
+	if (bdaddr_type != BDADDR_BREDR && eir.flags &&
+					!(eir.flags & EIR_BREDR_UNSUP)) {
 		device_set_bredr_support(dev);
 		/* Update last seen for BR/EDR in case its flag is set */
 		device_update_last_seen(dev, BDADDR_BREDR, !not_connectable);
 	}
 
-	if (eir_data.name != NULL && eir_data.name_complete)
-		device_store_cached_name(dev, eir_data.name);
+	/* The name has already been stored if the report is unchanged */
+	if (name && eir.name_complete && !unchanged)
+		device_store_cached_name(dev, name);
 
 	/*
 	 * Only skip devices that are not connected, are temporary, and there
@@ -7421,20 +7546,16 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	 */
 	if (!btd_device_is_connected(dev) &&
 		(device_is_temporary(dev) && !adapter->discovery_list) &&
-		!monitoring) {
-		eir_data_free(&eir_data);
+		!monitoring)
 		return;
-	}
 
 	/* If there is no matched Adv monitors, don't continue if not
 	 * discoverable or if active discovery filter don't match.
 	 */
-	if (!eir_data.rsi && !monitoring && (!discoverable ||
+	if (!eir.rsi && !monitoring && (!discoverable ||
 		(adapter->filtered_discovery && !is_filter_match(
-				adapter->discovery_list, &eir_data, rssi)))) {
-		eir_data_free(&eir_data);
+				adapter->discovery_list, &eir, rssi))))
 		return;
-	}
 
 	device_set_legacy(dev, legacy);
 
@@ -7446,51 +7567,25 @@ void btd_adapter_device_found(struct btd_adapter *adapter,
 	else
 		device_set_rssi(dev, rssi);
 
-	if (eir_data.tx_power != 127)
-		device_set_tx_power(dev, eir_data.tx_power);
-
-	if (eir_data.appearance != 0)
-		device_set_appearance(dev, eir_data.appearance);
-
 	/* Report an unknown name to the kernel even if there is a short name
 	 * known, but still update the name with the known short name. */
 	name_known = device_name_known(dev);
 
-	if (eir_data.name && (eir_data.name_complete || !name_known))
-		btd_device_device_set_name(dev, eir_data.name);
-
-	if (eir_data.class != 0)
-		device_set_class(dev, eir_data.class);
-
-	if (eir_data.did_source || eir_data.did_vendor ||
-			eir_data.did_product || eir_data.did_version)
-		btd_device_set_pnpid(dev, eir_data.did_source,
-							eir_data.did_vendor,
-							eir_data.did_product,
-							eir_data.did_version);
-
-	device_add_eir_uuids(dev, eir_data.services);
-
 	if (adapter->discovery_list)
 		g_slist_foreach(adapter->discovery_list, filter_duplicate_data,
 								&duplicate);
 
-	if (eir_data.msd_list) {
-		device_set_manufacturer_data(dev, eir_data.msd_list, duplicate);
-		adapter_msd_notify(adapter, dev, eir_data.msd_list);
+	/* Reports identical to the last one only refresh the RSSI, unless a
+	 * client wants every report to be signalled.
+	 */
+	if (unchanged && !duplicate) {
+		adapter->reports_suppressed++;
+	} else {
+		device_set_report(dev, bdaddr_type, scan_rsp, data, data_len);
+		device_found_update(adapter, dev, bdaddr_type, data, data_len,
+							name_known, duplicate);
 	}
 
-	if (eir_data.sd_list)
-		device_set_service_data(dev, eir_data.sd_list, duplicate);
-
-	if (eir_data.data_list)
-		device_set_data(dev, eir_data.data_list, duplicate);
-
-	if (bdaddr_type != BDADDR_BREDR)
-		device_set_flags(dev, eir_data.flags);
-
-	eir_data_free(&eir_data);
-
 	/* After the device is updated, notify the matched Adv monitors */
 	if (matched_monitors) {
 		btd_adv_monitor_notify_monitors(adapter->adv_monitor_manager,
@@ -63,6 +63,7 @@ struct btd_adv_monitor_manager {
 
 	struct queue *apps;	/* apps who registered for Adv monitoring */
 	struct queue *merged_patterns;
+	struct bt_ad_matcher *matcher;	/* Patterns of merged_patterns */
 };
 
 struct adv_monitor_app {
@@ -118,7 +119,9 @@ struct adv_monitor {
 	struct rssi_parameters rssi;	/* RSSI parameter for this monitor */
 	struct adv_monitor_merged_pattern *merged_pattern;
 
-	struct queue *devices;		/* List of adv_monitor_device objects */
+	GHashTable *devices;		/* adv_monitor_device objects indexed
+					 * by btd_device
+					 */
 };
 
 /* Some chipsets doesn't support multiple monitors with the same pattern.
@@ -241,9 +244,13 @@ static void merged_pattern_free(void *data)
 	queue_destroy(merged_pattern->patterns, pattern_free);
 	queue_destroy(merged_pattern->monitors, NULL);
 
-	if (merged_pattern->manager)
+	if (merged_pattern->manager) {
 		queue_remove(merged_pattern->manager->merged_patterns,
 							merged_pattern);
+		bt_ad_matcher_remove(merged_pattern->manager->matcher,
+							merged_pattern);
+	}
+
 	free(merged_pattern);
 }
 
@@ -496,7 +503,7 @@ static void monitor_free(struct adv_monitor *monitor)
 	g_dbus_proxy_unref(monitor->proxy);
 	g_free(monitor->path);
 
-	queue_destroy(monitor->devices, monitor_device_free);
+	g_hash_table_destroy(monitor->devices);
 	monitor->devices = NULL;
 
 	free(monitor);
@@ -704,7 +711,8 @@ static struct adv_monitor *monitor_new(struct adv_monitor_app *app,
 	monitor->state = MONITOR_STATE_NEW;
 
 	rssi_unset(&monitor->rssi);
-	monitor->devices = queue_new();
+	monitor->devices = g_hash_table_new_full(NULL, NULL, NULL,
+							monitor_device_free);
 
 	return monitor;
 }
@@ -1189,6 +1197,14 @@ static void merged_pattern_send_add(
 		merged_pattern_send_add_pattern_rssi(merged_pattern);
 }
 
+static void matcher_add_pattern(void *data, void *user_data)
+{
+	struct adv_monitor_merged_pattern *merged_pattern = user_data;
+
+	bt_ad_matcher_add(merged_pattern->manager->matcher, data,
+							merged_pattern);
+}
+
 /* Handles an Adv Monitor D-Bus proxy added event */
 static void monitor_proxy_added_cb(GDBusProxy *proxy, void *user_data)
 {
@@ -1237,6 +1253,9 @@ static void monitor_proxy_added_cb(GDBusProxy *proxy, void *user_data)
 		monitor->merged_pattern->manager = monitor->app->manager;
 		queue_push_tail(monitor->app->manager->merged_patterns,
 						monitor->merged_pattern);
+		queue_foreach(monitor->merged_pattern->patterns,
+					matcher_add_pattern,
+					monitor->merged_pattern);
 		merged_pattern_add(monitor->merged_pattern);
 	} else {
 		/* Since there is a matching pattern, abandon the one we have */
@@ -1710,6 +1729,7 @@ static struct btd_adv_monitor_manager *manager_new(
 	manager->adapter_id = btd_adapter_get_index(adapter);
 	manager->apps = queue_new();
 	manager->merged_patterns = queue_new();
+	manager->matcher = bt_ad_matcher_new();
 
 	mgmt_register(manager->mgmt, MGMT_EV_ADV_MONITOR_REMOVED,
 			manager->adapter_id, adv_monitor_removed_callback,
@@ -1733,6 +1753,7 @@ static void manager_free(struct btd_adv_monitor_manager *manager)
 
 	queue_destroy(manager->apps, app_destroy);
 	queue_destroy(manager->merged_patterns, merged_pattern_free);
+	bt_ad_matcher_free(manager->matcher);
 
 	free(manager);
 }
@@ -1843,50 +1864,34 @@ bool btd_adv_monitor_offload_enabled(struct btd_adv_monitor_manager *manager)
 				MGMT_ADV_MONITOR_FEATURE_MASK_OR_PATTERNS);
 }
 
-/* Processes the content matching based pattern(s) of a monitor */
+/* Collects the active monitors of a content-matched merged pattern */
 static void adv_match_per_monitor(void *data, void *user_data)
 {
 	struct adv_monitor *monitor = data;
 	struct adv_content_filter_info *info = user_data;
-	struct queue *patterns;
-
-	if (!monitor) {
-		error("Unexpected NULL adv_monitor object upon match");
-		return;
-	}
 
 	if (monitor->state != MONITOR_STATE_ACTIVE)
 		return;
 
-	if (!monitor->merged_pattern)
-		return;
-
-	patterns = monitor->merged_pattern->patterns;
-	if (monitor->merged_pattern->type == MONITOR_TYPE_OR_PATTERNS &&
-				bt_ad_pattern_match(info->ad, patterns)) {
-		goto matched;
-	}
-
-	return;
-
-matched:
 	if (!info->matched_monitors)
 		info->matched_monitors = queue_new();
 
 	queue_push_tail(info->matched_monitors, monitor);
 }
 
-/* Processes the content matching for the monitor(s) of an app */
-static void adv_match_per_app(void *data, void *user_data)
+/* Processes a merged pattern with at least one pattern matching the ad data.
+ * Since merged patterns are shared by all the monitors with the same patterns
+ * each pattern is compared only once no matter how many monitors use it.
+ */
+static void adv_match_per_merged_pattern(void *data, void *user_data)
 {
-	struct adv_monitor_app *app = data;
+	struct adv_monitor_merged_pattern *merged_pattern = data;
 
-	if (!app) {
-		error("Unexpected NULL adv_monitor_app object upon match");
+	if (merged_pattern->type != MONITOR_TYPE_OR_PATTERNS)
 		return;
-	}
 
-	queue_foreach(app->monitors, adv_match_per_monitor, user_data);
+	queue_foreach(merged_pattern->monitors, adv_match_per_monitor,
+								user_data);
 }
 
 /* Processes the content matching for every app without RSSI filtering and
@@ -1906,7 +1911,8 @@ struct queue *btd_adv_monitor_content_filter(
 	info.ad = ad;
 	info.matched_monitors = NULL;
 
-	queue_foreach(manager->apps, adv_match_per_app, &info);
+	bt_ad_matcher_match(manager->matcher, ad, adv_match_per_merged_pattern,
+								&info);
 
 	return info.matched_monitors;
 }
@@ -1946,23 +1952,6 @@ void btd_adv_monitor_notify_monitors(struct btd_adv_monitor_manager *manager,
 	queue_foreach(matched_monitors, monitor_filter_rssi, &info);
 }
 
-/* Matches a device based on btd_device object */
-static bool monitor_device_match(const void *a, const void *b)
-{
-	const struct adv_monitor_device *dev = a;
-	const struct btd_device *device = b;
-
-	if (!dev) {
-		error("Unexpected NULL adv_monitor_device object upon match");
-		return false;
-	}
-
-	if (dev->device != device)
-		return false;
-
-	return true;
-}
-
 /* Frees a monitor device object */
 static void monitor_device_free(void *data)
 {
@@ -1984,24 +1973,20 @@ static void monitor_device_free(void *data)
 	free(dev);
 }
 
-/* Removes a device from monitor->devices list */
+/* Removes a device from monitor->devices table */
 static void remove_device_from_monitor(void *data, void *user_data)
 {
 	struct adv_monitor *monitor = data;
 	struct btd_device *device = user_data;
-	struct adv_monitor_device *dev = NULL;
 
 	if (!monitor) {
 		error("Unexpected NULL adv_monitor object upon device remove");
 		return;
 	}
 
-	dev = queue_remove_if(monitor->devices, monitor_device_match, device);
-	if (dev) {
+	if (g_hash_table_remove(monitor->devices, device))
 		DBG("Device removed from the Adv Monitor at path %s",
 		    monitor->path);
-		monitor_device_free(dev);
-	}
 }
 
 /* Removes a device from every monitor in an app */
@@ -2043,7 +2028,7 @@ static struct adv_monitor_device *monitor_device_create(
 	dev->monitor = monitor;
 	dev->device = device;
 
-	queue_push_tail(monitor->devices, dev);
+	g_hash_table_insert(monitor->devices, device, dev);
 
 	return dev;
 }
@@ -2091,7 +2076,7 @@ static void adv_monitor_filter_rssi(struct adv_monitor *monitor,
 		return;
 	}
 
-	dev = queue_find(monitor->devices, monitor_device_match, device);
+	dev = g_hash_table_lookup(monitor->devices, device);
 	if (!dev) {
 		dev = monitor_device_create(monitor, device);
 		if (!dev) {
@@ -2184,9 +2169,10 @@ static void adv_monitor_filter_rssi(struct adv_monitor *monitor,
 }
 
 /* Clears running DeviceLost timer for a given device */
-static void clear_device_lost_timer(void *data, void *user_data)
+static void clear_device_lost_timer(gpointer key, gpointer value,
+							gpointer user_data)
 {
-	struct adv_monitor_device *dev = data;
+	struct adv_monitor_device *dev = value;
 	struct adv_monitor *monitor = NULL;
 
 	if (dev->lost_timer) {
@@ -2210,7 +2196,7 @@ static void clear_lost_timers_from_monitor(void *data, void *user_data)
 {
 	struct adv_monitor *monitor = data;
 
-	queue_foreach(monitor->devices, clear_device_lost_timer, NULL);
+	g_hash_table_foreach(monitor->devices, clear_device_lost_timer, NULL);
 }
 
 /* Clears running DeviceLost timers from each app */
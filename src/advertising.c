@@ -54,8 +54,17 @@ struct btd_adv_manager {
 	bool extended_add_cmds;
 	int8_t min_tx_power;
 	int8_t max_tx_power;
+	struct queue *parked;
+	unsigned int rotate_id;
+	unsigned int rotations;
 };
 
+/* Advertisements waiting for an instance when all of them are in use */
+#define ADV_MAX_PARKED 32
+
+/* Default when MultiAdvertisementRotationInterval is not set, in msec */
+#define ADV_ROTATION_INTERVAL 2000
+
 #define AD_TYPE_BROADCAST 0
 #define AD_TYPE_PERIPHERAL 1
 
@@ -64,6 +73,16 @@ struct btd_adv_manager {
  */
 #define ADV_TX_POWER_NO_PREFERENCE 0x7F
 
+/* Encoded advertising or scan response data */
+struct adv_payload {
+	bool valid;
+	unsigned int version;
+	uint32_t flags_in;
+	uint32_t flags;
+	uint8_t *data;
+	size_t len;
+};
+
 struct btd_adv_client {
 	struct btd_adv_manager *manager;
 	char *owner;
@@ -88,6 +107,9 @@ struct btd_adv_client {
 	uint32_t max_interval;
 	int8_t tx_power;
 	mgmt_request_func_t refresh_done_func;
+	unsigned int version;
+	struct adv_payload adv_payload;
+	struct adv_payload scan_payload;
 };
 
 struct dbus_obj_match {
@@ -144,6 +166,9 @@ static void client_free(void *data)
 	bt_ad_unref(client->data);
 	bt_ad_unref(client->scan);
 
+	free(client->adv_payload.data);
+	free(client->scan_payload.data);
+
 	g_dbus_proxy_unref(client->proxy);
 
 	if (client->owner)
@@ -195,21 +220,117 @@ static void remove_advertising(struct btd_adv_manager *manager,
 			manager->mgmt_index, sizeof(cp), &cp, NULL, NULL, NULL);
 }
 
+static int refresh_advertisement(struct btd_adv_client *client,
+					mgmt_request_func_t func);
+
+static bool client_rotatable(const void *data, const void *user_data)
+{
+	const struct btd_adv_client *client = data;
+
+	/* Don't take the instance away while a request is in progress */
+	return client->instance && !client->reg && !client->add_adv_id;
+}
+
+static void client_install(struct btd_adv_client *client, uint8_t instance)
+{
+	struct btd_adv_manager *manager = client->manager;
+
+	DBG("Installing advertisement %s as instance %u", client->path,
+								instance);
+
+	queue_remove(manager->parked, client);
+
+	/* Keep the clients installed the longest at the head */
+	queue_remove(manager->clients, client);
+	queue_push_tail(manager->clients, client);
+
+	client->instance = instance;
+
+	if (refresh_advertisement(client, NULL) < 0)
+		error("Failed to install advertisement %s", client->path);
+}
+
+static bool rotate_timeout(void *user_data)
+{
+	struct btd_adv_manager *manager = user_data;
+	struct btd_adv_client *client, *old;
+	uint8_t instance;
+
+	client = queue_peek_head(manager->parked);
+	if (!client) {
+		manager->rotate_id = 0;
+		return false;
+	}
+
+	instance = util_get_uid(&manager->instance_bitmap, manager->max_ads);
+	if (!instance) {
+		old = queue_find(manager->clients, client_rotatable, NULL);
+		if (!old)
+			return true;
+
+		DBG("Parking advertisement %s (rotation %u)", old->path,
+						manager->rotations + 1);
+
+		/* Adding the instance again replaces the old data */
+		instance = old->instance;
+		old->instance = 0;
+		queue_push_tail(manager->parked, old);
+	}
+
+	manager->rotations++;
+
+	client_install(client, instance);
+
+	return true;
+}
+
+static void rotate_start(struct btd_adv_manager *manager)
+{
+	unsigned int interval = btd_opts.defaults.le.adv_rotation_interval;
+
+	if (manager->rotate_id || queue_isempty(manager->parked))
+		return;
+
+	if (!interval)
+		interval = ADV_ROTATION_INTERVAL;
+
+	DBG("Rotating %u parked advertisements every %u ms",
+				queue_length(manager->parked), interval);
+
+	manager->rotate_id = timeout_add(interval, rotate_timeout, manager,
+									NULL);
+}
+
 static void client_remove(struct btd_adv_client *client)
 {
+	struct btd_adv_manager *manager = client->manager;
 	struct mgmt_cp_remove_advertising cp;
+	struct btd_adv_client *next;
 
 	g_dbus_client_set_proxy_handlers(client->client, NULL, NULL, NULL,
 									client);
 	g_dbus_client_set_disconnect_watch(client->client, NULL, NULL);
 
-	cp.instance = client->instance;
+	/* Parked advertisements were never added, instance 0 means all */
+	if (client->instance) {
+		cp.instance = client->instance;
 
-	mgmt_send(client->manager->mgmt, MGMT_OP_REMOVE_ADVERTISING,
-			client->manager->mgmt_index, sizeof(cp), &cp,
-			NULL, NULL, NULL);
+		mgmt_send(manager->mgmt, MGMT_OP_REMOVE_ADVERTISING,
+				manager->mgmt_index, sizeof(cp), &cp,
+				NULL, NULL, NULL);
+	}
 
-	queue_remove(client->manager->clients, client);
+	queue_remove(manager->clients, client);
+	queue_remove(manager->parked, client);
+
+	/* Hand the instance over to the next advertisement waiting for one */
+	next = queue_peek_head(manager->parked);
+	if (client->instance && next) {
+		uint8_t instance = client->instance;
+
+		client->instance = 0;
+		client_install(next, instance);
+	}
 
 	g_idle_add(client_free_idle_cb, client);
 
@@ -930,6 +1051,59 @@ static bool adv_client_has_scan_response(struct btd_adv_client *client,
 	return true;
 }
 
+typedef uint8_t *(*adv_generate_func_t)(struct btd_adv_client *client,
+						uint32_t *flags, size_t *len);
+
+/*
+ * Returns the encoded data, only generating it again if the client data or
+ * the flags it was generated with have changed since the last time.
+ */
+static bool get_payload(struct btd_adv_client *client,
+				struct adv_payload *payload,
+				adv_generate_func_t generate, uint32_t *flags,
+				const uint8_t **data, size_t *len)
+{
+	if (!payload->valid || payload->version != client->version ||
+						payload->flags_in != *flags) {
+		free(payload->data);
+
+		payload->flags_in = *flags;
+		payload->len = 0;
+		payload->data = generate(client, flags, &payload->len);
+		payload->valid = payload->data || !payload->len;
+		payload->version = client->version;
+		payload->flags = *flags;
+
+		if (!payload->valid)
+			return false;
+	}
+
+	*flags = payload->flags;
+	*data = payload->data;
+	*len = payload->len;
+
+	return true;
+}
+
+static bool get_adv_data(struct btd_adv_client *client, uint32_t *flags,
+					const uint8_t **data, size_t *len)
+{
+	return get_payload(client, &client->adv_payload, generate_adv_data,
+							flags, data, len);
+}
+
+static bool get_scan_rsp(struct btd_adv_client *client, uint32_t *flags,
+					const uint8_t **data, size_t *len)
+{
+	return get_payload(client, &client->scan_payload, generate_scan_rsp,
+							flags, data, len);
+}
+
+static void client_invalidate_payload(struct btd_adv_client *client)
+{
+	client->version++;
+}
+
 static int get_adv_flags(struct btd_adv_client *client)
 {
 	uint32_t flags = 0;
@@ -959,10 +1133,10 @@ static int refresh_legacy_adv(struct btd_adv_client *client,
 {
 	struct mgmt_cp_add_advertising *cp;
 	uint8_t param_len;
-	uint8_t *adv_data;
+	const uint8_t *adv_data;
 	size_t adv_data_len;
-	uint8_t *scan_rsp;
-	size_t scan_rsp_len = -1;
+	const uint8_t *scan_rsp;
+	size_t scan_rsp_len;
 	uint32_t flags = 0;
 	unsigned int mgmt_ret;
 
@@ -970,16 +1144,14 @@ static int refresh_legacy_adv(struct btd_adv_client *client,
 
 	flags = get_adv_flags(client);
 
-	adv_data = generate_adv_data(client, &flags, &adv_data_len);
-	if (!adv_data || (adv_data_len > calc_max_adv_len(client, flags))) {
+	if (!get_adv_data(client, &flags, &adv_data, &adv_data_len) ||
+			adv_data_len > calc_max_adv_len(client, flags)) {
 		error("Advertising data too long or couldn't be generated.");
 		return -EINVAL;
 	}
 
-	scan_rsp = generate_scan_rsp(client, &flags, &scan_rsp_len);
-	if (!scan_rsp && scan_rsp_len) {
+	if (!get_scan_rsp(client, &flags, &scan_rsp, &scan_rsp_len)) {
 		error("Scan data couldn't be generated.");
-		free(adv_data);
 		return -EINVAL;
 	}
 
@@ -989,8 +1161,6 @@ static int refresh_legacy_adv(struct btd_adv_client *client,
 	cp = malloc0(param_len);
 	if (!cp) {
 		error("Couldn't allocate for MGMT!");
-		free(adv_data);
-		free(scan_rsp);
 		return -ENOMEM;
 	}
 
@@ -1004,9 +1174,6 @@ static int refresh_legacy_adv(struct btd_adv_client *client,
 	if (scan_rsp)
 		memcpy(cp->data + adv_data_len, scan_rsp, scan_rsp_len);
 
-	free(adv_data);
-	free(scan_rsp);
-
 	mgmt_ret = mgmt_send(client->manager->mgmt, MGMT_OP_ADD_ADVERTISING,
 			client->manager->mgmt_index, param_len, cp,
 			func, client, NULL);
@@ -1089,6 +1256,10 @@ static int refresh_extended_adv(struct btd_adv_client *client,
 static int refresh_advertisement(struct btd_adv_client *client,
 					mgmt_request_func_t func)
 {
+	/* Parked advertisements are refreshed once they get an instance */
+	if (!client->instance)
+		return 0;
+
 	if (client->manager->extended_add_cmds)
 		return refresh_extended_adv(client, func);
 
@@ -1104,6 +1275,7 @@ static bool client_discoverable_timeout(void *user_data)
 	client->disc_to_id = 0;
 
 	bt_ad_clear_flags(client->data);
+	client_invalidate_payload(client);
 
 	refresh_advertisement(client, NULL);
 
@@ -1316,6 +1488,7 @@ static void properties_changed(GDBusProxy *proxy, const char *name,
 			continue;
 
 		if (parser->func(iter, client)) {
+			client_invalidate_payload(client);
 			refresh_advertisement(client, NULL);
 
 			break;
@@ -1352,6 +1525,24 @@ static void add_client_complete(struct btd_adv_client *client, uint8_t status)
 	client->reg = NULL;
 }
 
+static void client_added(struct btd_adv_client *client)
+{
+	g_dbus_client_set_disconnect_watch(client->client, client_disconnect_cb,
+									client);
+	DBG("Advertisement registered: %s", client->path);
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(),
+				adapter_get_path(client->manager->adapter),
+				LE_ADVERTISING_MGR_IFACE, "SupportedInstances");
+
+	g_dbus_emit_property_changed(btd_get_dbus_connection(),
+				adapter_get_path(client->manager->adapter),
+				LE_ADVERTISING_MGR_IFACE, "ActiveInstances");
+
+	g_dbus_proxy_set_property_watch(client->proxy, properties_changed,
+								client);
+}
+
 static void add_adv_callback(uint8_t status, uint16_t length,
 					  const void *param, void *user_data)
 {
@@ -1370,20 +1561,7 @@ static void add_adv_callback(uint8_t status, uint16_t length,
 
 	client->instance = rp->instance;
 
-	g_dbus_client_set_disconnect_watch(client->client, client_disconnect_cb,
-									client);
-	DBG("Advertisement registered: %s", client->path);
-
-	g_dbus_emit_property_changed(btd_get_dbus_connection(),
-				adapter_get_path(client->manager->adapter),
-				LE_ADVERTISING_MGR_IFACE, "SupportedInstances");
-
-	g_dbus_emit_property_changed(btd_get_dbus_connection(),
-				adapter_get_path(client->manager->adapter),
-				LE_ADVERTISING_MGR_IFACE, "ActiveInstances");
-
-	g_dbus_proxy_set_property_watch(client->proxy, properties_changed,
-								client);
+	client_added(client);
 
 done:
 	add_client_complete(client, status);
@@ -1396,9 +1574,9 @@ static void add_adv_params_callback(uint8_t status, uint16_t length,
 	const struct mgmt_rp_add_ext_adv_params *rp = param;
 	struct mgmt_cp_add_ext_adv_data *cp = NULL;
 	uint8_t param_len;
-	uint8_t *adv_data = NULL;
+	const uint8_t *adv_data;
 	size_t adv_data_len;
-	uint8_t *scan_rsp = NULL;
+	const uint8_t *scan_rsp = NULL;
 	size_t scan_rsp_len = 0;
 	uint32_t flags = 0;
 	unsigned int mgmt_ret;
@@ -1426,15 +1604,14 @@ static void add_adv_params_callback(uint8_t status, uint16_t length,
 
 	flags = get_adv_flags(client);
 
-	adv_data = generate_adv_data(client, &flags, &adv_data_len);
-	if (!adv_data || (adv_data_len > rp->max_adv_data_len)) {
+	if (!get_adv_data(client, &flags, &adv_data, &adv_data_len) ||
+			adv_data_len > rp->max_adv_data_len) {
 		error("Advertising data too long or couldn't be generated.");
 		goto fail;
 	}
 
 	if (adv_client_has_scan_response(client, flags)) {
-		scan_rsp = generate_scan_rsp(client, &flags, &scan_rsp_len);
-		if ((!scan_rsp && scan_rsp_len) ||
+		if (!get_scan_rsp(client, &flags, &scan_rsp, &scan_rsp_len) ||
 				scan_rsp_len > rp->max_scan_rsp_len) {
 			error("Scan data couldn't be generated.");
 			goto fail;
@@ -1458,11 +1635,6 @@ static void add_adv_params_callback(uint8_t status, uint16_t length,
 	if (scan_rsp)
 		memcpy(cp->data + adv_data_len, scan_rsp, scan_rsp_len);
 
-	free(adv_data);
-	free(scan_rsp);
-	adv_data = NULL;
-	scan_rsp = NULL;
-
 	/* Submit request to update instance data */
 	mgmt_ret = mgmt_send(client->manager->mgmt, MGMT_OP_ADD_EXT_ADV_DATA,
 			     client->manager->mgmt_index, param_len, cp,
@@ -1485,12 +1657,6 @@ static void add_adv_params_callback(uint8_t status, uint16_t length,
 	return;
 
 fail:
-	if (adv_data)
-		free(adv_data);
-
-	if (scan_rsp)
-		free(scan_rsp);
-
 	if (cp)
 		free(cp);
 
@@ -1560,6 +1726,30 @@ static DBusMessage *parse_advertisement(struct btd_adv_client *client)
 		goto fail;
 	}
 
+	if (!client->instance) {
+		uint32_t flags = get_adv_flags(client);
+		const uint8_t *adv_data;
+		size_t adv_data_len;
+
+		/* Validate now, the data is sent once it gets an instance */
+		if (!get_adv_data(client, &flags, &adv_data, &adv_data_len) ||
+			adv_data_len > calc_max_adv_len(client, flags)) {
+			error("Advertising data too long or couldn't be "
+								"generated.");
+			goto fail;
+		}
+
+		DBG("Advertisement %s parked", client->path);
+
+		queue_push_tail(client->manager->parked, client);
+		rotate_start(client->manager);
+
+		client_added(client);
+		add_client_complete(client, 0);
+
+		return NULL;
+	}
+
 	err = refresh_advertisement(client, add_adv_callback);
 
 	if (!err)
@@ -1689,7 +1879,10 @@ static DBusMessage *register_advertisement(DBusConnection *conn,
 
 	client->instance = util_get_uid(&manager->instance_bitmap,
 							manager->max_ads);
-	if (!client->instance) {
+
+	/* Without a free instance it is rotated with the others instead */
+	if (!client->instance && (!manager->max_ads ||
+			queue_length(manager->parked) >= ADV_MAX_PARKED)) {
 		client_free(client);
 		return btd_error_not_permitted(msg,
 					"Maximum advertisements reached");
@@ -1740,7 +1933,8 @@ static gboolean get_instances(const GDBusPropertyTable *property,
 	struct btd_adv_manager *manager = data;
 	uint8_t instances;
 
-	instances = manager->max_ads - queue_length(manager->clients);
+	instances = manager->max_ads - (queue_length(manager->clients) -
+					queue_length(manager->parked));
 
 	dbus_message_iter_append_basic(iter, DBUS_TYPE_BYTE, &instances);
 
@@ -1923,6 +2117,10 @@ static void manager_destroy(void *user_data)
 {
 	struct btd_adv_manager *manager = user_data;
 
+	if (manager->rotate_id)
+		timeout_remove(manager->rotate_id);
+
+	queue_destroy(manager->parked, NULL);
 	queue_destroy(manager->clients, client_destroy);
 
 	mgmt_unref(manager->mgmt);
@@ -2041,6 +2239,7 @@ static struct btd_adv_manager *manager_create(struct btd_adapter *adapter,
 
 	manager->mgmt_index = btd_adapter_get_index(adapter);
 	manager->clients = queue_new();
+	manager->parked = queue_new();
 	manager->supported_flags = MGMT_ADV_FLAG_LOCAL_NAME;
 	manager->extended_add_cmds =
 			btd_has_kernel_features(KERNEL_HAS_EXT_ADV_ADD_CMDS);
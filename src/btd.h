@@ -128,6 +128,7 @@ struct btd_opts {
 	uint32_t	pairto;
 	uint32_t	discovto;
 	uint32_t	tmpto;
+	uint32_t	tmpmax;
 	uint8_t		privacy;
 	bool		device_privacy;
 	uint32_t	name_request_retry_delay;
@@ -143,6 +144,9 @@ struct btd_opts {
 	bool		experimental;
 	bool		testing;
 	bool		filter_discoverable;
+	uint32_t	prop_window;
+	uint32_t	prop_interval;
+	bool		prop_snapshot;
 	struct queue	*kernel;
 
 	uint16_t	did_source;
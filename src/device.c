@@ -162,6 +162,8 @@ struct bearer_state {
 	bool connectable;
 	time_t last_seen;
 	time_t last_used;
+	uint64_t report_hash;		/* Last applied EIR/advertising data */
+	uint64_t rsp_hash;		/* Last applied scan response */
 };
 
 struct ltk_info {
@@ -2438,8 +2440,9 @@ static void add_manufacturer_data(void *data, void *user_data)
 								msd->data_len))
 		return;
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-					DEVICE_INTERFACE, "ManufacturerData");
+	g_dbus_emit_property_changed_full(dbus_conn, dev->path,
+					DEVICE_INTERFACE, "ManufacturerData",
+					G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE);
 }
 
 void device_set_manufacturer_data(struct btd_device *dev, GSList *list,
@@ -2468,8 +2471,9 @@ static void add_service_data(void *data, void *user_data)
 	device_add_eir_uuids(dev, l);
 	g_slist_free(l);
 
-	g_dbus_emit_property_changed(dbus_conn, dev->path,
-					DEVICE_INTERFACE, "ServiceData");
+	g_dbus_emit_property_changed_full(dbus_conn, dev->path,
+					DEVICE_INTERFACE, "ServiceData",
+					G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE);
 }
 
 void device_set_service_data(struct btd_device *dev, GSList *list,
@@ -3797,6 +3801,61 @@ static bool device_service_connected(struct btd_device *dev)
 					BTD_SERVICE_STATE_CONNECTED);
 }
 
+/* Temporary devices which are not in use by anything other than discovery
+ * can be removed early to make room for new ones.
+ */
+bool device_is_evictable(struct btd_device *dev)
+{
+	if (!dev->temporary || dev->trusted)
+		return false;
+
+	if (btd_device_bearer_is_connected(dev) ||
+					device_service_connected(dev))
+		return false;
+
+	if (dev->bredr_state.paired || dev->le_state.paired)
+		return false;
+
+	return !dev->bonding && !dev->authr && !dev->browse &&
+						!dev->connect && !dev->disconnect;
+}
+
+time_t device_get_last_seen(struct btd_device *dev)
+{
+	return MAX(dev->bredr_state.last_seen, dev->le_state.last_seen);
+}
+
+static size_t str_list_size(GSList *list)
+{
+	size_t size = 0;
+
+	for (; list; list = list->next)
+		size += sizeof(*list) + strlen(list->data) + 1;
+
+	return size;
+}
+
+/* Estimates the memory held by the device itself, not counting services,
+ * GATT state and advertising data.
+ */
+size_t device_get_size(struct btd_device *dev)
+{
+	size_t size = sizeof(*dev);
+
+	size += strlen(dev->path) + 1;
+
+	if (dev->alias)
+		size += strlen(dev->alias) + 1;
+
+	if (dev->modalias)
+		size += strlen(dev->modalias) + 1;
+
+	size += str_list_size(dev->eir_uuids);
+	size += str_list_size(dev->uuids);
+
+	return size;
+}
+
 static bool device_disappeared(gpointer user_data)
 {
 	struct btd_device *dev = user_data;
@@ -5159,6 +5218,53 @@ void device_update_last_seen(struct btd_device *device, uint8_t bdaddr_type,
 	set_temporary_timer(device, btd_opts.tmpto);
 }
 
+/* FNV-1a, 0 is reserved for no report */
+static uint64_t report_hash(const uint8_t *data, uint8_t data_len)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	uint8_t i;
+
+	hash = (hash ^ data_len) * 0x100000001b3ULL;
+
+	for (i = 0; i < data_len; i++)
+		hash = (hash ^ data[i]) * 0x100000001b3ULL;
+
+	return hash ? hash : 1;
+}
+
+/* Checks if the report is identical to the last one applied to the device
+ * from the same bearer, in which case only its RSSI needs updating.
+ */
+bool device_report_unchanged(struct btd_device *device, uint8_t bdaddr_type,
+				bool scan_rsp, const uint8_t *data,
+				uint8_t data_len)
+{
+	struct bearer_state *state = get_state(device, bdaddr_type);
+	uint64_t hash = scan_rsp ? state->rsp_hash : state->report_hash;
+
+	return hash && hash == report_hash(data, data_len);
+}
+
+void device_set_report(struct btd_device *device, uint8_t bdaddr_type,
+				bool scan_rsp, const uint8_t *data,
+				uint8_t data_len)
+{
+	struct bearer_state *state = get_state(device, bdaddr_type);
+
+	if (scan_rsp)
+		state->rsp_hash = report_hash(data, data_len);
+	else
+		state->report_hash = report_hash(data, data_len);
+}
+
+void device_clear_reports(struct btd_device *device)
+{
+	device->bredr_state.report_hash = 0;
+	device->bredr_state.rsp_hash = 0;
+	device->le_state.report_hash = 0;
+	device->le_state.rsp_hash = 0;
+}
+
 void btd_device_set_connectable(struct btd_device *device, bool connectable)
 {
 	device_update_last_seen(device, device->bdaddr_type, connectable);
@@ -6926,8 +7032,9 @@ void device_set_rssi_with_delta(struct btd_device *device, int8_t rssi,
 		device->rssi = rssi;
 	}
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "RSSI");
+	g_dbus_emit_property_changed_full(dbus_conn, device->path,
+					DEVICE_INTERFACE, "RSSI",
+					G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE);
 }
 
 void device_set_rssi(struct btd_device *device, int8_t rssi)
@@ -6947,8 +7054,9 @@ void device_set_tx_power(struct btd_device *device, int8_t tx_power)
 
 	device->tx_power = tx_power;
 
-	g_dbus_emit_property_changed(dbus_conn, device->path,
-						DEVICE_INTERFACE, "TxPower");
+	g_dbus_emit_property_changed_full(dbus_conn, device->path,
+					DEVICE_INTERFACE, "TxPower",
+					G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE);
 }
 
 void device_set_flags(struct btd_device *device, uint8_t flags)
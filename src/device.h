@@ -38,6 +38,16 @@ void device_set_bredr_support(struct btd_device *device);
 void device_set_le_support(struct btd_device *device, uint8_t bdaddr_type);
 void device_update_last_seen(struct btd_device *device, uint8_t bdaddr_type,
 							bool connectable);
+bool device_is_evictable(struct btd_device *dev);
+time_t device_get_last_seen(struct btd_device *dev);
+size_t device_get_size(struct btd_device *dev);
+bool device_report_unchanged(struct btd_device *device, uint8_t bdaddr_type,
+				bool scan_rsp, const uint8_t *data,
+				uint8_t data_len);
+void device_set_report(struct btd_device *device, uint8_t bdaddr_type,
+				bool scan_rsp, const uint8_t *data,
+				uint8_t data_len);
+void device_clear_reports(struct btd_device *device);
 void device_merge_duplicate(struct btd_device *dev, struct btd_device *dup);
 uint32_t btd_device_get_class(struct btd_device *device);
 uint16_t btd_device_get_vendor(struct btd_device *device);
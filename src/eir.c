@@ -124,16 +124,25 @@ static void eir_parse_uuid128(struct eir_data *eir, const uint8_t *data,
 	}
 }
 
-static char *name2utf8(const uint8_t *name, uint8_t len)
+static void name2utf8_buf(const uint8_t *name, uint8_t len, char *buf,
+								size_t size)
 {
-	char utf8_name[HCI_MAX_NAME_LENGTH + 2];
+	if (len > size - 2)
+		len = size - 2;
 
-	memset(utf8_name, 0, sizeof(utf8_name));
-	strncpy(utf8_name, (char *) name, len);
-	strtoutf8(utf8_name, len);
+	memset(buf, 0, size);
+	strncpy(buf, (char *) name, len);
+	strtoutf8(buf, len);
 
 	/* Remove leading and trailing whitespace characters */
-	g_strstrip(utf8_name);
+	g_strstrip(buf);
+}
+
+static char *name2utf8(const uint8_t *name, uint8_t len)
+{
+	char utf8_name[HCI_MAX_NAME_LENGTH + 2];
+
+	name2utf8_buf(name, len, utf8_name, sizeof(utf8_name));
 
 	return g_strdup(utf8_name);
 }
@@ -232,36 +241,61 @@ static void eir_parse_data(struct eir_data *eir, uint8_t type,
 		eir->rsi = true;
 }
 
-void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+void eir_iter_init(struct eir_iter *iter, const uint8_t *data, uint8_t len)
 {
-	uint16_t len = 0;
+	iter->data = data;
+	iter->len = data ? len : 0;
+	iter->offset = 0;
+}
 
-	eir->flags = 0;
-	eir->tx_power = 127;
+bool eir_iter_next(struct eir_iter *iter, uint8_t *type, const uint8_t **data,
+								uint8_t *len)
+{
+	const uint8_t *field;
+	uint8_t field_len;
 
-	/* No EIR data to parse */
-	if (eir_data == NULL)
-		return;
+	/* A field needs at least the length and type octets */
+	if (iter->offset + 1 >= iter->len)
+		return false;
 
-	while (len < eir_len - 1) {
-		uint8_t field_len = eir_data[0];
-		const uint8_t *data;
-		uint8_t data_len;
+	field = iter->data + iter->offset;
+	field_len = field[0];
 
-		/* Check for the end of EIR */
-		if (field_len == 0)
-			break;
+	/* Check for the end of EIR */
+	if (field_len == 0)
+		goto done;
 
-		len += field_len + 1;
+	/* Do not continue EIR Data parsing if got incorrect length */
+	if (iter->offset + field_len + 1 > iter->len)
+		goto done;
 
-		/* Do not continue EIR Data parsing if got incorrect length */
-		if (len > eir_len)
-			break;
+	iter->offset += field_len + 1;
+
+	*type = field[1];
+	*data = &field[2];
+	*len = field_len - 1;
+
+	return true;
+
+done:
+	iter->offset = iter->len;
+	return false;
+}
+
+void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
+{
+	struct eir_iter iter;
+	const uint8_t *data;
+	uint8_t data_len;
+	uint8_t type;
 
-		data = &eir_data[2];
-		data_len = field_len - 1;
+	eir->flags = 0;
+	eir->tx_power = 127;
 
-		switch (eir_data[1]) {
+	eir_iter_init(&iter, eir_data, eir_len);
+
+	while (eir_iter_next(&iter, &type, &data, &data_len)) {
+		switch (type) {
 		case EIR_UUID16_SOME:
 		case EIR_UUID16_ALL:
 			eir_parse_uuid16(eir, data, data_len);
@@ -293,7 +327,7 @@ void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
 			g_free(eir->name);
 
 			eir->name = name2utf8(data, data_len);
-			eir->name_complete = eir_data[1] != EIR_NAME_SHORT;
+			eir->name_complete = type != EIR_NAME_SHORT;
 			break;
 
 		case EIR_TX_POWER:
@@ -354,12 +388,189 @@ void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len)
 			break;
 
 		default:
-			eir_parse_data(eir, eir_data[1], data, data_len);
+			eir_parse_data(eir, type, data, data_len);
+			break;
+		}
+	}
+}
+
+void eir_view_init(struct eir_view *view, const uint8_t *data, uint8_t len)
+{
+	struct eir_iter iter;
+	const uint8_t *field;
+	uint8_t field_len;
+	uint8_t type;
+
+	memset(view, 0, sizeof(*view));
+	view->data = data;
+	view->len = len;
+	view->tx_power = 127;
+
+	eir_iter_init(&iter, data, len);
+
+	while (eir_iter_next(&iter, &type, &field, &field_len)) {
+		switch (type) {
+		case EIR_FLAGS:
+			if (field_len > 0)
+				view->flags = *field;
+			break;
+
+		case EIR_NAME_SHORT:
+		case EIR_NAME_COMPLETE:
+		case EIR_BC_NAME:
+			while (field_len > 0 && field[field_len - 1] == '\0')
+				field_len--;
+
+			view->name = field;
+			view->name_len = field_len;
+			view->name_complete = type != EIR_NAME_SHORT;
+			break;
+
+		case EIR_TX_POWER:
+			if (field_len > 0)
+				view->tx_power = (int8_t) field[0];
+			break;
+
+		case EIR_CSIP_RSI:
+			view->rsi = true;
 			break;
 		}
+	}
+}
+
+/* Returns the name in the same form as eir_parse, buf must be able to hold
+ * HCI_MAX_NAME_LENGTH + 2 bytes for the name not to be truncated.
+ */
+const char *eir_view_get_name(const struct eir_view *view, char *buf,
+								size_t size)
+{
+	if (!view->name || size < 2)
+		return NULL;
+
+	name2utf8_buf(view->name, view->name_len, buf, size);
+
+	return buf;
+}
+
+static bool eir_uuid_get(uint8_t type, const uint8_t *data, bt_uuid_t *uuid)
+{
+	uint128_t u128;
+	int k;
+
+	switch (type) {
+	case EIR_UUID16_SOME:
+	case EIR_UUID16_ALL:
+	case EIR_SVC_DATA16:
+		bt_uuid16_create(uuid, get_le16(data));
+		return true;
+	case EIR_UUID32_SOME:
+	case EIR_UUID32_ALL:
+	case EIR_SVC_DATA32:
+		bt_uuid32_create(uuid, get_le32(data));
+		return true;
+	case EIR_UUID128_SOME:
+	case EIR_UUID128_ALL:
+	case EIR_SVC_DATA128:
+		/* EIR data is Little Endian */
+		for (k = 0; k < 16; k++)
+			u128.data[k] = data[16 - k - 1];
+		bt_uuid128_create(uuid, u128);
+		return true;
+	}
+
+	return false;
+}
+
+static uint8_t eir_uuid_size(uint8_t type)
+{
+	switch (type) {
+	case EIR_UUID16_SOME:
+	case EIR_UUID16_ALL:
+		return 2;
+	case EIR_UUID32_SOME:
+	case EIR_UUID32_ALL:
+		return 4;
+	case EIR_UUID128_SOME:
+	case EIR_UUID128_ALL:
+		return 16;
+	}
+
+	return 0;
+}
+
+static uint8_t eir_sd_uuid_size(uint8_t type)
+{
+	switch (type) {
+	case EIR_SVC_DATA16:
+		return 2;
+	case EIR_SVC_DATA32:
+		return 4;
+	case EIR_SVC_DATA128:
+		return 16;
+	}
+
+	return 0;
+}
+
+/* Decodes the UUID lists one entry at a time, so nothing is allocated and
+ * decoding stops at the first match.
+ */
+bool eir_view_has_uuid(const struct eir_view *view, const char *uuid)
+{
+	struct eir_iter iter;
+	const uint8_t *data;
+	uint8_t len, size;
+	uint8_t type;
+	bt_uuid_t match, value;
+
+	if (bt_string_to_uuid(&match, uuid) < 0)
+		return false;
+
+	eir_iter_init(&iter, view->data, view->len);
+
+	while (eir_iter_next(&iter, &type, &data, &len)) {
+		size = eir_uuid_size(type);
+		if (!size)
+			continue;
+
+		for (; len >= size; len -= size, data += size) {
+			eir_uuid_get(type, data, &value);
+			if (!bt_uuid_cmp(&value, &match))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+bool eir_view_has_service_data(const struct eir_view *view, const char *uuid)
+{
+	struct eir_iter iter;
+	const uint8_t *data;
+	uint8_t len, size;
+	uint8_t type;
+	bt_uuid_t match, value;
+
+	if (bt_string_to_uuid(&match, uuid) < 0)
+		return false;
 
-		eir_data += field_len + 1;
+	eir_iter_init(&iter, view->data, view->len);
+
+	while (eir_iter_next(&iter, &type, &data, &len)) {
+		size = eir_sd_uuid_size(type);
+		if (!size)
+			continue;
+
+		/* Same limits as eir_parse so the results are consistent */
+		if (len < size || len > EIR_SD_MAX_LEN)
+			continue;
+
+		eir_uuid_get(type, data, &value);
+		if (!bt_uuid_cmp(&value, &match))
+			return true;
 	}
+
+	return false;
 }
 
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len)
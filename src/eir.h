@@ -93,6 +93,35 @@ struct eir_data {
 	GSList *data_list;
 };
 
+/* Iterates over the fields of raw EIR/AD data without copying them */
+struct eir_iter {
+	const uint8_t *data;
+	uint8_t len;
+	uint8_t offset;
+};
+
+/* Fields needed to filter a report, pointing into the raw data */
+struct eir_view {
+	const uint8_t *data;
+	uint8_t len;
+	unsigned int flags;
+	const uint8_t *name;
+	uint8_t name_len;
+	bool name_complete;
+	bool rsi;
+	int8_t tx_power;
+};
+
+void eir_iter_init(struct eir_iter *iter, const uint8_t *data, uint8_t len);
+bool eir_iter_next(struct eir_iter *iter, uint8_t *type, const uint8_t **data,
+								uint8_t *len);
+
+void eir_view_init(struct eir_view *view, const uint8_t *data, uint8_t len);
+const char *eir_view_get_name(const struct eir_view *view, char *buf,
+								size_t size);
+bool eir_view_has_uuid(const struct eir_view *view, const char *uuid);
+bool eir_view_has_service_data(const struct eir_view *view, const char *uuid);
+
 void eir_data_free(struct eir_data *eir);
 void eir_parse(struct eir_data *eir, const uint8_t *eir_data, uint8_t eir_len);
 int eir_parse_oob(struct eir_data *eir, uint8_t *eir_data, uint16_t eir_len);
@@ -56,6 +56,7 @@
 #include "profile.h"
 
 #define BLUEZ_NAME "org.bluez"
+#define OBJECT_MANAGER_INTERFACE "org.bluez.ObjectManager1"
 
 #define DEFAULT_PAIRABLE_TIMEOUT           0 /* disabled */
 #define DEFAULT_DISCOVERABLE_TIMEOUT     180 /* 3 minutes */
@@ -86,12 +87,16 @@ static const char *supported_options[] = {
 	"Privacy",
 	"JustWorksRepairing",
 	"TemporaryTimeout",
+	"MaxTemporaryDevices",
 	"RefreshDiscovery",
 	"Experimental",
 	"Testing",
 	"KernelExperimental",
 	"RemoteNameRequestRetryDelay",
 	"FilterDiscoverable",
+	"PropertiesChangedWindow",
+	"PropertiesChangedInterval",
+	"PropertiesSnapshot",
 	NULL
 };
 
@@ -1052,6 +1057,9 @@ static void parse_general(GKeyFile *config)
 	parse_config_u32(config, "General", "TemporaryTimeout",
 						&btd_opts.tmpto,
 						0, UINT32_MAX);
+	parse_config_u32(config, "General", "MaxTemporaryDevices",
+						&btd_opts.tmpmax,
+						0, UINT32_MAX);
 	parse_config_bool(config, "General", "RefreshDiscovery",
 						&btd_opts.refresh_discovery);
 	parse_secure_conns(config);
@@ -1065,6 +1073,14 @@ static void parse_general(GKeyFile *config)
 					0, UINT32_MAX);
 	parse_config_bool(config, "General", "FilterDiscoverable",
 						&btd_opts.filter_discoverable);
+	parse_config_u32(config, "General", "PropertiesChangedWindow",
+						&btd_opts.prop_window,
+						0, UINT16_MAX);
+	parse_config_u32(config, "General", "PropertiesChangedInterval",
+						&btd_opts.prop_interval,
+						0, UINT16_MAX);
+	parse_config_bool(config, "General", "PropertiesSnapshot",
+						&btd_opts.prop_snapshot);
 }
 
 static void parse_gatt_cache(GKeyFile *config)
@@ -1347,6 +1363,20 @@ static void free_options(void)
 	option_configfile = NULL;
 }
 
+static DBusMessage *get_managed_objects_filtered(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	return g_dbus_get_managed_objects_filtered(conn, msg);
+}
+
+static const GDBusMethodTable manager_methods[] = {
+	{ GDBUS_EXPERIMENTAL_METHOD("GetManagedObjectsFiltered",
+		GDBUS_ARGS({ "filter", "a{sv}" }),
+		GDBUS_ARGS({ "objects", "a{oa{sa{sv}}}" }, { "next", "o" }),
+		get_managed_objects_filtered) },
+	{ }
+};
+
 static void disconnect_dbus(void)
 {
 	DBusConnection *conn = btd_get_dbus_connection();
@@ -1354,6 +1384,7 @@ static void disconnect_dbus(void)
 	if (!conn || !dbus_connection_get_is_connected(conn))
 		return;
 
+	g_dbus_unregister_interface(conn, "/", OBJECT_MANAGER_INTERFACE);
 	g_dbus_detach_object_manager(conn);
 	set_dbus_connection(NULL);
 
@@ -1392,6 +1423,8 @@ static int connect_dbus(void)
 
 	g_dbus_set_disconnect_function(conn, disconnected_dbus, NULL, NULL);
 	g_dbus_attach_object_manager(conn);
+	g_dbus_register_interface(conn, "/", OBJECT_MANAGER_INTERFACE,
+					manager_methods, NULL, NULL, NULL, NULL);
 	g_dbus_set_debug(dbus_debug, NULL, NULL);
 
 	return 0;
@@ -1435,6 +1468,17 @@ static GOptionEntry options[] = {
 	{ NULL },
 };
 
+static void log_property_stats(void)
+{
+	GDBusPropertyStats stats;
+
+	g_dbus_get_property_stats(&stats);
+
+	DBG("PropertiesChanged: %lu changes, %lu merged, %lu deferred, "
+			"%lu signals", stats.changed, stats.merged,
+			stats.deferred, stats.signals);
+}
+
 int main(int argc, char *argv[])
 {
 	GOptionContext *context;
@@ -1482,18 +1526,24 @@ int main(int argc, char *argv[])
 
 	parse_config(main_conf);
 
-	if (connect_dbus() < 0) {
-		error("Unable to get on D-Bus");
-		exit(1);
-	}
-
+	/* Set before connecting so experimental interfaces register */
 	if (btd_opts.experimental)
 		gdbus_flags = G_DBUS_FLAG_ENABLE_EXPERIMENTAL;
 
 	if (btd_opts.testing)
 		gdbus_flags |= G_DBUS_FLAG_ENABLE_TESTING;
 
+	if (btd_opts.prop_snapshot)
+		gdbus_flags |= G_DBUS_FLAG_PROPERTY_SNAPSHOT;
+
 	g_dbus_set_flags(gdbus_flags);
+	g_dbus_set_property_coalescing(btd_opts.prop_window,
+						btd_opts.prop_interval);
+
+	if (connect_dbus() < 0) {
+		error("Unable to get on D-Bus");
+		exit(1);
+	}
 
 	if (adapter_init() < 0) {
 		error("Adapter handling initialization failed");
@@ -1540,6 +1590,8 @@ int main(int argc, char *argv[])
 
 	mainloop_sd_notify("STATUS=Quitting");
 
+	log_property_stats();
+
 	plugin_cleanup();
 
 	btd_profile_cleanup();
@@ -1477,3 +1477,310 @@ struct bt_ad_pattern *bt_ad_pattern_match(struct bt_ad *ad,
 
 	return info.matched_pattern;
 }
+
+/*
+ * Patterns are compiled into a prefix tree per AD type and offset so a
+ * report is only compared once against patterns sharing the same prefix.
+ */
+struct pattern_node {
+	uint8_t byte;
+	struct pattern_node *next;	/* Siblings sorted by byte */
+	struct pattern_node *child;
+	struct queue *entries;		/* Entries with a pattern ending here */
+};
+
+struct pattern_root {
+	uint8_t offset;
+	struct pattern_node *child;
+	struct pattern_root *next;
+};
+
+struct matcher_entry {
+	void *data;
+	unsigned int match_id;
+};
+
+struct bt_ad_matcher {
+	struct pattern_root *roots[UINT8_MAX + 1];
+	struct queue *entries;
+	unsigned int match_id;
+};
+
+struct bt_ad_matcher *bt_ad_matcher_new(void)
+{
+	struct bt_ad_matcher *matcher;
+
+	matcher = new0(struct bt_ad_matcher, 1);
+	matcher->entries = queue_new();
+
+	return matcher;
+}
+
+static void pattern_nodes_free(struct pattern_node *node)
+{
+	while (node) {
+		struct pattern_node *next = node->next;
+
+		pattern_nodes_free(node->child);
+		queue_destroy(node->entries, NULL);
+		free(node);
+
+		node = next;
+	}
+}
+
+void bt_ad_matcher_free(struct bt_ad_matcher *matcher)
+{
+	unsigned int i;
+
+	if (!matcher)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(matcher->roots); i++) {
+		while (matcher->roots[i]) {
+			struct pattern_root *root = matcher->roots[i];
+
+			matcher->roots[i] = root->next;
+			pattern_nodes_free(root->child);
+			free(root);
+		}
+	}
+
+	queue_destroy(matcher->entries, free);
+	free(matcher);
+}
+
+/* Any kind of service data is matched against service data patterns */
+static uint8_t matcher_type(uint8_t type)
+{
+	switch (type) {
+	case BT_AD_SERVICE_DATA32:
+	case BT_AD_SERVICE_DATA128:
+		return BT_AD_SERVICE_DATA16;
+	}
+
+	return type;
+}
+
+static bool match_entry_data(const void *data, const void *match_data)
+{
+	const struct matcher_entry *entry = data;
+
+	return entry->data == match_data;
+}
+
+static struct pattern_node *pattern_node_get(struct pattern_node **list,
+								uint8_t byte)
+{
+	struct pattern_node *node;
+
+	while (*list && (*list)->byte < byte)
+		list = &(*list)->next;
+
+	if (*list && (*list)->byte == byte)
+		return *list;
+
+	node = new0(struct pattern_node, 1);
+	node->byte = byte;
+	node->next = *list;
+	*list = node;
+
+	return node;
+}
+
+bool bt_ad_matcher_add(struct bt_ad_matcher *matcher,
+				const struct bt_ad_pattern *pattern, void *data)
+{
+	struct pattern_root **root;
+	struct pattern_node **list;
+	struct pattern_node *node = NULL;
+	struct matcher_entry *entry;
+	uint8_t i;
+
+	if (!matcher || !pattern || !pattern->len ||
+					pattern->len > BT_AD_MAX_DATA_LEN)
+		return false;
+
+	entry = queue_find(matcher->entries, match_entry_data, data);
+	if (!entry) {
+		entry = new0(struct matcher_entry, 1);
+		entry->data = data;
+		queue_push_tail(matcher->entries, entry);
+	}
+
+	root = &matcher->roots[matcher_type(pattern->type)];
+	while (*root && (*root)->offset != pattern->offset)
+		root = &(*root)->next;
+
+	if (!*root) {
+		*root = new0(struct pattern_root, 1);
+		(*root)->offset = pattern->offset;
+	}
+
+	list = &(*root)->child;
+
+	for (i = 0; i < pattern->len; i++) {
+		node = pattern_node_get(list, pattern->data[i]);
+		list = &node->child;
+	}
+
+	if (!node->entries)
+		node->entries = queue_new();
+
+	if (!queue_find(node->entries, NULL, entry))
+		queue_push_tail(node->entries, entry);
+
+	return true;
+}
+
+static void pattern_nodes_prune(struct pattern_node **list,
+						struct matcher_entry *entry)
+{
+	while (*list) {
+		struct pattern_node *node = *list;
+
+		pattern_nodes_prune(&node->child, entry);
+
+		if (node->entries && queue_remove(node->entries, entry) &&
+					queue_isempty(node->entries)) {
+			queue_destroy(node->entries, NULL);
+			node->entries = NULL;
+		}
+
+		if (!node->child && !node->entries) {
+			*list = node->next;
+			free(node);
+			continue;
+		}
+
+		list = &node->next;
+	}
+}
+
+void bt_ad_matcher_remove(struct bt_ad_matcher *matcher, void *data)
+{
+	struct matcher_entry *entry;
+	unsigned int i;
+
+	if (!matcher)
+		return;
+
+	entry = queue_remove_if(matcher->entries, match_entry_data, data);
+	if (!entry)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(matcher->roots); i++) {
+		struct pattern_root **root = &matcher->roots[i];
+
+		while (*root) {
+			struct pattern_root *r = *root;
+
+			pattern_nodes_prune(&r->child, entry);
+
+			if (!r->child) {
+				*root = r->next;
+				free(r);
+				continue;
+			}
+
+			root = &r->next;
+		}
+	}
+
+	free(entry);
+}
+
+struct matcher_match_info {
+	struct bt_ad_matcher *matcher;
+	bt_ad_func_t func;
+	void *user_data;
+};
+
+static void matcher_match_data(struct matcher_match_info *info, uint8_t type,
+					const uint8_t *data, size_t len)
+{
+	struct pattern_root *root;
+
+	for (root = info->matcher->roots[type]; root; root = root->next) {
+		struct pattern_node *node = root->child;
+		size_t i;
+
+		for (i = root->offset; i < len && node; i++) {
+			const struct queue_entry *e;
+
+			while (node && node->byte < data[i])
+				node = node->next;
+
+			if (!node || node->byte != data[i])
+				break;
+
+			for (e = queue_get_entries(node->entries); e;
+							e = e->next) {
+				struct matcher_entry *entry = e->data;
+
+				/* Report each entry only once per AD */
+				if (entry->match_id == info->matcher->match_id)
+					continue;
+
+				entry->match_id = info->matcher->match_id;
+				info->func(entry->data, info->user_data);
+			}
+
+			node = node->child;
+		}
+	}
+}
+
+void bt_ad_matcher_match(struct bt_ad_matcher *matcher, struct bt_ad *ad,
+					bt_ad_func_t func, void *user_data)
+{
+	struct matcher_match_info info;
+	const struct queue_entry *e;
+
+	if (!matcher || !ad || !func)
+		return;
+
+	/* Entries start with 0 which must never be a valid match id */
+	if (!++matcher->match_id)
+		matcher->match_id = 1;
+
+	info.matcher = matcher;
+	info.func = func;
+	info.user_data = user_data;
+
+	if (matcher->roots[BT_AD_MANUFACTURER_DATA]) {
+		for (e = queue_get_entries(ad->manufacturer_data); e;
+							e = e->next) {
+			struct bt_ad_manufacturer_data *md = e->data;
+			uint8_t all_data[BT_EA_MAX_DATA_LEN];
+			size_t len;
+
+			/* Take the manufacturer ID into account */
+			len = md->len;
+			if (len > sizeof(all_data) - 2)
+				len = sizeof(all_data) - 2;
+
+			memcpy(&all_data[0], &md->manufacturer_id, 2);
+			memcpy(&all_data[2], md->data, len);
+
+			matcher_match_data(&info, BT_AD_MANUFACTURER_DATA,
+							all_data, len + 2);
+		}
+	}
+
+	if (matcher->roots[BT_AD_SERVICE_DATA16]) {
+		for (e = queue_get_entries(ad->service_data); e; e = e->next) {
+			struct bt_ad_service_data *sd = e->data;
+
+			matcher_match_data(&info, BT_AD_SERVICE_DATA16,
+							sd->data, sd->len);
+		}
+	}
+
+	for (e = queue_get_entries(ad->data); e; e = e->next) {
+		struct bt_ad_data *d = e->data;
+
+		if (matcher->roots[d->type])
+			matcher_match_data(&info, d->type, d->data, d->len);
+	}
+}
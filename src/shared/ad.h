@@ -189,3 +189,13 @@ struct bt_ad_pattern *bt_ad_pattern_new(uint8_t type, size_t offset,
 
 struct bt_ad_pattern *bt_ad_pattern_match(struct bt_ad *ad,
 							struct queue *patterns);
+
+struct bt_ad_matcher;
+
+struct bt_ad_matcher *bt_ad_matcher_new(void);
+void bt_ad_matcher_free(struct bt_ad_matcher *matcher);
+bool bt_ad_matcher_add(struct bt_ad_matcher *matcher,
+				const struct bt_ad_pattern *pattern, void *data);
+void bt_ad_matcher_remove(struct bt_ad_matcher *matcher, void *data);
+void bt_ad_matcher_match(struct bt_ad_matcher *matcher, struct bt_ad *ad,
+					bt_ad_func_t func, void *user_data);
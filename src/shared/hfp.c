@@ -45,8 +45,10 @@ struct hfp_gw {
 	struct io *io;
 	struct ringbuf *read_buf;
 	struct ringbuf *write_buf;
-	struct queue *cmd_handlers;
+	char *line_buf;
+	struct prefix_node *cmd_handlers;
 	bool writer_active;
+	bool processing;
 	bool result_pending;
 	hfp_command_func_t command_callback;
 	hfp_destroy_func_t command_destroy;
@@ -63,6 +65,17 @@ struct hfp_gw {
 	bool destroyed;
 };
 
+/*
+ * Handlers are kept in a prefix tree, so looking up a command or event
+ * compares each character of its prefix once.
+ */
+struct prefix_node {
+	char c;
+	void *handler;
+	struct prefix_node *child;
+	struct prefix_node *next;
+};
+
 typedef void (*ciev_func_t)(uint8_t val, void *user_data);
 
 struct indicator {
@@ -81,10 +94,12 @@ struct hfp_hf {
 	struct ringbuf *read_buf;
 	struct ringbuf *write_buf;
 
+	char *line_buf;
+
 	bool writer_active;
 	struct queue *cmd_queue;
 
-	struct queue *event_handlers;
+	struct prefix_node *event_handlers;
 
 	hfp_debug_func_t debug_callback;
 	hfp_destroy_func_t debug_destroy;
@@ -177,17 +192,134 @@ static void destroy_cmd_handler(void *data)
 	free(handler);
 }
 
-static bool match_handler_prefix(const void *a, const void *b)
+static struct prefix_node *prefix_node_get(struct prefix_node **list, char c,
+								bool create)
+{
+	struct prefix_node *node;
+
+	for (node = *list; node; node = node->next) {
+		if (node->c == c)
+			return node;
+	}
+
+	if (!create)
+		return NULL;
+
+	node = new0(struct prefix_node, 1);
+	node->c = c;
+	node->next = *list;
+	*list = node;
+
+	return node;
+}
+
+static bool prefix_tree_add(struct prefix_node **root, const char *prefix,
+								void *handler)
 {
-	const struct cmd_handler *handler = a;
-	const char *prefix = b;
+	struct prefix_node *node = NULL;
+	struct prefix_node **list = root;
 
-	if (strcmp(handler->prefix, prefix) != 0)
+	if (!prefix[0])
 		return false;
 
+	for (; *prefix; prefix++) {
+		node = prefix_node_get(list, *prefix, true);
+		list = &node->child;
+	}
+
+	if (node->handler)
+		return false;
+
+	node->handler = handler;
+
 	return true;
 }
 
+/* Commands and events are matched ignoring the case of the received prefix */
+static void *prefix_tree_find(struct prefix_node *list, const char *prefix,
+								size_t len)
+{
+	struct prefix_node *node = NULL;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		node = prefix_node_get(&list, toupper(prefix[i]), false);
+		if (!node)
+			return NULL;
+
+		list = node->child;
+	}
+
+	return node ? node->handler : NULL;
+}
+
+static void *prefix_tree_remove(struct prefix_node **list, const char *prefix)
+{
+	struct prefix_node *node, **pos;
+	void *handler;
+
+	for (pos = list; *pos; pos = &(*pos)->next) {
+		if ((*pos)->c == *prefix)
+			break;
+	}
+
+	node = *pos;
+	if (!node)
+		return NULL;
+
+	if (prefix[1]) {
+		handler = prefix_tree_remove(&node->child, prefix + 1);
+	} else {
+		handler = node->handler;
+		node->handler = NULL;
+	}
+
+	/* Prune nodes which no longer lead to a handler */
+	if (!node->handler && !node->child) {
+		*pos = node->next;
+		free(node);
+	}
+
+	return handler;
+}
+
+static void prefix_tree_free(struct prefix_node *node,
+						void (*destroy)(void *data))
+{
+	while (node) {
+		struct prefix_node *next = node->next;
+
+		prefix_tree_free(node->child, destroy);
+
+		if (node->handler)
+			destroy(node->handler);
+
+		free(node);
+		node = next;
+	}
+}
+
+/*
+ * Lines are parsed in place in the ring buffer. Only a line wrapping around
+ * its end is copied, into a buffer allocated once per connection.
+ */
+static char *join_wrapped_line(char **line_buf, struct ringbuf *buf,
+					const char *str, size_t len,
+					const char *str2, size_t len2)
+{
+	if (!*line_buf) {
+		*line_buf = malloc(ringbuf_capacity(buf) + 1);
+		if (!*line_buf)
+			return NULL;
+	}
+
+	memcpy(*line_buf, str, len);
+	memcpy(*line_buf + len, str2, len2);
+	(*line_buf)[len + len2] = '\0';
+
+	return *line_buf;
+}
+
 static void write_watch_destroy(void *user_data)
 {
 	struct hfp_gw *hfp = user_data;
@@ -248,17 +380,16 @@ static bool handle_at_command(struct hfp_gw *hfp, const char *data)
 	const char *separators = ";?=\0";
 	struct hfp_context context;
 	enum hfp_gw_cmd_type type;
-	char lookup_prefix[18];
-	uint8_t pref_len = 0;
+	size_t pref_len;
 	const char *prefix;
-	int i;
 
 	context.offset = 0;
 	context.data = data;
 
 	skip_whitespace(&context);
 
-	if (strlen(data + context.offset) < 3)
+	prefix = data + context.offset;
+	if (!prefix[0] || !prefix[1] || !prefix[2])
 		return false;
 
 	if (strncmp(data + context.offset, "AT", 2))
@@ -269,20 +400,16 @@ static bool handle_at_command(struct hfp_gw *hfp, const char *data)
 	prefix = data + context.offset;
 
 	if (isalpha(prefix[0])) {
-		lookup_prefix[pref_len++] = toupper(prefix[0]);
+		pref_len = 1;
 	} else {
 		pref_len = strcspn(prefix, separators);
 		if (pref_len > 17 || pref_len < 2)
 			return false;
-
-		for (i = 0; i < pref_len; i++)
-			lookup_prefix[i] = toupper(prefix[i]);
 	}
 
-	lookup_prefix[pref_len] = '\0';
 	context.offset += pref_len;
 
-	if (lookup_prefix[0] == 'D') {
+	if (toupper(prefix[0]) == 'D') {
 		type = HFP_GW_CMD_TYPE_SET;
 		goto done;
 	}
@@ -308,8 +435,7 @@ static bool handle_at_command(struct hfp_gw *hfp, const char *data)
 
 done:
 
-	handler = queue_find(hfp->cmd_handlers, match_handler_prefix,
-								lookup_prefix);
+	handler = prefix_tree_find(hfp->cmd_handlers, prefix, pref_len);
 	if (!handler) {
 		handle_unknown_at_command(hfp, data);
 		return true;
@@ -533,17 +659,27 @@ failed:
 static void process_input(struct hfp_gw *hfp)
 {
 	char *str, *ptr;
-	size_t len, count;
-	bool free_ptr = false;
+	size_t len, count, total;
 	bool read_again;
 
+	/* Handlers replying right away must not recurse into here */
+	if (hfp->processing)
+		return;
+
+	hfp->processing = true;
+
 	do {
 		str = ringbuf_peek(hfp->read_buf, 0, &len);
 		if (!str)
-			return;
+			break;
+
+		total = ringbuf_len(hfp->read_buf);
 
 		ptr = memchr(str, '\r', len);
-		if (!ptr) {
+		if (ptr) {
+			count = ptr - str;
+			*ptr = '\0';
+		} else {
 			char *str2;
 			size_t len2;
 
@@ -551,34 +687,31 @@ static void process_input(struct hfp_gw *hfp)
 			 * If there is no more data in ringbuffer,
 			 * it's just an incomplete command.
 			 */
-			if (len == ringbuf_len(hfp->read_buf))
-				return;
+			if (len == total)
+				break;
 
 			str2 = ringbuf_peek(hfp->read_buf, len, &len2);
-			if (!str2)
-				return;
+			if (len2 > total - len)
+				len2 = total - len;
 
 			ptr = memchr(str2, '\r', len2);
 			if (!ptr)
-				return;
-
-			*ptr = '\0';
-
-			count = len2 + len;
-			ptr = malloc(count);
-			if (!ptr)
-				return;
+				break;
 
-			memcpy(ptr, str, len);
-			memcpy(ptr + len, str2, len2);
+			str = join_wrapped_line(&hfp->line_buf, hfp->read_buf,
+						str, len, str2, ptr - str2);
+			if (!str)
+				break;
 
-			free_ptr = true;
-			str = ptr;
-		} else {
-			count = ptr - str;
-			*ptr = '\0';
+			count = len + (ptr - str2);
 		}
 
+		/*
+		 * The line stays valid until new data is read, so it can be
+		 * drained before being handled.
+		 */
+		ringbuf_drain(hfp->read_buf, count + 1);
+
 		if (!handle_at_command(hfp, str))
 			/*
 			 * Command is not handled that means that was some
@@ -591,17 +724,13 @@ static void process_input(struct hfp_gw *hfp)
 			 * Command has been handled. If we are waiting for a
 			 * result from upper layer, we can stop reading. If we
 			 * already reply i.e. ERROR on unknown command, then we
-			 * can keep reading ring buffer. Actually ring buffer
-			 * should be empty but lets just look there.
+			 * can keep reading ring buffer.
 			 */
 			read_again = !hfp->result_pending;
 
-		ringbuf_drain(hfp->read_buf, count + 1);
-
-		if (free_ptr)
-			free(ptr);
-
 	} while (read_again);
+
+	hfp->processing = false;
 }
 
 static void read_watch_destroy(void *user_data)
@@ -657,11 +786,8 @@ struct hfp_gw *hfp_gw_new(int fd)
 		return NULL;
 	}
 
-	hfp->cmd_handlers = queue_new();
-
 	if (!io_set_read_handler(hfp->io, can_read_data, hfp,
 							read_watch_destroy)) {
-		queue_destroy(hfp->cmd_handlers, destroy_cmd_handler);
 		io_destroy(hfp->io);
 		ringbuf_free(hfp->write_buf);
 		ringbuf_free(hfp->read_buf);
@@ -713,7 +839,10 @@ void hfp_gw_unref(struct hfp_gw *hfp)
 	ringbuf_free(hfp->write_buf);
 	hfp->write_buf = NULL;
 
-	queue_destroy(hfp->cmd_handlers, destroy_cmd_handler);
+	free(hfp->line_buf);
+	hfp->line_buf = NULL;
+
+	prefix_tree_free(hfp->cmd_handlers, destroy_cmd_handler);
 	hfp->cmd_handlers = NULL;
 
 	if (!hfp->in_disconnect) {
@@ -901,30 +1030,21 @@ bool hfp_gw_register(struct hfp_gw *hfp, hfp_result_func_t callback,
 		return false;
 	}
 
-	if (queue_find(hfp->cmd_handlers, match_handler_prefix,
-							handler->prefix)) {
+	if (!prefix_tree_add(&hfp->cmd_handlers, handler->prefix, handler)) {
 		destroy_cmd_handler(handler);
 		return false;
 	}
 
 	handler->destroy = destroy;
 
-	return queue_push_tail(hfp->cmd_handlers, handler);
+	return true;
 }
 
 bool hfp_gw_unregister(struct hfp_gw *hfp, const char *prefix)
 {
 	struct cmd_handler *handler;
-	char *lookup_prefix;
-
-	lookup_prefix = strdup(prefix);
-	if (!lookup_prefix)
-		return false;
-
-	handler = queue_remove_if(hfp->cmd_handlers, match_handler_prefix,
-								lookup_prefix);
-	free(lookup_prefix);
 
+	handler = prefix_tree_remove(&hfp->cmd_handlers, prefix);
 	if (!handler)
 		return false;
 
@@ -992,17 +1112,6 @@ bool hfp_gw_disconnect(struct hfp_gw *hfp)
 	return io_shutdown(hfp->io);
 }
 
-static bool match_handler_event_prefix(const void *a, const void *b)
-{
-	const struct event_handler *handler = a;
-	const char *prefix = b;
-
-	if (strcmp(handler->prefix, prefix) != 0)
-		return false;
-
-	return true;
-}
-
 static void destroy_event_handler(void *data)
 {
 	struct event_handler *handler = data;
@@ -1173,8 +1282,8 @@ static void hf_call_prefix_handler(struct hfp_hf *hfp, const char *data)
 		return;
 	}
 
-	handler = queue_find(hfp->event_handlers, match_handler_event_prefix,
-								lookup_prefix);
+	handler = prefix_tree_find(hfp->event_handlers, lookup_prefix,
+								pref_len);
 	if (!handler)
 		return;
 
@@ -1212,77 +1321,54 @@ static char *find_cr_lf(char *str, size_t len)
 
 static void hf_process_input(struct hfp_hf *hfp)
 {
-	char *str, *ptr, *str2, *tmp;
-	size_t len, count, offset, len2;
-	bool free_tmp = false;
+	char *str, *ptr, *str2;
+	size_t len, len2, count, total;
 
-	str = ringbuf_peek(hfp->read_buf, 0, &len);
-	if (!str)
-		return;
-
-	offset = 0;
+	while ((total = ringbuf_len(hfp->read_buf))) {
+		str = ringbuf_peek(hfp->read_buf, 0, &len);
+		if (!str)
+			return;
 
-	ptr = find_cr_lf(str, len);
-	while (ptr) {
-		count = ptr - (str + offset);
-		if (count == 0) {
-			/* 2 is for <cr><lf> */
-			offset += 2;
-		} else {
+		ptr = find_cr_lf(str, len);
+		if (ptr) {
+			count = ptr - str;
 			*ptr = '\0';
-			hf_call_prefix_handler(hfp, str + offset);
-			offset += count + 2;
+			goto handle;
 		}
 
-		ptr = find_cr_lf(str + offset, len - offset);
-	}
-
-	/*
-	 * Just check if there is no wrapped data in ring buffer.
-	 * Should not happen too often
-	 */
-	if (len == ringbuf_len(hfp->read_buf))
-		goto done;
+		/* Just check if there is no wrapped data in ring buffer */
+		if (len == total)
+			return;
 
-	str2 = ringbuf_peek(hfp->read_buf, len, &len2);
-	if (!str2)
-		goto done;
+		str2 = ringbuf_peek(hfp->read_buf, len, &len2);
+		if (len2 > total - len)
+			len2 = total - len;
 
-	ptr = find_cr_lf(str2, len2);
-	if (!ptr) {
 		/* Might happen that we wrap between \r and \n */
-		ptr = memchr(str2, '\n', len2);
-		if (!ptr)
-			goto done;
-	}
+		if (str[len - 1] == '\r' && str2[0] == '\n') {
+			count = len - 1;
+			str[count] = '\0';
+			goto handle;
+		}
 
-	count = ptr - str2;
+		ptr = find_cr_lf(str2, len2);
+		if (!ptr)
+			return;
 
-	if (count) {
-		*ptr = '\0';
+		str = join_wrapped_line(&hfp->line_buf, hfp->read_buf,
+						str, len, str2, ptr - str2);
+		if (!str)
+			return;
 
-		tmp = malloc(len + count);
-		if (!tmp)
-			goto done;
+		count = len + (ptr - str2);
 
-		/* "str" here is not a string so we need to use memcpy */
-		memcpy(tmp, str, len);
-		memcpy(tmp + len, str2, count);
+handle:
+		/* 2 is for <cr><lf>, the line stays valid until next read */
+		ringbuf_drain(hfp->read_buf, count + 2);
 
-		free_tmp = true;
-	} else {
-		str[len-1] = '\0';
-		tmp = str;
+		if (count)
+			hf_call_prefix_handler(hfp, str);
 	}
-
-	hf_call_prefix_handler(hfp, tmp);
-	offset += count;
-
-done:
-	ringbuf_drain(hfp->read_buf, offset);
-
-	if (free_tmp)
-		free(tmp);
 }
 
 static bool hf_can_read_data(struct io *io, void *user_data)
@@ -1331,7 +1417,6 @@ struct hfp_hf *hfp_hf_new(int fd)
 		return NULL;
 	}
 
-	hfp->event_handlers = queue_new();
 	hfp->cmd_queue = queue_new();
 	hfp->calls = queue_new();
 	hfp->updated_calls = queue_new();
@@ -1339,8 +1424,9 @@ struct hfp_hf *hfp_hf_new(int fd)
 
 	if (!io_set_read_handler(hfp->io, hf_can_read_data, hfp,
 							read_watch_destroy)) {
-		queue_destroy(hfp->event_handlers,
-						destroy_event_handler);
+		queue_destroy(hfp->cmd_queue, NULL);
+		queue_destroy(hfp->calls, NULL);
+		queue_destroy(hfp->updated_calls, NULL);
 		io_destroy(hfp->io);
 		ringbuf_free(hfp->write_buf);
 		ringbuf_free(hfp->read_buf);
@@ -1399,7 +1485,10 @@ void hfp_hf_unref(struct hfp_hf *hfp)
 	ringbuf_free(hfp->write_buf);
 	hfp->write_buf = NULL;
 
-	queue_destroy(hfp->event_handlers, destroy_event_handler);
+	free(hfp->line_buf);
+	hfp->line_buf = NULL;
+
+	prefix_tree_free(hfp->event_handlers, destroy_event_handler);
 	hfp->event_handlers = NULL;
 
 	queue_destroy(hfp->cmd_queue, free);
@@ -1536,26 +1625,21 @@ bool hfp_hf_register(struct hfp_hf *hfp, hfp_hf_result_func_t callback,
 		return false;
 	}
 
-	if (queue_find(hfp->event_handlers, match_handler_event_prefix,
-							handler->prefix)) {
+	if (!prefix_tree_add(&hfp->event_handlers, handler->prefix, handler)) {
 		destroy_event_handler(handler);
 		return false;
 	}
 
 	handler->destroy = destroy;
 
-	return queue_push_tail(hfp->event_handlers, handler);
+	return true;
 }
 
 bool hfp_hf_unregister(struct hfp_hf *hfp, const char *prefix)
 {
-	struct cmd_handler *handler;
-
-	/* Cast to void as queue_remove needs that */
-	handler = queue_remove_if(hfp->event_handlers,
-						match_handler_event_prefix,
-						(void *) prefix);
+	struct event_handler *handler;
 
+	handler = prefix_tree_remove(&hfp->event_handlers, prefix);
 	if (!handler)
 		return false;
 
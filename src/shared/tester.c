@@ -68,6 +68,34 @@ enum test_result {
 	TEST_RESULT_TIMED_OUT,
 };
 
+struct test_perf {
+	unsigned int warmup;
+	unsigned int repeat;
+	unsigned int iteration;
+	gdouble span_start;
+	gdouble span_end;
+	bool span_set;
+	double value;
+	bool value_set;
+	const char *unit;
+	bool higher_better;
+	double *samples;
+	unsigned int count;
+	double mean;
+	double p50;
+	double p99;
+	double min;
+	double max;
+	double baseline;
+	bool has_baseline;
+	bool regressed;
+};
+
+struct perf_baseline {
+	char *name;
+	double value;
+};
+
 enum test_stage {
 	TEST_STAGE_INVALID,
 	TEST_STAGE_PRE_SETUP,
@@ -97,6 +125,7 @@ struct test_case {
 	unsigned int teardown_id;
 	tester_destroy_func_t destroy;
 	void *user_data;
+	struct test_perf *perf;
 };
 
 static char *tester_name;
@@ -112,6 +141,14 @@ static gboolean option_monitor = FALSE;
 static gboolean option_list = FALSE;
 static const char *option_prefix = NULL;
 static const char *option_string = NULL;
+static gint option_repeat = 0;
+static gint option_warmup = -1;
+static const char *option_baseline = NULL;
+static const char *option_save_baseline = NULL;
+static gdouble option_tolerance = 10.0;
+static const char *option_json = NULL;
+
+static GList *baseline_list;
 
 struct monitor_hdr {
 	uint16_t opcode;
@@ -139,6 +176,11 @@ static void test_destroy(gpointer data)
 	if (test->destroy)
 		test->destroy(test->user_data);
 
+	if (test->perf) {
+		free(test->perf->samples);
+		free(test->perf);
+	}
+
 	free(test->name);
 	free(test);
 }
@@ -271,14 +313,38 @@ static void default_post_teardown(const void *test_data)
 	tester_post_teardown_complete();
 }
 
-void tester_add_full(const char *name, const void *test_data,
+static struct test_perf *test_perf_new(unsigned int warmup,
+							unsigned int repeat)
+{
+	struct test_perf *perf;
+
+	if (option_repeat > 0)
+		repeat = option_repeat;
+
+	if (option_warmup >= 0)
+		warmup = option_warmup;
+
+	if (!repeat)
+		return NULL;
+
+	perf = new0(struct test_perf, 1);
+	perf->warmup = warmup;
+	perf->repeat = repeat;
+	perf->unit = "ms";
+	perf->samples = new0(double, repeat);
+
+	return perf;
+}
+
+void tester_add_perf_full(const char *name, const void *test_data,
 				tester_data_func_t pre_setup_func,
 				tester_data_func_t setup_func,
 				tester_data_func_t test_func,
 				tester_data_func_t teardown_func,
 				tester_data_func_t post_teardown_func,
 				unsigned int timeout,
-				void *user_data, tester_destroy_func_t destroy)
+				void *user_data, tester_destroy_func_t destroy,
+				unsigned int warmup, unsigned int repeat)
 {
 	struct test_case *test;
 
@@ -338,9 +404,25 @@ void tester_add_full(const char *name, const void *test_data,
 	test->destroy = destroy;
 	test->user_data = user_data;
 
+	test->perf = test_perf_new(warmup, repeat);
+
 	test_list = g_list_append(test_list, test);
 }
 
+void tester_add_full(const char *name, const void *test_data,
+				tester_data_func_t pre_setup_func,
+				tester_data_func_t setup_func,
+				tester_data_func_t test_func,
+				tester_data_func_t teardown_func,
+				tester_data_func_t post_teardown_func,
+				unsigned int timeout,
+				void *user_data, tester_destroy_func_t destroy)
+{
+	tester_add_perf_full(name, test_data, pre_setup_func, setup_func,
+				test_func, teardown_func, post_teardown_func,
+				timeout, user_data, destroy, 0, 0);
+}
+
 void tester_add(const char *name, const void *test_data,
 					tester_data_func_t setup_func,
 					tester_data_func_t test_func,
@@ -368,6 +450,254 @@ void *tester_get_data(void)
 	return test->user_data;
 }
 
+static int sample_cmp(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of the sorted samples */
+static double perf_percentile(const struct test_perf *perf, unsigned int pct)
+{
+	unsigned int rank;
+
+	rank = (pct * perf->count + 99) / 100;
+	if (rank < 1)
+		rank = 1;
+
+	return perf->samples[rank - 1];
+}
+
+static struct perf_baseline *baseline_find(const char *name)
+{
+	GList *list;
+
+	for (list = g_list_first(baseline_list); list;
+						list = g_list_next(list)) {
+		struct perf_baseline *baseline = list->data;
+
+		if (!strcmp(baseline->name, name))
+			return baseline;
+	}
+
+	return NULL;
+}
+
+static void baseline_free(gpointer data)
+{
+	struct perf_baseline *baseline = data;
+
+	free(baseline->name);
+	free(baseline);
+}
+
+/* Baseline file format is one "<value> <unit> <test name>" line per test */
+static void baseline_load(const char *filename)
+{
+	struct perf_baseline *baseline;
+	char line[512];
+	FILE *fp;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		tester_warn("Unable to open baseline %s: %s", filename,
+							strerror(errno));
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		char unit[16];
+		double value;
+		int off = 0;
+
+		line[strcspn(line, "\n")] = '\0';
+
+		if (line[0] == '#' || sscanf(line, "%lf %15s %n", &value,
+							unit, &off) < 2 || !off)
+			continue;
+
+		baseline = new0(struct perf_baseline, 1);
+		baseline->name = strdup(line + off);
+		baseline->value = value;
+
+		baseline_list = g_list_append(baseline_list, baseline);
+	}
+
+	fclose(fp);
+}
+
+static void baseline_save(const char *filename)
+{
+	GList *list;
+	FILE *fp;
+
+	fp = fopen(filename, "w");
+	if (!fp) {
+		tester_warn("Unable to write baseline %s: %s", filename,
+							strerror(errno));
+		return;
+	}
+
+	for (list = g_list_first(test_list); list; list = g_list_next(list)) {
+		struct test_case *test = list->data;
+
+		if (!test->perf || !test->perf->count ||
+					test->result != TEST_RESULT_PASSED)
+			continue;
+
+		fprintf(fp, "%.6f %s %s\n", test->perf->mean, test->perf->unit,
+								test->name);
+	}
+
+	fclose(fp);
+}
+
+static void json_print_string(FILE *fp, const char *str)
+{
+	fputc('"', fp);
+
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fprintf(fp, "\\%c", *str);
+		else if ((unsigned char) *str < 0x20)
+			fprintf(fp, "\\u%04x", *str);
+		else
+			fputc(*str, fp);
+	}
+
+	fputc('"', fp);
+}
+
+static const char *result_str(enum test_result result)
+{
+	switch (result) {
+	case TEST_RESULT_NOT_RUN:
+		return "not-run";
+	case TEST_RESULT_PASSED:
+		return "passed";
+	case TEST_RESULT_FAILED:
+		return "failed";
+	case TEST_RESULT_TIMED_OUT:
+		return "timed-out";
+	}
+
+	return "unknown";
+}
+
+static void json_save(const char *filename)
+{
+	const char *sep = "";
+	GList *list;
+	FILE *fp;
+
+	fp = fopen(filename, "w");
+	if (!fp) {
+		tester_warn("Unable to write %s: %s", filename,
+							strerror(errno));
+		return;
+	}
+
+	fprintf(fp, "{\"tester\":");
+	json_print_string(fp, tester_name);
+	fprintf(fp, ",\"tests\":[");
+
+	for (list = g_list_first(test_list); list; list = g_list_next(list)) {
+		struct test_case *test = list->data;
+		struct test_perf *perf = test->perf;
+
+		fprintf(fp, "%s\n{\"name\":", sep);
+		json_print_string(fp, test->name);
+		fprintf(fp, ",\"result\":\"%s\",\"time\":%.6f",
+					result_str(test->result),
+					test->end_time - test->start_time);
+
+		if (perf && perf->count) {
+			fprintf(fp, ",\"unit\":\"%s\",\"runs\":%u,"
+				"\"warmup\":%u,\"mean\":%.6f,\"p50\":%.6f,"
+				"\"p99\":%.6f,\"min\":%.6f,\"max\":%.6f",
+				perf->unit, perf->count, perf->warmup,
+				perf->mean, perf->p50, perf->p99,
+				perf->min, perf->max);
+
+			if (perf->has_baseline)
+				fprintf(fp, ",\"baseline\":%.6f,"
+					"\"regression\":%s", perf->baseline,
+					perf->regressed ? "true" : "false");
+		}
+
+		fputc('}', fp);
+		sep = ",";
+	}
+
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+}
+
+static void perf_summarize(struct test_case *test)
+{
+	struct test_perf *perf = test->perf;
+	struct perf_baseline *baseline;
+	double sum = 0, delta;
+	unsigned int i;
+
+	if (!perf->count)
+		return;
+
+	qsort(perf->samples, perf->count, sizeof(double), sample_cmp);
+
+	for (i = 0; i < perf->count; i++)
+		sum += perf->samples[i];
+
+	perf->mean = sum / perf->count;
+	perf->p50 = perf_percentile(perf, 50);
+	perf->p99 = perf_percentile(perf, 99);
+	perf->min = perf->samples[0];
+	perf->max = perf->samples[perf->count - 1];
+
+	baseline = baseline_find(test->name);
+	if (!baseline || baseline->value <= 0)
+		return;
+
+	perf->baseline = baseline->value;
+	perf->has_baseline = true;
+
+	delta = (perf->mean - perf->baseline) * 100.0 / perf->baseline;
+	if (perf->higher_better)
+		delta = -delta;
+
+	/* A positive delta is always a change for the worse */
+	if (delta > option_tolerance) {
+		perf->regressed = true;
+		print_progress(test->name, COLOR_RED,
+				"performance regression %.1f%% (%.3f %s, "
+				"baseline %.3f %s)", delta, perf->mean,
+				perf->unit, perf->baseline, perf->unit);
+		test->result = TEST_RESULT_FAILED;
+	}
+}
+
+static void print_perf(struct test_case *test)
+{
+	struct test_perf *perf = test->perf;
+
+	if (!perf || !perf->count)
+		return;
+
+	tester_log("  %u runs: mean %.3f p50 %.3f p99 %.3f "
+			"min %.3f max %.3f %s", perf->count, perf->mean,
+			perf->p50, perf->p99, perf->min, perf->max,
+			perf->unit);
+
+	if (perf->has_baseline)
+		tester_log("  baseline %.3f %s (%+.1f%%)%s", perf->baseline,
+			perf->unit,
+			(perf->mean - perf->baseline) * 100.0 / perf->baseline,
+			perf->regressed ? COLOR_RED " regression" COLOR_OFF :
+			"");
+}
+
 static int tester_summarize(void)
 {
 	unsigned int not_run = 0, passed = 0, failed = 0;
@@ -406,6 +736,8 @@ static int tester_summarize(void)
 			failed++;
 			break;
 		}
+
+		print_perf(test);
         }
 
 	tester_log("Total: %d, "
@@ -420,6 +752,12 @@ static int tester_summarize(void)
 	execution_time = g_timer_elapsed(test_timer, NULL);
 	tester_log("Overall execution time: %.3g seconds", execution_time);
 
+	if (option_save_baseline)
+		baseline_save(option_save_baseline);
+
+	if (option_json)
+		json_save(option_json);
+
 	return failed;
 }
 
@@ -457,6 +795,46 @@ static bool test_timeout(gpointer user_data)
 	return FALSE;
 }
 
+static void start_test_case(struct test_case *test)
+{
+	if (test->timeout > 0)
+		test->timeout_id = timeout_add_seconds(test->timeout,
+							test_timeout, test,
+							NULL);
+
+	test->stage = TEST_STAGE_PRE_SETUP;
+
+	test->pre_setup_func(test->test_data);
+}
+
+static bool repeat_test_case(struct test_case *test)
+{
+	struct test_perf *perf = test->perf;
+
+	if (!perf || test->result != TEST_RESULT_PASSED)
+		return false;
+
+	if (++perf->iteration >= perf->warmup + perf->repeat)
+		return false;
+
+	test->result = TEST_RESULT_NOT_RUN;
+	test->iov = NULL;
+	test->iovcnt = 0;
+	test->io_complete_func = NULL;
+
+	tester_log("");
+	print_progress(test->name, COLOR_BLACK, "%s %u/%u",
+			perf->iteration < perf->warmup ? "warmup" : "run",
+			perf->iteration < perf->warmup ? perf->iteration + 1 :
+			perf->iteration - perf->warmup + 1,
+			perf->iteration < perf->warmup ? perf->warmup :
+			perf->repeat);
+
+	start_test_case(test);
+
+	return true;
+}
+
 static void next_test_case(void)
 {
 	struct test_case *test;
@@ -480,14 +858,7 @@ static void next_test_case(void)
 
 	test->start_time = g_timer_elapsed(test_timer, NULL);
 
-	if (test->timeout > 0)
-		test->timeout_id = timeout_add_seconds(test->timeout,
-							test_timeout, test,
-							NULL);
-
-	test->stage = TEST_STAGE_PRE_SETUP;
-
-	test->pre_setup_func(test->test_data);
+	start_test_case(test);
 }
 
 static gboolean setup_callback(gpointer user_data)
@@ -508,6 +879,12 @@ static gboolean run_callback(gpointer user_data)
 
 	test->stage = TEST_STAGE_RUN;
 
+	if (test->perf) {
+		test->perf->span_start = g_timer_elapsed(test_timer, NULL);
+		test->perf->span_set = false;
+		test->perf->value_set = false;
+	}
+
 	print_progress(test->name, COLOR_BLACK, "run");
 	test->test_func(test->test_data);
 
@@ -521,6 +898,13 @@ static gboolean done_callback(gpointer user_data)
 	test->end_time = g_timer_elapsed(test_timer, NULL);
 
 	print_progress(test->name, COLOR_BLACK, "done");
+
+	if (repeat_test_case(test))
+		return FALSE;
+
+	if (test->perf)
+		perf_summarize(test);
+
 	next_test_case();
 
 	return FALSE;
@@ -637,6 +1021,64 @@ void tester_setup_failed(void)
 	test->post_teardown_func(test->test_data);
 }
 
+void tester_perf_start(void)
+{
+	struct test_case *test = tester_get_test();
+
+	if (!test || !test->perf || test->stage != TEST_STAGE_RUN)
+		return;
+
+	test->perf->span_start = g_timer_elapsed(test_timer, NULL);
+	test->perf->span_set = false;
+}
+
+void tester_perf_stop(void)
+{
+	struct test_case *test = tester_get_test();
+
+	if (!test || !test->perf || test->stage != TEST_STAGE_RUN)
+		return;
+
+	test->perf->span_end = g_timer_elapsed(test_timer, NULL);
+	test->perf->span_set = true;
+}
+
+void tester_perf_value(double value, const char *unit, bool higher_better)
+{
+	struct test_case *test = tester_get_test();
+
+	if (!test || !test->perf || test->stage != TEST_STAGE_RUN)
+		return;
+
+	test->perf->value = value;
+	test->perf->value_set = true;
+	test->perf->unit = unit;
+	test->perf->higher_better = higher_better;
+}
+
+static void perf_sample(struct test_case *test)
+{
+	struct test_perf *perf = test->perf;
+	double sample;
+
+	if (perf->value_set)
+		sample = perf->value;
+	else {
+		if (!perf->span_set)
+			perf->span_end = g_timer_elapsed(test_timer, NULL);
+
+		sample = (perf->span_end - perf->span_start) * 1000.0;
+	}
+
+	if (perf->iteration < perf->warmup || perf->count >= perf->repeat)
+		return;
+
+	perf->samples[perf->count++] = sample;
+
+	print_progress(test->name, COLOR_BLACK, "sample %.3f %s", sample,
+								perf->unit);
+}
+
 static void test_result(enum test_result result)
 {
 	struct test_case *test;
@@ -660,6 +1102,10 @@ static void test_result(enum test_result result)
 		result = TEST_RESULT_FAILED;
 
 	test->result = result;
+
+	if (test->perf && result == TEST_RESULT_PASSED)
+		perf_sample(test);
+
 	switch (result) {
 	case TEST_RESULT_PASSED:
 		print_progress(test->name, COLOR_GREEN, "test passed");
@@ -867,6 +1313,19 @@ static GOptionEntry options[] = {
 				"Run tests matching provided prefix" },
 	{ "string", 's', 0, G_OPTION_ARG_STRING, &option_string,
 				"Run tests matching provided string" },
+	{ "repeat", 'r', 0, G_OPTION_ARG_INT, &option_repeat,
+				"Run each test N times and collect timing" },
+	{ "warmup", 'w', 0, G_OPTION_ARG_INT, &option_warmup,
+				"Discard the first N runs of each timed test" },
+	{ "baseline", 'b', 0, G_OPTION_ARG_STRING, &option_baseline,
+				"Compare timed tests against baseline file" },
+	{ "save-baseline", 'B', 0, G_OPTION_ARG_STRING,
+				&option_save_baseline,
+				"Write timed test results as baseline file" },
+	{ "tolerance", 't', 0, G_OPTION_ARG_DOUBLE, &option_tolerance,
+				"Allowed regression against baseline in %" },
+	{ "json", 'j', 0, G_OPTION_ARG_STRING, &option_json,
+				"Write test results in JSON format to file" },
 	{ NULL },
 };
 
@@ -904,6 +1363,9 @@ void tester_init(int *argc, char ***argv)
 
 	test_list = NULL;
 	test_current = NULL;
+
+	if (option_baseline)
+		baseline_load(option_baseline);
 }
 
 static struct io *ios[2];
@@ -1087,6 +1549,7 @@ int tester_run(void)
 	ret = tester_summarize();
 
 	g_list_free_full(test_list, test_destroy);
+	g_list_free_full(baseline_list, baseline_free);
 
 	if (option_monitor)
 		bt_log_close();
@@ -50,6 +50,16 @@ void tester_add_full(const char *name, const void *test_data,
 				unsigned int timeout,
 				void *user_data, tester_destroy_func_t destroy);
 
+void tester_add_perf_full(const char *name, const void *test_data,
+				tester_data_func_t pre_setup_func,
+				tester_data_func_t setup_func,
+				tester_data_func_t test_func,
+				tester_data_func_t teardown_func,
+				tester_data_func_t post_teardown_func,
+				unsigned int timeout,
+				void *user_data, tester_destroy_func_t destroy,
+				unsigned int warmup, unsigned int repeat);
+
 void tester_add(const char *name, const void *test_data,
 					tester_data_func_t setup_func,
 					tester_data_func_t test_func,
@@ -65,6 +75,10 @@ bool tester_pre_setup_skip_by_default(void);
 void tester_setup_complete(void);
 void tester_setup_failed(void);
 
+void tester_perf_start(void);
+void tester_perf_stop(void);
+void tester_perf_value(double value, const char *unit, bool higher_better);
+
 void tester_test_passed(void);
 void tester_test_failed(void);
 void tester_test_abort(void);
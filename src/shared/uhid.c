@@ -18,6 +18,7 @@
 #include <string.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <stddef.h>
 
 #include "src/shared/io.h"
 #include "src/shared/util.h"
@@ -30,6 +31,23 @@
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #endif
 
+/* Number of input reports that can be pending either until UHID_START is
+ * received or until the next batched write.
+ */
+#define UHID_INPUT_RING_SIZE	16
+
+/* The kernel zero fills anything past the end of a short write, so pending
+ * input reports are written with just their header and payload.
+ */
+#define UHID_INPUT2_HDR_SIZE	offsetof(struct uhid_event, u.input2.data)
+
+struct uhid_input_ring {
+	struct uhid_event ev[UHID_INPUT_RING_SIZE];
+	struct timespec rx[UHID_INPUT_RING_SIZE];
+	unsigned int head;
+	unsigned int count;
+};
+
 struct uhid_replay {
 	bool active;
 	struct queue *out;
@@ -44,12 +62,17 @@ struct bt_uhid {
 	unsigned int notify_id;
 	bool notifying;
 	struct queue *notify_list;
-	struct queue *input;
+	struct uhid_input_ring *input;
+	bool input_batch;
+	bool input_flushing;
+	struct bt_uhid_input_stats input_stats;
 	uint8_t type;
 	bool created;
 	unsigned int start_id;
 	bool started;
 	struct uhid_replay *replay;
+	struct uhid_event *input_ev;
+	size_t input_len;
 };
 
 struct uhid_notify {
@@ -72,19 +95,25 @@ static void uhid_replay_free(struct uhid_replay *replay)
 	free(replay);
 }
 
+static int input_ring_flush(struct bt_uhid *uhid);
+
 static void uhid_free(struct bt_uhid *uhid)
 {
+	/* Don't drop reports still pending a batched write */
+	if (uhid->io && uhid->started)
+		input_ring_flush(uhid);
+
 	if (uhid->io)
 		io_destroy(uhid->io);
 
 	if (uhid->notify_list)
 		queue_destroy(uhid->notify_list, free);
 
-	if (uhid->input)
-		queue_destroy(uhid->input, free);
+	free(uhid->input);
 
 	uhid_replay_free(uhid->replay);
 
+	free(uhid->input_ev);
 	free(uhid);
 }
 
@@ -360,6 +389,144 @@ static int uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 	return len != sizeof(*ev) ? -EIO : 0;
 }
 
+static const uint64_t latency_buckets[BT_UHID_LATENCY_BUCKETS - 1] = {
+	10, 50, 100, 250, 500, 1000, 5000
+};
+
+static void input_stats_latency(struct bt_uhid *uhid,
+					const struct timespec *rx,
+					const struct timespec *now)
+{
+	struct bt_uhid_input_stats *stats = &uhid->input_stats;
+	int64_t latency;
+	unsigned int i;
+
+	latency = (now->tv_sec - rx->tv_sec) * 1000000LL +
+				(now->tv_nsec - rx->tv_nsec) / 1000;
+	if (latency < 0)
+		latency = 0;
+
+	stats->latency_sum += latency;
+
+	if ((uint64_t) latency > stats->latency_max)
+		stats->latency_max = latency;
+
+	for (i = 0; i < BT_UHID_LATENCY_BUCKETS - 1; i++) {
+		if ((uint64_t) latency < latency_buckets[i])
+			break;
+	}
+
+	stats->latency[i]++;
+}
+
+static void input_ring_clear(struct bt_uhid *uhid)
+{
+	if (uhid->input_flushing) {
+		io_set_write_handler(uhid->io, NULL, NULL, NULL);
+		uhid->input_flushing = false;
+	}
+
+	if (!uhid->input)
+		return;
+
+	uhid->input->head = 0;
+	uhid->input->count = 0;
+}
+
+/* Write all pending input reports with a single writev, /dev/uhid handles
+ * each iovec as a separate event.
+ */
+static int input_ring_flush(struct bt_uhid *uhid)
+{
+	struct uhid_input_ring *ring = uhid->input;
+	struct iovec iov[UHID_INPUT_RING_SIZE];
+	struct timespec now;
+	unsigned int i;
+	size_t total = 0;
+	ssize_t len;
+
+	if (!ring || !ring->count)
+		return 0;
+
+	for (i = 0; i < ring->count; i++) {
+		struct uhid_event *ev;
+
+		ev = &ring->ev[(ring->head + i) % UHID_INPUT_RING_SIZE];
+
+		iov[i].iov_base = ev;
+		iov[i].iov_len = UHID_INPUT2_HDR_SIZE + ev->u.input2.size;
+		total += iov[i].iov_len;
+	}
+
+	len = io_send(uhid->io, iov, ring->count);
+
+	uhid->input_stats.writes++;
+	uhid->input_stats.reports += ring->count;
+
+	if (len >= 0 && (size_t) len == total) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		for (i = 0; i < ring->count; i++)
+			input_stats_latency(uhid, &ring->rx[(ring->head + i) %
+							UHID_INPUT_RING_SIZE],
+							&now);
+
+		ring->head = 0;
+		ring->count = 0;
+
+		return 0;
+	}
+
+	ring->head = 0;
+	ring->count = 0;
+
+	/* Deferred flushes have no caller to report to, so count failures */
+	uhid->input_stats.errors++;
+
+	return len < 0 ? len : -EIO;
+}
+
+static bool input_flush_handler(struct io *io, void *user_data)
+{
+	struct bt_uhid *uhid = user_data;
+
+	uhid->input_flushing = false;
+
+	input_ring_flush(uhid);
+
+	return false;
+}
+
+static struct uhid_event *input_ring_push(struct bt_uhid *uhid,
+						const struct timespec *rx)
+{
+	struct uhid_input_ring *ring;
+	unsigned int i;
+
+	if (!uhid->input)
+		uhid->input = new0(struct uhid_input_ring, 1);
+
+	ring = uhid->input;
+
+	if (ring->count == UHID_INPUT_RING_SIZE) {
+		/* Once started make room by writing what is pending, before
+		 * that drop the oldest report as it is the most stale.
+		 */
+		if (uhid->started)
+			input_ring_flush(uhid);
+		else {
+			ring->head = (ring->head + 1) % UHID_INPUT_RING_SIZE;
+			ring->count--;
+			uhid->input_stats.dropped++;
+		}
+	}
+
+	i = (ring->head + ring->count++) % UHID_INPUT_RING_SIZE;
+	ring->rx[i] = *rx;
+
+	return &ring->ev[i];
+}
+
 int bt_uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 {
 	if (!uhid || !ev)
@@ -368,15 +535,11 @@ int bt_uhid_send(struct bt_uhid *uhid, const struct uhid_event *ev)
 	if (!uhid->io)
 		return -ENOTCONN;
 
-	return uhid_send(uhid, ev);
-}
-
-static bool input_dequeue(const void *data, const void *match_data)
-{
-	struct uhid_event *ev = (void *)data;
-	struct bt_uhid *uhid = (void *)match_data;
+	/* Keep pending input reports ordered with respect to other events */
+	if (uhid->started && uhid->input && uhid->input->count)
+		input_ring_flush(uhid);
 
-	return bt_uhid_send(uhid, ev) == 0;
+	return uhid_send(uhid, ev);
 }
 
 static void uhid_start(struct uhid_event *ev, void *user_data)
@@ -386,7 +549,7 @@ static void uhid_start(struct uhid_event *ev, void *user_data)
 	uhid->started = true;
 
 	/* dequeue input events send while UHID_CREATE2 was in progress */
-	queue_remove_all(uhid->input, input_dequeue, uhid, free);
+	input_ring_flush(uhid);
 }
 
 int bt_uhid_create(struct bt_uhid *uhid, const char *name, bdaddr_t *src,
@@ -461,18 +624,40 @@ bool bt_uhid_started(struct bt_uhid *uhid)
 	return uhid->started;
 }
 
-int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
-			size_t size)
+int bt_uhid_input_at(struct bt_uhid *uhid, uint8_t number, const void *data,
+			size_t size, const struct timespec *rx)
 {
-	struct uhid_event ev;
-	struct uhid_input2_req *req = &ev.u.input2;
+	struct uhid_event *ev;
+	struct uhid_input2_req *req;
+	struct timespec ts, now;
 	size_t len = 0;
+	int err;
 
 	if (!uhid)
 		return -EINVAL;
 
-	memset(&ev, 0, sizeof(ev));
-	ev.type = UHID_INPUT2;
+	if (!rx) {
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		rx = &ts;
+	}
+
+	/* Queue events if UHID_START has not been received yet */
+	if (!uhid->started || uhid->input_batch)
+		ev = input_ring_push(uhid, rx);
+	else {
+		/* Input reports are the hot path, so reuse a single
+		 * preallocated event and only clear what the previous report
+		 * left behind instead of zeroing the whole event every time.
+		 */
+		if (!uhid->input_ev)
+			uhid->input_ev = new0(struct uhid_event, 1);
+
+		ev = uhid->input_ev;
+	}
+
+	req = &ev->u.input2;
+
+	ev->type = UHID_INPUT2;
 
 	if (number) {
 		req->data[len++] = number;
@@ -483,16 +668,82 @@ int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 	if (data && size)
 		memcpy(&req->data[len], data, req->size - len);
 
-	/* Queue events if UHID_START has not been received yet */
-	if (!uhid->started) {
-		if (!uhid->input)
-			uhid->input = queue_new();
+	if (ev != uhid->input_ev)
+		goto pending;
+
+	if (uhid->input_len > req->size)
+		memset(&req->data[req->size], 0,
+					uhid->input_len - req->size);
+
+	uhid->input_len = req->size;
+
+	uhid->input_stats.writes++;
+	uhid->input_stats.reports++;
+
+	err = bt_uhid_send(uhid, ev);
+	if (err < 0) {
+		uhid->input_stats.errors++;
+		return err;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	input_stats_latency(uhid, rx, &now);
+
+	return 0;
 
-		queue_push_tail(uhid->input, util_memdup(&ev, sizeof(ev)));
+pending:
+	if (!uhid->started)
 		return 0;
+
+	/* Coalesce reports until the mainloop polls the fd for writing */
+	if (!uhid->input_flushing) {
+		if (!io_set_write_handler(uhid->io, input_flush_handler, uhid,
+									NULL))
+			return input_ring_flush(uhid);
+
+		uhid->input_flushing = true;
 	}
 
-	return bt_uhid_send(uhid, &ev);
+	return 0;
+}
+
+int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
+			size_t size)
+{
+	return bt_uhid_input_at(uhid, number, data, size, NULL);
+}
+
+bool bt_uhid_set_input_batch(struct bt_uhid *uhid, bool enable)
+{
+	if (!uhid)
+		return false;
+
+	if (uhid->input_batch == enable)
+		return true;
+
+	uhid->input_batch = enable;
+
+	if (!enable && uhid->started) {
+		if (uhid->input_flushing) {
+			io_set_write_handler(uhid->io, NULL, NULL, NULL);
+			uhid->input_flushing = false;
+		}
+
+		input_ring_flush(uhid);
+	}
+
+	return true;
+}
+
+bool bt_uhid_get_input_stats(struct bt_uhid *uhid,
+					struct bt_uhid_input_stats *stats)
+{
+	if (!uhid || !stats)
+		return false;
+
+	*stats = uhid->input_stats;
+
+	return true;
 }
 
 int bt_uhid_set_report_reply(struct bt_uhid *uhid, uint32_t id, uint8_t status)
@@ -555,9 +806,14 @@ int bt_uhid_destroy(struct bt_uhid *uhid, bool force)
 	if (!uhid)
 		return -EINVAL;
 
-	/* Cleanup input queue */
-	queue_destroy(uhid->input, free);
-	uhid->input = NULL;
+	/* Write reports still pending a batched flush before cleaning up the
+	 * input queue, those queued before UHID_START can no longer be
+	 * delivered.
+	 */
+	if (uhid->started && uhid->io)
+		input_ring_flush(uhid);
+
+	input_ring_clear(uhid);
 
 	/* Force destroy for non-keyboard devices - keyboards are not destroyed
 	 * on disconnect since they can glitch on reconnection losing
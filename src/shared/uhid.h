@@ -10,11 +10,28 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
 #include <linux/uhid.h>
 #include <bluetooth/bluetooth.h>
 
 struct bt_uhid;
 
+/* Input report latency is measured from the time passed to bt_uhid_input_at,
+ * or the call to bt_uhid_input, until the report has been written to uHID.
+ */
+#define BT_UHID_LATENCY_BUCKETS	8
+
+struct bt_uhid_input_stats {
+	uint64_t reports;
+	uint64_t writes;
+	uint64_t dropped;
+	uint64_t errors;
+	uint64_t latency_sum;
+	uint64_t latency_max;
+	/* < 10, 50, 100, 250, 500, 1000, 5000 and >= 5000 usec */
+	uint64_t latency[BT_UHID_LATENCY_BUCKETS];
+};
+
 enum {
 	BT_UHID_NONE = 0,
 	BT_UHID_KEYBOARD,
@@ -63,6 +80,11 @@ bool bt_uhid_created(struct bt_uhid *uhid);
 bool bt_uhid_started(struct bt_uhid *uhid);
 int bt_uhid_input(struct bt_uhid *uhid, uint8_t number, const void *data,
 			size_t size);
+int bt_uhid_input_at(struct bt_uhid *uhid, uint8_t number, const void *data,
+			size_t size, const struct timespec *rx);
+bool bt_uhid_set_input_batch(struct bt_uhid *uhid, bool enable);
+bool bt_uhid_get_input_stats(struct bt_uhid *uhid,
+					struct bt_uhid_input_stats *stats);
 int bt_uhid_set_report_reply(struct bt_uhid *uhid, uint32_t id, uint8_t status);
 int bt_uhid_get_report_reply(struct bt_uhid *uhid, uint32_t id, uint8_t number,
 				uint8_t status, const void *data, size_t size);
@@ -33,7 +33,9 @@
 #include <time.h>
 #include <inttypes.h>
 #include <sys/wait.h>
+#include <sys/timerfd.h>
 #include <poll.h>
+#include <linux/net_tstamp.h>
 
 #include "bluetooth/bluetooth.h"
 #include "bluetooth/hci.h"
@@ -42,6 +44,7 @@
 #include "bluetooth/iso.h"
 
 #include "src/shared/util.h"
+#include "tools/perf-stats.h"
 
 #define NSEC_USEC(_t) (_t / 1000L)
 #define SEC_USEC(_t)  (_t  * 1000000L)
@@ -82,6 +85,11 @@ static bool inout;
 
 static uint8_t num_bis = 1;
 
+static int stats_format = PERF_STATS_NONE;
+static unsigned int stats_interval = 1000;
+
+static bool sched;
+
 struct lookup_table {
 	const char *name;
 	int flag;
@@ -658,6 +666,49 @@ static void dump_mode(int fd, int sk, char *peer)
 	}
 }
 
+static void stats_recv(int fd, int sk, char *peer)
+{
+	struct perf_stats *stats;
+	struct bt_iso_qos qos;
+	socklen_t len;
+	int r;
+
+	stats = perf_stats_new("isotest", stats_format, stats_interval);
+
+	memset(&qos, 0, sizeof(qos));
+	len = sizeof(qos);
+	if (!getsockopt(sk, SOL_BLUETOOTH, BT_ISO_QOS, &qos, &len))
+		perf_stats_set_interval(stats, peer ? qos.bcast.in.interval :
+							qos.ucast.in.interval);
+
+	while (1) {
+		r = recv(sk, buf, data_size, 0);
+		if (r < 0) {
+			syslog(LOG_ERR, "Read failed: %s (%d)",
+						strerror(errno), errno);
+
+			if (errno != ENOTCONN)
+				break;
+
+			continue;
+		}
+
+		if (!r)
+			break;
+
+		if (fd >= 0 && write(fd, buf, r) < 0) {
+			syslog(LOG_ERR, "Write failed: %s (%d)",
+						strerror(errno), errno);
+			break;
+		}
+
+		perf_stats_rx(stats, buf, r);
+	}
+
+	perf_stats_report(stats, true);
+	perf_stats_free(stats);
+}
+
 static void recv_mode(int fd, int sk, char *peer)
 {
 	struct timeval tv_beg, tv_end, tv_diff;
@@ -676,6 +727,11 @@ static void recv_mode(int fd, int sk, char *peer)
 
 	syslog(LOG_INFO, "Receiving ...");
 
+	if (stats_format != PERF_STATS_NONE) {
+		stats_recv(fd, sk, peer);
+		return;
+	}
+
 	for (seq = 0; ; seq++) {
 		gettimeofday(&tv_beg, NULL);
 		total = 0;
@@ -885,9 +941,13 @@ static void do_send(int sk, int fd, char *peer, bool repeat)
 						strerror(-send_len), -send_len);
 				exit(1);
 			}
-		} else
+		} else {
 			send_len = out->sdu;
 
+			if (stats_format != PERF_STATS_NONE)
+				perf_stats_put_header(buf, send_len, seq);
+		}
+
 		send_len = send(sk, buf, send_len, 0);
 		if (send_len <= 0) {
 			syslog(LOG_ERR, "send failed: %s (%d)",
@@ -907,6 +967,398 @@ static void do_send(int sk, int fd, char *peer, bool repeat)
 	}
 }
 
+/* Maximum number of SDUs handed to sendmmsg per stream and tick */
+#define SCHED_BATCH	16
+
+struct sched_stream {
+	int sk;
+	uint32_t interval;
+	uint16_t sdu;
+	uint32_t num;
+	uint32_t seq;
+	uint64_t next;
+	bool txtime;
+	bool closed;
+	uint8_t *bufs;
+	struct mmsghdr msgs[SCHED_BATCH];
+	struct iovec iov[SCHED_BATCH];
+	uint8_t ctrl[SCHED_BATCH][CMSG_SPACE(sizeof(uint64_t))];
+	/* Counters since last report and totals */
+	uint64_t sent;
+	uint64_t late;
+	uint64_t dropped;
+	uint64_t lateness_sum;
+	uint64_t lateness_max;
+	uint64_t total_sent;
+	uint64_t total_late;
+	uint64_t total_dropped;
+};
+
+static uint64_t sched_now(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+		perror("clock_gettime");
+		exit(EXIT_FAILURE);
+	}
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sched_stream_init(struct sched_stream *stream, int sk, char *peer)
+{
+	struct bt_iso_qos qos;
+	struct bt_iso_io_qos *out;
+	socklen_t len;
+	int flags;
+
+	memset(stream, 0, sizeof(*stream));
+	stream->sk = sk;
+
+	memset(&qos, 0, sizeof(qos));
+	len = sizeof(qos);
+	if (getsockopt(sk, SOL_BLUETOOTH, BT_ISO_QOS, &qos, &len) < 0)
+		syslog(LOG_ERR, "Can't get Output QoS socket option: %s (%d)",
+				strerror(errno), errno);
+
+	if (!strcmp(peer, "00:00:00:00:00:00"))
+		out = &qos.bcast.out;
+	else
+		out = &qos.ucast.out;
+
+	stream->interval = out->interval ? out->interval : 10000;
+	stream->sdu = out->sdu ? out->sdu : ISO_DEFAULT_MTU;
+	if (stream->sdu > data_size)
+		stream->sdu = data_size;
+
+	stream->num = ROUND_CLOSEST(out->latency * 1000, stream->interval);
+	if (!stream->num)
+		stream->num = 1;
+
+	if (stream->num > SCHED_BATCH)
+		stream->num = SCHED_BATCH;
+
+	flags = fcntl(sk, F_GETFL, 0);
+	fcntl(sk, F_SETFL, (flags < 0 ? 0 : flags) | O_NONBLOCK);
+
+	if (sndbuf && setsockopt(sk, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+						sizeof(sndbuf)) < 0)
+		syslog(LOG_ERR, "Can't set socket SO_SNDBUF option: %s (%d)",
+				strerror(errno), errno);
+
+#ifdef SO_TXTIME
+	{
+		struct sock_txtime txtime = {
+			.clockid = CLOCK_MONOTONIC,
+		};
+
+		stream->txtime = !setsockopt(sk, SOL_SOCKET, SO_TXTIME,
+						&txtime, sizeof(txtime));
+	}
+#endif
+
+	stream->bufs = malloc(SCHED_BATCH * stream->sdu);
+	if (!stream->bufs) {
+		perror("Can't allocate stream buffers");
+		exit(1);
+	}
+
+	memset(stream->bufs, 0x7f, SCHED_BATCH * stream->sdu);
+
+	syslog(LOG_INFO, "Stream %d: interval %u us SDU %u jitter buffer %u "
+			"%s", sk, stream->interval, stream->sdu, stream->num,
+			stream->txtime ? "SO_TXTIME" : "");
+}
+
+/* Hand count SDUs to the socket with a single sendmmsg call, deadline is
+ * the time by which the first SDU is due.
+ */
+static void sched_stream_send(struct sched_stream *stream, unsigned int count,
+							uint64_t deadline)
+{
+	unsigned int i;
+	uint64_t now, lateness;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		struct msghdr *msg = &stream->msgs[i].msg_hdr;
+		uint8_t *buf = stream->bufs + i * stream->sdu;
+
+		if (stats_format != PERF_STATS_NONE)
+			perf_stats_put_header(buf, stream->sdu, stream->seq);
+
+		stream->seq++;
+
+		stream->iov[i].iov_base = buf;
+		stream->iov[i].iov_len = stream->sdu;
+
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_iov = &stream->iov[i];
+		msg->msg_iovlen = 1;
+
+		if (stream->txtime) {
+			struct cmsghdr *cmsg;
+			uint64_t txtime = deadline +
+					i * stream->interval * 1000ULL;
+
+			msg->msg_control = stream->ctrl[i];
+			msg->msg_controllen = sizeof(stream->ctrl[i]);
+
+			cmsg = CMSG_FIRSTHDR(msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_TXTIME;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(txtime));
+			memcpy(CMSG_DATA(cmsg), &txtime, sizeof(txtime));
+		}
+	}
+
+	ret = sendmmsg(stream->sk, stream->msgs, count, MSG_DONTWAIT);
+	if (ret < 0) {
+		if (errno != EAGAIN && errno != ENOBUFS) {
+			syslog(LOG_ERR, "Stream %d send failed: %s (%d)",
+					stream->sk, strerror(errno), errno);
+			stream->closed = true;
+		}
+
+		ret = 0;
+	}
+
+	now = sched_now();
+
+	/* An SDU is on time if it was queued before its own slot ends */
+	for (i = 0; i < (unsigned int) ret; i++) {
+		uint64_t due = deadline + i * stream->interval * 1000ULL;
+
+		lateness = now > due ? (now - due) / 1000 : 0;
+
+		if (lateness > stream->interval)
+			stream->late++;
+
+		stream->lateness_sum += lateness;
+		if (lateness > stream->lateness_max)
+			stream->lateness_max = lateness;
+	}
+
+	stream->sent += ret;
+	stream->dropped += count - ret;
+}
+
+static void sched_report(struct sched_stream *streams, int count,
+							bool final)
+{
+	for (int i = 0; i < count; i++) {
+		struct sched_stream *stream = &streams[i];
+		int used = 0;
+
+		stream->total_sent += stream->sent;
+		stream->total_late += stream->late;
+		stream->total_dropped += stream->dropped;
+
+		ioctl(stream->sk, TIOCOUTQ, &used);
+
+		if (final)
+			syslog(LOG_INFO, "Stream %d total: %" PRIu64 " sent %"
+				PRIu64 " late %" PRIu64 " dropped (%.2f%% "
+				"on time)", stream->sk, stream->total_sent,
+				stream->total_late, stream->total_dropped,
+				stream->total_sent ? 100.0 *
+				(stream->total_sent - stream->total_late) /
+				(stream->total_sent + stream->total_dropped) :
+				0.0);
+		else if (!quiet)
+			syslog(LOG_INFO, "Stream %d: %" PRIu64 " sent %" PRIu64
+				" late %" PRIu64 " dropped, lateness avg %"
+				PRIu64 " max %" PRIu64 " us, queued %d bytes",
+				stream->sk, stream->sent, stream->late,
+				stream->dropped, stream->sent ?
+				stream->lateness_sum / stream->sent : 0,
+				stream->lateness_max, used);
+
+		stream->sent = 0;
+		stream->late = 0;
+		stream->dropped = 0;
+		stream->lateness_sum = 0;
+		stream->lateness_max = 0;
+	}
+}
+
+static void sched_wait_connected(int *sk, int count)
+{
+	for (int i = 0; i < count; i++) {
+		struct pollfd p = { .fd = sk[i], .events = POLLOUT };
+
+		if (poll(&p, 1, 10000) <= 0 || !(p.revents & POLLOUT)) {
+			syslog(LOG_ERR, "Stream %d not connected", sk[i]);
+			exit(1);
+		}
+	}
+}
+
+/* Drive all streams from a single timerfd aligned to the ISO interval of
+ * the fastest stream instead of one process sleeping per stream.
+ */
+static void sched_send(int *sk, int count, char *peer)
+{
+	struct sched_stream *streams;
+	struct itimerspec its;
+	uint64_t tick, start, last_report, exp;
+	int tfd, open;
+
+	syslog(LOG_INFO, "Sending %d streams ...", count);
+
+	sched_wait_connected(sk, count);
+
+	streams = calloc(count, sizeof(*streams));
+	if (!streams) {
+		perror("Can't allocate streams");
+		exit(1);
+	}
+
+	tick = UINT32_MAX;
+	for (int i = 0; i < count; i++) {
+		sched_stream_init(&streams[i], sk[i], peer);
+		if (streams[i].interval < tick)
+			tick = streams[i].interval;
+	}
+
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (tfd < 0) {
+		perror("timerfd_create");
+		exit(1);
+	}
+
+	start = sched_now();
+
+	/* Prefill the jitter buffer then send one SDU per interval */
+	for (int i = 0; i < count; i++) {
+		sched_stream_send(&streams[i], streams[i].num, start);
+		streams[i].next = start + streams[i].num *
+					streams[i].interval * 1000ULL;
+	}
+
+	memset(&its, 0, sizeof(its));
+	its.it_interval.tv_sec = tick / 1000000;
+	its.it_interval.tv_nsec = (tick % 1000000) * 1000;
+	its.it_value.tv_sec = (start + tick * 1000) / 1000000000ULL;
+	its.it_value.tv_nsec = (start + tick * 1000) % 1000000000ULL;
+
+	if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+		perror("timerfd_settime");
+		exit(1);
+	}
+
+	last_report = start;
+
+	do {
+		uint64_t now;
+
+		if (read(tfd, &exp, sizeof(exp)) != sizeof(exp))
+			break;
+
+		now = sched_now();
+		open = 0;
+
+		for (int i = 0; i < count; i++) {
+			struct sched_stream *stream = &streams[i];
+			uint64_t deadline = stream->next;
+			unsigned int due = 0;
+
+			if (stream->closed)
+				continue;
+
+			open++;
+
+			while (stream->next <= now) {
+				stream->next += stream->interval * 1000ULL;
+				due++;
+			}
+
+			/* Too far behind, skip what cannot be caught up but
+			 * keep their sequence numbers so the gap is visible.
+			 */
+			if (due > SCHED_BATCH) {
+				stream->dropped += due - SCHED_BATCH;
+				stream->seq += due - SCHED_BATCH;
+				deadline += (due - SCHED_BATCH) *
+						stream->interval * 1000ULL;
+				due = SCHED_BATCH;
+			}
+
+			if (due)
+				sched_stream_send(stream, due, deadline);
+		}
+
+		if (now - last_report >= stats_interval * 1000000ULL) {
+			sched_report(streams, count, false);
+			last_report = now;
+		}
+	} while (open);
+
+	sched_report(streams, count, true);
+
+	for (int i = 0; i < count; i++)
+		free(streams[i].bufs);
+
+	free(streams);
+	close(tfd);
+}
+
+static int *ucast_do_connect_mcis(char **peers, int count)
+{
+	int *sk;
+	int sk_cnt = 0;
+
+	sk = malloc(count * sizeof(*sk));
+	if (!sk) {
+		syslog(LOG_ERR, "Can't allocate socket array");
+		return NULL;
+	}
+
+	/* Defer all but the last CIS so they are created together */
+	for (int i = 0; i < count; i++) {
+		defer_setup = i < count - 1 ? 1 : 0;
+
+		sk[i] = do_connect(peers[i]);
+		if (sk[i] < 0)
+			goto error;
+
+		sk_cnt++;
+	}
+
+	return sk;
+
+error:
+	for (int i = 0; i < sk_cnt; i++)
+		close(sk[i]);
+
+	free(sk);
+	return NULL;
+}
+
+static void sched_send_mode(char **peers, int count)
+{
+	int *sk_arr;
+
+	mgmt_set_experimental();
+
+	if (count == 1 && !strcmp(peers[0], "00:00:00:00:00:00")) {
+		count = num_bis;
+		sk_arr = bcast_do_connect_mbis(num_bis, peers[0]);
+	} else
+		sk_arr = ucast_do_connect_mcis(peers, count);
+
+	if (!sk_arr)
+		exit(1);
+
+	sched_send(sk_arr, count, peers[0]);
+
+	for (int i = 0; i < count; i++)
+		close(sk_arr[i]);
+
+	free(sk_arr);
+}
+
 static void send_mode(char *filename, char *peer, int i, bool repeat)
 {
 	int sk, fd = -1;
@@ -1146,7 +1598,11 @@ static void usage(void)
 		"\t[-G, --CIG/BIG <value>]\n"
 		"\t[-T, --CIS/BIS <value>]\n"
 		"\t[-V, --type <value>] address type (help for list)\n"
-		"\t[-N, --nbis <value>] Number of BISes to create/synchronize to\n");
+		"\t[-N, --nbis <value>] Number of BISes to create/synchronize to\n"
+		"\t[-x, --stats[=<format>]] statistics mode: text, json or csv\n"
+		"\t[-K, --stats-interval <msec>] statistics report interval\n"
+		"\t[-X, --sched            send all streams from a single "
+		"timerfd scheduler]\n");
 }
 
 static const struct option main_options[] = {
@@ -1177,6 +1633,9 @@ static const struct option main_options[] = {
 	{ "CIS/BIS",   required_argument, NULL, 'T'},
 	{ "type",      required_argument, NULL, 'V'},
 	{ "nbis",      required_argument, NULL, 'N'},
+	{ "stats",     optional_argument, NULL, 'x'},
+	{ "stats-interval", required_argument, NULL, 'K'},
+	{ "sched",     no_argument,       NULL, 'X'},
 	{}
 };
 
@@ -1218,7 +1677,7 @@ int main(int argc, char *argv[])
 		int opt;
 
 		opt = getopt_long(argc, argv,
-			"d::cmr::s::nb:i:j:hqt:CV:W:M:S:P:F:I:L:Y:R:B:G:T:e:k:N:",
+			"d::cmr::s::nb:i:j:hqt:CV:W:M:S:P:F:I:L:Y:R:B:G:T:e:k:N:x::K:X",
 			main_options, NULL);
 		if (opt < 0)
 			break;
@@ -1401,6 +1860,22 @@ int main(int argc, char *argv[])
 			}
 			break;
 
+		case 'x':
+			stats_format = perf_stats_parse_format(optarg);
+			if (stats_format < 0) {
+				fprintf(stderr, "Invalid statistics format\n");
+				exit(1);
+			}
+			break;
+
+		case 'K':
+			stats_interval = atoi(optarg);
+			break;
+
+		case 'X':
+			sched = true;
+			break;
+
 		/* fall through */
 		default:
 			usage();
@@ -1446,6 +1921,22 @@ int main(int argc, char *argv[])
 
 	argc -= optind;
 
+	if (mode == SEND && sched) {
+		if (filename)
+			syslog(LOG_INFO, "Scheduler mode ignores input files");
+
+		for (i = 0; i < (unsigned int) argc; i++) {
+			if (bachk(argv[optind + i]) < 0) {
+				fprintf(stderr, "Invalid peer address '%s'\n",
+							argv[optind + i]);
+				exit(1);
+			}
+		}
+
+		sched_send_mode(argv + optind, argc);
+		goto done;
+	}
+
 	for (i = 0; i < (unsigned int) argc; i++) {
 		pid_t pid;
 
@@ -37,6 +37,7 @@
 
 #include "src/shared/util.h"
 #include "monitor/display.h"
+#include "tools/perf-stats.h"
 
 #define NIBBLE_TO_ASCII(c)  ((c) < 0x0a ? (c) + 0x30 : (c) + 0x57)
 
@@ -123,6 +124,8 @@ static int priority = -1;
 static int rcvbuf = 0;
 static int chan_policy = -1;
 static int bdaddr_type = 0;
+static int stats_format = PERF_STATS_NONE;
+static unsigned int stats_interval = 1000;
 
 struct lookup_table {
 	const char *name;
@@ -838,6 +841,49 @@ static void dump_mode(int sk)
 	}
 }
 
+static void stats_recv(int sk)
+{
+	struct perf_stats *stats;
+	struct pollfd p;
+	int len;
+
+	if (data_size < PERF_STATS_HDR_SIZE)
+		syslog(LOG_ERR, "Data size %ld too small for statistics",
+								data_size);
+
+	stats = perf_stats_new("l2test", stats_format, stats_interval);
+
+	p.fd = sk;
+	p.events = POLLIN | POLLERR | POLLHUP;
+
+	while (1) {
+		p.revents = 0;
+		if (poll(&p, 1, -1) <= 0)
+			break;
+
+		if (p.revents & (POLLERR | POLLHUP))
+			break;
+
+		len = recv(sk, buf, data_size, 0);
+		if (len < 0) {
+			if (reliable && errno == ECOMM)
+				continue;
+
+			syslog(LOG_ERR, "Read failed: %s (%d)",
+						strerror(errno), errno);
+			break;
+		}
+
+		if (!len)
+			break;
+
+		perf_stats_rx(stats, buf, len);
+	}
+
+	perf_stats_report(stats, true);
+	perf_stats_free(stats);
+}
+
 static void recv_mode(int sk)
 {
 	struct timeval tv_beg, tv_end, tv_diff;
@@ -865,6 +911,11 @@ static void recv_mode(int sk)
 
 	syslog(LOG_INFO, "Receiving ...");
 
+	if (stats_format != PERF_STATS_NONE) {
+		stats_recv(sk);
+		return;
+	}
+
 	memset(ts, 0, sizeof(ts));
 
 	p.fd = sk;
@@ -1001,8 +1052,12 @@ static void do_send(int sk)
 
 	seq = seq_start;
 	while ((num_frames == -1) || (num_frames-- > 0)) {
-		put_le32(seq, buf);
-		put_le16(data_size, buf + 4);
+		if (stats_format != PERF_STATS_NONE)
+			perf_stats_put_header(buf, data_size, seq);
+		else {
+			put_le32(seq, buf);
+			put_le16(data_size, buf + 4);
+		}
 
 		seq++;
 
@@ -1356,7 +1411,10 @@ static void usage(void)
 		"\t[-M] become central\n"
 		"\t[-T] enable timestamps\n"
 		"\t[-V type] address type (help for list, default = bredr)\n"
-		"\t[-e seq] initial sequence value (default = 0)\n");
+		"\t[-e seq] initial sequence value (default = 0)\n"
+		"\t[-f format] statistics mode: text, json or csv\n"
+		"\t[-l milliseconds] statistics report interval "
+		"(default = 1000)\n");
 }
 
 int main(int argc, char *argv[])
@@ -1366,7 +1424,7 @@ int main(int argc, char *argv[])
 
 	bacpy(&bdaddr, BDADDR_ANY);
 
-	while ((opt = getopt(argc, argv, "a:b:cde:g:i:mnpqrstuwxyz"
+	while ((opt = getopt(argc, argv, "a:b:cde:f:g:i:l:mnpqrstuwxyz"
 		"AB:C:D:EF:GH:I:J:K:L:MN:O:P:Q:RSTUV:W:X:Y:Z:")) != EOF) {
 		switch (opt) {
 		case 'r':
@@ -1581,6 +1639,19 @@ int main(int argc, char *argv[])
 			disc_delay = atoi(optarg) * 1000;
 			break;
 
+		case 'f':
+			stats_format = perf_stats_parse_format(optarg);
+			if (stats_format < 0) {
+				printf("Invalid statistics format: %s\n",
+								optarg);
+				exit(1);
+			}
+			break;
+
+		case 'l':
+			stats_interval = atoi(optarg);
+			break;
+
 		default:
 			usage();
 			exit(1);
@@ -1599,6 +1670,13 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
+	if (stats_format != PERF_STATS_NONE && data_size >= 0 &&
+					data_size < PERF_STATS_HDR_SIZE) {
+		printf("Data size %ld too small for statistics (minimum %d)\n",
+						data_size, PERF_STATS_HDR_SIZE);
+		exit(1);
+	}
+
 	if (data_size < 0)
 		buffer_size = (omtu > imtu) ? omtu : imtu;
 	else
@@ -1253,6 +1253,146 @@ fail:
 	free_generic_request(req);
 }
 
+struct import_db {
+	char *fname;
+	int pending;
+	int imported;
+};
+
+struct import_db_request {
+	struct import_db *db;
+	void *node;
+	uint16_t unicast;
+	uint8_t ele_cnt;
+	uint8_t dev_key[16];
+};
+
+static void import_db_node_reply(struct l_dbus_proxy *proxy,
+				struct l_dbus_message *msg, void *user_data)
+{
+	struct import_db_request *req = user_data;
+	void *node = req->node;
+
+	req->node = NULL;
+
+	if (l_dbus_message_is_error(msg)) {
+		const char *name;
+
+		l_dbus_message_get_error(msg, &name, NULL);
+		l_error("Failed to import remote node %4.4x: %s",
+							req->unicast, name);
+		mesh_db_free_imported_node(node);
+		return;
+	}
+
+	/* Only nodes the daemon accepted go into the database */
+	if (!mesh_db_add_imported_node(node)) {
+		l_error("Failed to store imported node %4.4x", req->unicast);
+		return;
+	}
+
+	req->db->imported++;
+}
+
+static void import_db_node_setup(struct l_dbus_message *msg,
+							void *user_data)
+{
+	struct import_db_request *req = user_data;
+	struct l_dbus_message_builder *builder;
+
+	builder = l_dbus_message_builder_new(msg);
+	l_dbus_message_builder_append_basic(builder, 'q', &req->unicast);
+	l_dbus_message_builder_append_basic(builder, 'y', &req->ele_cnt);
+	append_byte_array(builder, req->dev_key, 16);
+	l_dbus_message_builder_finalize(builder);
+	l_dbus_message_builder_destroy(builder);
+}
+
+static void import_db_unref(struct import_db *db)
+{
+	if (--db->pending)
+		return;
+
+	bt_shell_printf("Imported %d nodes from %s\n", db->imported,
+								db->fname);
+	l_free(db->fname);
+	l_free(db);
+}
+
+static void free_import_db_request(void *data)
+{
+	struct import_db_request *req = data;
+
+	/* No reply, the daemon may or may not have the node */
+	if (req->node)
+		mesh_db_free_imported_node(req->node);
+
+	import_db_unref(req->db);
+	l_free(req);
+}
+
+static void import_db_node(void *node, const uint8_t uuid[16],
+					uint16_t unicast, uint8_t ele_cnt,
+					uint16_t net_idx, const uint8_t dev_key[16],
+					void *user_data)
+{
+	struct import_db *db = user_data;
+	struct import_db_request *req;
+
+	req = l_new(struct import_db_request, 1);
+	req->db = db;
+	req->node = node;
+	req->unicast = unicast;
+	req->ele_cnt = ele_cnt;
+	memcpy(req->dev_key, dev_key, 16);
+
+	db->pending++;
+
+	l_dbus_proxy_method_call(local->mgmt_proxy, "ImportRemoteNode",
+					import_db_node_setup,
+					import_db_node_reply, req,
+					free_import_db_request);
+}
+
+static void cmd_import_db(int argc, char *argv[])
+{
+	struct import_db *db;
+	int count;
+
+	if (!local || !local->proxy || !local->mgmt_proxy) {
+		bt_shell_printf("Node is not attached\n");
+		return;
+	}
+
+	if (argc < 2) {
+		bt_shell_printf("File name is required\n");
+		return;
+	}
+
+	db = l_new(struct import_db, 1);
+	db->fname = l_strdup(argv[1]);
+
+	/* Hold a reference so replies cannot finish the import early */
+	db->pending = 1;
+
+	count = mesh_db_import_nodes(argv[1], import_db_node, db);
+	if (count <= 0) {
+		if (count < 0)
+			bt_shell_printf("Failed to import nodes from %s\n",
+								argv[1]);
+		else
+			bt_shell_printf("No new nodes in %s\n", argv[1]);
+
+		l_free(db->fname);
+		l_free(db);
+		return;
+	}
+
+	/* The count is reported once the daemon replied for every node */
+	bt_shell_printf("Importing %d nodes from %s\n", count, argv[1]);
+	import_db_unref(db);
+}
+
 static void subnet_set_phase_reply(struct l_dbus_proxy *proxy,
 				struct l_dbus_message *msg, void *user_data)
 {
@@ -1803,6 +1943,8 @@ static const struct bt_shell_menu main_menu = {
 			"List available keys"},
 	{ "export-db", NULL, cmd_export_db,
 			"Export mesh configuration database"},
+	{ "import-db", "<filename>", cmd_import_db,
+			"Import remote nodes from an exported database"},
 	{ } },
 };
 
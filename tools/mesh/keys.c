@@ -87,7 +87,9 @@ void keys_del_net_key(uint16_t idx)
 	if (!key)
 		return;
 
+	mesh_db_batch_begin();
 	l_queue_destroy(key->app_keys, delete_bound_appkey);
+	mesh_db_batch_end();
 	l_free(key);
 }
 
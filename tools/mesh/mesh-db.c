@@ -41,9 +41,18 @@
 struct mesh_db {
 	json_object *jcfg;
 	char *cfg_fname;
+	struct l_hashmap *node_addrs;
+	struct l_hashmap *node_uuids;
+	unsigned int batch;
+	bool dirty;
 	uint8_t token[8];
 };
 
+struct mesh_db_export {
+	json_object *jcfg;
+	struct l_hashmap *node_addrs;
+};
+
 static struct mesh_db *cfg;
 static const char *bak_ext = ".bak";
 static const char *tmp_ext = ".tmp";
@@ -110,7 +119,7 @@ static bool save_config_file(const char *fname)
 	return result;
 }
 
-static bool save_config(void)
+static bool write_config(void)
 {
 	char *fname_tmp, *fname_bak, *fname_cfg;
 	bool result = false;
@@ -136,46 +145,129 @@ static bool save_config(void)
 	return result;
 }
 
+/* Within a batch, changes are only written out when the batch ends */
+static bool save_config(void)
+{
+	if (cfg->batch) {
+		cfg->dirty = true;
+		return true;
+	}
+
+	return write_config();
+}
+
+void mesh_db_batch_begin(void)
+{
+	if (cfg)
+		cfg->batch++;
+}
+
+bool mesh_db_batch_end(void)
+{
+	if (!cfg || !cfg->batch)
+		return false;
+
+	if (--cfg->batch || !cfg->dirty)
+		return true;
+
+	cfg->dirty = false;
+
+	return write_config();
+}
+
 static void release_config(void)
 {
+	l_hashmap_destroy(cfg->node_addrs, NULL);
+	l_hashmap_destroy(cfg->node_uuids, NULL);
 	l_free(cfg->cfg_fname);
 	json_object_put(cfg->jcfg);
 	l_free(cfg);
 	cfg = NULL;
 }
 
-static json_object *get_node_by_unicast(json_object *jcfg, uint16_t unicast)
+static bool get_node_unicast(json_object *jnode, uint16_t *unicast)
 {
-	json_object *jarray;
-	int i, sz;
+	json_object *jval;
+	const char *str;
 
-	if (!json_object_object_get_ex(jcfg, "nodes", &jarray))
+	if (!json_object_object_get_ex(jnode, "unicastAddress", &jval))
+		return false;
+
+	str = json_object_get_string(jval);
+
+	return str && sscanf(str, "%04hx", unicast) == 1;
+}
+
+static const char *get_node_uuid(json_object *jnode)
+{
+	json_object *jval;
+	const char *str;
+
+	if (!json_object_object_get_ex(jnode, "UUID", &jval))
 		return NULL;
 
-	if (!jarray || json_object_get_type(jarray) != json_type_array)
+	str = json_object_get_string(jval);
+	if (!str || strlen(str) != 36)
 		return NULL;
 
-	sz = json_object_array_length(jarray);
+	return str;
+}
 
-	for (i = 0; i < sz; ++i) {
-		json_object *jentry, *jval;
-		uint16_t addr;
-		const char *str;
+/* Duplicates keep the first node found, as a scan of the array would */
+static void index_node(struct l_hashmap *node_addrs,
+			struct l_hashmap *node_uuids, json_object *jnode)
+{
+	const char *uuid;
+	uint16_t unicast;
 
-		jentry = json_object_array_get_idx(jarray, i);
-		if (!json_object_object_get_ex(jentry, "unicastAddress",
-								&jval))
-			return NULL;
+	if (get_node_unicast(jnode, &unicast) &&
+			!l_hashmap_lookup(node_addrs, L_UINT_TO_PTR(unicast)))
+		l_hashmap_insert(node_addrs, L_UINT_TO_PTR(unicast), jnode);
 
-		str = json_object_get_string(jval);
-		if (sscanf(str, "%04hx", &addr) != 1)
-			continue;
+	uuid = get_node_uuid(jnode);
 
-		if (addr == unicast)
-			return jentry;
-	}
+	if (node_uuids && uuid && !l_hashmap_lookup(node_uuids, uuid))
+		l_hashmap_insert(node_uuids, uuid, jnode);
+}
 
-	return NULL;
+static void unindex_node(json_object *jnode)
+{
+	const char *uuid;
+	uint16_t unicast;
+
+	if (get_node_unicast(jnode, &unicast) &&
+			l_hashmap_lookup(cfg->node_addrs,
+					L_UINT_TO_PTR(unicast)) == jnode)
+		l_hashmap_remove(cfg->node_addrs, L_UINT_TO_PTR(unicast));
+
+	uuid = get_node_uuid(jnode);
+
+	if (uuid && l_hashmap_lookup(cfg->node_uuids, uuid) == jnode)
+		l_hashmap_remove(cfg->node_uuids, uuid);
+}
+
+static void index_nodes(json_object *jcfg, struct l_hashmap *node_addrs,
+						struct l_hashmap *node_uuids)
+{
+	json_object *jarray;
+	int i, sz;
+
+	if (!json_object_object_get_ex(jcfg, "nodes", &jarray))
+		return;
+
+	if (!jarray || json_object_get_type(jarray) != json_type_array)
+		return;
+
+	sz = json_object_array_length(jarray);
+
+	for (i = 0; i < sz; ++i)
+		index_node(node_addrs, node_uuids,
+					json_object_array_get_idx(jarray, i));
+}
+
+static json_object *get_node_by_unicast(uint16_t unicast)
+{
+	return l_hashmap_lookup(cfg->node_addrs, L_UINT_TO_PTR(unicast));
 }
 
 static bool get_int(json_object *jobj, const char *keyword, int *value)
@@ -297,38 +389,14 @@ static bool write_uint32_hex(json_object *jobj, const char *desc, uint32_t val)
 	return true;
 }
 
-static json_object *get_node_by_uuid(json_object *jcfg, uint8_t uuid[16])
+static json_object *get_node_by_uuid(uint8_t uuid[16])
 {
-	json_object *jarray = NULL;
 	char buf[37];
-	int i, sz;
 
 	if (!l_uuid_to_string(uuid, buf, sizeof(buf)))
 		return NULL;
 
-	json_object_object_get_ex(jcfg, "nodes", &jarray);
-	if (!jarray || json_object_get_type(jarray) != json_type_array)
-		return NULL;
-
-	sz = json_object_array_length(jarray);
-
-	for (i = 0; i < sz; ++i) {
-		json_object *jentry, *jval;
-		const char *str;
-
-		jentry = json_object_array_get_idx(jarray, i);
-		if (!json_object_object_get_ex(jentry, "UUID", &jval))
-			return NULL;
-
-		str = json_object_get_string(jval);
-		if (strlen(str) != 36)
-			continue;
-
-		if (!strcmp(buf, str))
-			return jentry;
-	}
-
-	return NULL;
+	return l_hashmap_lookup(cfg->node_uuids, buf);
 }
 
 static bool add_u8_8(json_object *jobj, const char *desc,
@@ -487,114 +555,120 @@ static bool load_composition(json_object *jnode, uint16_t unicast)
 	return true;
 }
 
-static void load_remotes(json_object *jcfg)
+static bool load_remote(json_object *jnode)
 {
-	json_object *jnodes;
-	int i, sz, node_count = 0;
-
-	json_object_object_get_ex(jcfg, "nodes", &jnodes);
-	if (!jnodes || json_object_get_type(jnodes) != json_type_array)
-		return;
+	json_object *jval, *jarray;
+	uint8_t uuid[16];
+	uint16_t unicast, key_idx;
+	const char *str;
+	uint8_t ele_cnt;
+	int key_cnt;
+	int j;
 
-	sz = json_object_array_length(jnodes);
+	if (!json_object_object_get_ex(jnode, "UUID", &jval))
+		return false;
 
-	for (i = 0; i < sz; ++i) {
-		json_object *jnode, *jval, *jarray;
-		uint8_t uuid[16];
-		uint16_t unicast, key_idx;
-		const char *str;
-		uint8_t ele_cnt;
-		int key_cnt;
-		int j;
+	str = json_object_get_string(jval);
+	if (strlen(str) != 36)
+		return false;
 
-		jnode = json_object_array_get_idx(jnodes, i);
-		if (!jnode)
-			continue;
+	if (!l_uuid_from_string(str, uuid))
+		return false;
 
-		if (!json_object_object_get_ex(jnode, "UUID", &jval))
-			continue;
+	if (!json_object_object_get_ex(jnode, "unicastAddress", &jval))
+		return false;
 
-		str = json_object_get_string(jval);
-		if (strlen(str) != 36)
-			continue;
+	str = json_object_get_string(jval);
+	if (sscanf(str, "%04hx", &unicast) != 1)
+		return false;
 
-		if (!l_uuid_from_string(str, uuid))
-			continue;
+	json_object_object_get_ex(jnode, "elements", &jarray);
+	if (!jarray || json_object_get_type(jarray) != json_type_array ||
+			json_object_array_length(jarray) > MAX_ELE_COUNT)
+		return false;
 
-		if (!json_object_object_get_ex(jnode, "unicastAddress", &jval))
-			continue;
+	ele_cnt = json_object_array_length(jarray);
 
-		str = json_object_get_string(jval);
-		if (sscanf(str, "%04hx", &unicast) != 1)
-			continue;
+	json_object_object_get_ex(jnode, "netKeys", &jarray);
+	if (!jarray || json_object_get_type(jarray) != json_type_array)
+		return false;
 
-		json_object_object_get_ex(jnode, "elements", &jarray);
-		if (!jarray ||
-			json_object_get_type(jarray) != json_type_array ||
-			json_object_array_length(jarray) > MAX_ELE_COUNT)
-			continue;
+	key_cnt = json_object_array_length(jarray);
+	if (key_cnt < 0)
+		return false;
 
-		ele_cnt = json_object_array_length(jarray);
+	key_idx = node_parse_key(jarray, 0);
+	if (key_idx == KEY_IDX_INVALID)
+		return false;
 
-		json_object_object_get_ex(jnode, "netKeys", &jarray);
-		if (!jarray || json_object_get_type(jarray) != json_type_array)
-			continue;
+	remote_add_node((const uint8_t *)uuid, unicast, ele_cnt, key_idx);
+	for (j = 1; j < key_cnt; j++) {
+		bool updated = false;
 
-		key_cnt = json_object_array_length(jarray);
-		if (key_cnt < 0)
-			continue;
+		key_idx = node_parse_key(jarray, j);
 
-		key_idx = node_parse_key(jarray, 0);
 		if (key_idx == KEY_IDX_INVALID)
 			continue;
 
-		remote_add_node((const uint8_t *)uuid, unicast, ele_cnt,
-								key_idx);
-		for (j = 1; j < key_cnt; j++) {
-			bool updated = false;
+		remote_add_net_key(unicast, key_idx, false);
 
-			key_idx = node_parse_key(jarray, j);
+		node_check_key_updated(jarray, j, &updated);
+		remote_update_net_key(unicast, key_idx, updated, false);
+	}
 
-			if (key_idx == KEY_IDX_INVALID)
-				continue;
+	json_object_object_get_ex(jnode, "appKeys", &jarray);
+	if (!jarray || json_object_get_type(jarray) != json_type_array)
+		return false;
 
-			remote_add_net_key(unicast, key_idx, false);
+	key_cnt = json_object_array_length(jarray);
 
-			node_check_key_updated(jarray, j, &updated);
-			remote_update_net_key(unicast, key_idx, updated, false);
-		}
+	for (j = 0; j < key_cnt; j++) {
+		bool updated = false;
 
-		json_object_object_get_ex(jnode, "appKeys", &jarray);
-		if (!jarray || json_object_get_type(jarray) != json_type_array)
+		key_idx = node_parse_key(jarray, j);
+
+		if (key_idx == KEY_IDX_INVALID)
 			continue;
 
-		key_cnt = json_object_array_length(jarray);
+		remote_add_app_key(unicast, key_idx, false);
 
-		for (j = 0; j < key_cnt; j++) {
-			bool updated = false;
+		node_check_key_updated(jarray, j, &updated);
+		remote_update_app_key(unicast, key_idx, updated, false);
+	}
 
-			key_idx = node_parse_key(jarray, j);
+	if (!load_composition(jnode, unicast))
+		return false;
 
-			if (key_idx == KEY_IDX_INVALID)
-				continue;
+	/* If "crpl" is present, composition's is available */
+	jval = NULL;
+	if (json_object_object_get_ex(jnode, "crpl", &jval) && jval)
+		remote_set_composition(unicast, true);
 
-			remote_add_app_key(unicast, key_idx, false);
+	/* TODO: Add the rest of the configuration */
 
-			node_check_key_updated(jarray, j, &updated);
-			remote_update_app_key(unicast, key_idx, updated, false);
-		}
+	return true;
+}
 
-		if (!load_composition(jnode, unicast))
-			continue;
+static void load_remotes(json_object *jcfg)
+{
+	json_object *jnodes;
+	int i, sz, node_count = 0;
 
-		/* If "crpl" is present, composition's is available */
-		jval = NULL;
-		if (json_object_object_get_ex(jnode, "crpl", &jval) && jval)
-			remote_set_composition(unicast, true);
+	json_object_object_get_ex(jcfg, "nodes", &jnodes);
+	if (!jnodes || json_object_get_type(jnodes) != json_type_array)
+		return;
 
-		/* TODO: Add the rest of the configuration */
+	sz = json_object_array_length(jnodes);
+
+	for (i = 0; i < sz; ++i) {
+		json_object *jnode;
 
-		node_count++;
+		jnode = json_object_array_get_idx(jnodes, i);
+		if (!jnode)
+			continue;
+
+		if (load_remote(jnode))
+			node_count++;
 	}
 
 	if (node_count != sz)
@@ -664,7 +738,7 @@ bool mesh_db_node_set_ttl(uint16_t unicast, uint8_t ttl)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -704,7 +778,7 @@ bool mesh_db_node_set_net_transmit(uint16_t unicast, uint8_t cnt,
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -741,7 +815,7 @@ bool mesh_db_node_set_relay(uint16_t unicast, uint8_t relay, uint8_t cnt,
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -759,7 +833,7 @@ bool mesh_db_node_set_proxy(uint16_t unicast, uint8_t proxy)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -773,7 +847,7 @@ bool mesh_db_node_set_friend(uint16_t unicast, uint8_t friend)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -787,7 +861,7 @@ bool mesh_db_node_set_beacon(uint16_t unicast, bool enabled)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -802,7 +876,7 @@ static json_object *get_element(uint16_t unicast, uint16_t ele_addr)
 	json_object *jnode, *jarray;
 	int i, ele_cnt;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1210,7 +1284,7 @@ bool mesh_db_node_set_hb_pub(uint16_t unicast, uint16_t dst, uint16_t net_idx,
 	if (period_log > 0x12 || ttl > 0x7F)
 		return  false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1269,7 +1343,7 @@ bool mesh_db_node_set_hb_sub(uint16_t unicast, uint16_t src, uint16_t dst)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1331,7 +1405,7 @@ bool mesh_db_node_add_net_key(uint16_t unicast, uint16_t idx)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1345,7 +1419,7 @@ bool mesh_db_node_del_net_key(uint16_t unicast, uint16_t net_idx)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1361,7 +1435,7 @@ static bool key_update(uint16_t unicast, int16_t idx, bool updated,
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1398,7 +1472,7 @@ bool mesh_db_node_add_app_key(uint16_t unicast, uint16_t idx)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1412,7 +1486,7 @@ bool mesh_db_node_del_app_key(uint16_t unicast, uint16_t idx)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -1709,14 +1783,20 @@ bool mesh_db_reset_node(uint16_t original, uint16_t unicast, uint8_t num_els)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, original);
+	jnode = get_node_by_unicast(original);
 	if (!jnode) {
 		l_error("Node %4.4x does not exist", original);
 		return false;
 	}
 
-	if (!write_uint16_hex(jnode, "unicastAddress", unicast))
+	unindex_node(jnode);
+
+	if (!write_uint16_hex(jnode, "unicastAddress", unicast)) {
+		index_node(cfg->node_addrs, cfg->node_uuids, jnode);
 		return false;
+	}
+
+	index_node(cfg->node_addrs, cfg->node_uuids, jnode);
 
 	json_object_object_del(jnode, "elements");
 	jelements = init_elements(num_els);
@@ -1735,7 +1815,7 @@ bool mesh_db_add_node(uint8_t uuid[16], uint8_t num_els, uint16_t unicast,
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_uuid(cfg->jcfg, uuid);
+	jnode = get_node_by_uuid(uuid);
 	if (jnode) {
 		l_error("Node already exists");
 		return false;
@@ -1786,6 +1866,7 @@ bool mesh_db_add_node(uint8_t uuid[16], uint8_t num_els, uint16_t unicast,
 		goto fail;
 
 	json_object_array_add(jnodes, jnode);
+	index_node(cfg->node_addrs, cfg->node_uuids, jnode);
 
 	return save_config();
 
@@ -1796,7 +1877,7 @@ fail:
 
 bool mesh_db_del_node(uint16_t unicast)
 {
-	json_object *jarray;
+	json_object *jarray, *jnode;
 	int i, sz;
 
 	if (!json_object_object_get_ex(cfg->jcfg, "nodes", &jarray))
@@ -1805,29 +1886,21 @@ bool mesh_db_del_node(uint16_t unicast)
 	if (!jarray || json_object_get_type(jarray) != json_type_array)
 		return false;
 
+	jnode = get_node_by_unicast(unicast);
+	if (!jnode)
+		return true;
+
 	sz = json_object_array_length(jarray);
 
 	for (i = 0; i < sz; ++i) {
-		json_object *jentry, *jval;
-		uint16_t addr;
-		const char *str;
-
-		jentry = json_object_array_get_idx(jarray, i);
-		if (!json_object_object_get_ex(jentry, "unicastAddress",
-								&jval))
-			continue;
-
-		str = json_object_get_string(jval);
-		if (sscanf(str, "%04hx", &addr) != 1)
-			continue;
-
-		if (addr == unicast)
+		if (json_object_array_get_idx(jarray, i) == jnode)
 			break;
 	}
 
 	if (i == sz)
 		return true;
 
+	unindex_node(jnode);
 	json_object_array_del_idx(jarray, i, 1);
 
 	return save_config();
@@ -1883,7 +1956,7 @@ bool mesh_db_node_set_composition(uint16_t unicast, uint8_t *data, uint16_t len)
 	if (!cfg || !cfg->jcfg)
 		return false;
 
-	jnode = get_node_by_unicast(cfg->jcfg, unicast);
+	jnode = get_node_by_unicast(unicast);
 	if (!jnode)
 		return false;
 
@@ -2328,6 +2401,8 @@ bool mesh_db_create(const char *fname, const uint8_t token[8],
 	cfg = l_new(struct mesh_db, 1);
 	cfg->jcfg = jcfg;
 	cfg->cfg_fname = l_strdup(fname);
+	cfg->node_addrs = l_hashmap_new();
+	cfg->node_uuids = l_hashmap_string_new();
 	memcpy(cfg->token, token, 8);
 
 	if (!add_u8_8(jcfg, "token", token))
@@ -2387,7 +2462,7 @@ fail:
 	return false;
 }
 
-bool mesh_db_load(const char *fname)
+static json_object *read_config_file(const char *fname)
 {
 	int fd;
 	char *str;
@@ -2397,17 +2472,17 @@ bool mesh_db_load(const char *fname)
 
 	fd = open(fname, O_RDONLY);
 	if (fd < 0)
-		return false;
+		return NULL;
 
 	if (fstat(fd, &st) == -1) {
 		close(fd);
-		return false;
+		return NULL;
 	}
 
 	str = (char *) l_new(char, st.st_size + 1);
 	if (!str) {
 		close(fd);
-		return false;
+		return NULL;
 	}
 
 	sz = read(fd, str, st.st_size);
@@ -2415,7 +2490,7 @@ bool mesh_db_load(const char *fname)
 		close(fd);
 		l_free(str);
 		l_error("Failed to read configuration file %s", fname);
-		return false;
+		return NULL;
 	}
 
 	jcfg = json_tokener_parse(str);
@@ -2423,6 +2498,14 @@ bool mesh_db_load(const char *fname)
 	close(fd);
 	l_free(str);
 
+	return jcfg;
+}
+
+bool mesh_db_load(const char *fname)
+{
+	json_object *jcfg;
+
+	jcfg = read_config_file(fname);
 	if (!jcfg)
 		return false;
 
@@ -2430,12 +2513,16 @@ bool mesh_db_load(const char *fname)
 
 	cfg->jcfg = jcfg;
 	cfg->cfg_fname = l_strdup(fname);
+	cfg->node_addrs = l_hashmap_new();
+	cfg->node_uuids = l_hashmap_string_new();
 
 	if (!get_token(jcfg, cfg->token)) {
 		l_error("Configuration file missing token");
 		goto fail;
 	}
 
+	index_nodes(jcfg, cfg->node_addrs, cfg->node_uuids);
+
 	if (!load_keys(jcfg))
 		goto fail;
 
@@ -2450,14 +2537,176 @@ fail:
 	return false;
 }
 
+/* Checks that an exported node is complete and does not clash with ours */
+static bool check_import_node(json_object *jnode, uint8_t uuid[16],
+					uint16_t *unicast, uint8_t *ele_cnt,
+					uint16_t *net_idx)
+{
+	json_object *jarray;
+	const char *str;
+	int cnt, i;
+
+	str = get_node_uuid(jnode);
+	if (!str || !l_uuid_from_string(str, uuid) ||
+					!get_node_unicast(jnode, unicast))
+		return false;
+
+	if (get_node_by_uuid(uuid)) {
+		l_info("Node %s is already known", str);
+		return false;
+	}
+
+	if (!json_object_object_get_ex(jnode, "elements", &jarray) ||
+			json_object_get_type(jarray) != json_type_array)
+		return false;
+
+	cnt = json_object_array_length(jarray);
+	if (!cnt || cnt > MAX_ELE_COUNT || !IS_UNICAST_RANGE(*unicast, cnt))
+		return false;
+
+	for (i = 0; i < cnt; i++) {
+		if (remote_ele_cnt(*unicast + i)) {
+			l_info("Address %4.4x of node %s is in use",
+							*unicast + i, str);
+			return false;
+		}
+	}
+
+	if (!json_object_object_get_ex(jnode, "netKeys", &jarray) ||
+			json_object_get_type(jarray) != json_type_array)
+		return false;
+
+	*net_idx = node_parse_key(jarray, 0);
+	if (*net_idx == KEY_IDX_INVALID)
+		return false;
+
+	*ele_cnt = cnt;
+
+	return true;
+}
+
+static bool import_node(json_object *jnode, mesh_db_import_func_t cb,
+							void *user_data)
+{
+	json_object *jcopy = NULL, *jval;
+	uint8_t uuid[16], dev_key[16];
+	uint16_t unicast, net_idx;
+	uint8_t ele_cnt;
+	const char *str;
+
+	if (!check_import_node(jnode, uuid, &unicast, &ele_cnt, &net_idx))
+		return false;
+
+	/* The daemon cannot talk to a node without its device key */
+	if (!json_object_object_get_ex(jnode, "deviceKey", &jval))
+		goto no_key;
+
+	str = json_object_get_string(jval);
+	if (!str || strlen(str) != 32 || !str2hex(str, 32, dev_key, 16))
+		goto no_key;
+
+	if (json_object_deep_copy(jnode, &jcopy, NULL) != 0)
+		return false;
+
+	/* Device keys live with the daemon, never in the database */
+	json_object_object_del(jcopy, "deviceKey");
+
+	cb(jcopy, uuid, unicast, ele_cnt, net_idx, dev_key, user_data);
+
+	return true;
+
+no_key:
+	l_info("No device key for node %4.4x", unicast);
+	return false;
+}
+
+/*
+ * Hands each node of an exported database that is not known yet to cb,
+ * which owns it and must pass it to either mesh_db_add_imported_node or
+ * mesh_db_free_imported_node. Returns the number of nodes handed over.
+ */
+int mesh_db_import_nodes(const char *fname, mesh_db_import_func_t cb,
+							void *user_data)
+{
+	json_object *jimport, *jnodes;
+	int i, sz, count = 0;
+
+	if (!cfg || !cfg->jcfg || !cb)
+		return -1;
+
+	jimport = read_config_file(fname);
+	if (!jimport)
+		return -1;
+
+	if (!json_object_object_get_ex(jimport, "nodes", &jnodes) ||
+			json_object_get_type(jnodes) != json_type_array) {
+		json_object_put(jimport);
+		return -1;
+	}
+
+	sz = json_object_array_length(jnodes);
+
+	for (i = 0; i < sz; i++) {
+		if (import_node(json_object_array_get_idx(jnodes, i), cb,
+								user_data))
+			count++;
+	}
+
+	json_object_put(jimport);
+
+	if (count != sz)
+		l_warn("Importing %d of %d nodes from %s", count, sz, fname);
+
+	return count;
+}
+
+/* Adds a node handed out by mesh_db_import_nodes once the daemon has it */
+bool mesh_db_add_imported_node(void *node)
+{
+	json_object *jnode = node, *jnodes;
+	uint8_t uuid[16];
+	uint16_t unicast, net_idx;
+	uint8_t ele_cnt;
+
+	if (!cfg || !cfg->jcfg || !jnode)
+		goto fail;
+
+	if (!json_object_object_get_ex(cfg->jcfg, "nodes", &jnodes) ||
+			json_object_get_type(jnodes) != json_type_array)
+		goto fail;
+
+	/* Something else may have taken it since the import started */
+	if (!check_import_node(jnode, uuid, &unicast, &ele_cnt, &net_idx))
+		goto fail;
+
+	json_object_array_add(jnodes, jnode);
+	index_node(cfg->node_addrs, cfg->node_uuids, jnode);
+
+	/* As on load, the node is kept even if its configuration is not */
+	if (!load_remote(jnode))
+		l_warn("Configuration of node %4.4x is incomplete", unicast);
+
+	return save_config();
+
+fail:
+	json_object_put(jnode);
+	return false;
+}
+
+void mesh_db_free_imported_node(void *node)
+{
+	json_object_put(node);
+}
+
 bool mesh_db_set_device_key(void *expt_cfg, uint16_t unicast, uint8_t key[16])
 {
+	struct mesh_db_export *expt = expt_cfg;
 	json_object *jnode;
 
-	if (!expt_cfg)
+	if (!expt)
 		return false;
 
-	jnode = get_node_by_unicast(expt_cfg, unicast);
+	jnode = l_hashmap_lookup(expt->node_addrs, L_UINT_TO_PTR(unicast));
 	if (!jnode)
 		return false;
 
@@ -2467,12 +2716,13 @@ bool mesh_db_set_device_key(void *expt_cfg, uint16_t unicast, uint8_t key[16])
 bool mesh_db_set_net_key(void *expt_cfg, uint16_t idx, uint8_t key[16],
 					uint8_t *old_key, uint8_t phase)
 {
+	struct mesh_db_export *expt = expt_cfg;
 	json_object *jarray, *jkey;
 
-	if (!expt_cfg)
+	if (!expt)
 		return false;
 
-	json_object_object_get_ex(expt_cfg, "netKeys", &jarray);
+	json_object_object_get_ex(expt->jcfg, "netKeys", &jarray);
 	if (!jarray || json_object_get_type(jarray) != json_type_array)
 		return false;
 
@@ -2496,12 +2746,13 @@ bool mesh_db_set_net_key(void *expt_cfg, uint16_t idx, uint8_t key[16],
 bool mesh_db_set_app_key(void *expt_cfg, uint16_t net_idx, uint16_t app_idx,
 					uint8_t key[16], uint8_t *old_key)
 {
+	struct mesh_db_export *expt = expt_cfg;
 	json_object *jarray, *jkey;
 
-	if (!expt_cfg)
+	if (!expt)
 		return false;
 
-	json_object_object_get_ex(expt_cfg, "appKeys", &jarray);
+	json_object_object_get_ex(expt->jcfg, "appKeys", &jarray);
 	if (!jarray || json_object_get_type(jarray) != json_type_array)
 		return false;
 
@@ -2520,6 +2771,7 @@ bool mesh_db_set_app_key(void *expt_cfg, uint16_t net_idx, uint16_t app_idx,
 
 void *mesh_db_prepare_export(void)
 {
+	struct mesh_db_export *expt;
 	json_object *export = NULL, *jarray;
 
 	if (!cfg || !cfg->jcfg)
@@ -2541,11 +2793,25 @@ void *mesh_db_prepare_export(void)
 	if (!write_bool(export, "partial", false))
 		l_warn("Failed to write\"partial\" property");
 
-	return export;
+	/* Device keys are filled in per node, look them up by address */
+	expt = l_new(struct mesh_db_export, 1);
+	expt->jcfg = export;
+	expt->node_addrs = l_hashmap_new();
+	index_nodes(export, expt->node_addrs, NULL);
+
+	return expt;
+}
+
+static void free_export(struct mesh_db_export *expt)
+{
+	l_hashmap_destroy(expt->node_addrs, NULL);
+	json_object_put(expt->jcfg);
+	l_free(expt);
 }
 
 bool mesh_db_finish_export(bool is_error, void *expt_cfg, const char *fname)
 {
+	struct mesh_db_export *expt = expt_cfg;
 	FILE *outfile = NULL;
 	const char *str, *hdr;
 	json_object *jhdr = NULL;
@@ -2554,11 +2820,11 @@ bool mesh_db_finish_export(bool is_error, void *expt_cfg, const char *fname)
 
 	uint32_t sz;
 
-	if (!expt_cfg)
+	if (!expt)
 		return false;
 
 	if (is_error) {
-		json_object_put(expt_cfg);
+		free_export(expt);
 		return true;
 	}
 
@@ -2584,7 +2850,7 @@ bool mesh_db_finish_export(bool is_error, void *expt_cfg, const char *fname)
 	hdr = json_object_to_json_string_ext(jhdr, JSON_C_TO_STRING_PRETTY |
 						JSON_C_TO_STRING_NOSLASHESCAPE);
 
-	str = json_object_to_json_string_ext(expt_cfg, JSON_C_TO_STRING_PRETTY |
+	str = json_object_to_json_string_ext(expt->jcfg, JSON_C_TO_STRING_PRETTY |
 						JSON_C_TO_STRING_NOSLASHESCAPE);
 
 	if (!hdr || !str)
@@ -2627,7 +2893,7 @@ done:
 	if (outfile)
 		fclose(outfile);
 
-	json_object_put(expt_cfg);
+	free_export(expt);
 
 	if (jhdr)
 		json_object_put(jhdr);
@@ -13,9 +13,21 @@
 struct mesh_group;
 struct model_pub;
 
+typedef void (*mesh_db_import_func_t)(void *node, const uint8_t uuid[16],
+					uint16_t unicast, uint8_t ele_cnt,
+					uint16_t net_idx,
+					const uint8_t dev_key[16],
+					void *user_data);
+
 bool mesh_db_create(const char *fname, const uint8_t token[8],
 							const char *name);
 bool mesh_db_load(const char *fname);
+void mesh_db_batch_begin(void);
+bool mesh_db_batch_end(void);
+int mesh_db_import_nodes(const char *fname, mesh_db_import_func_t cb,
+							void *user_data);
+bool mesh_db_add_imported_node(void *node);
+void mesh_db_free_imported_node(void *node);
 
 bool mesh_db_get_token(uint8_t token[8]);
 bool mesh_db_set_iv_index(uint32_t ivi);
@@ -53,7 +53,9 @@ struct rejected_addr {
 	uint16_t unicast;
 };
 
+/* Sorted by unicast, with every element address indexed */
 static struct l_queue *nodes;
+static struct l_hashmap *node_addrs;
 static struct l_queue *reject_list;
 
 static bool match_mod_id(const void *a, const void *b)
@@ -95,16 +97,35 @@ static int compare_unicast(const void *a, const void *b, void *user_data)
 	return 0;
 }
 
-static bool match_node_addr(const void *a, const void *b)
+static struct remote_node *get_node(uint16_t addr)
 {
-	const struct remote_node *rmt = a;
-	uint16_t addr = L_PTR_TO_UINT(b);
+	return l_hashmap_lookup(node_addrs, L_UINT_TO_PTR(addr));
+}
 
-	if (addr >= rmt->unicast &&
-				addr <= (rmt->unicast + rmt->num_ele - 1))
-		return true;
+static void add_node(struct remote_node *rmt)
+{
+	struct remote_node *tail = l_queue_peek_tail(nodes);
+	uint8_t i;
 
-	return false;
+	/* Nodes are mostly added, and loaded, in ascending order */
+	if (!tail || tail->unicast < rmt->unicast)
+		l_queue_push_tail(nodes, rmt);
+	else
+		l_queue_insert(nodes, rmt, compare_unicast, NULL);
+
+	for (i = 0; i < rmt->num_ele; i++)
+		l_hashmap_insert(node_addrs, L_UINT_TO_PTR(rmt->unicast + i),
+									rmt);
+}
+
+static void remove_node(struct remote_node *rmt)
+{
+	uint8_t i;
+
+	l_queue_remove(nodes, rmt);
+
+	for (i = 0; i < rmt->num_ele; i++)
+		l_hashmap_remove(node_addrs, L_UINT_TO_PTR(rmt->unicast + i));
 }
 
 static bool match_key(const void *a, const void *b)
@@ -129,12 +150,16 @@ uint8_t remote_del_node(uint16_t unicast)
 	uint8_t num_ele, i;
 	uint32_t iv_index = mesh_db_get_iv_index();
 
-	rmt = l_queue_remove_if(nodes, match_node_addr, L_UINT_TO_PTR(unicast));
+	rmt = get_node(unicast);
 	if (!rmt)
 		return 0;
 
+	remove_node(rmt);
+
 	num_ele = rmt->num_ele;
 
+	mesh_db_batch_begin();
+
 	for (i = 0; i < num_ele; ++i) {
 		l_queue_destroy(rmt->els[i], NULL);
 		remote_add_rejected_address(unicast + i, iv_index, true);
@@ -142,12 +167,14 @@ uint8_t remote_del_node(uint16_t unicast)
 
 	l_free(rmt->els);
 
-	l_queue_destroy(rmt->net_keys, NULL);
-	l_queue_destroy(rmt->app_keys, NULL);
+	l_queue_destroy(rmt->net_keys, l_free);
+	l_queue_destroy(rmt->app_keys, l_free);
 	l_free(rmt);
 
 	mesh_db_del_node(unicast);
 
+	mesh_db_batch_end();
+
 	return num_ele;
 }
 
@@ -158,11 +185,12 @@ bool remote_reset_node(uint16_t original, uint16_t unicast, uint8_t ele_cnt,
 	bool reject = true;
 	int i;
 
-	rmt = l_queue_remove_if(nodes, match_node_addr,
-						L_UINT_TO_PTR(original));
+	rmt = get_node(original);
 	if (!rmt)
 		return false;
 
+	remove_node(rmt);
+
 	if (unicast == rmt->unicast)
 		reject = false;
 
@@ -181,7 +209,7 @@ bool remote_reset_node(uint16_t original, uint16_t unicast, uint8_t ele_cnt,
 
 	rmt->unicast = unicast;
 	rmt->num_ele = ele_cnt;
-	l_queue_insert(nodes, rmt, compare_unicast, NULL);
+	add_node(rmt);
 	return true;
 }
 
@@ -191,8 +219,7 @@ bool remote_add_node(const uint8_t uuid[16], uint16_t unicast,
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(unicast));
-	if (rmt)
+	if (get_node(unicast))
 		return false;
 
 	rmt = l_new(struct remote_node, 1);
@@ -208,10 +235,12 @@ bool remote_add_node(const uint8_t uuid[16], uint16_t unicast,
 
 	rmt->els = l_new(struct l_queue *, ele_cnt);
 
-	if (!nodes)
+	if (!nodes) {
 		nodes = l_queue_new();
+		node_addrs = l_hashmap_new();
+	}
 
-	l_queue_insert(nodes, rmt, compare_unicast, NULL);
+	add_node(rmt);
 
 	return true;
 }
@@ -221,7 +250,7 @@ bool remote_set_model(uint16_t unicast, uint8_t ele_idx, uint32_t mod_id,
 {
 	struct remote_node *rmt;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(unicast));
+	rmt = get_node(unicast);
 	if (!rmt)
 		return false;
 
@@ -248,7 +277,7 @@ void remote_set_composition(uint16_t addr, bool comp)
 {
 	struct remote_node *rmt;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return;
 
@@ -259,7 +288,7 @@ bool remote_has_composition(uint16_t addr)
 {
 	struct remote_node *rmt;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -271,7 +300,7 @@ bool remote_add_net_key(uint16_t addr, uint16_t net_idx, bool save)
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -294,7 +323,7 @@ bool remote_del_net_key(uint16_t addr, uint16_t net_idx)
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -303,6 +332,7 @@ bool remote_del_net_key(uint16_t addr, uint16_t net_idx)
 	if (!key)
 		return false;
 
+	mesh_db_batch_begin();
 	mesh_db_node_del_net_key(addr, net_idx);
 
 	l_free(key);
@@ -317,6 +347,8 @@ bool remote_del_net_key(uint16_t addr, uint16_t net_idx)
 						L_UINT_TO_PTR(net_idx));
 	}
 
+	mesh_db_batch_end();
+
 	return true;
 }
 
@@ -326,7 +358,7 @@ bool remote_update_net_key(uint16_t addr, uint16_t net_idx, bool update,
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -348,7 +380,7 @@ bool remote_add_app_key(uint16_t addr, uint16_t app_idx, bool save)
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -374,7 +406,7 @@ bool remote_del_app_key(uint16_t addr, uint16_t app_idx)
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -391,7 +423,7 @@ bool remote_update_app_key(uint16_t addr, uint16_t app_idx, bool update,
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
@@ -415,12 +447,16 @@ bool remote_finish_key_refresh(uint16_t addr, uint16_t net_idx)
 	const struct l_queue_entry *l;
 	bool res = true;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return false;
 
-	if (!remote_update_net_key(addr, net_idx, false, true))
+	mesh_db_batch_begin();
+
+	if (!remote_update_net_key(addr, net_idx, false, true)) {
+		mesh_db_batch_end();
 		return false;
+	}
 
 	l = l_queue_get_entries(rmt->app_keys);
 
@@ -435,6 +471,8 @@ bool remote_finish_key_refresh(uint16_t addr, uint16_t net_idx)
 		res &= mesh_db_node_update_app_key(addr, key->idx, false);
 	}
 
+	res &= mesh_db_batch_end();
+
 	return res;
 }
 
@@ -443,7 +481,7 @@ uint16_t remote_get_subnet_idx(uint16_t addr)
 	struct remote_node *rmt;
 	struct remote_key *key;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 
 	if (!rmt || l_queue_isempty(rmt->net_keys))
 		return NET_IDX_INVALID;
@@ -562,7 +600,7 @@ void remote_print_node(uint16_t addr)
 	if (!nodes)
 		return;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(addr));
+	rmt = get_node(addr);
 	if (!rmt)
 		return;
 
@@ -724,7 +762,7 @@ uint8_t remote_ele_cnt(uint16_t unicast)
 {
 	struct remote_node *rmt;
 
-	rmt = l_queue_find(nodes, match_node_addr, L_UINT_TO_PTR(unicast));
+	rmt = get_node(unicast);
 
 	if (rmt)
 		return rmt->num_ele;
@@ -5535,6 +5535,10 @@ static const struct generic_data device_found_gtag = {
 	.adv_data = adv_data_invalid_significant_len,
 };
 
+static const struct generic_data device_found_load = {
+	.setup_settings = settings_powered_le,
+};
+
 static const uint8_t adv_data_invalid_field_len[] = { 0x02, 0x01, 0x01,
 		0x05, 0x09, 0x74, 0x65, 0x73, 0x74,
 		0xa0, 0xff, 0x01, 0x02, 0x03, 0x04, 0x05};
@@ -11826,6 +11830,71 @@ static void test_device_found(const void *test_data)
 	test_add_condition(data);
 }
 
+#define ADV_LOAD_RATE		2000
+#define ADV_LOAD_DEVICES	500
+#define ADV_LOAD_EXPECT		4000
+
+static unsigned int adv_load_found;
+static int64_t adv_load_start;
+
+static void adv_load_device_found(uint16_t index, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+	double elapsed;
+
+	if (++adv_load_found != ADV_LOAD_EXPECT)
+		return;
+
+	elapsed = (g_get_monotonic_time() - adv_load_start) / 1000000.0;
+
+	tester_print("%u Device Found events in %.3f s (%.0f events/sec)",
+				adv_load_found, elapsed,
+				elapsed > 0 ? adv_load_found / elapsed : 0);
+	tester_print("%llu advertising reports generated",
+		(unsigned long long) hciemu_get_central_adv_load_count(
+							data->hciemu));
+
+	hciemu_set_central_adv_load(data->hciemu, 0, 0);
+
+	tester_test_passed();
+}
+
+static void adv_load_discovery_callback(uint8_t status, uint16_t length,
+					const void *param, void *user_data)
+{
+	struct test_data *data = tester_get_data();
+
+	if (status != MGMT_STATUS_SUCCESS) {
+		tester_warn("Start Discovery failed: %s (0x%02x)",
+						mgmt_errstr(status), status);
+		tester_test_failed();
+		return;
+	}
+
+	adv_load_found = 0;
+	adv_load_start = g_get_monotonic_time();
+
+	if (hciemu_set_central_adv_load(data->hciemu, ADV_LOAD_RATE,
+						ADV_LOAD_DEVICES) < 0) {
+		tester_warn("Failed to enable advertising load");
+		tester_test_failed();
+	}
+}
+
+static void test_device_found_load(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+
+	mgmt_register(data->mgmt, MGMT_EV_DEVICE_FOUND, data->mgmt_index,
+					adv_load_device_found, NULL, NULL);
+
+	mgmt_send(data->mgmt, MGMT_OP_START_DISCOVERY, data->mgmt_index,
+				sizeof(start_discovery_le_param),
+				start_discovery_le_param,
+				adv_load_discovery_callback, NULL, NULL);
+}
+
 static void pairing_new_conn(uint16_t handle, void *user_data)
 {
 	struct test_data *data = tester_get_data();
@@ -14187,6 +14256,9 @@ int main(int argc, char *argv[])
 	test_bredrle("Device Found - Advertising data - Invalid field",
 				&device_found_invalid_field,
 				NULL, test_device_found);
+	test_bredrle_full("Device Found - Advertising load",
+				&device_found_load,
+				NULL, test_device_found_load, 10);
 
 	test_bredrle50("Read Ext Advertising Features - Success 3 (PHY flags)",
 				&read_adv_features_success_3,
@@ -0,0 +1,511 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "src/shared/util.h"
+#include "tools/perf-stats.h"
+
+/* Log-linear histogram: values below 16 us get their own bucket, above
+ * that each power of two is split in 8 sub-buckets (~12% resolution).
+ */
+#define HIST_LINEAR	16
+#define HIST_SUB_BITS	3
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_SIZE	(HIST_LINEAR + (32 - 4) * HIST_SUB)
+
+#define SEQ_WINDOW	1024
+
+struct perf_hist {
+	uint64_t buckets[HIST_SIZE];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+};
+
+struct perf_counters {
+	uint64_t bytes;
+	uint64_t sdus;
+	uint64_t lost;
+	uint64_t dup;
+	uint64_t reorder;
+	uint64_t invalid;
+	struct perf_hist latency;
+	struct perf_hist jitter;
+};
+
+struct perf_stats {
+	char *name;
+	enum perf_stats_format format;
+	unsigned int report_ms;
+	uint32_t interval_us;
+	bool started;
+	uint64_t start;
+	uint64_t last_report;
+	uint64_t last_rx;
+	bool have_seq;
+	uint32_t high_seq;
+	uint64_t seen[SEQ_WINDOW / 64];
+	bool have_transit;
+	int64_t last_transit;
+	double rfc_jitter;
+	unsigned int reports;
+	struct perf_counters cur;
+	struct perf_counters total;
+};
+
+static const struct {
+	const char *name;
+	enum perf_stats_format format;
+} formats[] = {
+	{ "text", PERF_STATS_TEXT },
+	{ "json", PERF_STATS_JSON },
+	{ "csv", PERF_STATS_CSV },
+};
+
+static uint64_t now_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int hist_index(uint64_t v)
+{
+	unsigned int msb;
+
+	if (v < HIST_LINEAR)
+		return v;
+
+	if (v > UINT32_MAX)
+		v = UINT32_MAX;
+
+	msb = 31 - __builtin_clz(v);
+
+	return HIST_LINEAR + (msb - 4) * HIST_SUB +
+			((v >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+static uint64_t hist_value(unsigned int idx)
+{
+	unsigned int msb, sub;
+
+	if (idx < HIST_LINEAR)
+		return idx;
+
+	msb = (idx - HIST_LINEAR) / HIST_SUB + 4;
+	sub = (idx - HIST_LINEAR) % HIST_SUB;
+
+	return ((uint64_t) (HIST_SUB + sub)) << (msb - HIST_SUB_BITS);
+}
+
+static void hist_add(struct perf_hist *hist, uint64_t v)
+{
+	hist->buckets[hist_index(v)]++;
+
+	if (!hist->count || v < hist->min)
+		hist->min = v;
+
+	if (v > hist->max)
+		hist->max = v;
+
+	hist->count++;
+	hist->sum += v;
+}
+
+static uint64_t hist_percentile(const struct perf_hist *hist,
+						unsigned int percent)
+{
+	uint64_t target, acc = 0;
+	unsigned int i;
+
+	if (!hist->count)
+		return 0;
+
+	target = (hist->count * percent + 99) / 100;
+
+	for (i = 0; i < HIST_SIZE; i++) {
+		acc += hist->buckets[i];
+		if (acc < target)
+			continue;
+
+		/* Bucket lower bound, clamped to the observed range */
+		if (hist_value(i) < hist->min)
+			return hist->min;
+
+		if (hist_value(i) > hist->max)
+			return hist->max;
+
+		return hist_value(i);
+	}
+
+	return hist->max;
+}
+
+static double hist_mean(const struct perf_hist *hist)
+{
+	if (!hist->count)
+		return 0;
+
+	return (double) hist->sum / hist->count;
+}
+
+int perf_stats_parse_format(const char *str)
+{
+	size_t i;
+
+	if (!str)
+		return PERF_STATS_TEXT;
+
+	for (i = 0; i < ARRAY_SIZE(formats); i++) {
+		if (!strcasecmp(formats[i].name, str))
+			return formats[i].format;
+	}
+
+	return -1;
+}
+
+struct perf_stats *perf_stats_new(const char *name,
+					enum perf_stats_format format,
+					unsigned int report_ms)
+{
+	struct perf_stats *stats;
+
+	if (format == PERF_STATS_NONE)
+		return NULL;
+
+	stats = calloc(1, sizeof(*stats));
+	if (!stats)
+		return NULL;
+
+	stats->name = strdup(name);
+	stats->format = format;
+	stats->report_ms = report_ms ? report_ms : 1000;
+
+	return stats;
+}
+
+void perf_stats_free(struct perf_stats *stats)
+{
+	if (!stats)
+		return;
+
+	free(stats->name);
+	free(stats);
+}
+
+void perf_stats_set_interval(struct perf_stats *stats, uint32_t interval_us)
+{
+	if (!stats)
+		return;
+
+	stats->interval_us = interval_us;
+}
+
+void perf_stats_put_header(uint8_t *buf, size_t len, uint32_t seq)
+{
+	if (len < PERF_STATS_HDR_SIZE)
+		return;
+
+	put_le32(seq, buf);
+	put_le16(len, buf + 4);
+	put_le64(now_ns(CLOCK_REALTIME), buf + 6);
+}
+
+static bool seq_seen(struct perf_stats *stats, uint32_t seq)
+{
+	return stats->seen[(seq % SEQ_WINDOW) / 64] & (1ULL << (seq % 64));
+}
+
+static void seq_set(struct perf_stats *stats, uint32_t seq, bool seen)
+{
+	uint64_t *word = &stats->seen[(seq % SEQ_WINDOW) / 64];
+
+	if (seen)
+		*word |= 1ULL << (seq % 64);
+	else
+		*word &= ~(1ULL << (seq % 64));
+}
+
+static void update_seq(struct perf_stats *stats, uint32_t seq)
+{
+	uint32_t gap, i;
+
+	if (!stats->have_seq) {
+		stats->have_seq = true;
+		stats->high_seq = seq;
+		seq_set(stats, seq, true);
+		return;
+	}
+
+	gap = seq - stats->high_seq;
+
+	/* New highest sequence number, anything skipped is lost for now */
+	if (gap && gap < UINT32_MAX / 2) {
+		for (i = 1; i < gap && i < SEQ_WINDOW; i++)
+			seq_set(stats, stats->high_seq + i, false);
+
+		stats->cur.lost += gap - 1;
+		stats->total.lost += gap - 1;
+		stats->high_seq = seq;
+		seq_set(stats, seq, true);
+		return;
+	}
+
+	/* Too old to be tracked, count it as a duplicate */
+	if (stats->high_seq - seq >= SEQ_WINDOW || seq_seen(stats, seq)) {
+		stats->cur.dup++;
+		stats->total.dup++;
+		return;
+	}
+
+	/* Late arrival of something previously counted as lost */
+	seq_set(stats, seq, true);
+
+	stats->cur.reorder++;
+	stats->total.reorder++;
+
+	if (stats->cur.lost)
+		stats->cur.lost--;
+
+	if (stats->total.lost)
+		stats->total.lost--;
+}
+
+static void update_latency(struct perf_stats *stats, uint64_t tx_ns,
+								uint64_t rx_ns)
+{
+	int64_t transit = rx_ns - tx_ns;
+	uint64_t latency_us = transit > 0 ? transit / 1000 : 0;
+	int64_t d;
+
+	hist_add(&stats->cur.latency, latency_us);
+	hist_add(&stats->total.latency, latency_us);
+
+	/* RFC 3550 interarrival jitter estimate */
+	if (stats->have_transit) {
+		d = transit - stats->last_transit;
+		if (d < 0)
+			d = -d;
+
+		stats->rfc_jitter += (d / 1000.0 - stats->rfc_jitter) / 16;
+	}
+
+	stats->have_transit = true;
+	stats->last_transit = transit;
+}
+
+static void update_interval(struct perf_stats *stats, uint64_t rx_ns)
+{
+	int64_t delta;
+
+	if (stats->interval_us && stats->last_rx) {
+		delta = (int64_t) ((rx_ns - stats->last_rx) / 1000) -
+							stats->interval_us;
+		if (delta < 0)
+			delta = -delta;
+
+		hist_add(&stats->cur.jitter, delta);
+		hist_add(&stats->total.jitter, delta);
+	}
+
+	stats->last_rx = rx_ns;
+}
+
+void perf_stats_rx(struct perf_stats *stats, const uint8_t *buf, size_t len)
+{
+	uint64_t rx, mono;
+
+	if (!stats)
+		return;
+
+	rx = now_ns(CLOCK_REALTIME);
+	mono = now_ns(CLOCK_MONOTONIC);
+
+	if (!stats->started) {
+		stats->started = true;
+		stats->start = mono;
+		stats->last_report = mono;
+	}
+
+	stats->cur.bytes += len;
+	stats->cur.sdus++;
+	stats->total.bytes += len;
+	stats->total.sdus++;
+
+	update_interval(stats, mono);
+
+	if (len < PERF_STATS_HDR_SIZE || get_le16(buf + 4) != len) {
+		stats->cur.invalid++;
+		stats->total.invalid++;
+	} else {
+		update_seq(stats, get_le32(buf));
+		update_latency(stats, get_le64(buf + 6), rx);
+	}
+
+	if (mono - stats->last_report >= stats->report_ms * 1000000ULL)
+		perf_stats_report(stats, false);
+}
+
+static void report_text(struct perf_stats *stats, const char *type,
+				const struct perf_counters *c, double secs)
+{
+	syslog(LOG_INFO, "[%s] %s %.2f sec: %" PRIu64 " bytes %.2f kb/s, "
+			"%" PRIu64 " SDUs, lost %" PRIu64 " dup %" PRIu64
+			" reorder %" PRIu64 " invalid %" PRIu64,
+			stats->name, type, secs, c->bytes,
+			secs > 0 ? c->bytes * 8 / secs / 1000 : 0,
+			c->sdus, c->lost, c->dup, c->reorder, c->invalid);
+
+	if (c->latency.count)
+		syslog(LOG_INFO, "[%s] latency min/mean/p50/p90/p99/max "
+			"%" PRIu64 "/%.0f/%" PRIu64 "/%" PRIu64 "/%" PRIu64
+			"/%" PRIu64 " us, jitter %.1f us", stats->name,
+			c->latency.min, hist_mean(&c->latency),
+			hist_percentile(&c->latency, 50),
+			hist_percentile(&c->latency, 90),
+			hist_percentile(&c->latency, 99),
+			c->latency.max, stats->rfc_jitter);
+
+	if (c->jitter.count)
+		syslog(LOG_INFO, "[%s] interval jitter p50/p99/max "
+			"%" PRIu64 "/%" PRIu64 "/%" PRIu64 " us", stats->name,
+			hist_percentile(&c->jitter, 50),
+			hist_percentile(&c->jitter, 99), c->jitter.max);
+}
+
+static void print_hist_json(const char *name, const struct perf_hist *hist)
+{
+	unsigned int i;
+	bool first = true;
+
+	printf(",\"%s\":{\"count\":%" PRIu64 ",\"min\":%" PRIu64
+		",\"mean\":%.1f,\"p50\":%" PRIu64 ",\"p90\":%" PRIu64
+		",\"p99\":%" PRIu64 ",\"max\":%" PRIu64 ",\"buckets\":[",
+		name, hist->count, hist->min, hist_mean(hist),
+		hist_percentile(hist, 50), hist_percentile(hist, 90),
+		hist_percentile(hist, 99), hist->max);
+
+	for (i = 0; i < HIST_SIZE; i++) {
+		if (!hist->buckets[i])
+			continue;
+
+		printf("%s[%" PRIu64 ",%" PRIu64 "]", first ? "" : ",",
+					hist_value(i), hist->buckets[i]);
+		first = false;
+	}
+
+	printf("]}");
+}
+
+static void report_json(struct perf_stats *stats, const char *type,
+				const struct perf_counters *c, double secs)
+{
+	printf("{\"name\":\"%s\",\"type\":\"%s\",\"time\":%.3f,"
+		"\"bytes\":%" PRIu64 ",\"sdus\":%" PRIu64 ",\"kbps\":%.2f,"
+		"\"lost\":%" PRIu64 ",\"duplicate\":%" PRIu64
+		",\"reordered\":%" PRIu64 ",\"invalid\":%" PRIu64
+		",\"jitter_us\":%.1f",
+		stats->name, type, secs, c->bytes, c->sdus,
+		secs > 0 ? c->bytes * 8 / secs / 1000 : 0,
+		c->lost, c->dup, c->reorder, c->invalid, stats->rfc_jitter);
+
+	print_hist_json("latency_us", &c->latency);
+
+	if (stats->interval_us) {
+		printf(",\"interval_us\":%u", stats->interval_us);
+		print_hist_json("interval_jitter_us", &c->jitter);
+	}
+
+	printf("}\n");
+	fflush(stdout);
+}
+
+static void report_csv(struct perf_stats *stats, const char *type,
+				const struct perf_counters *c, double secs)
+{
+	if (!stats->reports)
+		printf("name,type,time,bytes,sdus,kbps,lost,duplicate,"
+			"reordered,invalid,lat_min,lat_mean,lat_p50,lat_p90,"
+			"lat_p99,lat_max,jitter,ijit_p50,ijit_p99,ijit_max\n");
+
+	printf("%s,%s,%.3f,%" PRIu64 ",%" PRIu64 ",%.2f,%" PRIu64 ",%" PRIu64
+		",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.1f,%" PRIu64
+		",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.1f,%" PRIu64
+		",%" PRIu64 ",%" PRIu64 "\n",
+		stats->name, type, secs, c->bytes, c->sdus,
+		secs > 0 ? c->bytes * 8 / secs / 1000 : 0,
+		c->lost, c->dup, c->reorder, c->invalid,
+		c->latency.min, hist_mean(&c->latency),
+		hist_percentile(&c->latency, 50),
+		hist_percentile(&c->latency, 90),
+		hist_percentile(&c->latency, 99), c->latency.max,
+		stats->rfc_jitter, hist_percentile(&c->jitter, 50),
+		hist_percentile(&c->jitter, 99), c->jitter.max);
+	fflush(stdout);
+}
+
+void perf_stats_report(struct perf_stats *stats, bool final)
+{
+	const struct perf_counters *c;
+	const char *type;
+	uint64_t now;
+	double secs;
+
+	if (!stats || !stats->started)
+		return;
+
+	now = now_ns(CLOCK_MONOTONIC);
+
+	if (final) {
+		c = &stats->total;
+		type = "summary";
+		secs = (now - stats->start) / 1e9;
+	} else {
+		c = &stats->cur;
+		type = "interval";
+		secs = (now - stats->last_report) / 1e9;
+	}
+
+	switch (stats->format) {
+	case PERF_STATS_TEXT:
+		report_text(stats, type, c, secs);
+		break;
+	case PERF_STATS_JSON:
+		report_json(stats, type, c, secs);
+		break;
+	case PERF_STATS_CSV:
+		report_csv(stats, type, c, secs);
+		break;
+	case PERF_STATS_NONE:
+		break;
+	}
+
+	stats->reports++;
+
+	if (!final) {
+		memset(&stats->cur, 0, sizeof(stats->cur));
+		stats->last_report = now;
+	}
+}
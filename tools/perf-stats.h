@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Test payload header: seq (le32), len (le16), tx time in ns (le64) */
+#define PERF_STATS_HDR_SIZE	14
+
+enum perf_stats_format {
+	PERF_STATS_NONE,
+	PERF_STATS_TEXT,
+	PERF_STATS_JSON,
+	PERF_STATS_CSV,
+};
+
+struct perf_stats;
+
+int perf_stats_parse_format(const char *str);
+
+struct perf_stats *perf_stats_new(const char *name,
+					enum perf_stats_format format,
+					unsigned int report_ms);
+void perf_stats_free(struct perf_stats *stats);
+
+/* Expected SDU interval, enables the interval jitter histogram */
+void perf_stats_set_interval(struct perf_stats *stats, uint32_t interval_us);
+
+void perf_stats_put_header(uint8_t *buf, size_t len, uint32_t seq);
+
+void perf_stats_rx(struct perf_stats *stats, const uint8_t *buf, size_t len);
+void perf_stats_report(struct perf_stats *stats, bool final);
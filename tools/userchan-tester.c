@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include <glib.h>
 
@@ -42,8 +43,12 @@ struct test_data {
 	unsigned int remove_id;
 	struct bt_hci *hci;
 	uint32_t current_settings;
+	unsigned int cmd_count;
+	struct timespec cmd_start;
 };
 
+#define THROUGHPUT_CMD_COUNT 2000
+
 static void mgmt_debug(const char *str, void *user_data)
 {
 	const char *prefix = user_data;
@@ -357,6 +362,64 @@ static void test_close_success(const void *test_data)
 					close_read_info_callback, NULL, NULL);
 }
 
+static void throughput_cmd_callback(const void *data, uint8_t size,
+							void *user_data)
+{
+	struct test_data *test_data = tester_get_data();
+	const uint8_t *status = data;
+	struct timespec now;
+	double elapsed;
+
+	if (!size || *status) {
+		tester_warn("Command failed (0x%02x)", size ? *status : 0xff);
+		bt_hci_unref(test_data->hci);
+		test_data->hci = NULL;
+		tester_test_failed();
+		return;
+	}
+
+	if (++test_data->cmd_count < THROUGHPUT_CMD_COUNT)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	elapsed = (now.tv_sec - test_data->cmd_start.tv_sec) +
+			(now.tv_nsec - test_data->cmd_start.tv_nsec) / 1e9;
+
+	tester_print("%u commands in %.3f s (%.0f commands/sec)",
+			test_data->cmd_count, elapsed,
+			elapsed > 0 ? test_data->cmd_count / elapsed : 0);
+
+	if (elapsed > 0)
+		tester_perf_value(test_data->cmd_count / elapsed, "cmd/s", true);
+
+	bt_hci_unref(test_data->hci);
+	test_data->hci = NULL;
+
+	tester_test_passed();
+}
+
+static void test_cmd_throughput(const void *test_data)
+{
+	struct test_data *data = tester_get_data();
+	unsigned int i;
+
+	tester_print("Sending %u commands", THROUGHPUT_CMD_COUNT);
+
+	data->cmd_count = 0;
+	clock_gettime(CLOCK_MONOTONIC, &data->cmd_start);
+
+	for (i = 0; i < THROUGHPUT_CMD_COUNT; i++) {
+		if (!bt_hci_send(data->hci, BT_HCI_CMD_READ_LOCAL_VERSION,
+					NULL, 0, throughput_cmd_callback,
+					NULL, NULL)) {
+			tester_warn("Failed to send command");
+			tester_test_failed();
+			return;
+		}
+	}
+}
+
 #define test_user(name, data, setup, func) \
 	do { \
 		struct test_data *user; \
@@ -384,6 +447,8 @@ int main(int argc, char *argv[])
 					toggle_powered, test_open_success);
 	test_user("User channel close - Success", NULL,
 					setup_channel_open, test_close_success);
+	test_user("User channel command - Throughput", NULL,
+					setup_channel_open, test_cmd_throughput);
 
 
 	return tester_run();
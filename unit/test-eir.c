@@ -21,6 +21,7 @@
 #include "bluetooth/sdp.h"
 #include "src/shared/tester.h"
 #include "src/shared/util.h"
+#include "src/shared/queue.h"
 #include "src/shared/ad.h"
 #include "src/eir.h"
 
@@ -632,6 +633,41 @@ static void test_ad(const struct test_data *test, struct eir_data *eir)
 	bt_ad_unref(ad);
 }
 
+/* The view must report the same fields as eir_parse */
+static void test_view(const struct test_data *test, struct eir_data *eir)
+{
+	struct eir_view view;
+	char name[HCI_MAX_NAME_LENGTH + 2];
+	const char *view_name;
+	GSList *list;
+
+	eir_view_init(&view, test->eir_data, test->eir_size);
+
+	g_assert_cmpint(view.flags, ==, eir->flags);
+	g_assert(view.tx_power == eir->tx_power);
+	g_assert(view.rsi == eir->rsi);
+
+	view_name = eir_view_get_name(&view, name, sizeof(name));
+	if (eir->name) {
+		g_assert_cmpstr(view_name, ==, eir->name);
+		g_assert(view.name_complete == eir->name_complete);
+	} else {
+		g_assert(view_name == NULL);
+	}
+
+	for (list = eir->services; list; list = list->next)
+		g_assert(eir_view_has_uuid(&view, list->data));
+
+	for (list = eir->sd_list; list; list = list->next) {
+		struct eir_sd *sd = list->data;
+
+		g_assert(eir_view_has_service_data(&view, sd->uuid));
+	}
+
+	g_assert(!eir_view_has_uuid(&view,
+				"00000000-dead-beef-0000-000000000000"));
+}
+
 static void test_parsing(gconstpointer data)
 {
 	const struct test_data *test = data;
@@ -693,6 +729,7 @@ static void test_parsing(gconstpointer data)
 	}
 
 	test_ad(data, &eir);
+	test_view(data, &eir);
 
 	eir_data_free(&eir);
 
@@ -736,6 +773,281 @@ static const struct test_data uri_beacon_test = {
 	.uuid = uri_beacon_uuid,
 };
 
+#define MATCHER_MONITORS	500
+#define MATCHER_REPORTS		1000
+#define MATCHER_ROUNDS		20
+
+struct matcher_test {
+	struct queue *patterns[MATCHER_MONITORS];
+	bool matched[MATCHER_MONITORS];
+	struct bt_ad *ads[MATCHER_REPORTS];
+	struct bt_ad_matcher *matcher;
+	unsigned int count;
+};
+
+static void matcher_test_add(struct matcher_test *test, unsigned int i,
+					uint8_t type, uint8_t offset,
+					const uint8_t *data, size_t len)
+{
+	struct bt_ad_pattern *pattern;
+
+	pattern = bt_ad_pattern_new(type, offset, len, data);
+	g_assert(pattern);
+
+	queue_push_tail(test->patterns[i], pattern);
+	g_assert(bt_ad_matcher_add(test->matcher, pattern,
+						UINT_TO_PTR(i + 1)));
+}
+
+/* Monitors looking for beacons by id in manufacturer or service data */
+static void matcher_test_init(struct matcher_test *test)
+{
+	unsigned int i;
+
+	test->matcher = bt_ad_matcher_new();
+
+	for (i = 0; i < MATCHER_MONITORS; i++) {
+		uint8_t beacon[] = { 0x4c, 0x00, 0x02, 0x15, i >> 8, i };
+		uint8_t service[] = { i, i >> 8 };
+		const char *name = "beacon";
+
+		test->patterns[i] = queue_new();
+
+		matcher_test_add(test, i, BT_AD_MANUFACTURER_DATA, 0, beacon,
+							sizeof(beacon));
+		matcher_test_add(test, i, BT_AD_SERVICE_DATA16, 2, service,
+							sizeof(service));
+
+		/* Names are not part of the data patterns are matched with */
+		if (!(i % 10))
+			matcher_test_add(test, i, BT_AD_NAME_COMPLETE, 0,
+					(const uint8_t *) name, strlen(name));
+	}
+
+	for (i = 0; i < MATCHER_REPORTS; i++) {
+		unsigned int id = i % (MATCHER_MONITORS + 100);
+		uint8_t data[] = {
+			0x02, BT_AD_FLAGS, 0x06,
+			0x07, BT_AD_NAME_COMPLETE, 'b', 'e', 'a', 'c', 'o', 'n',
+			0x0b, BT_AD_MANUFACTURER_DATA, 0x4c, 0x00, 0x02, 0x15,
+			id >> 8, id, 0xaa, 0xbb, 0xcc, 0xdd,
+			0x07, BT_AD_SERVICE_DATA16, 0xaa, 0xfe,
+			0x00, 0x00, (id * 7) % MATCHER_MONITORS,
+			((id * 7) % MATCHER_MONITORS) >> 8,
+		};
+
+		test->ads[i] = bt_ad_new_with_data(sizeof(data), data);
+		g_assert(test->ads[i]);
+	}
+}
+
+static void matcher_test_free(struct matcher_test *test)
+{
+	unsigned int i;
+
+	for (i = 0; i < MATCHER_MONITORS; i++)
+		queue_destroy(test->patterns[i], free);
+
+	for (i = 0; i < MATCHER_REPORTS; i++)
+		bt_ad_unref(test->ads[i]);
+
+	bt_ad_matcher_free(test->matcher);
+}
+
+static void matcher_test_matched(void *data, void *user_data)
+{
+	struct matcher_test *test = user_data;
+	unsigned int i = PTR_TO_UINT(data) - 1;
+
+	g_assert(!test->matched[i]);
+
+	test->matched[i] = true;
+	test->count++;
+}
+
+/* The matcher must give the same result as matching each monitor */
+static void matcher_test_check(struct matcher_test *test, struct bt_ad *ad,
+						unsigned int removed)
+{
+	unsigned int i;
+
+	memset(test->matched, 0, sizeof(test->matched));
+
+	bt_ad_matcher_match(test->matcher, ad, matcher_test_matched, test);
+
+	for (i = 0; i < MATCHER_MONITORS; i++) {
+		bool match = i >= removed &&
+				bt_ad_pattern_match(ad, test->patterns[i]);
+
+		g_assert(test->matched[i] == match);
+	}
+}
+
+static void test_matcher(const void *data)
+{
+	struct matcher_test test;
+	unsigned int i;
+
+	memset(&test, 0, sizeof(test));
+	matcher_test_init(&test);
+
+	for (i = 0; i < MATCHER_REPORTS; i++)
+		matcher_test_check(&test, test.ads[i], 0);
+
+	tester_debug("%u matches in %u reports", test.count,
+						MATCHER_REPORTS);
+	g_assert(test.count > MATCHER_REPORTS);
+
+	/* Remove half of the monitors, their patterns must no longer match */
+	for (i = 0; i < MATCHER_MONITORS / 2; i++)
+		bt_ad_matcher_remove(test.matcher, UINT_TO_PTR(i + 1));
+
+	for (i = 0; i < MATCHER_REPORTS; i++)
+		matcher_test_check(&test, test.ads[i], MATCHER_MONITORS / 2);
+
+	matcher_test_free(&test);
+
+	tester_test_passed();
+}
+
+static void test_matcher_benchmark(const void *data)
+{
+	struct matcher_test test;
+	gint64 start, linear, compiled;
+	unsigned int i, j, r;
+
+	memset(&test, 0, sizeof(test));
+	matcher_test_init(&test);
+
+	start = g_get_monotonic_time();
+
+	for (r = 0; r < MATCHER_ROUNDS; r++) {
+		for (i = 0; i < MATCHER_REPORTS; i++) {
+			for (j = 0; j < MATCHER_MONITORS; j++)
+				bt_ad_pattern_match(test.ads[i],
+							test.patterns[j]);
+		}
+	}
+
+	linear = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+
+	for (r = 0; r < MATCHER_ROUNDS; r++) {
+		for (i = 0; i < MATCHER_REPORTS; i++) {
+			memset(test.matched, 0, sizeof(test.matched));
+			bt_ad_matcher_match(test.matcher, test.ads[i],
+						matcher_test_matched, &test);
+		}
+	}
+
+	compiled = g_get_monotonic_time() - start;
+
+	tester_print("%u reports, %u monitors: per monitor %.3f ms, "
+			"compiled %.3f ms",
+			MATCHER_REPORTS * MATCHER_ROUNDS, MATCHER_MONITORS,
+			linear / 1000.0, compiled / 1000.0);
+
+	if (compiled)
+		tester_perf_value(MATCHER_REPORTS * MATCHER_ROUNDS * 1e6 /
+						compiled, "reports/s", true);
+
+	matcher_test_free(&test);
+
+	tester_test_passed();
+}
+
+static const struct test_data *view_tests[] = {
+	&macbookair_test, &iphone5_test, &ipadmini_test, &gigaset_sl400h_test,
+	&gigaset_sl910_test, &nokia_bh907_test, &fuelband_test,
+	&invalid_utf8_name_test, &utf16_name_test, &iso_2022_jp_name_test,
+	&bluesc_test, &wahoo_scale_test, &mio_alpha_test, &cookoo_test,
+	&citizen_adv_test, &citizen_scan_test, &gigaset_gtag_test,
+	&uri_beacon_test,
+};
+
+#define VIEW_ROUNDS		20000
+
+/* Heap blocks eir_parse allocated for the report */
+static unsigned int eir_data_allocs(const struct eir_data *eir)
+{
+	unsigned int allocs = 0;
+
+	/* List node and UUID string */
+	allocs += g_slist_length(eir->services) * 2;
+	/* List node and eir_msd */
+	allocs += g_slist_length(eir->msd_list) * 2;
+	/* List node, eir_sd and UUID string */
+	allocs += g_slist_length(eir->sd_list) * 3;
+	/* List node, eir_ad and data */
+	allocs += g_slist_length(eir->data_list) * 3;
+
+	allocs += !!eir->name + !!eir->hash + !!eir->randomizer;
+
+	return allocs;
+}
+
+/* Compares the discovery filtering of a report with eir_parse, which copies
+ * every field, and eir_view which only looks at the raw data.
+ */
+static void test_view_benchmark(const void *data)
+{
+	const char *uuid = "0000180f-0000-1000-8000-00805f9b34fb";
+	unsigned int i, r, reports, allocs = 0, matches = 0, view_matches = 0;
+	gint64 start, parse, view;
+
+	start = g_get_monotonic_time();
+
+	for (r = 0; r < VIEW_ROUNDS; r++) {
+		for (i = 0; i < ARRAY_SIZE(view_tests); i++) {
+			const struct test_data *test = view_tests[i];
+			struct eir_data eir;
+
+			memset(&eir, 0, sizeof(eir));
+			eir_parse(&eir, test->eir_data, test->eir_size);
+
+			if (g_slist_find_custom(eir.services, uuid,
+						(GCompareFunc) strcmp))
+				matches++;
+
+			allocs += eir_data_allocs(&eir);
+			eir_data_free(&eir);
+		}
+	}
+
+	parse = g_get_monotonic_time() - start;
+	start = g_get_monotonic_time();
+
+	for (r = 0; r < VIEW_ROUNDS; r++) {
+		for (i = 0; i < ARRAY_SIZE(view_tests); i++) {
+			const struct test_data *test = view_tests[i];
+			char name[HCI_MAX_NAME_LENGTH + 2];
+			struct eir_view eir;
+
+			eir_view_init(&eir, test->eir_data, test->eir_size);
+			eir_view_get_name(&eir, name, sizeof(name));
+
+			if (eir_view_has_uuid(&eir, uuid))
+				view_matches++;
+		}
+	}
+
+	view = g_get_monotonic_time() - start;
+
+	g_assert_cmpuint(matches, ==, view_matches);
+
+	reports = VIEW_ROUNDS * ARRAY_SIZE(view_tests);
+
+	tester_print("%u reports: parse %.3f ms (%.2f allocations/report), "
+			"view %.3f ms (no allocations)", reports,
+			parse / 1000.0, (double) allocs / reports,
+			view / 1000.0);
+
+	if (view)
+		tester_perf_value(reports * 1e6 / view, "reports/s", true);
+
+	tester_test_passed();
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -768,5 +1080,12 @@ int main(int argc, char *argv[])
 	tester_add("ad/g-tag", &gigaset_gtag_test, NULL, test_parsing, NULL);
 	tester_add("ad/uri-beacon", &uri_beacon_test, NULL, test_parsing, NULL);
 
+	tester_add("/ad/matcher", NULL, NULL, test_matcher, NULL);
+	tester_add("/ad/matcher/benchmark", NULL, NULL, test_matcher_benchmark,
+									NULL);
+
+	tester_add("/eir/view/benchmark", NULL, NULL, test_view_benchmark,
+									NULL);
+
 	return tester_run();
 }
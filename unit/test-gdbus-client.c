@@ -12,6 +12,9 @@
 #include <config.h>
 #endif
 
+#include <stdint.h>
+#include <string.h>
+
 #include <glib.h>
 
 #include "gdbus/gdbus.h"
@@ -29,6 +32,10 @@ struct context {
 	void *data;
 	gboolean client_ready;
 	guint timeout_source;
+	gint64 start;
+	unsigned int count;
+	GDBusPropertyStats stats;
+	int flags;
 };
 
 static const GDBusMethodTable methods[] = {
@@ -82,6 +89,8 @@ static void destroy_context(struct context *context)
 	if (context->timeout_source > 0)
 		g_source_remove(context->timeout_source);
 
+	g_dbus_set_property_coalescing(0, 0);
+
 	g_dbus_detach_object_manager(context->dbus_conn);
 
 	g_dbus_unregister_interface(context->dbus_conn,
@@ -904,6 +913,878 @@ static void client_ready(const void *data)
 						proxy_added, NULL, NULL, context);
 }
 
+#define COALESCE_WINDOW		100
+#define COALESCE_INTERVAL	100
+
+static void emit_coalesced_string(struct context *context, const char *value)
+{
+	g_free(context->data);
+	context->data = g_strdup(value);
+
+	g_dbus_emit_property_changed_full(context->dbus_conn, SERVICE_PATH,
+					SERVICE_NAME, "String",
+					G_DBUS_PROPERTY_CHANGED_FLAG_COALESCE);
+}
+
+static void check_string(DBusMessageIter *iter, const char *value)
+{
+	const char *string;
+
+	g_assert(dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_STRING);
+
+	dbus_message_iter_get_basic(iter, &string);
+	g_assert_cmpstr(string, ==, value);
+}
+
+static const GDBusSignalTable coalesce_signals[] = {
+	{ GDBUS_SIGNAL("Updated", NULL) },
+	{ }
+};
+
+static struct context *create_coalesce_context(
+					const GDBusMethodTable *methods,
+					GDBusProxyFunction proxy_added,
+					GDBusPropertyFunction property_changed)
+{
+	struct context *context = create_context();
+	static const GDBusPropertyTable string_properties[] = {
+		{ "String", "s", get_string, NULL, string_exists },
+		{ },
+	};
+
+	if (context == NULL)
+		return NULL;
+
+	g_dbus_register_interface(context->dbus_conn,
+				SERVICE_PATH, SERVICE_NAME,
+				methods, coalesce_signals, string_properties,
+				context, NULL);
+
+	context->dbus_client = g_dbus_client_new(context->dbus_conn,
+						SERVICE_NAME, SERVICE_PATH);
+
+	g_dbus_client_set_disconnect_watch(context->dbus_client,
+						disconnect_handler, context);
+	g_dbus_client_set_proxy_handlers(context->dbus_client, proxy_added,
+						NULL, property_changed,
+						context);
+
+	return context;
+}
+
+static gboolean emit_coalesce_window(void *user_data)
+{
+	struct context *context = user_data;
+	GDBusPropertyStats stats;
+
+	context->start = g_get_monotonic_time();
+	g_dbus_get_property_stats(&context->stats);
+
+	emit_coalesced_string(context, "value1");
+
+	g_dbus_get_property_stats(&stats);
+	g_assert_cmpuint(stats.deferred, ==, context->stats.deferred + 1);
+	g_assert_cmpuint(stats.signals, ==, context->stats.signals);
+
+	return FALSE;
+}
+
+static void proxy_coalesce_window(GDBusProxy *proxy, void *user_data)
+{
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	g_idle_add(emit_coalesce_window, user_data);
+}
+
+static void property_coalesce_window(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+
+	tester_debug("property %s changed", name);
+
+	check_string(iter, "value1");
+
+	/* Not emitted before the window expired */
+	g_assert_cmpint(g_get_monotonic_time() - context->start, >=,
+						COALESCE_WINDOW * 1000);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_coalesce_window(const void *data)
+{
+	g_dbus_set_property_coalescing(COALESCE_WINDOW, 0);
+
+	create_coalesce_context(methods, proxy_coalesce_window,
+					property_coalesce_window);
+}
+
+static gboolean emit_coalesce_interval(void *user_data)
+{
+	struct context *context = user_data;
+
+	context->start = g_get_monotonic_time();
+
+	/* First change is not rate limited */
+	emit_coalesced_string(context, "value1");
+
+	return FALSE;
+}
+
+static void proxy_coalesce_interval(GDBusProxy *proxy, void *user_data)
+{
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	g_idle_add(emit_coalesce_interval, user_data);
+}
+
+static void property_coalesce_interval(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+	GDBusPropertyStats stats;
+
+	tester_debug("property %s changed", name);
+
+	if (++context->count == 1) {
+		check_string(iter, "value1");
+
+		g_dbus_get_property_stats(&context->stats);
+		emit_coalesced_string(context, "value2");
+		g_dbus_get_property_stats(&stats);
+		g_assert_cmpuint(stats.deferred, ==,
+						context->stats.deferred + 1);
+		return;
+	}
+
+	check_string(iter, "value2");
+
+	/* Held back until the interval since the first change expired */
+	g_assert_cmpint(g_get_monotonic_time() - context->start, >=,
+						COALESCE_INTERVAL * 1000);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_coalesce_interval(const void *data)
+{
+	g_dbus_set_property_coalescing(0, COALESCE_INTERVAL);
+
+	create_coalesce_context(methods, proxy_coalesce_interval,
+					property_coalesce_interval);
+}
+
+static gboolean emit_coalesce_merge(void *user_data)
+{
+	struct context *context = user_data;
+	GDBusPropertyStats stats;
+
+	g_dbus_get_property_stats(&context->stats);
+
+	emit_coalesced_string(context, "value1");
+	emit_coalesced_string(context, "value2");
+	emit_coalesced_string(context, "value3");
+
+	g_dbus_get_property_stats(&stats);
+	g_assert_cmpuint(stats.changed, ==, context->stats.changed + 3);
+	g_assert_cmpuint(stats.merged, ==, context->stats.merged + 2);
+	g_assert_cmpuint(stats.deferred, ==, context->stats.deferred + 1);
+
+	return FALSE;
+}
+
+static void proxy_coalesce_merge(GDBusProxy *proxy, void *user_data)
+{
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	g_idle_add(emit_coalesce_merge, user_data);
+}
+
+static void property_coalesce_merge(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+	GDBusPropertyStats stats;
+
+	tester_debug("property %s changed", name);
+
+	/* A single signal carrying the latest value */
+	check_string(iter, "value3");
+
+	g_dbus_get_property_stats(&stats);
+	g_assert_cmpuint(stats.signals, ==, context->stats.signals + 1);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_coalesce_merge(const void *data)
+{
+	g_dbus_set_property_coalescing(COALESCE_WINDOW, 0);
+
+	create_coalesce_context(methods, proxy_coalesce_merge,
+					property_coalesce_merge);
+}
+
+static DBusMessage *update_string(DBusConnection *conn, DBusMessage *msg,
+							void *user_data)
+{
+	struct context *context = user_data;
+
+	context->start = g_get_monotonic_time();
+
+	emit_coalesced_string(context, "value1");
+
+	return dbus_message_new_method_return(msg);
+}
+
+static DBusMessage *update_string_signal(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	struct context *context = user_data;
+
+	emit_coalesced_string(context, "value1");
+
+	g_dbus_emit_signal(conn, SERVICE_PATH, SERVICE_NAME, "Updated",
+							DBUS_TYPE_INVALID);
+
+	return dbus_message_new_method_return(msg);
+}
+
+static const GDBusMethodTable update_methods[] = {
+	{ GDBUS_METHOD("Update", NULL, NULL, update_string) },
+	{ GDBUS_METHOD("UpdateSignal", NULL, NULL, update_string_signal) },
+	{ }
+};
+
+static void update_reply(DBusMessage *message, void *user_data)
+{
+	struct context *context = user_data;
+
+	g_assert(dbus_message_get_type(message) ==
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+	context->count++;
+}
+
+static void proxy_coalesce_reply(GDBusProxy *proxy, void *user_data)
+{
+	struct context *context = user_data;
+
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	g_assert(g_dbus_proxy_method_call(proxy, "Update", NULL, update_reply,
+							context, NULL));
+}
+
+static void property_coalesce_reply(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+
+	tester_debug("property %s changed", name);
+
+	check_string(iter, "value1");
+
+	/* Replies don't flush coalesced changes */
+	g_assert_cmpuint(context->count, ==, 1);
+	g_assert_cmpint(g_get_monotonic_time() - context->start, >=,
+						COALESCE_WINDOW * 1000);
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void client_coalesce_reply(const void *data)
+{
+	g_dbus_set_property_coalescing(COALESCE_WINDOW, 0);
+
+	create_coalesce_context(update_methods, proxy_coalesce_reply,
+					property_coalesce_reply);
+}
+
+static void signal_coalesce(DBusConnection *conn, DBusMessage *msg,
+							void *user_data)
+{
+	struct context *context = user_data;
+	DBusMessageIter iter;
+
+	if (!dbus_message_has_member(msg, "Updated"))
+		return;
+
+	tester_debug("signal Updated received");
+
+	/* Coalesced change of the object must be received before */
+	g_assert_cmpuint(context->count, ==, 1);
+
+	g_assert(g_dbus_proxy_get_property(context->proxy, "String", &iter));
+	check_string(&iter, "value1");
+
+	g_dbus_client_unref(context->dbus_client);
+}
+
+static void proxy_coalesce_signal(GDBusProxy *proxy, void *user_data)
+{
+	struct context *context = user_data;
+
+	tester_debug("proxy %s found", g_dbus_proxy_get_interface(proxy));
+
+	context->proxy = proxy;
+	g_assert(g_dbus_proxy_method_call(proxy, "UpdateSignal", NULL, NULL,
+							context, NULL));
+}
+
+static void property_coalesce_signal(GDBusProxy *proxy, const char *name,
+					DBusMessageIter *iter, void *user_data)
+{
+	struct context *context = user_data;
+
+	tester_debug("property %s changed", name);
+
+	check_string(iter, "value1");
+
+	context->count++;
+}
+
+static void client_coalesce_signal(const void *data)
+{
+	struct context *context;
+
+	/* Window long enough that only the signal can emit the change */
+	g_dbus_set_property_coalescing(COALESCE_WINDOW * 50, 0);
+
+	context = create_coalesce_context(update_methods,
+					proxy_coalesce_signal,
+					property_coalesce_signal);
+	if (context == NULL)
+		return;
+
+	g_dbus_client_set_signal_watch(context->dbus_client, signal_coalesce,
+								context);
+}
+
+#define OBJECT_MANAGER_INTERFACE "org.bluez.ObjectManager1"
+
+static DBusMessage *get_objects_filtered(DBusConnection *conn,
+					DBusMessage *msg, void *user_data)
+{
+	return g_dbus_get_managed_objects_filtered(conn, msg);
+}
+
+static const GDBusMethodTable manager_methods[] = {
+	{ GDBUS_EXPERIMENTAL_METHOD("GetManagedObjectsFiltered",
+		GDBUS_ARGS({ "filter", "a{sv}" }),
+		GDBUS_ARGS({ "objects", "a{oa{sa{sv}}}" }, { "next", "o" }),
+		get_objects_filtered) },
+	{ }
+};
+
+#define BENCH_OBJECTS	10000
+#define BENCH_PAGE	1000
+
+struct bench {
+	struct context *context;
+	int flags;
+	unsigned int stage;
+	unsigned int total;
+	unsigned int pages;
+	gint64 start;
+	gint64 elapsed[3];
+};
+
+static gboolean get_bench_name(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	const char *name = "bench";
+
+	dbus_message_iter_append_basic(iter, DBUS_TYPE_STRING, &name);
+
+	return TRUE;
+}
+
+static gboolean get_bench_data(const GDBusPropertyTable *property,
+					DBusMessageIter *iter, void *data)
+{
+	static const uint8_t value[31] = { 0x02, 0x01, 0x06 };
+	const uint8_t *ptr = value;
+	DBusMessageIter array;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+					DBUS_TYPE_BYTE_AS_STRING, &array);
+	dbus_message_iter_append_fixed_array(&array, DBUS_TYPE_BYTE, &ptr,
+							sizeof(value));
+	dbus_message_iter_close_container(iter, &array);
+
+	return TRUE;
+}
+
+static const GDBusPropertyTable bench_properties[] = {
+	{ "Name", "s", get_bench_name },
+	{ "Data", "ay", get_bench_data },
+	{ }
+};
+
+static void bench_call(struct bench *bench, const char *start);
+
+static unsigned int bench_count(DBusMessage *reply, const char **next)
+{
+	DBusMessageIter iter, array;
+	unsigned int count = 0;
+
+	g_assert(dbus_message_get_type(reply) ==
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+	dbus_message_iter_init(reply, &iter);
+	dbus_message_iter_recurse(&iter, &array);
+
+	while (dbus_message_iter_get_arg_type(&array) ==
+						DBUS_TYPE_DICT_ENTRY) {
+		count++;
+		dbus_message_iter_next(&array);
+	}
+
+	if (next) {
+		g_assert(dbus_message_iter_next(&iter));
+		dbus_message_iter_get_basic(&iter, next);
+	}
+
+	return count;
+}
+
+static void bench_done(struct bench *bench)
+{
+	struct context *context = bench->context;
+	unsigned int i;
+
+	tester_print("%u objects: cold %.3f ms, snapshot %.3f ms, "
+			"%u pages %.3f ms", BENCH_OBJECTS,
+			bench->elapsed[0] / 1000.0,
+			bench->elapsed[1] / 1000.0, bench->pages,
+			bench->elapsed[2] / 1000.0);
+
+	tester_perf_value(bench->elapsed[1] / 1000.0, "ms", false);
+
+	for (i = 0; i < BENCH_OBJECTS; i++) {
+		char *path = g_strdup_printf("%s/obj%u", SERVICE_PATH, i);
+
+		g_dbus_unregister_interface(context->dbus_conn, path,
+							SERVICE_NAME);
+		g_free(path);
+	}
+
+	g_dbus_unregister_interface(context->dbus_conn, "/",
+						OBJECT_MANAGER_INTERFACE);
+	g_dbus_set_flags(bench->flags);
+	g_free(bench);
+
+	destroy_context(context);
+}
+
+static void bench_reply(DBusPendingCall *call, void *user_data)
+{
+	struct bench *bench = user_data;
+	DBusMessage *reply = dbus_pending_call_steal_reply(call);
+	const char *next = NULL;
+	unsigned int count;
+
+	count = bench_count(reply, bench->stage < 2 ? NULL : &next);
+
+	if (bench->stage < 2) {
+		bench->elapsed[bench->stage] =
+				g_get_monotonic_time() - bench->start;
+		g_assert_cmpuint(count, ==, BENCH_OBJECTS);
+
+		bench->stage++;
+		bench_call(bench, "/");
+		goto done;
+	}
+
+	bench->total += count;
+	bench->pages++;
+	g_assert_cmpuint(count, <=, BENCH_PAGE);
+
+	if (strcmp(next, "/")) {
+		bench_call(bench, next);
+		goto done;
+	}
+
+	bench->elapsed[2] = g_get_monotonic_time() - bench->start;
+	g_assert_cmpuint(bench->total, ==, BENCH_OBJECTS);
+
+	bench_done(bench);
+
+done:
+	dbus_message_unref(reply);
+}
+
+static void bench_call(struct bench *bench, const char *start)
+{
+	DBusConnection *conn = bench->context->dbus_conn;
+	DBusMessage *msg;
+	DBusMessageIter iter, dict;
+	DBusPendingCall *call;
+	const char *prefix = SERVICE_PATH;
+	dbus_uint32_t limit = BENCH_PAGE;
+
+	if (bench->stage < 2) {
+		bench->start = g_get_monotonic_time();
+		msg = dbus_message_new_method_call(
+					dbus_bus_get_unique_name(conn), "/",
+					"org.freedesktop.DBus.ObjectManager",
+					"GetManagedObjects");
+	} else {
+		if (!bench->pages)
+			bench->start = g_get_monotonic_time();
+
+		msg = dbus_message_new_method_call(
+					dbus_bus_get_unique_name(conn), "/",
+					OBJECT_MANAGER_INTERFACE,
+					"GetManagedObjectsFiltered");
+
+		dbus_message_iter_init_append(msg, &iter);
+		dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+		g_dbus_dict_append_entry(&dict, "PathPrefix",
+					DBUS_TYPE_OBJECT_PATH, &prefix);
+		g_dbus_dict_append_entry(&dict, "Start",
+					DBUS_TYPE_OBJECT_PATH, &start);
+		g_dbus_dict_append_entry(&dict, "Limit", DBUS_TYPE_UINT32,
+								&limit);
+		dbus_message_iter_close_container(&iter, &dict);
+	}
+
+	g_assert(dbus_connection_send_with_reply(conn, msg, &call, -1));
+	dbus_pending_call_set_notify(call, bench_reply, bench, NULL);
+	dbus_pending_call_unref(call);
+	dbus_message_unref(msg);
+}
+
+static void client_managed_objects_benchmark(const void *data)
+{
+	struct bench *bench;
+	struct context *context;
+	int flags = g_dbus_get_flags();
+	unsigned int i;
+
+	g_dbus_set_flags(flags | G_DBUS_FLAG_ENABLE_EXPERIMENTAL |
+					G_DBUS_FLAG_PROPERTY_SNAPSHOT);
+
+	context = create_context();
+	if (context == NULL) {
+		g_dbus_set_flags(flags);
+		return;
+	}
+
+	bench = g_new0(struct bench, 1);
+	bench->context = context;
+	bench->flags = flags;
+
+	g_dbus_register_interface(context->dbus_conn, "/",
+					OBJECT_MANAGER_INTERFACE,
+					manager_methods, NULL, NULL, NULL, NULL);
+
+	for (i = 0; i < BENCH_OBJECTS; i++) {
+		char *path = g_strdup_printf("%s/obj%u", SERVICE_PATH, i);
+
+		g_dbus_register_interface(context->dbus_conn, path,
+					SERVICE_NAME, methods, signals,
+					bench_properties, NULL, NULL);
+		g_free(path);
+	}
+
+	bench_call(bench, "/");
+}
+
+#define OBJECTS_PATH	SERVICE_PATH "/obj"
+#define RAW_PATH	"/org/bluez/unit/raw"
+
+static gboolean dict_lookup(DBusMessageIter *dict, const char *key,
+							DBusMessageIter *value)
+{
+	while (dbus_message_iter_get_arg_type(dict) == DBUS_TYPE_DICT_ENTRY) {
+		DBusMessageIter entry;
+		const char *str;
+
+		dbus_message_iter_recurse(dict, &entry);
+		dbus_message_iter_get_basic(&entry, &str);
+
+		if (!strcmp(str, key)) {
+			dbus_message_iter_next(&entry);
+			dbus_message_iter_recurse(&entry, value);
+			return TRUE;
+		}
+
+		dbus_message_iter_next(dict);
+	}
+
+	return FALSE;
+}
+
+static const char *objects_string(DBusMessage *reply, const char *path)
+{
+	DBusMessageIter iter, objects, interfaces, props, value;
+	const char *string;
+
+	g_assert(dbus_message_get_type(reply) ==
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+	dbus_message_iter_init(reply, &iter);
+	dbus_message_iter_recurse(&iter, &objects);
+
+	if (!dict_lookup(&objects, path, &interfaces))
+		return NULL;
+
+	if (!dict_lookup(&interfaces, SERVICE_NAME, &props))
+		return NULL;
+
+	if (!dict_lookup(&props, "String", &value))
+		return NULL;
+
+	dbus_message_iter_get_basic(&value, &string);
+
+	return string;
+}
+
+static void objects_call(struct context *context, const char *interface,
+				const char *method, const char *filter,
+				const char *value, int type,
+				DBusPendingCallNotifyFunction function)
+{
+	DBusConnection *conn = context->dbus_conn;
+	DBusMessage *msg;
+	DBusMessageIter iter, dict;
+	DBusPendingCall *call;
+
+	msg = dbus_message_new_method_call(dbus_bus_get_unique_name(conn),
+						"/", interface, method);
+
+	if (filter) {
+		dbus_message_iter_init_append(msg, &iter);
+		dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+					DBUS_DICT_ENTRY_BEGIN_CHAR_AS_STRING
+					DBUS_TYPE_STRING_AS_STRING
+					DBUS_TYPE_VARIANT_AS_STRING
+					DBUS_DICT_ENTRY_END_CHAR_AS_STRING,
+					&dict);
+		g_dbus_dict_append_entry(&dict, filter, type, &value);
+		dbus_message_iter_close_container(&iter, &dict);
+	}
+
+	g_assert(dbus_connection_send_with_reply(conn, msg, &call, -1));
+	dbus_pending_call_set_notify(call, function, context, NULL);
+	dbus_pending_call_unref(call);
+	dbus_message_unref(msg);
+}
+
+static void snapshot_call(struct context *context,
+				DBusPendingCallNotifyFunction function)
+{
+	objects_call(context, "org.freedesktop.DBus.ObjectManager",
+				"GetManagedObjects", NULL, NULL, 0, function);
+}
+
+static void snapshot_reply(DBusPendingCall *call, void *user_data)
+{
+	struct context *context = user_data;
+	DBusMessage *reply = dbus_pending_call_steal_reply(call);
+	const char *string = objects_string(reply, SERVICE_PATH);
+
+	tester_debug("String %s", string);
+
+	switch (context->count++) {
+	case 0:
+		g_assert_cmpstr(string, ==, "value");
+
+		/* Not signalled, served from the snapshot */
+		g_free(context->data);
+		context->data = g_strdup("value1");
+		snapshot_call(context, snapshot_reply);
+		break;
+	case 1:
+		g_assert_cmpstr(string, ==, "value");
+
+		/* Signalling the change drops the snapshot */
+		g_dbus_emit_property_changed(context->dbus_conn, SERVICE_PATH,
+						SERVICE_NAME, "String");
+		snapshot_call(context, snapshot_reply);
+		break;
+	default:
+		g_assert_cmpstr(string, ==, "value1");
+
+		g_dbus_set_flags(context->flags);
+		destroy_context(context);
+		break;
+	}
+
+	dbus_message_unref(reply);
+}
+
+static void client_managed_objects_snapshot(const void *data)
+{
+	struct context *context;
+	int flags = g_dbus_get_flags();
+	static const GDBusPropertyTable string_properties[] = {
+		{ "String", "s", get_string },
+		{ },
+	};
+
+	g_dbus_set_flags(flags | G_DBUS_FLAG_PROPERTY_SNAPSHOT);
+
+	context = create_context();
+	if (context == NULL) {
+		g_dbus_set_flags(flags);
+		return;
+	}
+
+	context->flags = flags;
+	context->data = g_strdup("value");
+
+	g_dbus_register_interface(context->dbus_conn,
+				SERVICE_PATH, SERVICE_NAME,
+				methods, signals, string_properties,
+				context, NULL);
+
+	snapshot_call(context, snapshot_reply);
+}
+
+static void filter_call(struct context *context, const char *filter,
+				const char *value, int type,
+				DBusPendingCallNotifyFunction function)
+{
+	objects_call(context, OBJECT_MANAGER_INTERFACE,
+				"GetManagedObjectsFiltered", filter, value,
+				type, function);
+}
+
+static void filter_done(struct context *context)
+{
+	unsigned int i;
+
+	dbus_connection_unregister_object_path(context->dbus_conn, RAW_PATH);
+	g_dbus_unregister_interface(context->dbus_conn, "/",
+						OBJECT_MANAGER_INTERFACE);
+
+	for (i = 0; i < 4; i++) {
+		char *path = g_strdup_printf("%s%u", OBJECTS_PATH, i);
+
+		g_dbus_unregister_interface(context->dbus_conn, path,
+							SERVICE_NAME);
+		if (i % 2)
+			g_dbus_unregister_interface(context->dbus_conn, path,
+							SERVICE_NAME1);
+		g_free(path);
+	}
+
+	g_dbus_set_flags(context->flags);
+	destroy_context(context);
+}
+
+static void filter_start_reply(DBusPendingCall *call, void *user_data)
+{
+	struct context *context = user_data;
+	DBusMessage *reply = dbus_pending_call_steal_reply(call);
+
+	/* Paths not registered through gdbus cannot be resumed from */
+	g_assert(dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR);
+	g_assert_cmpstr(dbus_message_get_error_name(reply), ==,
+						DBUS_ERROR_INVALID_ARGS);
+
+	dbus_message_unref(reply);
+
+	filter_done(context);
+}
+
+static void filter_interface_reply(DBusPendingCall *call, void *user_data)
+{
+	struct context *context = user_data;
+	DBusMessage *reply = dbus_pending_call_steal_reply(call);
+	DBusMessageIter iter, objects, entry;
+	const char *path, *next;
+
+	g_assert(dbus_message_get_type(reply) ==
+					DBUS_MESSAGE_TYPE_METHOD_RETURN);
+
+	dbus_message_iter_init(reply, &iter);
+	dbus_message_iter_recurse(&iter, &objects);
+
+	/* Only the objects implementing the interface, in tree order */
+	g_assert(dbus_message_iter_get_arg_type(&objects) ==
+						DBUS_TYPE_DICT_ENTRY);
+	dbus_message_iter_recurse(&objects, &entry);
+	dbus_message_iter_get_basic(&entry, &path);
+	g_assert_cmpstr(path, ==, OBJECTS_PATH "1");
+
+	g_assert(dbus_message_iter_next(&objects));
+	dbus_message_iter_recurse(&objects, &entry);
+	dbus_message_iter_get_basic(&entry, &path);
+	g_assert_cmpstr(path, ==, OBJECTS_PATH "3");
+
+	g_assert(!dbus_message_iter_next(&objects));
+
+	g_assert(dbus_message_iter_next(&iter));
+	dbus_message_iter_get_basic(&iter, &next);
+	g_assert_cmpstr(next, ==, "/");
+
+	dbus_message_unref(reply);
+
+	filter_call(context, "Start", RAW_PATH, DBUS_TYPE_OBJECT_PATH,
+							filter_start_reply);
+}
+
+static DBusHandlerResult raw_message(DBusConnection *conn, DBusMessage *msg,
+							void *user_data)
+{
+	return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+static const DBusObjectPathVTable raw_table = {
+	.message_function = raw_message,
+};
+
+static void client_managed_objects_filter(const void *data)
+{
+	struct context *context;
+	int flags = g_dbus_get_flags();
+	unsigned int i;
+
+	g_dbus_set_flags(flags | G_DBUS_FLAG_ENABLE_EXPERIMENTAL);
+
+	context = create_context();
+	if (context == NULL) {
+		g_dbus_set_flags(flags);
+		return;
+	}
+
+	context->flags = flags;
+
+	g_dbus_register_interface(context->dbus_conn, "/",
+					OBJECT_MANAGER_INTERFACE,
+					manager_methods, NULL, NULL, NULL, NULL);
+
+	for (i = 0; i < 4; i++) {
+		char *path = g_strdup_printf("%s%u", OBJECTS_PATH, i);
+
+		g_dbus_register_interface(context->dbus_conn, path,
+					SERVICE_NAME, methods, signals,
+					properties, NULL, NULL);
+		if (i % 2)
+			g_dbus_register_interface(context->dbus_conn, path,
+					SERVICE_NAME1, methods, signals,
+					properties, NULL, NULL);
+		g_free(path);
+	}
+
+	/* Object path whose user data is not owned by gdbus */
+	g_assert(dbus_connection_register_object_path(context->dbus_conn,
+						RAW_PATH, &raw_table, context));
+
+	filter_call(context, "Interface", SERVICE_NAME1, DBUS_TYPE_STRING,
+						filter_interface_reply);
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -948,5 +1829,29 @@ int main(int argc, char *argv[])
 
 	tester_add("/gdbus/client_ready", NULL, NULL, client_ready, NULL);
 
+	tester_add("/gdbus/client_coalesce_window", NULL, NULL,
+					client_coalesce_window, NULL);
+
+	tester_add("/gdbus/client_coalesce_interval", NULL, NULL,
+					client_coalesce_interval, NULL);
+
+	tester_add("/gdbus/client_coalesce_merge", NULL, NULL,
+					client_coalesce_merge, NULL);
+
+	tester_add("/gdbus/client_coalesce_reply", NULL, NULL,
+					client_coalesce_reply, NULL);
+
+	tester_add("/gdbus/client_coalesce_signal", NULL, NULL,
+					client_coalesce_signal, NULL);
+
+	tester_add("/gdbus/managed_objects_snapshot", NULL, NULL,
+				client_managed_objects_snapshot, NULL);
+
+	tester_add("/gdbus/managed_objects_filter", NULL, NULL,
+				client_managed_objects_filter, NULL);
+
+	tester_add("/gdbus/managed_objects_benchmark", NULL, NULL,
+				client_managed_objects_benchmark, NULL);
+
 	return tester_run();
 }
@@ -1357,6 +1357,196 @@ static void test_hf_session(gconstpointer data)
 	g_assert(ret);
 }
 
+struct line_log {
+	struct hfp_gw *hfp;
+	bool reply_now;
+	char buf[128];
+};
+
+static void log_line(struct line_log *log, const char *name,
+						struct hfp_context *context)
+{
+	size_t len = strlen(log->buf);
+	unsigned int val;
+
+	len += snprintf(log->buf + len, sizeof(log->buf) - len, "%s", name);
+
+	while (hfp_context_get_number(context, &val))
+		len += snprintf(log->buf + len, sizeof(log->buf) - len,
+								" %u", val);
+
+	snprintf(log->buf + len, sizeof(log->buf) - len, ";");
+}
+
+static gboolean send_ok(gpointer user_data)
+{
+	struct line_log *log = user_data;
+
+	hfp_gw_send_result(log->hfp, HFP_RESULT_OK);
+
+	return FALSE;
+}
+
+static void log_gw_line(struct line_log *log, const char *name,
+						struct hfp_context *context)
+{
+	log_line(log, name, context);
+
+	if (log->reply_now)
+		hfp_gw_send_result(log->hfp, HFP_RESULT_OK);
+	else
+		g_idle_add(send_ok, log);
+}
+
+static void log_vgs(struct hfp_context *context, enum hfp_gw_cmd_type type,
+							void *user_data)
+{
+	log_gw_line(user_data, "VGS", context);
+}
+
+static void log_vgm(struct hfp_context *context, enum hfp_gw_cmd_type type,
+							void *user_data)
+{
+	log_gw_line(user_data, "VGM", context);
+}
+
+static void log_ciev(struct hfp_context *context, void *user_data)
+{
+	log_line(user_data, "CIEV", context);
+}
+
+static void write_str(int fd, const char *str)
+{
+	ssize_t len = strlen(str);
+
+	g_assert_cmpint(write(fd, str, len), ==, len);
+
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+}
+
+/*
+ * Fill the 4096 bytes ring buffer with empty lines followed by "head", so
+ * that the incomplete line left at its end is completed by "tail" written
+ * at its start.
+ */
+static void write_wrapped(int fd, const char *filler, const char *head,
+							const char *tail)
+{
+	size_t len = strlen(head), step = strlen(filler);
+	char buf[4096];
+	size_t i;
+
+	g_assert((sizeof(buf) - len) % step == 0);
+
+	for (i = 0; i < sizeof(buf) - len; i += step)
+		memcpy(buf + i, filler, step);
+
+	memcpy(buf + i, head, len);
+
+	g_assert_cmpint(write(fd, buf, sizeof(buf)), ==, sizeof(buf));
+
+	while (g_main_context_iteration(NULL, FALSE))
+		;
+
+	write_str(fd, tail);
+}
+
+static struct hfp_gw *log_gw_new(int sv[2], struct line_log *log)
+{
+	struct hfp_gw *hfp;
+
+	g_assert(!socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv));
+
+	hfp = hfp_gw_new(sv[0]);
+	g_assert(hfp);
+	g_assert(hfp_gw_set_close_on_unref(hfp, true));
+
+	g_assert(hfp_gw_register(hfp, log_vgs, "+VGS", log, NULL));
+	g_assert(hfp_gw_register(hfp, log_vgm, "+VGM", log, NULL));
+
+	log->hfp = hfp;
+
+	return hfp;
+}
+
+/* A command split by the end of the ring buffer and the one following it */
+static void test_wrapped_command(gconstpointer data)
+{
+	struct line_log log = {};
+	struct hfp_gw *hfp;
+	int sv[2];
+
+	hfp = log_gw_new(sv, &log);
+
+	write_wrapped(sv[1], "\r", "AT+VGM=1\rAT+V", "GS=5\rAT+VGM=7\r");
+
+	g_assert_cmpstr(log.buf, ==, "VGM 1;VGS 5;VGM 7;");
+
+	hfp_gw_unref(hfp);
+	close(sv[1]);
+
+	tester_test_passed();
+}
+
+/* Each command is handled once even if the result is sent from its handler */
+static void test_sync_result(gconstpointer data)
+{
+	struct line_log log = { .reply_now = true };
+	struct hfp_gw *hfp;
+	int sv[2];
+
+	hfp = log_gw_new(sv, &log);
+
+	write_str(sv[1], "AT+VGS=1\rAT+VGM=2\rAT+VGS=3\r");
+
+	g_assert_cmpstr(log.buf, ==, "VGS 1;VGM 2;VGS 3;");
+
+	hfp_gw_unref(hfp);
+	close(sv[1]);
+
+	tester_test_passed();
+}
+
+static void run_hf_wrapped(const char *head, const char *tail,
+							const char *expected)
+{
+	struct line_log log = {};
+	struct hfp_hf *hfp;
+	int sv[2];
+
+	g_assert(!socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv));
+
+	hfp = hfp_hf_new(sv[0]);
+	g_assert(hfp);
+	g_assert(hfp_hf_set_close_on_unref(hfp, true));
+	g_assert(hfp_hf_register(hfp, log_ciev, "+CIEV", &log, NULL));
+
+	write_wrapped(sv[1], "\r\n", head, tail);
+
+	g_assert_cmpstr(log.buf, ==, expected);
+
+	hfp_hf_unref(hfp);
+	close(sv[1]);
+
+	tester_test_passed();
+}
+
+/* An event split by the end of the ring buffer and the one following it */
+static void test_hf_wrapped_line(gconstpointer data)
+{
+	run_hf_wrapped("\r\n+CIEV: 1,1\r\n\r\n+CIE",
+					"V: 1,2\r\n\r\n+CIEV: 2,0\r\n",
+					"CIEV 1 1;CIEV 1 2;CIEV 2 0;");
+}
+
+/* An event whose <cr> ends the ring buffer and <lf> starts it */
+static void test_hf_wrapped_cr_lf(gconstpointer data)
+{
+	run_hf_wrapped("\r\n+CIEV: 1,10\r", "\n\r\n+CIEV: 2,0\r\n",
+					"CIEV 1 10;CIEV 2 0;");
+}
+
 int main(int argc, char *argv[])
 {
 	tester_init(&argc, &argv);
@@ -2282,5 +2472,13 @@ int main(int argc, char *argv[])
 			raw_pdu('\r', '\n', 'O', 'K', '\r', '\n'),
 			data_end());
 
+	tester_add("/hfp/test_wrapped_command", NULL, NULL,
+						test_wrapped_command, NULL);
+	tester_add("/hfp/test_sync_result", NULL, NULL, test_sync_result, NULL);
+	tester_add("/hfp/test_hf_wrapped_line", NULL, NULL,
+						test_hf_wrapped_line, NULL);
+	tester_add("/hfp/test_hf_wrapped_cr_lf", NULL, NULL,
+						test_hf_wrapped_cr_lf, NULL);
+
 	return tester_run();
 }
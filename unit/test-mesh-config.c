@@ -0,0 +1,492 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "client/display.h"
+
+#include "mesh/mesh-config-json.c"
+
+#define PASS	COLOR_GREEN "PASS" COLOR_OFF
+#define FAIL	COLOR_RED "FAIL" COLOR_OFF
+
+#define NUM_MODELS	8
+
+static char storage_dir[] = "/tmp/mesh-config-XXXXXX";
+static const uint8_t test_uuid[16] = { 0x01, 0x02, 0x03 };
+static const uint8_t test_key[16] = { 0x10, 0x11, 0x12 };
+
+static struct mesh_config *loaded_cfg;
+static uint8_t loaded_ttl;
+static unsigned int loaded_appkeys;
+
+static void verify_bool(const char *label, bool result)
+{
+	l_info("%-40s => %s", label, result ? PASS : FAIL);
+
+	if (!result)
+		exit(1);
+}
+
+static json_object *parse(const char *str)
+{
+	json_object *jobj = json_tokener_parse(str);
+
+	if (!jobj) {
+		l_info("Invalid test JSON: %s", str);
+		exit(1);
+	}
+
+	return jobj;
+}
+
+static json_object *diff(json_object *jold, json_object *jnew)
+{
+	json_object *jops, *jpath;
+
+	jops = json_object_new_array();
+	jpath = json_object_new_array();
+	diff_config(jold, jnew, jpath, jops);
+	json_object_put(jpath);
+
+	return jops;
+}
+
+static bool has_op(json_object *jops, const char *path, bool set)
+{
+	int i, len = json_object_array_length(jops);
+
+	for (i = 0; i < len; i++) {
+		json_object *jop = json_object_array_get_idx(jops, i);
+		json_object *jpath;
+
+		if (!json_object_object_get_ex(jop, "p", &jpath))
+			continue;
+
+		if (strcmp(json_object_to_json_string_ext(jpath,
+					JSON_C_TO_STRING_PLAIN), path))
+			continue;
+
+		return json_object_object_get_ex(jop, "v", NULL) == set;
+	}
+
+	return false;
+}
+
+static void check_diff(void)
+{
+	json_object *jold, *jnew, *jops, *jcopy = NULL;
+
+	l_info(COLOR_BLUE "[Diff configuration]" COLOR_OFF);
+
+	jold = parse("{\"a\":1,\"b\":{\"c\":[1,2,3],\"d\":\"x\"},"
+						"\"e\":[1],\"gone\":true}");
+	jnew = parse("{\"a\":1,\"b\":{\"c\":[1,5,3],\"d\":\"y\"},"
+						"\"e\":[1,2],\"f\":7}");
+
+	jops = diff(jold, jold);
+	verify_bool("No operations for equal trees",
+					json_object_array_length(jops) == 0);
+	json_object_put(jops);
+
+	jops = diff(jold, jnew);
+	verify_bool("One operation per changed member",
+					json_object_array_length(jops) == 5);
+	verify_bool("Array member set by index",
+				has_op(jops, "[\"b\",\"c\",1]", true));
+	verify_bool("Object member set by key",
+				has_op(jops, "[\"b\",\"d\"]", true));
+	verify_bool("Resized array replaced whole",
+				has_op(jops, "[\"e\"]", true));
+	verify_bool("New member added", has_op(jops, "[\"f\"]", true));
+	verify_bool("Missing member removed",
+				has_op(jops, "[\"gone\"]", false));
+
+	json_object_deep_copy(jold, &jcopy, NULL);
+	apply_journal_ops(jcopy, jops);
+	verify_bool("Operations turn old tree into new",
+					json_object_equal(jcopy, jnew));
+
+	json_object_put(jcopy);
+	json_object_put(jops);
+	json_object_put(jnew);
+	json_object_put(jold);
+}
+
+static bool apply(json_object *jroot, const char *op)
+{
+	json_object *jop = parse(op);
+	bool result;
+
+	result = apply_journal_op(jroot, jop);
+	json_object_put(jop);
+
+	return result;
+}
+
+static void check_apply_op(void)
+{
+	json_object *jroot, *jexpect;
+
+	l_info(COLOR_BLUE "[Apply journal operation]" COLOR_OFF);
+
+	jroot = parse("{\"a\":{\"b\":[1,2]},\"c\":1}");
+
+	verify_bool("Set nested array element",
+			apply(jroot, "{\"p\":[\"a\",\"b\",0],\"v\":9}"));
+	verify_bool("Add object member",
+			apply(jroot, "{\"p\":[\"a\",\"n\"],\"v\":[]}"));
+	verify_bool("Remove object member",
+			apply(jroot, "{\"p\":[\"c\"]}"));
+
+	verify_bool("Reject missing path", !apply(jroot, "{\"v\":1}"));
+	verify_bool("Reject empty path", !apply(jroot, "{\"p\":[],\"v\":1}"));
+	verify_bool("Reject index past array end",
+			!apply(jroot, "{\"p\":[\"a\",\"b\",2],\"v\":1}"));
+	verify_bool("Reject path through missing member",
+			!apply(jroot, "{\"p\":[\"x\",\"y\"],\"v\":1}"));
+	verify_bool("Reject removing array element",
+			!apply(jroot, "{\"p\":[\"a\",\"b\",1]}"));
+
+	jexpect = parse("{\"a\":{\"b\":[9,2],\"n\":[]}}");
+	verify_bool("Resulting tree", json_object_equal(jroot, jexpect));
+
+	json_object_put(jexpect);
+	json_object_put(jroot);
+}
+
+static char *node_path(void)
+{
+	char uuid[33];
+
+	hex2str((uint8_t *) test_uuid, 16, uuid, sizeof(uuid));
+
+	return l_strdup_printf("%s/%s%s", storage_dir, uuid, cfgnode_name);
+}
+
+static size_t file_size(const char *fname)
+{
+	struct stat st;
+
+	if (stat(fname, &st) < 0)
+		return 0;
+
+	return st.st_size;
+}
+
+static void remove_node(void)
+{
+	char *fname = node_path();
+	char *dir = l_strdup(fname);
+
+	remove(fname);
+	l_free(fname);
+
+	fname = l_strdup_printf("%s%s", dir, bak_ext);
+	remove(fname);
+	l_free(fname);
+
+	fname = l_strdup_printf("%s%s", dir, journal_ext);
+	remove(fname);
+	l_free(fname);
+
+	rmdir(dirname(dir));
+	l_free(dir);
+}
+
+static struct mesh_config *create_node(void)
+{
+	struct mesh_config_node node;
+	struct mesh_config_element ele;
+	struct mesh_config_model mods[NUM_MODELS];
+	struct mesh_config *cfg;
+	int i;
+
+	memset(&node, 0, sizeof(node));
+	memset(&ele, 0, sizeof(ele));
+	memset(mods, 0, sizeof(mods));
+
+	node.elements = l_queue_new();
+	ele.models = l_queue_new();
+
+	for (i = 0; i < NUM_MODELS; i++) {
+		mods[i].id = 0x1000 + i;
+		l_queue_push_tail(ele.models, &mods[i]);
+	}
+
+	l_queue_push_tail(node.elements, &ele);
+	node.ttl = 5;
+
+	cfg = mesh_config_create(storage_dir, test_uuid, &node);
+
+	l_queue_destroy(ele.models, NULL);
+	l_queue_destroy(node.elements, NULL);
+
+	if (!cfg) {
+		l_info("Failed to create node configuration");
+		exit(1);
+	}
+
+	mesh_config_write_unicast(cfg, 0x0100);
+	mesh_config_write_iv_index(cfg, 0, false);
+	mesh_config_write_token(cfg, test_key);
+	mesh_config_write_device_key(cfg, test_key);
+	mesh_config_net_key_add(cfg, 0, test_key);
+
+	return cfg;
+}
+
+static bool load_cb(struct mesh_config_node *node, const uint8_t uuid[16],
+				struct mesh_config *cfg, void *user_data)
+{
+	loaded_cfg = cfg;
+	loaded_ttl = node->ttl;
+	loaded_appkeys = l_queue_length(node->appkeys);
+
+	return true;
+}
+
+static struct mesh_config *reload_node(void)
+{
+	loaded_cfg = NULL;
+	mesh_config_load_nodes(storage_dir, load_cb, NULL);
+
+	return loaded_cfg;
+}
+
+/* Drops the node without writing anything back, as a crash would */
+static void drop_config(struct mesh_config *cfg)
+{
+	l_queue_destroy(cfg->idles, release_idle);
+	l_timeout_remove(cfg->flush_to);
+
+	if (cfg->journal_fd >= 0)
+		close(cfg->journal_fd);
+
+	l_free(cfg->node_dir_path);
+	json_object_put(cfg->jsaved);
+	json_object_put(cfg->jnode);
+	l_free(cfg);
+}
+
+static void check_replay(void)
+{
+	struct mesh_config_opts journal_opts = { .journal = true };
+	struct mesh_config_stats before, after;
+	struct mesh_config *cfg;
+	char *fname, *jname;
+	size_t saved;
+
+	l_info(COLOR_BLUE "[Replay journal on load]" COLOR_OFF);
+
+	mesh_config_set_opts(&journal_opts);
+	cfg = create_node();
+
+	fname = node_path();
+	jname = l_strdup_printf("%s%s", fname, journal_ext);
+	saved = file_size(fname);
+	mesh_config_get_stats(cfg, &before);
+
+	mesh_config_write_ttl(cfg, 7);
+	mesh_config_app_key_add(cfg, 0, 1, test_key);
+	mesh_config_get_stats(cfg, &after);
+
+	verify_bool("Changes go to the journal",
+			after.journal_writes == before.journal_writes + 2 &&
+						after.saves == before.saves);
+	verify_bool("Configuration file left alone",
+					file_size(fname) == saved);
+	verify_bool("Journal holds the changes",
+				file_size(jname) == cfg->journal_size);
+
+	drop_config(cfg);
+
+	cfg = reload_node();
+	verify_bool("Node loaded", cfg != NULL);
+	verify_bool("Replayed default TTL", loaded_ttl == 7);
+	verify_bool("Replayed application key",
+						loaded_appkeys == 1);
+
+	mesh_config_release(cfg);
+	remove_node();
+
+	l_free(jname);
+	l_free(fname);
+}
+
+static void check_torn_tail(void)
+{
+	struct mesh_config_opts journal_opts = { .journal = true };
+	struct mesh_config *cfg;
+	char *fname, *jname;
+	size_t good;
+	FILE *fp;
+
+	l_info(COLOR_BLUE "[Torn journal tail]" COLOR_OFF);
+
+	mesh_config_set_opts(&journal_opts);
+	cfg = create_node();
+
+	fname = node_path();
+	jname = l_strdup_printf("%s%s", fname, journal_ext);
+
+	mesh_config_write_ttl(cfg, 9);
+	good = cfg->journal_size;
+	drop_config(cfg);
+
+	/* A change cut short by a crash, missing its newline */
+	fp = fopen(jname, "a");
+	fputs("[{\"p\":[\"defaultTTL\"],\"v\":3", fp);
+	fclose(fp);
+
+	cfg = reload_node();
+	verify_bool("Node loaded", cfg != NULL);
+	verify_bool("Complete change replayed", loaded_ttl == 9);
+	verify_bool("Torn change trimmed", file_size(jname) == good);
+
+	/* Later changes must replay after the trimmed tail */
+	mesh_config_write_ttl(cfg, 11);
+	drop_config(cfg);
+
+	cfg = reload_node();
+	verify_bool("Change after trimmed tail replayed",
+						loaded_ttl == 11);
+
+	mesh_config_release(cfg);
+	remove_node();
+
+	l_free(jname);
+	l_free(fname);
+}
+
+static void check_backup(void)
+{
+	struct mesh_config_opts journal_opts = { .journal = true };
+	struct mesh_config *cfg;
+	char *fname, *jname, *bname;
+	size_t journal_size;
+
+	l_info(COLOR_BLUE "[Backup with journal]" COLOR_OFF);
+
+	mesh_config_set_opts(&journal_opts);
+	cfg = create_node();
+
+	fname = node_path();
+	jname = l_strdup_printf("%s%s", fname, journal_ext);
+	bname = l_strdup_printf("%s%s", fname, bak_ext);
+
+	mesh_config_write_ttl(cfg, 6);
+	journal_size = cfg->journal_size;
+	drop_config(cfg);
+
+	/* Crash between the two renames of a full save */
+	remove(bname);
+	rename(fname, bname);
+
+	cfg = reload_node();
+	verify_bool("Node loaded from backup", cfg != NULL);
+	verify_bool("Journal replayed over backup", loaded_ttl == 6);
+	verify_bool("Backup restored",
+			file_size(fname) && !file_size(bname));
+	verify_bool("Journal kept", file_size(jname) == journal_size);
+	verify_bool("Node uses configuration path",
+				!strcmp(cfg->node_dir_path, fname));
+
+	mesh_config_write_ttl(cfg, 8);
+	drop_config(cfg);
+
+	cfg = reload_node();
+	verify_bool("Change after restore replayed", loaded_ttl == 8);
+
+	mesh_config_release(cfg);
+	remove_node();
+
+	l_free(bname);
+	l_free(jname);
+	l_free(fname);
+}
+
+static void check_compaction(void)
+{
+	struct mesh_config_opts journal_opts = { .journal = true };
+	struct mesh_config_stats before, after;
+	struct mesh_config *cfg;
+	char *fname, *jname;
+	int i;
+
+	l_info(COLOR_BLUE "[Journal compaction]" COLOR_OFF);
+
+	mesh_config_set_opts(&journal_opts);
+	cfg = create_node();
+
+	fname = node_path();
+	jname = l_strdup_printf("%s%s", fname, journal_ext);
+	mesh_config_get_stats(cfg, &before);
+
+	/* Subscriptions grow the journal until it outgrows node.json */
+	for (i = 0; i < 1000; i++) {
+		struct mesh_config_sub sub = { .addr.grp = 0xc000 + i };
+
+		mesh_config_model_sub_add(cfg, 0x0100, 0x1000, false, &sub);
+		mesh_config_get_stats(cfg, &after);
+
+		if (after.saves != before.saves)
+			break;
+	}
+
+	verify_bool("Full save once journal outgrew file",
+					after.saves == before.saves + 1);
+	verify_bool("Journal removed after full save",
+				!cfg->journal_size && file_size(jname) == 0);
+	verify_bool("Saved copy matches configuration",
+				json_object_equal(cfg->jsaved, cfg->jnode));
+
+	mesh_config_write_ttl(cfg, 4);
+	verify_bool("Journal restarted after full save",
+				file_size(jname) == cfg->journal_size &&
+							cfg->journal_size);
+
+	mesh_config_release(cfg);
+
+	cfg = reload_node();
+	verify_bool("Node loaded", cfg != NULL);
+	verify_bool("Change after compaction replayed",
+						loaded_ttl == 4);
+
+	mesh_config_release(cfg);
+	remove_node();
+
+	l_free(jname);
+	l_free(fname);
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	if (!mkdtemp(storage_dir))
+		return 1;
+
+	check_diff();
+	check_apply_op();
+	check_replay();
+	check_torn_tail();
+	check_backup();
+	check_compaction();
+
+	rmdir(storage_dir);
+
+	return 0;
+}
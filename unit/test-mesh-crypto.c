@@ -19,6 +19,75 @@
 
 #include "mesh/crypto.c"
 
+/* Raw key wrappers for the key context based internals of crypto.c */
+static bool packet_encrypt(uint8_t *packet, uint8_t packet_len,
+				const uint8_t network_key[16],
+				uint32_t iv_index, bool proxy,
+				bool ctl, uint8_t ttl, uint32_t seq,
+				uint16_t src)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, network_key);
+	result = mesh_crypto_packet_encrypt(packet, packet_len, &ctx,
+					iv_index, proxy, ctl, ttl, seq, src);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
+static bool packet_decrypt(uint8_t *packet, uint8_t packet_len,
+				const uint8_t network_key[16],
+				uint32_t iv_index, bool proxy,
+				bool ctl, uint8_t ttl, uint32_t seq,
+				uint16_t src)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, network_key);
+	result = mesh_crypto_packet_decrypt(packet, packet_len, &ctx,
+					iv_index, proxy, ctl, ttl, seq, src);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
+static bool network_obfuscate(uint8_t *packet,
+					const uint8_t privacy_key[16],
+					uint32_t iv_index,
+					bool ctl, uint8_t ttl,
+					uint32_t seq, uint16_t src)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, privacy_key);
+	result = mesh_crypto_network_obfuscate(packet, &ctx, iv_index,
+							ctl, ttl, seq, src);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
+static bool network_clarify(uint8_t *packet,
+					const uint8_t privacy_key[16],
+					uint32_t iv_index,
+					bool *ctl, uint8_t *ttl,
+					uint32_t *seq, uint16_t *src)
+{
+	struct mesh_crypto_ctx ctx;
+	bool result;
+
+	ctx_init(&ctx, privacy_key);
+	result = mesh_crypto_network_clarify(packet, &ctx, iv_index,
+							ctl, ttl, seq, src);
+	ctx_clear(&ctx);
+
+	return result;
+}
+
 struct mesh_crypto_test {
 	const char *name;
 
@@ -914,7 +983,7 @@ static void check_encrypt_segment(const struct mesh_crypto_test *keys,
 	net_msg_len = len + 2;
 	show_data("TransportPayload", 7, packet + 7, net_msg_len);
 
-	status = mesh_crypto_packet_encrypt(packet, packet_len,
+	status = packet_encrypt(packet, packet_len,
 						enc_key,
 						keys->iv_index, false,
 						keys->ctl, keys->net_ttl,
@@ -956,7 +1025,7 @@ static void check_encrypt_segment(const struct mesh_crypto_test *keys,
 	}
 
 	show_data("PreObsPayload", 1, packet + 1, 6 + net_msg_len);
-	status = mesh_crypto_network_obfuscate(packet, priv_key,
+	status = network_obfuscate(packet, priv_key,
 					keys->iv_index,
 					keys->ctl, keys->net_ttl,
 					keys->net_seq[0], keys->net_src);
@@ -1255,7 +1324,7 @@ static void check_encrypt(const struct mesh_crypto_test *keys)
 		net_msg_len = seg_len + 2;
 		show_data("TransportPayload", 7, packet + 7, net_msg_len);
 
-		status = mesh_crypto_packet_encrypt(packet, packet_len, enc_key,
+		status = packet_encrypt(packet, packet_len, enc_key,
 						keys->iv_index, false,
 						keys->ctl, keys->net_ttl,
 						keys->net_seq[i],
@@ -1298,7 +1367,7 @@ static void check_encrypt(const struct mesh_crypto_test *keys)
 		}
 
 		show_data("PreObsPayload", 1, packet + 1, 6 + net_msg_len);
-		status = mesh_crypto_network_obfuscate(packet, priv_key,
+		status = network_obfuscate(packet, priv_key,
 					keys->iv_index,
 					keys->ctl, keys->net_ttl,
 					keys->net_seq[i], keys->net_src);
@@ -1365,7 +1434,7 @@ static void check_decrypt_segment(const struct mesh_crypto_test *keys,
 		net_mic64 = l_get_be64(pkt + pkt_len - 8);
 		show_data("EncryptedPayload", 7, pkt + 7, pkt_len - 7 - 8);
 
-		mesh_crypto_packet_decrypt(pkt, pkt_len,
+		packet_decrypt(pkt, pkt_len,
 							enc_key,
 							keys->iv_index, false,
 							ctl, ttl, seq,
@@ -1379,7 +1448,7 @@ static void check_decrypt_segment(const struct mesh_crypto_test *keys,
 		net_mic32 = l_get_be32(pkt + pkt_len - 4);
 		show_data("EncryptedPayload", 7, pkt + 7, pkt_len - 7 - 4);
 
-		mesh_crypto_packet_decrypt(pkt, pkt_len,
+		packet_decrypt(pkt, pkt_len,
 							enc_key,
 							keys->iv_index, false,
 							ctl, ttl, seq,
@@ -1576,7 +1645,7 @@ static void check_decrypt(const struct mesh_crypto_test *keys)
 		net_msg = packet + 7;
 		net_msg_len = packet_len - 7;
 
-		status = mesh_crypto_network_clarify(packet, priv_key,
+		status = network_clarify(packet, priv_key,
 				keys->iv_index, &net_ctl, &net_ttl, &net_seq,
 				&net_src);
 
@@ -1591,7 +1660,7 @@ static void check_decrypt(const struct mesh_crypto_test *keys)
 			net_mic64 = l_get_be64(packet + packet_len - 8);
 			show_data("NetworkMessage", 7, net_msg,
 							net_msg_len - 8);
-			mesh_crypto_packet_decrypt(packet, packet_len,
+			packet_decrypt(packet, packet_len,
 						enc_key,
 						keys->iv_index, false,
 						net_ctl, net_ttl,
@@ -1606,7 +1675,7 @@ static void check_decrypt(const struct mesh_crypto_test *keys)
 			net_mic32 = l_get_be32(packet + packet_len - 4);
 			show_data("NetworkMessage", 7, net_msg,
 							net_msg_len - 4);
-			mesh_crypto_packet_decrypt(packet, packet_len,
+			packet_decrypt(packet, packet_len,
 						enc_key,
 						keys->iv_index, false,
 						net_ctl, net_ttl,
@@ -2128,6 +2197,95 @@ static void check_k4(const struct mesh_crypto_test *keys)
 	l_info("");
 }
 
+#define BENCH_ROUNDS	2000
+
+static bool bench_round(const uint8_t *pkt, uint8_t pkt_len,
+				uint32_t iv_index, const uint8_t *enc_key,
+				const uint8_t *priv_key,
+				struct mesh_crypto_ctx *enc_ctx,
+				struct mesh_crypto_ctx *priv_ctx)
+{
+	uint8_t out[29];
+
+	if (enc_ctx) {
+		if (!mesh_crypto_ctx_packet_decode(pkt, pkt_len, false, out,
+						iv_index, enc_ctx, priv_ctx))
+			return false;
+
+		if (!mesh_crypto_ctx_packet_encode(out, pkt_len, iv_index,
+							enc_ctx, priv_ctx))
+			return false;
+	} else {
+		if (!mesh_crypto_packet_decode(pkt, pkt_len, false, out,
+						iv_index, enc_key, priv_key))
+			return false;
+
+		if (!mesh_crypto_packet_encode(out, pkt_len, iv_index,
+							enc_key, priv_key))
+			return false;
+	}
+
+	return !memcmp(out, pkt, pkt_len);
+}
+
+static void check_packet_benchmark(const struct mesh_crypto_test *keys)
+{
+	struct mesh_crypto_ctx *enc_ctx, *priv_ctx;
+	uint8_t *net_key, *packet;
+	uint8_t enc_key[16];
+	uint8_t priv_key[16];
+	uint8_t nid, p = 0;
+	size_t packet_len;
+	uint64_t start, raw_us, ctx_us;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Benchmark %s]" COLOR_OFF, keys->name);
+
+	net_key = l_util_from_hexstring(keys->net_key, NULL);
+	packet = l_util_from_hexstring(keys->packet[0], &packet_len);
+	mesh_crypto_k2(net_key, &p, 1, &nid, enc_key, priv_key);
+
+	start = l_time_now();
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		if (!bench_round(packet, packet_len, keys->iv_index,
+					enc_key, priv_key, NULL, NULL)) {
+			verify_bool("Raw key round trip", 0, true, false);
+			return;
+		}
+	}
+
+	raw_us = l_time_diff(start, l_time_now());
+
+	enc_ctx = mesh_crypto_ctx_new(enc_key);
+	priv_ctx = mesh_crypto_ctx_new(priv_key);
+	start = l_time_now();
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		if (!bench_round(packet, packet_len, keys->iv_index,
+				NULL, NULL, enc_ctx, priv_ctx)) {
+			verify_bool("Key context round trip", 0, true, false);
+			return;
+		}
+	}
+
+	ctx_us = l_time_diff(start, l_time_now());
+	mesh_crypto_ctx_free(enc_ctx);
+	mesh_crypto_ctx_free(priv_ctx);
+
+	/* Each round decodes and encodes one network PDU */
+	l_info("%-20s = %u packets/s", "Raw key",
+			(unsigned int) (BENCH_ROUNDS * 2000000ULL /
+							(raw_us ? : 1)));
+	l_info("%-20s = %u packets/s", "Key context",
+			(unsigned int) (BENCH_ROUNDS * 2000000ULL /
+							(ctx_us ? : 1)));
+	l_info("");
+
+	l_free(packet);
+	l_free(net_key);
+}
+
 int main(int argc, char *argv[])
 {
 	l_log_set_stderr();
@@ -2182,5 +2340,8 @@ int main(int argc, char *argv[])
 	/* Section 8.6 Mesh Proxy Service sample data */
 	check_id_beacon(&s8_6_2);
 
+	/* Network PDU throughput, per call vs cached key contexts */
+	check_packet_benchmark(&s8_3_1);
+
 	return 0;
 }
@@ -0,0 +1,418 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <ell/ell.h>
+#include <json-c/json.h>
+
+#include "src/shared/shell.h"
+#include "client/display.h"
+
+#include "mesh/mesh-defs.h"
+#include "mesh/util.h"
+
+#include "tools/mesh/keys.h"
+#include "tools/mesh/remote.h"
+#include "tools/mesh/mesh-db.h"
+
+#define PASS	COLOR_GREEN "PASS" COLOR_OFF
+#define FAIL	COLOR_RED "FAIL" COLOR_OFF
+
+#define NUM_NODES	200
+#define NUM_ADDED	20
+#define NUM_REMOVED	10
+#define NUM_ELEMENTS	2
+#define FIRST_UNICAST	0x0100
+
+static char storage_dir[] = "/tmp/mesh-db-XXXXXX";
+static char db_fname[PATH_MAX];
+
+void bt_shell_printf(const char *fmt, ...)
+{
+}
+
+void bt_shell_set_prompt(const char *string, const char *color)
+{
+}
+
+static void verify_bool(const char *label, bool result)
+{
+	l_info("%-40s => %s", label, result ? PASS : FAIL);
+
+	if (!result) {
+		del_path(storage_dir);
+		exit(1);
+	}
+}
+
+static uint16_t node_unicast(unsigned int i)
+{
+	return FIRST_UNICAST + i * NUM_ELEMENTS;
+}
+
+static void node_uuid(unsigned int i, uint8_t uuid[16])
+{
+	memset(uuid, 0, 16);
+	l_put_be32(i, uuid + 12);
+	uuid[6] = 0x40;
+	uuid[8] = 0x80;
+}
+
+static bool write_db_file(const char *fname, unsigned int first,
+					unsigned int count, bool dev_keys)
+{
+	char uuid_str[37];
+	uint8_t uuid[16];
+	unsigned int i;
+	FILE *fp;
+
+	fp = fopen(fname, "w");
+	if (!fp)
+		return false;
+
+	fprintf(fp, "{\"token\":\"0102030405060708\",\"ivIndex\":0,"
+				"\"netKeys\":[{\"index\":0,\"phase\":0}],"
+				"\"appKeys\":[{\"index\":1,\"boundNetKey\":0}],"
+				"\"networkExclusions\":[],\"nodes\":[");
+
+	for (i = first; i < first + count; i++) {
+		node_uuid(i, uuid);
+		l_uuid_to_string(uuid, uuid_str, sizeof(uuid_str));
+
+		fprintf(fp, "%s{\"UUID\":\"%s\",\"unicastAddress\":\"%4.4x\","
+				"%s"
+				"\"netKeys\":[{\"index\":0,\"updated\":false}],"
+				"\"appKeys\":[],\"elements\":["
+				"{\"index\":0,\"models\":[{\"modelId\":\"0000\"},"
+				"{\"modelId\":\"1000\"}]},"
+				"{\"index\":1,\"models\":[{\"modelId\":\"1000\","
+				"\"bind\":[],\"subscribe\":[]}]}]}",
+				i > first ? "," : "", uuid_str,
+				node_unicast(i), dev_keys ?
+				"\"deviceKey\":\"000102030405060708090a0b0c0d0e0f\","
+				: "");
+	}
+
+	fprintf(fp, "]}");
+	fclose(fp);
+
+	return true;
+}
+
+static bool write_file(const char *fname, const char *str)
+{
+	FILE *fp;
+
+	fp = fopen(fname, "w");
+	if (!fp)
+		return false;
+
+	fputs(str, fp);
+	fclose(fp);
+
+	return true;
+}
+
+static json_object *read_db(const char *fname)
+{
+	json_object *jcfg;
+	struct stat st;
+	char *str;
+	int fd;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	str = l_new(char, st.st_size + 1);
+
+	if (read(fd, str, st.st_size) != st.st_size)
+		str[0] = '\0';
+
+	close(fd);
+
+	jcfg = json_tokener_parse(str);
+	l_free(str);
+
+	return jcfg;
+}
+
+static int count_nodes(const char *fname, const char *key, int value)
+{
+	json_object *jcfg, *jnodes, *jval;
+	int i, len, count = 0;
+
+	jcfg = read_db(fname);
+
+	if (!json_object_object_get_ex(jcfg, "nodes", &jnodes)) {
+		json_object_put(jcfg);
+		return -1;
+	}
+
+	len = json_object_array_length(jnodes);
+
+	for (i = 0; i < len; i++) {
+		json_object *jnode = json_object_array_get_idx(jnodes, i);
+
+		/* A negative value matches any value of the key */
+		if (!key || (json_object_object_get_ex(jnode, key, &jval) &&
+				(value < 0 || json_object_get_int(jval) == value)))
+			count++;
+	}
+
+	json_object_put(jcfg);
+
+	return count;
+}
+
+static void check_load(void)
+{
+	bool result = true;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Load database]" COLOR_OFF);
+
+	snprintf(db_fname, PATH_MAX, "%s/mesh_db.json", storage_dir);
+
+	verify_bool("Write database",
+			write_db_file(db_fname, 0, NUM_NODES, false));
+	verify_bool("Load database", mesh_db_load(db_fname));
+
+	for (i = 0; i < NUM_NODES; i++)
+		result &= remote_ele_cnt(node_unicast(i) + 1) == NUM_ELEMENTS;
+
+	verify_bool("Nodes found by element address", result);
+}
+
+static void check_batch(void)
+{
+	bool result = true;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Batched saves]" COLOR_OFF);
+
+	mesh_db_batch_begin();
+
+	for (i = 0; i < NUM_NODES; i++) {
+		uint16_t unicast = node_unicast(i);
+
+		result &= remote_add_app_key(unicast, 1, true);
+		result &= mesh_db_node_set_ttl(unicast, 5);
+		result &= mesh_db_node_model_bind(unicast, unicast + 1,
+							false, 0x1000, 1);
+		result &= mesh_db_node_model_add_sub(unicast, unicast + 1,
+							false, 0x1000, 0xc000);
+	}
+
+	verify_bool("Configure nodes", result);
+	verify_bool("Nothing written inside batch",
+				count_nodes(db_fname, "defaultTTL", 5) == 0);
+
+	verify_bool("End batch", mesh_db_batch_end());
+	verify_bool("Batch written once it ends",
+			count_nodes(db_fname, "defaultTTL", 5) == NUM_NODES);
+
+	verify_bool("Update node outside batch",
+				mesh_db_node_set_ttl(node_unicast(0), 7));
+	verify_bool("Update written at once",
+				count_nodes(db_fname, "defaultTTL", 7) == 1);
+}
+
+static void check_add_remove(void)
+{
+	uint8_t uuid[16];
+	bool result = true;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Add and remove nodes]" COLOR_OFF);
+
+	mesh_db_batch_begin();
+
+	for (i = 0; i < NUM_ADDED; i++) {
+		uint16_t unicast = node_unicast(NUM_NODES + i);
+
+		node_uuid(NUM_NODES + i, uuid);
+
+		result &= remote_add_node(uuid, unicast, NUM_ELEMENTS, 0);
+		result &= mesh_db_add_node(uuid, NUM_ELEMENTS, unicast, 0);
+	}
+
+	/* Already known by UUID */
+	node_uuid(0, uuid);
+	verify_bool("Add nodes", result);
+	verify_bool("Reject node with known UUID",
+			!mesh_db_add_node(uuid, NUM_ELEMENTS,
+				node_unicast(NUM_NODES + NUM_ADDED), 0));
+
+	mesh_db_batch_end();
+
+	for (i = 0; i < NUM_REMOVED; i++)
+		result &= remote_del_node(node_unicast(i * 2)) == NUM_ELEMENTS;
+
+	verify_bool("Remove nodes", result);
+	verify_bool("Removed node dropped from index",
+				!remote_ele_cnt(node_unicast(0)) &&
+				!remote_ele_cnt(node_unicast(0) + 1));
+	verify_bool("Other nodes kept in index",
+			remote_ele_cnt(node_unicast(1)) == NUM_ELEMENTS);
+	verify_bool("Database holds remaining nodes",
+			count_nodes(db_fname, NULL, 0) ==
+				NUM_NODES + NUM_ADDED - NUM_REMOVED);
+}
+
+static void check_export(void)
+{
+	char fname[PATH_MAX];
+	uint8_t key[16] = { 0 };
+	bool result = true;
+	unsigned int i;
+	void *expt;
+
+	l_info(COLOR_BLUE "[Export database]" COLOR_OFF);
+
+	snprintf(fname, PATH_MAX, "%s/export.json", storage_dir);
+
+	expt = mesh_db_prepare_export();
+	verify_bool("Prepare export", expt != NULL);
+
+	for (i = 1; i < NUM_NODES + NUM_ADDED; i += 2)
+		result &= mesh_db_set_device_key(expt, node_unicast(i), key);
+
+	verify_bool("Set device keys", result);
+	verify_bool("Reject device key of removed node",
+			!mesh_db_set_device_key(expt, node_unicast(0), key));
+	verify_bool("Finish export",
+				mesh_db_finish_export(false, expt, fname));
+	verify_bool("Exported all nodes", count_nodes(fname, NULL, 0) ==
+				NUM_NODES + NUM_ADDED - NUM_REMOVED);
+}
+
+static void import_cb(void *node, const uint8_t uuid[16], uint16_t unicast,
+					uint8_t ele_cnt, uint16_t net_idx,
+					const uint8_t dev_key[16], void *user_data)
+{
+	struct l_queue *nodes = user_data;
+
+	if (dev_key[15] == 0x0f && ele_cnt == NUM_ELEMENTS &&
+					!remote_ele_cnt(unicast))
+		l_queue_push_tail(nodes, node);
+	else
+		mesh_db_free_imported_node(node);
+}
+
+static void check_import(void)
+{
+	unsigned int first = NUM_NODES + NUM_ADDED;
+	struct l_queue *nodes = l_queue_new();
+	char fname[PATH_MAX];
+	bool result = true;
+	void *node;
+	int total;
+
+	l_info(COLOR_BLUE "[Import nodes]" COLOR_OFF);
+
+	snprintf(fname, PATH_MAX, "%s/import.json", storage_dir);
+	total = count_nodes(db_fname, NULL, 0);
+
+	verify_bool("Write import file without keys",
+			write_db_file(fname, first, NUM_ADDED, false));
+	verify_bool("Skip nodes without device key",
+			mesh_db_import_nodes(fname, import_cb, nodes) == 0 &&
+						l_queue_isempty(nodes));
+
+	/* Two known nodes lead the new ones */
+	verify_bool("Write import file",
+			write_db_file(fname, first - 2, NUM_ADDED + 2, true));
+
+	verify_bool("Import new nodes",
+			mesh_db_import_nodes(fname, import_cb, nodes) ==
+								NUM_ADDED);
+	verify_bool("Callback per node with device key",
+				l_queue_length(nodes) == NUM_ADDED);
+	verify_bool("Nothing written before the daemon replied",
+			count_nodes(db_fname, NULL, 0) == total &&
+			!remote_ele_cnt(node_unicast(first)));
+
+	/* The daemon rejects the first node */
+	mesh_db_free_imported_node(l_queue_pop_head(nodes));
+
+	while ((node = l_queue_pop_head(nodes)))
+		result &= mesh_db_add_imported_node(node);
+
+	verify_bool("Add accepted nodes", result);
+	verify_bool("Rejected node left out",
+			!remote_ele_cnt(node_unicast(first)) &&
+			remote_ele_cnt(node_unicast(first + 1)) ==
+								NUM_ELEMENTS);
+	verify_bool("Nodes written to database",
+			count_nodes(db_fname, NULL, 0) ==
+						total + NUM_ADDED - 1);
+	verify_bool("No device key in database",
+			count_nodes(db_fname, "deviceKey", -1) == 0);
+
+	verify_bool("Import again offers only rejected node",
+			mesh_db_import_nodes(fname, import_cb, nodes) == 1);
+
+	verify_bool("Add node accepted later",
+			mesh_db_add_imported_node(l_queue_pop_head(nodes)));
+	verify_bool("Import again offers nothing",
+			mesh_db_import_nodes(fname, import_cb, nodes) == 0);
+
+	/* New UUID, but its addresses overlap those of a known node */
+	verify_bool("Write overlapping node", write_file(fname,
+		"{\"nodes\":[{\"UUID\":\"ffffffff-0000-4000-8000-000000000000\","
+		"\"unicastAddress\":\"0103\",\"netKeys\":[{\"index\":0}],"
+		"\"deviceKey\":\"000102030405060708090a0b0c0d0e0f\","
+		"\"appKeys\":[],\"elements\":[{\"index\":0,\"models\":[]},"
+		"{\"index\":1,\"models\":[]}]}]}"));
+	verify_bool("Skip node with addresses in use",
+			mesh_db_import_nodes(fname, import_cb, nodes) == 0);
+
+	verify_bool("Reject missing file",
+		mesh_db_import_nodes(db_fname + 1, import_cb, nodes) < 0);
+
+	l_queue_destroy(nodes, mesh_db_free_imported_node);
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	if (!mkdtemp(storage_dir))
+		return 1;
+
+	check_load();
+	check_batch();
+	check_add_remove();
+	check_export();
+	check_import();
+
+	del_path(storage_dir);
+
+	return 0;
+}
@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/net-keys.h"
+#include "mesh/net.h"
+#include "mesh/util.h"
+#include "mesh/friend.h"
+
+#include "client/display.h"
+
+#define PASS	COLOR_GREEN "PASS" COLOR_OFF
+#define FAIL	COLOR_RED "FAIL" COLOR_OFF
+
+#define CACHE_SIZE	8
+#define LPN_ADDR	0x0100
+#define PEER_ADDR	0x0200
+#define MAX_SENT	32
+#define NUM_MSGS	(4 * FRND_CACHE_MAX)
+
+static struct l_queue *negotiations;
+
+static uint32_t sent[MAX_SENT];
+static uint32_t sent_flags[MAX_SENT];
+static unsigned int num_sent;
+static bool responded;
+static bool update_sent;
+
+struct l_queue *mesh_net_get_negotiations(struct mesh_net *net)
+{
+	return negotiations;
+}
+
+uint16_t mesh_net_get_address(struct mesh_net *net)
+{
+	return 0x0001;
+}
+
+uint32_t mesh_net_get_iv_index(struct mesh_net *net)
+{
+	return 0;
+}
+
+uint32_t mesh_net_get_seq_num(struct mesh_net *net)
+{
+	return 0;
+}
+
+uint32_t mesh_net_next_seq_num(struct mesh_net *net)
+{
+	return 0;
+}
+
+void mesh_net_get_snb_state(struct mesh_net *net, uint8_t *flags,
+							uint32_t *iv_index)
+{
+	*flags = 0;
+	*iv_index = 0;
+}
+
+bool mesh_net_get_key(struct mesh_net *net, bool new_key, uint16_t idx,
+							uint32_t *net_key_id)
+{
+	return false;
+}
+
+uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
+					uint16_t lp_cnt, uint16_t fn_cnt)
+{
+	return 0;
+}
+
+void net_key_unref(uint32_t id)
+{
+}
+
+void print_packet(const char *label, const void *data, uint16_t size)
+{
+}
+
+struct mesh_friend *mesh_friend_new(struct mesh_net *net, uint16_t dst,
+					uint8_t ele_cnt, uint8_t frd,
+					uint8_t frw, uint32_t fpt,
+					uint16_t fn_cnt, uint16_t lp_cnt,
+					uint8_t cache_size)
+{
+	return NULL;
+}
+
+void mesh_friend_free(void *data)
+{
+	struct mesh_friend *frnd = data;
+
+	friend_cache_free(frnd);
+	l_free(frnd);
+}
+
+bool mesh_friend_clear(struct mesh_net *net, struct mesh_friend *frnd)
+{
+	return false;
+}
+
+static void record(uint32_t seq, uint32_t flags)
+{
+	if (num_sent < MAX_SENT) {
+		sent_flags[num_sent] = flags;
+		sent[num_sent++] = seq;
+	}
+
+	responded = true;
+}
+
+void mesh_net_transport_send(struct mesh_net *net, uint32_t net_key_id,
+				uint16_t net_idx, uint32_t iv_index,
+				uint8_t ttl, uint32_t seq, uint16_t src,
+				uint16_t dst, const uint8_t *msg,
+				uint16_t msg_len)
+{
+	if (msg[0] == NET_OP_FRND_UPDATE) {
+		update_sent = true;
+		responded = true;
+	} else
+		record(seq, 0);
+}
+
+void mesh_net_ack_send(struct mesh_net *net, uint32_t net_key_id,
+				uint32_t iv_index, uint8_t ttl, uint32_t seq,
+				uint16_t src, uint16_t dst, bool rly,
+				uint16_t seqZero, uint32_t ack_flags)
+{
+	record(seq, ack_flags);
+}
+
+void mesh_net_send_seg(struct mesh_net *net, uint32_t net_key_id,
+				uint32_t iv_index, uint8_t ttl, uint32_t seq,
+				uint16_t src, uint16_t dst, uint32_t hdr,
+				const void *seg, uint16_t seg_len)
+{
+	record(seq, 0);
+}
+
+static void verify_bool(const char *label, bool result)
+{
+	l_info("%-40s => %s", label, result ? PASS : FAIL);
+
+	if (!result)
+		exit(1);
+}
+
+static struct mesh_friend *new_friend(uint16_t addr, uint8_t size)
+{
+	struct mesh_friend *frnd = l_new(struct mesh_friend, 1);
+
+	frnd->lp_addr = addr;
+	frnd->ele_cnt = 1;
+	frnd->frd = 1;
+	frnd->cache_size = size;
+	frnd->pkt_cache = friend_cache_new(size);
+
+	return frnd;
+}
+
+static void push_msg(struct mesh_friend *frnd, uint32_t seq)
+{
+	struct mesh_friend_msg msg = {
+		.src = PEER_ADDR,
+		.dst = frnd->lp_addr,
+		.last_len = 8,
+	};
+
+	msg.u.one[0].seq = seq;
+	friend_cache_push(frnd, &msg);
+}
+
+static void push_seg_msg(struct mesh_friend *frnd, uint32_t seq,
+							uint8_t seg_max)
+{
+	size_t size = FRND_MSG_SIZE(seg_max);
+	struct mesh_friend_msg *msg = l_malloc(size);
+	uint8_t i;
+
+	memset(msg, 0, size);
+	msg->src = PEER_ADDR;
+	msg->dst = frnd->lp_addr;
+	msg->cnt_in = seg_max;
+	msg->last_len = 12;
+
+	for (i = 0; i <= seg_max; i++) {
+		msg->u.s12[i].hdr = ((uint32_t) 1 << SEG_HDR_SHIFT) |
+					(i << SEGO_HDR_SHIFT) | seg_max;
+		msg->u.s12[i].seq = seq + i;
+	}
+
+	friend_cache_push(frnd, msg);
+	l_free(msg);
+}
+
+static void push_ack(struct mesh_friend *frnd, uint16_t src, uint32_t seq,
+					uint16_t seq_zero, uint32_t flags)
+{
+	struct mesh_friend_msg msg = {
+		.ctl = true,
+		.src = src,
+		.dst = frnd->lp_addr,
+		.last_len = sizeof(flags),
+	};
+
+	msg.u.one[0].hdr = (NET_OP_SEG_ACKNOWLEDGE << OPCODE_HDR_SHIFT) |
+				(seq_zero << SEQ_ZERO_HDR_SHIFT);
+	msg.u.one[0].seq = seq;
+	l_put_be32(flags, msg.u.one[0].data);
+	friend_cache_push(frnd, &msg);
+}
+
+/* Poll as the LPN does, toggling FSN for each response received */
+static void lpn_poll(struct mesh_friend *frnd, bool *fsn)
+{
+	responded = false;
+	friend_poll(NULL, frnd->lp_addr, *fsn, frnd);
+
+	while (!responded)
+		l_main_iterate(10);
+
+	*fsn = !*fsn;
+}
+
+static void check_delivery(void)
+{
+	static const uint32_t expected[] = { 10, 11, 12, 21, 30, 31, 32, 33,
+								34, 35 };
+	struct friend_cache_stats stats;
+	struct mesh_friend *frnd = new_friend(LPN_ADDR, CACHE_SIZE);
+	bool fsn = false, in_order = true;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Friend Queue delivery]" COLOR_OFF);
+
+	/* Oldest three get evicted by the end */
+	for (i = 1; i <= 3; i++)
+		push_msg(frnd, i);
+
+	push_seg_msg(frnd, 10, 2);
+
+	/* Only the latest Ack for a message is kept */
+	push_ack(frnd, PEER_ADDR, 20, 5, 0x1);
+	push_ack(frnd, PEER_ADDR, 21, 5, 0x3);
+
+	for (i = 30; i <= 35; i++)
+		push_msg(frnd, i);
+
+	verify_bool("Friend Queue full",
+				friend_cache_length(frnd) == CACHE_SIZE);
+
+	while (!update_sent)
+		lpn_poll(frnd, &fsn);
+
+	verify_bool("Every queued PDU delivered",
+				num_sent == L_ARRAY_SIZE(expected));
+
+	for (i = 0; i < num_sent; i++)
+		in_order &= sent[i] == expected[i];
+
+	verify_bool("Oldest evicted, rest in order", in_order);
+	verify_bool("Only latest Segment Ack delivered",
+						sent_flags[3] == 0x3);
+
+	friend_cache_get_stats(frnd, &stats);
+
+	verify_bool("Statistics", stats.queued == 11 &&
+				stats.replaced == 1 && stats.evicted == 3 &&
+				stats.delivered == CACHE_SIZE &&
+				stats.peak == CACHE_SIZE);
+
+	/* Evicting the message a response is pending for sends an Update */
+	num_sent = 0;
+	update_sent = false;
+	responded = false;
+
+	push_msg(frnd, 40);
+	friend_poll(NULL, frnd->lp_addr, fsn, frnd);
+
+	for (i = 41; i <= 41 + CACHE_SIZE; i++)
+		push_msg(frnd, i);
+
+	while (!responded)
+		l_main_iterate(10);
+
+	verify_bool("Evicted pending PDU not delivered",
+						!num_sent && update_sent);
+
+	mesh_friend_free(frnd);
+}
+
+static void build_msg(struct mesh_friend_msg *msg, unsigned int i)
+{
+	memset(msg, 0, sizeof(*msg));
+	msg->src = PEER_ADDR + (i & 7);
+	msg->last_len = 8;
+	msg->u.one[0].seq = i;
+
+	/* Every fourth one is a Segment Ack */
+	if (i & 3)
+		return;
+
+	msg->ctl = true;
+	msg->u.one[0].hdr = (NET_OP_SEG_ACKNOWLEDGE << OPCODE_HDR_SHIFT) |
+				((i >> 5 & 0xf) << SEQ_ZERO_HDR_SHIFT);
+}
+
+static void check_reuse(void)
+{
+	struct mesh_friend *frnd = new_friend(LPN_ADDR, FRND_CACHE_MAX);
+	struct friend_cache_stats stats;
+	struct mesh_friend_msg msg;
+	uint32_t allocs;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Friend Queue reuse]" COLOR_OFF);
+
+	memset(&stats, 0, sizeof(stats));
+
+	/* Every slot holds a message once the first one gets evicted */
+	for (i = 0; !stats.evicted && i < NUM_MSGS; i++) {
+		build_msg(&msg, i);
+		friend_cache_push(frnd, &msg);
+		friend_cache_get_stats(frnd, &stats);
+	}
+
+	allocs = stats.allocs;
+
+	for (; i < NUM_MSGS; i++) {
+		build_msg(&msg, i);
+		friend_cache_push(frnd, &msg);
+	}
+
+	friend_cache_get_stats(frnd, &stats);
+
+	verify_bool("Queue bounded by its size",
+			friend_cache_length(frnd) <= FRND_CACHE_MAX &&
+						stats.peak <= FRND_CACHE_MAX);
+	verify_bool("Segment Acks replaced in place", stats.replaced > 0);
+	verify_bool("Every other message queued",
+				stats.queued + stats.replaced == NUM_MSGS);
+	verify_bool("Slots reused once allocated", stats.allocs == allocs);
+
+	mesh_friend_free(frnd);
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	if (!l_main_init())
+		return 1;
+
+	check_delivery();
+	check_reuse();
+
+	l_main_exit();
+
+	return 0;
+}
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <ell/ell.h>
+
+#include "bluetooth/bluetooth.h"
+#include "bluetooth/mgmt.h"
+#include "src/shared/ad.h"
+#include "src/shared/mgmt.h"
+#include "client/display.h"
+
+#include "mesh/mesh-defs.h"
+#include "mesh/mesh-mgmt.h"
+#include "mesh/dbus.h"
+#include "mesh/mesh-io.h"
+#include "mesh/mesh-io-api.h"
+#include "mesh/mesh-io-mgmt.h"
+#include "mesh/mesh-io-generic.h"
+#include "mesh/mesh-io-unit.h"
+
+#define PASS	COLOR_GREEN "PASS" COLOR_OFF
+#define FAIL	COLOR_RED "FAIL" COLOR_OFF
+
+#define NUM_PACKETS		2000
+#define BURST			64
+#define NUM_UUIDS		16
+#define PKT_LEN			29
+
+/* Remote Provisioning scans for specific devices and for extra AD types */
+static const uint8_t ad_types[] = { BT_AD_FLAGS, BT_AD_NAME_COMPLETE,
+					BT_AD_SERVICE_DATA16, BT_AD_URI };
+
+struct filter {
+	uint8_t len;
+	uint8_t data[18];
+	unsigned int expected;
+	unsigned int count;
+};
+
+static struct filter filters[5 + L_ARRAY_SIZE(ad_types) + NUM_UUIDS];
+static unsigned int num_filters;
+
+static uint8_t packets[256][PKT_LEN];
+static char sk_path[] = "/tmp/mesh-io-XXXXXX";
+static struct mesh_io *io;
+static int client_fd;
+static unsigned int sent;
+
+const struct mesh_io_api mesh_io_mgmt;
+const struct mesh_io_api mesh_io_generic;
+
+bool mesh_mgmt_list(mesh_mgmt_read_info_func_t cb, void *user_data)
+{
+	return false;
+}
+
+struct l_dbus *dbus_get_bus(void)
+{
+	return NULL;
+}
+
+static void verify_bool(const char *label, bool result)
+{
+	l_info("%-40s => %s", label, result ? PASS : FAIL);
+
+	if (!result) {
+		unlink(sk_path);
+		exit(1);
+	}
+}
+
+static void recv_cb(void *user_data, struct mesh_io_recv_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	struct filter *filter = user_data;
+
+	filter->count++;
+}
+
+static bool add_filter(const uint8_t *data, uint8_t len)
+{
+	struct filter *filter = &filters[num_filters++];
+
+	memcpy(filter->data, data, len);
+	filter->len = len;
+
+	return mesh_io_register_recv_cb(io, data, len, recv_cb, filter);
+}
+
+static void set_uuid(uint8_t *uuid, unsigned int i)
+{
+	memset(uuid, 0xa5, 16);
+	l_put_be32(i, uuid + 12);
+}
+
+static bool add_filters(void)
+{
+	uint8_t filter[18] = { BT_AD_MESH_BEACON, 0 };
+	bool result = true;
+	unsigned int i;
+
+	/* What the daemon itself registers, with any number of nodes */
+	result &= add_filter((uint8_t []) { BT_AD_MESH_PROV }, 1);
+	result &= add_filter((uint8_t []) { BT_AD_MESH_DATA }, 1);
+	result &= add_filter((uint8_t []) { BT_AD_MESH_BEACON, 1 }, 2);
+	result &= add_filter((uint8_t []) { BT_AD_MESH_BEACON, 2 }, 2);
+	result &= add_filter(filter, 2);
+
+	for (i = 0; i < L_ARRAY_SIZE(ad_types); i++)
+		result &= add_filter(&ad_types[i], 1);
+
+	for (i = 0; i < NUM_UUIDS; i++) {
+		set_uuid(filter + 2, i * 2);
+		result &= add_filter(filter, sizeof(filter));
+	}
+
+	return result;
+}
+
+/* Mostly network PDUs, then beacons, then anything else on the air */
+static void build_packets(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < L_ARRAY_SIZE(packets); i++) {
+		uint8_t *pkt = packets[i];
+
+		l_getrandom(pkt, PKT_LEN);
+
+		if (i % 10 < 6) {
+			pkt[0] = BT_AD_MESH_DATA;
+		} else if (i % 10 < 8) {
+			pkt[0] = BT_AD_MESH_BEACON;
+			pkt[1] = 1;
+		} else if (i % 10 == 8) {
+			pkt[0] = BT_AD_MESH_BEACON;
+			pkt[1] = 0;
+			set_uuid(pkt + 2, i % (NUM_UUIDS * 2));
+		} else {
+			pkt[0] = i & 1 ? BT_AD_MANUFACTURER_DATA :
+							ad_types[i % 4];
+		}
+	}
+}
+
+static void expect_packet(const uint8_t *data, uint8_t len)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_filters; i++) {
+		if (filters[i].len <= len &&
+				!memcmp(data, filters[i].data, filters[i].len))
+			filters[i].expected++;
+	}
+}
+
+static bool counts_match(void)
+{
+	bool result = true;
+	unsigned int i;
+
+	for (i = 0; i < num_filters; i++) {
+		if (filters[i].count != filters[i].expected)
+			result = false;
+
+		filters[i].count = filters[i].expected = 0;
+	}
+
+	return result;
+}
+
+static void check_dispatch(void)
+{
+	struct mesh_io_recv_info info = { 0 };
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Dispatch]" COLOR_OFF);
+
+	for (i = 0; i < L_ARRAY_SIZE(packets); i++) {
+		mesh_io_process_rx(io, &info, packets[i], PKT_LEN);
+		expect_packet(packets[i], PKT_LEN);
+	}
+
+	verify_bool("Packets reach every matching filter", counts_match());
+
+	/* Filters longer than the packet never match */
+	mesh_io_process_rx(io, &info, packets[8], 2);
+	expect_packet(packets[8], 2);
+
+	verify_bool("Short packet skips longer filters", counts_match());
+}
+
+static void deregister_cb(void *user_data, struct mesh_io_recv_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	struct filter *filter = user_data;
+
+	filter->count++;
+
+	/* Drop this filter and the longer one below it while dispatching */
+	mesh_io_deregister_recv_cb(io, filter->data, filter->len);
+	mesh_io_deregister_recv_cb(io, filters[num_filters - 1].data,
+						filters[num_filters - 1].len);
+}
+
+static void check_deregister(void)
+{
+	uint8_t pkt[PKT_LEN] = { BT_AD_MESH_BEACON, 0 };
+	struct filter *filter = &filters[4];
+
+	l_info(COLOR_BLUE "[Deregister]" COLOR_OFF);
+
+	/* Replaces the unprovisioned beacon filter */
+	verify_bool("Replace filter",
+			mesh_io_register_recv_cb(io, filter->data, filter->len,
+							deregister_cb, filter));
+
+	memcpy(pkt + 2, filters[num_filters - 1].data + 2, 16);
+
+	mesh_io_process_rx(io, NULL, pkt, sizeof(pkt));
+	mesh_io_process_rx(io, NULL, pkt, sizeof(pkt));
+
+	verify_bool("Deregistered while dispatching",
+			filter->count == 1 && !filters[num_filters - 1].count);
+	verify_bool("Deregistered filters unlisted",
+			l_queue_length(io->rx_regs) == num_filters - 2);
+
+	/* Pruned nodes are rebuilt when registered again */
+	verify_bool("Register filter again",
+			mesh_io_register_recv_cb(io, filter->data, filter->len,
+							recv_cb, filter));
+
+	mesh_io_process_rx(io, NULL, pkt, sizeof(pkt));
+	verify_bool("Filter called again", filter->count == 2);
+}
+
+static bool send_burst(void)
+{
+	struct sockaddr_un addr = { .sun_family = AF_LOCAL };
+	uint8_t buf[PKT_LEN + 1] = { 1 };
+	unsigned int i;
+
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sk_path);
+
+	for (i = 0; i < BURST && sent < NUM_PACKETS; i++) {
+		memcpy(buf + 1, packets[sent & 0xff], PKT_LEN);
+
+		if (sendto(client_fd, buf, sizeof(buf), MSG_DONTWAIT,
+				(struct sockaddr *) &addr, sizeof(addr)) < 0)
+			return errno == EAGAIN;
+
+		expect_packet(packets[sent & 0xff], PKT_LEN);
+		sent++;
+	}
+
+	return true;
+}
+
+static unsigned int received(void)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < num_filters; i++)
+		count += filters[i].count;
+
+	return count;
+}
+
+static unsigned int expected(void)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < num_filters; i++)
+		count += filters[i].expected;
+
+	return count;
+}
+
+static void check_socket(struct l_idle *idle, void *user_data)
+{
+	if (sent < NUM_PACKETS || received() < expected()) {
+		if (!send_burst())
+			verify_bool("Send packets", false);
+
+		return;
+	}
+
+	l_idle_remove(idle);
+
+	verify_bool("Socket packets reach matching filters", counts_match());
+
+	check_dispatch();
+	check_deregister();
+
+	l_main_quit();
+}
+
+static void io_ready(void *user_data, bool result)
+{
+	l_info(COLOR_BLUE "[Unit IO socket]" COLOR_OFF);
+
+	verify_bool("Unit IO ready", result);
+	verify_bool("Register filters", add_filters());
+
+	build_packets();
+
+	client_fd = socket(PF_LOCAL, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	verify_bool("Open socket", client_fd >= 0);
+
+	l_idle_create(check_socket, NULL, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	if (!l_main_init())
+		return 1;
+
+	if (!mkdtemp(sk_path))
+		return 1;
+
+	rmdir(sk_path);
+
+	io = mesh_io_new(MESH_IO_TYPE_UNIT_TEST, sk_path, io_ready, NULL);
+	verify_bool("Create unit IO", io != NULL);
+
+	l_main_run();
+
+	mesh_io_destroy(io);
+	close(client_fd);
+	unlink(sk_path);
+	l_main_exit();
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <ell/ell.h>
+
+#include "mesh/mesh-defs.h"
+#include "mesh/node.h"
+#include "mesh/util.h"
+#include "mesh/rpl.h"
+
+#include "client/display.h"
+
+#define PASS	COLOR_GREEN "PASS" COLOR_OFF
+#define FAIL	COLOR_RED "FAIL" COLOR_OFF
+
+#define NUM_SOURCES	50
+#define NUM_MESSAGES	1000
+#define IV_INDEX	5
+
+/* Entry in the per-file layout used before the append-only log */
+#define LEGACY_SRC	0x0100
+#define LEGACY_SEQ	0x00000a
+
+static char storage_dir[] = "/tmp/mesh-rpl-XXXXXX";
+static uint32_t last_seq[NUM_SOURCES];
+
+/* Distinct handles standing in for nodes sharing one storage directory */
+static char node_handles[3];
+
+#define NODE(i)	((struct mesh_node *) &node_handles[i])
+
+const char *node_get_storage_dir(struct mesh_node *node)
+{
+	return storage_dir;
+}
+
+static void verify_bool(const char *label, bool result)
+{
+	l_info("%-40s => %s", label, result ? PASS : FAIL);
+
+	if (!result) {
+		del_path(storage_dir);
+		exit(1);
+	}
+}
+
+static bool match_src(const void *a, const void *b)
+{
+	const struct mesh_rpl *rpl = a;
+
+	return rpl->src == L_PTR_TO_UINT(b);
+}
+
+static struct mesh_rpl *find_entry(struct l_queue *list, uint16_t src)
+{
+	return l_queue_find(list, match_src, L_UINT_TO_PTR(src));
+}
+
+static bool write_file(const char *path, int flags, const char *data)
+{
+	size_t len = strlen(data);
+	bool result;
+	int fd;
+
+	fd = open(path, flags, 0600);
+	if (fd < 0)
+		return false;
+
+	result = write(fd, data, len) == (ssize_t) len;
+	close(fd);
+
+	return result;
+}
+
+static bool list_matches(struct mesh_node *node)
+{
+	struct l_queue *list = l_queue_new();
+	struct mesh_rpl *rpl;
+	bool result = false;
+	unsigned int i;
+
+	if (!rpl_get_list(node, list))
+		goto done;
+
+	for (i = 0; i < NUM_SOURCES; i++) {
+		rpl = find_entry(list, i + 1);
+
+		if (!rpl || rpl->seq != last_seq[i] ||
+					rpl->iv_index != IV_INDEX)
+			goto done;
+	}
+
+	rpl = find_entry(list, LEGACY_SRC);
+	result = rpl && rpl->seq == LEGACY_SEQ;
+
+done:
+	l_queue_destroy(list, l_free);
+
+	return result;
+}
+
+static void check_append(void)
+{
+	struct rpl_io_stats stats;
+	char path[PATH_MAX];
+	bool result = true;
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Append to log]" COLOR_OFF);
+
+	snprintf(path, PATH_MAX, "%s/rpl/%8.8x", storage_dir, IV_INDEX);
+	mkdir(path, 0755);
+
+	snprintf(path, PATH_MAX, "%s/rpl/%8.8x/%4.4x", storage_dir,
+							IV_INDEX, LEGACY_SRC);
+	verify_bool("Create legacy entry", write_file(path,
+				O_WRONLY | O_CREAT | O_TRUNC, "00000a"));
+
+	for (i = 0; i < NUM_MESSAGES; i++) {
+		uint16_t src = (i % NUM_SOURCES) + 1;
+
+		last_seq[src - 1] = i + 1;
+		result &= rpl_put_entry(NODE(0), src, IV_INDEX, i + 1);
+	}
+
+	verify_bool("Store entries", result);
+	verify_bool("Read statistics", rpl_get_io_stats(NODE(0), &stats));
+	verify_bool("One record per message", stats.writes == NUM_MESSAGES);
+	verify_bool("Log compacted", stats.compactions > 0);
+}
+
+static void check_reload(void)
+{
+	l_info(COLOR_BLUE "[Reload after crash]" COLOR_OFF);
+
+	/* Reload without releasing, as after a daemon crash */
+	verify_bool("Latest entries and legacy entry loaded",
+						list_matches(NODE(1)));
+	rpl_release(NODE(1));
+}
+
+static void check_torn_record(void)
+{
+	char path[PATH_MAX];
+
+	l_info(COLOR_BLUE "[Torn record]" COLOR_OFF);
+
+	/* A record cut short by a crash must not hide any other one */
+	snprintf(path, PATH_MAX, "%s/rpl/log", storage_dir);
+	verify_bool("Append torn record",
+			write_file(path, O_WRONLY | O_APPEND, "0001 0000"));
+
+	last_seq[0]++;
+	verify_bool("Store entry after torn record",
+			rpl_put_entry(NODE(2), 1, IV_INDEX, last_seq[0]));
+	verify_bool("All entries loaded", list_matches(NODE(1)));
+
+	rpl_release(NODE(1));
+	rpl_release(NODE(2));
+}
+
+static void check_iv_update(void)
+{
+	struct l_queue *list;
+
+	l_info(COLOR_BLUE "[IV Index update]" COLOR_OFF);
+
+	/* Moving two IV Indexes ahead drops every entry */
+	rpl_update(NODE(0), IV_INDEX + 2);
+	rpl_release(NODE(0));
+
+	list = l_queue_new();
+	rpl_get_list(NODE(0), list);
+	verify_bool("Stale entries dropped", l_queue_isempty(list));
+	l_queue_destroy(list, l_free);
+
+	rpl_release(NODE(0));
+}
+
+int main(int argc, char *argv[])
+{
+	l_log_set_stderr();
+
+	if (!l_main_init())
+		return 1;
+
+	if (!mkdtemp(storage_dir))
+		return 1;
+
+	verify_bool("Initialize storage", rpl_init(storage_dir));
+
+	check_append();
+	check_reload();
+	check_torn_record();
+	check_iv_update();
+
+	del_path(storage_dir);
+	l_main_exit();
+
+	return 0;
+}
@@ -0,0 +1,536 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ *
+ *  BlueZ - Bluetooth protocol stack for Linux
+ *
+ *  Copyright (C) 2026  BlueZ contributors
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ell/ell.h>
+
+#include "src/shared/ad.h"
+#include "client/display.h"
+
+#include "mesh/mesh-defs.h"
+#include "mesh/crypto.h"
+#include "mesh/net-keys.h"
+#include "mesh/mesh-io.h"
+#include "mesh/mesh-config.h"
+#include "mesh/node.h"
+#include "mesh/net.h"
+#include "mesh/model.h"
+#include "mesh/appkey.h"
+#include "mesh/rpl.h"
+
+#define SRC_ADDR	0x0001
+#define DST_ADDR	0x0100
+#define MAX_DSTS	16
+#define BLOB_LEN	380
+#define BLOB_SEGS	32
+#define NET_KEY_ID	1
+
+#define PASS	COLOR_GREEN "PASS" COLOR_OFF
+#define FAIL	COLOR_RED "FAIL" COLOR_OFF
+
+/* Only ever handed back to the stubs below */
+struct mesh_node {
+	uint16_t addr;
+};
+
+static const uint8_t net_key[16];
+static struct mesh_node nodes[MAX_DSTS + 1];
+
+static struct mesh_net *sender;
+static struct mesh_net *receivers[MAX_DSTS];
+
+static unsigned int delivered[MAX_DSTS];
+static uint8_t last_id[MAX_DSTS];
+static unsigned int segs_sent;
+static unsigned int acks_sent;
+static bool lossy;
+
+static void verify_bool(const char *label, bool result)
+{
+	l_info("%-40s => %s", label, result ? PASS : FAIL);
+
+	if (!result)
+		exit(1);
+}
+
+void appkey_key_free(void *data)
+{
+}
+
+void appkey_finalize(struct mesh_net *net, uint16_t net_idx)
+{
+}
+
+void appkey_delete_bound_keys(struct mesh_net *net, uint16_t net_idx)
+{
+}
+
+bool mesh_config_net_key_add(struct mesh_config *cfg, uint16_t net_idx,
+							const uint8_t key[16])
+{
+	return true;
+}
+
+bool mesh_config_net_key_update(struct mesh_config *cfg, uint16_t idx,
+							const uint8_t key[16])
+{
+	return true;
+}
+
+bool mesh_config_net_key_del(struct mesh_config *cfg, uint16_t net_idx)
+{
+	return true;
+}
+
+bool mesh_config_net_key_set_phase(struct mesh_config *cfg, uint16_t idx,
+								uint8_t phase)
+{
+	return true;
+}
+
+bool mesh_config_write_iv_index(struct mesh_config *cfg, uint32_t idx,
+								bool update)
+{
+	return true;
+}
+
+struct mesh_config *node_config_get(struct mesh_node *node)
+{
+	return NULL;
+}
+
+uint16_t node_get_crpl(struct mesh_node *node)
+{
+	return MAX_DSTS + 1;
+}
+
+void node_property_changed(struct mesh_node *node, const char *property)
+{
+}
+
+bool node_set_sequence_number(struct mesh_node *node, uint32_t seq)
+{
+	return true;
+}
+
+bool rpl_put_entry(struct mesh_node *node, uint16_t src, uint32_t iv_index,
+								uint32_t seq)
+{
+	return true;
+}
+
+bool rpl_get_list(struct mesh_node *node, struct l_queue *rpl_list)
+{
+	return true;
+}
+
+void rpl_update(struct mesh_node *node, uint32_t iv_index)
+{
+}
+
+bool mesh_io_register_recv_cb(struct mesh_io *io, const uint8_t *filter,
+					uint8_t len, mesh_io_recv_func_t cb,
+					void *user_data)
+{
+	return true;
+}
+
+bool mesh_io_deregister_recv_cb(struct mesh_io *io, const uint8_t *filter,
+								uint8_t len)
+{
+	return true;
+}
+
+/* Every node lives in this process, so nothing goes on the air */
+bool mesh_io_send(struct mesh_io *io, struct mesh_io_send_info *info,
+					const uint8_t *data, uint16_t len)
+{
+	return true;
+}
+
+bool mesh_io_send_cancel(struct mesh_io *io, const uint8_t *pattern,
+								uint8_t len)
+{
+	return true;
+}
+
+uint32_t net_key_add(const uint8_t flooding[16])
+{
+	return NET_KEY_ID;
+}
+
+bool net_key_confirm(uint32_t id, const uint8_t flooding[16])
+{
+	return id == NET_KEY_ID;
+}
+
+uint32_t net_key_frnd_add(uint32_t flooding_id, uint16_t lpn, uint16_t frnd,
+					uint16_t lp_cnt, uint16_t fn_cnt)
+{
+	return 0;
+}
+
+void net_key_unref(uint32_t id)
+{
+}
+
+uint32_t net_key_beacon(const uint8_t *data, uint16_t len, uint32_t *ivi,
+							bool *ivu, bool *kr)
+{
+	return 0;
+}
+
+void net_key_beacon_seen(uint32_t id)
+{
+}
+
+bool net_key_beacon_refresh(uint32_t id, uint32_t iv_index, bool kr, bool ivu,
+								bool force)
+{
+	return true;
+}
+
+void net_key_beacon_enable(uint32_t id, bool mpb, uint8_t refresh_count)
+{
+}
+
+void net_key_beacon_disable(uint32_t id, bool mpb)
+{
+}
+
+uint32_t net_key_beacon_last_seen(uint32_t id)
+{
+	return 0;
+}
+
+static bool parse(const uint8_t *pkt, size_t len, bool *ctl, uint32_t *seq,
+					bool *segmented, uint16_t *seqZero,
+					uint8_t *segO, uint8_t *segN)
+{
+	uint8_t ttl, key_aid, opcode, payload_len;
+	uint16_t src, dst;
+	uint32_t cookie;
+	bool szmic, relay;
+	const uint8_t *payload;
+
+	return mesh_crypto_packet_parse(pkt, len, ctl, &ttl, seq, &src, &dst,
+					&cookie, &opcode, segmented, &key_aid,
+					&szmic, &relay, seqZero, segO, segN,
+					&payload, &payload_len);
+}
+
+/* Packets are sent in the clear, counted on the way out */
+bool net_key_encrypt(uint32_t id, uint32_t iv_index, uint8_t *pkt, size_t len)
+{
+	uint16_t seqZero;
+	uint32_t seq;
+	uint8_t segO, segN;
+	bool ctl, segmented;
+
+	if (!parse(pkt, len, &ctl, &seq, &segmented, &seqZero, &segO, &segN))
+		return false;
+
+	if (ctl)
+		acks_sent++;
+	else if (segmented)
+		segs_sent++;
+
+	return true;
+}
+
+/*
+ * With losses, the first transmission of every eighth segment never makes
+ * it. Segment retransmissions are sent on new sequence numbers, which is
+ * what tells them apart from the first transmission.
+ */
+static bool dropped(const uint8_t *pkt, size_t len)
+{
+	uint16_t seqZero;
+	uint32_t seq;
+	uint8_t segO, segN;
+	bool ctl, segmented;
+
+	if (!lossy || !parse(pkt, len, &ctl, &seq, &segmented, &seqZero,
+								&segO, &segN))
+		return false;
+
+	if (ctl || !segmented || segO == segN || segO % 8 != 3)
+		return false;
+
+	return ((seq - seqZero) & SEQ_ZERO_MASK) == segO + 1U;
+}
+
+uint32_t net_key_decrypt(uint32_t iv_index, const uint8_t *pkt, size_t len,
+					uint8_t **plain, size_t *plain_len)
+{
+	static uint8_t buf[MESH_NET_MAX_PDU_LEN];
+
+	if (len > sizeof(buf) || dropped(pkt, len))
+		return 0;
+
+	memcpy(buf, pkt, len);
+	*plain = buf;
+	*plain_len = len;
+
+	return NET_KEY_ID;
+}
+
+bool mesh_model_rx(struct mesh_node *node, bool szmict, uint32_t seq0,
+			uint32_t iv_index, uint16_t net_idx, uint16_t src,
+			uint16_t dst, uint8_t key_aid, const uint8_t *data,
+								uint16_t size)
+{
+	unsigned int i = dst - DST_ADDR;
+	uint16_t j;
+
+	/* The sender offers its own messages to its local models first */
+	if (node->addr != dst)
+		return false;
+
+	if (src != SRC_ADDR || size != BLOB_LEN)
+		verify_bool("Unexpected message delivered", false);
+
+	for (j = 1; j < size; j++) {
+		if (data[j] != (uint8_t) (data[0] + j))
+			verify_bool("Message corrupted", false);
+	}
+
+	if (delivered[i]++ && (int8_t) (data[0] - last_id[i]) <= 0)
+		verify_bool("Messages out of order", false);
+
+	last_id[i] = data[0];
+
+	return true;
+}
+
+static struct mesh_net *create_net(struct mesh_node *node, uint16_t addr)
+{
+	struct mesh_net *net = mesh_net_new(node);
+
+	node->addr = addr;
+
+	/* Nodes in the same process hear each other without any IO */
+	if (!mesh_net_register_unicast(net, addr, 1) ||
+			mesh_net_add_key(net, PRIMARY_NET_IDX, net_key) ||
+			!mesh_net_attach(net, NULL))
+		verify_bool("Create node", false);
+
+	return net;
+}
+
+static void send_blob(unsigned int dst, uint8_t id)
+{
+	uint8_t msg[BLOB_LEN];
+	uint16_t i;
+
+	for (i = 0; i < sizeof(msg); i++)
+		msg[i] = id + i;
+
+	if (!mesh_net_app_send(sender, false, SRC_ADDR, DST_ADDR + dst,
+				APP_AID_DEV, PRIMARY_NET_IDX, DEFAULT_TTL, 0, 0,
+				mesh_net_next_seq_num(sender),
+				mesh_net_get_iv_index(sender), true, false,
+				msg, sizeof(msg)))
+		verify_bool("Send message", false);
+}
+
+static unsigned int total_delivered(void)
+{
+	unsigned int i, count = 0;
+
+	for (i = 0; i < MAX_DSTS; i++)
+		count += delivered[i];
+
+	return count;
+}
+
+static void reset_counts(void)
+{
+	memset(delivered, 0, sizeof(delivered));
+	segs_sent = acks_sent = 0;
+}
+
+/* Runs until every message is in and the last Ack got back to the sender */
+static void run(unsigned int expected)
+{
+	uint64_t start = l_time_now();
+
+	while (total_delivered() < expected) {
+		l_main_iterate(l_main_prepare());
+
+		if (l_time_diff(start, l_time_now()) > 30 * L_USEC_PER_SEC)
+			verify_bool("Transfer stalled", false);
+	}
+
+	while (l_main_prepare() == 0)
+		l_main_iterate(0);
+}
+
+static void check_transfer(void)
+{
+	l_info(COLOR_BLUE "[Lossless transfer]" COLOR_OFF);
+
+	reset_counts();
+	send_blob(0, 0);
+	run(1);
+
+	verify_bool("Segments sent once, one Ack",
+				segs_sent == BLOB_SEGS && acks_sent == 1);
+
+	/* Nothing outstanding, so a new message goes out right away */
+	send_blob(0, 1);
+	run(2);
+
+	verify_bool("Next message sent right away",
+			segs_sent == BLOB_SEGS * 2 && acks_sent == 2);
+}
+
+static void check_loss(void)
+{
+	l_info(COLOR_BLUE "[Lossy transfer]" COLOR_OFF);
+
+	lossy = true;
+	reset_counts();
+	send_blob(1, 0);
+	run(1);
+	lossy = false;
+
+	/* Only the four lost segments are sent again, on the first NAK */
+	verify_bool("Only lost segments resent",
+			segs_sent == BLOB_SEGS + 4 && acks_sent == 2);
+}
+
+static void check_queue(void)
+{
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Queued transfers]" COLOR_OFF);
+
+	reset_counts();
+
+	/* Held back behind the first, then sent one after the other */
+	for (i = 0; i < 4; i++)
+		send_blob(2, i);
+
+	for (i = 0; i < 4; i++)
+		send_blob(3, i);
+
+	verify_bool("One message in flight per destination",
+						segs_sent == BLOB_SEGS * 2);
+
+	run(8);
+
+	verify_bool("Held back messages sent",
+				delivered[2] == 4 && delivered[3] == 4 &&
+						segs_sent == BLOB_SEGS * 8);
+}
+
+static bool stage_matches(const struct mesh_net_stage_stats *stage,
+							uint32_t count)
+{
+	uint32_t total = 0;
+	unsigned int i;
+
+	for (i = 0; i < MESH_NET_HIST_BUCKETS; i++)
+		total += stage->hist[i];
+
+	return stage->count == count && total == count &&
+					stage->max_us <= stage->total_us;
+}
+
+/* Every node hears every packet: 32 segments and one Ack */
+static void check_stats(void)
+{
+	struct mesh_net_stats tx, rx, other;
+
+	l_info(COLOR_BLUE "[Statistics]" COLOR_OFF);
+
+	reset_counts();
+	send_blob(0, 0);
+	run(1);
+
+	verify_bool("Read statistics", mesh_net_get_stats(sender, &tx) &&
+				mesh_net_get_stats(receivers[0], &rx) &&
+				mesh_net_get_stats(receivers[1], &other));
+
+	verify_bool("Received packets counted",
+				tx.rx_packets == BLOB_SEGS + 1 &&
+				rx.rx_packets == BLOB_SEGS + 1 &&
+				other.rx_packets == BLOB_SEGS + 1);
+
+	verify_bool("No other packets counted",
+				!tx.rx_not_decrypted && !tx.rx_duplicates &&
+				!tx.rx_replayed && !tx.relayed &&
+				!tx.tx_packets);
+
+	verify_bool("Stages timed once per packet",
+		stage_matches(&tx.stage[MESH_NET_STAGE_NET_DECRYPT],
+							BLOB_SEGS + 1) &&
+		stage_matches(&tx.stage[MESH_NET_STAGE_RX], BLOB_SEGS + 1) &&
+		stage_matches(&tx.stage[MESH_NET_STAGE_TX_QUEUE], BLOB_SEGS) &&
+		stage_matches(&rx.stage[MESH_NET_STAGE_TX_QUEUE], 1) &&
+		stage_matches(&other.stage[MESH_NET_STAGE_TX_QUEUE], 0));
+}
+
+static void check_expired(void)
+{
+	unsigned int i;
+
+	l_info(COLOR_BLUE "[Expired transfers]" COLOR_OFF);
+
+	reset_counts();
+
+	/* Later ones can't go out once SeqZero is too far behind */
+	for (i = 0; i < 300; i++)
+		send_blob(4, i);
+
+	run(1);
+
+	verify_bool("Expired messages dropped",
+				delivered[4] >= 200 && delivered[4] < 300);
+
+	/* Nothing is left held back */
+	send_blob(4, i);
+	run(delivered[4] + 1);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+
+	l_log_set_stderr();
+
+	if (!l_main_init())
+		return 1;
+
+	sender = create_net(&nodes[MAX_DSTS], SRC_ADDR);
+
+	for (i = 0; i < MAX_DSTS; i++)
+		receivers[i] = create_net(&nodes[i], DST_ADDR + i);
+
+	check_stats();
+	check_transfer();
+	check_loss();
+	check_queue();
+	check_expired();
+
+	mesh_net_cleanup();
+	l_main_exit();
+
+	return 0;
+}
@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <string.h>
 #include <fcntl.h>
+#include <time.h>
 #include <sys/socket.h>
 
 #include <glib.h>
@@ -331,6 +332,273 @@ static void test_server(gconstpointer data)
 }
 
 
+#define BENCH_ROUNDS		500
+#define BENCH_REPORTS		8
+#define BENCH_REPORT_SIZE	8
+
+struct bench {
+	struct bt_uhid *uhid;
+	int fd;
+	guint source;
+	bool batch;
+	unsigned int round;
+	unsigned int msgs;
+	unsigned int reports;
+	size_t bytes;
+	size_t expected;
+	struct timespec start;
+};
+
+static void bench_free(struct bench *bench)
+{
+	if (bench->source > 0)
+		g_source_remove(bench->source);
+
+	bt_uhid_unregister_all(bench->uhid);
+	bt_uhid_unref(bench->uhid);
+	g_free(bench);
+}
+
+static void bench_done(struct bench *bench)
+{
+	struct bt_uhid_input_stats stats;
+	struct timespec now;
+	double elapsed;
+	unsigned int reports = BENCH_ROUNDS * BENCH_REPORTS;
+	uint64_t written = 0;
+	unsigned int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	elapsed = (now.tv_sec - bench->start.tv_sec) +
+			(now.tv_nsec - bench->start.tv_nsec) / 1e9;
+
+	bt_uhid_get_input_stats(bench->uhid, &stats);
+
+	tester_print("%u reports in %u writes (%zu bytes) in %.3f ms",
+			reports, bench->msgs, bench->bytes, elapsed * 1000);
+
+	g_assert_cmpint(bench->reports, ==, reports);
+	g_assert_cmpint(stats.reports, ==, reports);
+	g_assert_cmpint(stats.writes, ==, bench->msgs);
+	g_assert_cmpint(stats.errors, ==, 0);
+
+	/* Latency is accounted once each report has been written */
+	for (i = 0; i < BT_UHID_LATENCY_BUCKETS; i++)
+		written += stats.latency[i];
+
+	g_assert_cmpint(written, ==, reports);
+
+	tester_print("latency avg %" PRIu64 " max %" PRIu64 " usec",
+				stats.latency_sum / written, stats.latency_max);
+
+	/* Reports of the same mainloop iteration must share one write */
+	if (bench->batch)
+		g_assert_cmpint(bench->msgs, ==, BENCH_ROUNDS);
+	else
+		g_assert_cmpint(bench->msgs, ==, reports);
+
+	if (elapsed > 0)
+		tester_perf_value(reports / elapsed, "reports/s", true);
+
+	bench_free(bench);
+	tester_test_passed();
+}
+
+static gboolean bench_round(gpointer user_data)
+{
+	struct bench *bench = user_data;
+	uint8_t report[BENCH_REPORT_SIZE];
+	unsigned int i;
+
+	for (i = 0; i < BENCH_REPORTS; i++) {
+		memset(report, bench->round + i, sizeof(report));
+
+		if (bt_uhid_input(bench->uhid, 0, report, sizeof(report)) < 0) {
+			tester_test_failed();
+			return FALSE;
+		}
+	}
+
+	return ++bench->round < BENCH_ROUNDS;
+}
+
+static void bench_start(struct uhid_event *ev, void *user_data)
+{
+	struct bench *bench = user_data;
+
+	clock_gettime(CLOCK_MONOTONIC, &bench->start);
+
+	g_idle_add(bench_round, bench);
+}
+
+static gboolean bench_destroy_round(gpointer user_data)
+{
+	struct bench *bench = user_data;
+	uint8_t report[BENCH_REPORT_SIZE];
+	unsigned int i;
+
+	for (i = 0; i < BENCH_REPORTS; i++) {
+		memset(report, i, sizeof(report));
+
+		if (bt_uhid_input(bench->uhid, 0, report, sizeof(report)) < 0) {
+			tester_test_failed();
+			return FALSE;
+		}
+	}
+
+	/* Reports pending a batched write must go out ahead of the destroy */
+	if (bt_uhid_destroy(bench->uhid, true) < 0)
+		tester_test_failed();
+
+	return FALSE;
+}
+
+static void bench_destroy(struct uhid_event *ev, void *user_data)
+{
+	g_idle_add(bench_destroy_round, user_data);
+}
+
+/*
+ * A batched write carries several events back to back, /dev/uhid handles
+ * each iovec as an event of its own so check them one by one.
+ */
+static void bench_check_input(struct bench *bench, const uint8_t *buf,
+								size_t len)
+{
+	size_t hdr = offsetof(struct uhid_event, u.input2.data);
+
+	while (len) {
+		const struct uhid_event *ev = (const void *) buf;
+		unsigned int round = bench->reports / BENCH_REPORTS;
+		unsigned int i = bench->reports % BENCH_REPORTS;
+		size_t ev_len = bench->batch ? hdr + BENCH_REPORT_SIZE :
+							sizeof(*ev);
+		uint8_t report[BENCH_REPORT_SIZE];
+
+		g_assert(len >= ev_len);
+		g_assert_cmpint(ev->type, ==, UHID_INPUT2);
+		g_assert_cmpint(ev->u.input2.size, ==, BENCH_REPORT_SIZE);
+
+		/* Reports must arrive in order and intact */
+		memset(report, round + i, sizeof(report));
+		g_assert(!memcmp(ev->u.input2.data, report, sizeof(report)));
+
+		bench->reports++;
+		buf += ev_len;
+		len -= ev_len;
+	}
+}
+
+static gboolean bench_handler(GIOChannel *channel, GIOCondition cond,
+							gpointer user_data)
+{
+	struct bench *bench = user_data;
+	struct uhid_event ev;
+	ssize_t len;
+
+	if (cond & (G_IO_NVAL | G_IO_ERR | G_IO_HUP)) {
+		bench->source = 0;
+		return FALSE;
+	}
+
+	len = read(bench->fd, &ev, sizeof(ev));
+	g_assert(len > 0);
+
+	/* Act as the kernel and start the device once it is created */
+	if (ev.type == UHID_CREATE2) {
+		memset(&ev, 0, sizeof(ev));
+		ev.type = UHID_START;
+
+		len = write(bench->fd, &ev, sizeof(ev));
+		g_assert_cmpint(len, ==, sizeof(ev));
+
+		return TRUE;
+	}
+
+	if (ev.type == UHID_DESTROY) {
+		g_assert_cmpint(bench->reports, ==, BENCH_REPORTS);
+		g_assert_cmpint(bench->msgs, ==, 1);
+
+		bench->source = 0;
+		bench_free(bench);
+		tester_test_passed();
+		return FALSE;
+	}
+
+	bench_check_input(bench, (const uint8_t *) &ev, len);
+
+	bench->msgs++;
+	bench->bytes += len;
+
+	if (bench->bytes == bench->expected) {
+		bench->source = 0;
+		bench_done(bench);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void bench_new(bool batch, bt_uhid_callback_t start)
+{
+	struct bench *bench = g_new0(struct bench, 1);
+	GIOChannel *channel;
+	size_t report_len;
+	int err, sv[2];
+
+	bench->batch = batch;
+
+	err = socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv);
+	g_assert(err == 0);
+
+	bench->uhid = bt_uhid_new(sv[0]);
+	g_assert(bench->uhid != NULL);
+
+	bt_uhid_set_close_on_unref(bench->uhid, true);
+	bt_uhid_set_input_batch(bench->uhid, bench->batch);
+
+	/* Batched reports are written without the unused part of the event */
+	if (bench->batch)
+		report_len = offsetof(struct uhid_event, u.input2.data) +
+							BENCH_REPORT_SIZE;
+	else
+		report_len = sizeof(struct uhid_event);
+
+	bench->expected = BENCH_ROUNDS * BENCH_REPORTS * report_len;
+
+	channel = g_io_channel_unix_new(sv[1]);
+
+	g_io_channel_set_close_on_unref(channel, TRUE);
+	g_io_channel_set_encoding(channel, NULL, NULL);
+	g_io_channel_set_buffered(channel, FALSE);
+
+	bench->source = g_io_add_watch(channel,
+				G_IO_IN | G_IO_HUP | G_IO_ERR | G_IO_NVAL,
+				bench_handler, bench);
+	g_assert(bench->source > 0);
+
+	g_io_channel_unref(channel);
+
+	bench->fd = sv[1];
+
+	bt_uhid_register(bench->uhid, UHID_START, start, bench);
+
+	err = bt_uhid_create(bench->uhid, "", NULL, NULL, 0, 0, 0, 0,
+						BT_UHID_NONE, NULL, 0);
+	g_assert(err == 0);
+}
+
+static void test_benchmark(gconstpointer data)
+{
+	bench_new(PTR_TO_INT(data), bench_start);
+}
+
+static void test_input_batch_destroy(gconstpointer data)
+{
+	bench_new(true, bench_destroy);
+}
+
 static struct test_device mx_anywhere_3 = {
 	.name = "MX Anywhere 3",
 	.vendor = 0x46D,
@@ -369,5 +637,13 @@ int main(int argc, char *argv[])
 	define_test_device("/uhid/device/mx_anywhere_3", test_client,
 					&mx_anywhere_3, event(&ev_create));
 
+	tester_add("/uhid/input_batch/destroy", NULL, NULL,
+					test_input_batch_destroy, NULL);
+
+	tester_add("/uhid/benchmark/input", INT_TO_PTR(false), NULL,
+						test_benchmark, NULL);
+	tester_add("/uhid/benchmark/input_batch", INT_TO_PTR(true), NULL,
+						test_benchmark, NULL);
+
 	return tester_run();
 }